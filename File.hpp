@@ -7,16 +7,29 @@
 
 #include <atomic>
 #include <cstdint>
+#include <functional>
+#include <mutex>
+#include <span>
 #include <string>
+#include <vector>
 
 /*
  * TODO:
  * [ ] lock
- * [ ] pread
+ * [x] pread
  * [ ] pwrite
  * [ ] UserCredentials
  */
 
+class FileChunkReader;
+class FileDirectory;
+class FileFollower;
+class FileRecords;
+class FileView;
+struct FileChunk;
+struct FileContext;
+struct FileEntry;
+
 /**
  * A class for abstracting the details of files regardless of type, location, or scheme.
  * I'm tired of having to use different interfaces for local versus remote files. Sure I'll have
@@ -32,14 +45,59 @@ private:
 	// at the interface layer, before going down into the
 	// protocol specific codes; which are stored in the
 	// file context object.
-	int mErrorCode;
+	mutable int mErrorCode;
+
+	// Set while the file is pinned to a thread by pin(): its context, cached so
+	// that reads and writes skip the registry, whether this is the only File
+	// referencing it, and the registry epoch at which both held.
+	struct FileContext* mPinnedContext;
+	bool mPinnedExclusive;
+	uint64_t mPinnedEpoch;
+
+	struct FileContext* getContext( std::unique_lock< std::mutex >& contextLock );
+
+	// A follower refreshes the files it follows, and a poller waits on them;
+	// both set the error codes of the files. Tables and record ranges take theirs.
+	friend class FileFollower;
+	friend class FilePoller;
+	friend class FileRecords;
+	friend class FileTableReader;
+	friend class FileTableWriter;
 
 public:
 	enum IOFlag : uint32_t
 	{
 		READ = 0x1,
 		WRITE = 0x2,
-		SEEK = 0x4
+		SEEK = 0x4,
+		// Write a replacement for the file, which takes its place atomically on commit() or close().
+		ATOMIC = 0x8,
+		// Don't block reading or writing a pipe, device, or socket; fail with EAGAIN
+		// instead, and wait for it to be ready with a FilePoller.
+		NONBLOCK = 0x10,
+		// Defer opening the resource, e.g. connecting to a server, until the file is first
+		// used, bar position() and setPriority(); or warm it up ahead with prefetch().
+		// Errors opening it are reported by that first use, and the open is retried by the next.
+		LAZY = 0x20
+	};
+
+	// Priority classes of the I/O scheduler, which all reads and writes pass through.
+	// Lower classes yield to higher ones, and are admitted once they reach their deadline.
+	enum IOPriority : uint8_t
+	{
+		FOREGROUND, // Latency sensitive; never held back, bar bandwidth limits
+		NORMAL,
+		BACKGROUND // e.g. compaction, backups
+	};
+
+	// Counters of the handle budget of local files, returned by handleStats().
+	struct HandleStats
+	{
+		uint64_t budget; // The most handles held open at once, bar those in use
+		uint64_t openHandles;
+		uint64_t files; // Within the budget, whether their handle is open or not
+		uint64_t evictions; // Idle handles closed to stay within the budget
+		uint64_t reopens; // Closed handles reopened on their next use
 	};
 
 	/**
@@ -81,20 +139,119 @@ public:
 	 *         errorMessage(). On error, -1 is returned and the error message can
 	 *         be retrieved via errorMessage().
 	 */
-	int64_t append( const uint8_t* buffer, uint32_t count );
+	int64_t append( const uint8_t* buffer, size_t count );
+
+	/**
+	 * Write to the end of the file the requested number of bytes
+	 * without updating the file position, and report where they were written.
+	 * When opened with "group_commit=1", e.g. "file:///logs/x.log?group_commit=1",
+	 * concurrent appends reserve their offsets up front and are written and made
+	 * durable together, by one vectored write and one fdatasync(), rather than one
+	 * synchronous write each. A failed group append leaves its reserved range unwritten.
+	 * @param buffer Pointer to an array of const bytes.
+	 * @param count The number of byte to write from {@param buffer}.
+	 * @param offset Reference to store the offset the bytes were written at.
+	 * @return The number of bytes appended to the file is returned. On error, -1 is
+	 *         returned and the error message can be retrieved via errorMessage().
+	 */
+	int64_t append( const uint8_t* buffer, size_t count, int64_t& offset );
+
+	/**
+	 * Begin a batch of writes, to be made durable together by commit(). This requires
+	 * the file to have been opened in journal mode, e.g. "file:///data/x.db?journal=1",
+	 * where writes are first appended with checksums to a journal next to the file
+	 * ("x.db.journal"), and applied in place once durable there. A crash can then never
+	 * leave a batch half written: it is completed from the journal when next opened.
+	 * Outside of a batch, every write is committed on its own. Reads see the writes
+	 * of the batch in progress. A batch still open when the file is closed is discarded.
+	 * @return True is returned on success. False is returned on error, including when
+	 *         a batch is already open, or the file isn't in journal mode.
+	 */
+	bool beginBatch();
 
 	/**
 	 * Average of the observed read byte-rate (bytes per second).
 	 * @param ioFlag Flag indicating which byte-rate to return. If both Read and Write
 	 *               are set, then the Read byte-rate is returned. If neither Read nor
-	 *               Write are set, then NaN is returned. [default: File::IOFlag::Read]
+	 *               Write are set, then NaN is returned. [default: File::IOFlag::READ]
 	 * @return An average of bytes read/written per second. NaN is returned on error,
 	 *         and zero indicates either nothing has been read/written, or you're using AvianIP (RFC-1149).
 	 */
-	double byteRate( File::IOFlag ioFlag = File::IOFlag::Read ) const;
+	double byteRate( File::IOFlag ioFlag = File::IOFlag::READ ) const;
+
+	/**
+	 * Commit the batch begun by beginBatch(). Its writes are made durable by a single
+	 * write and flush of the journal, and then applied in place. The file itself is only
+	 * flushed by sync(), or once the journal has grown large, after which the journal is
+	 * emptied.
+	 * For a file opened with File::IOFlag::ATOMIC, what was written is instead flushed and
+	 * renamed over the file, in one step as far as readers can tell, and the rename made
+	 * durable. Writes after that go to the file in place. Closing commits as well.
+	 * @return True is returned once the batch is durable, or if no batch is open.
+	 *         False is returned on error, and the batch is discarded.
+	 */
+	bool commit();
+
+	/**
+	 * Commit many files opened with File::IOFlag::ATOMIC. The files are flushed
+	 * in parallel and renamed over their targets, and then each directory involved
+	 * is synced once, rather than once per file.
+	 * @param files The files to commit.
+	 * @return True is returned if every file was committed. Otherwise false is returned,
+	 *         and the error code of each file that failed is set.
+	 */
+	static bool commitMany( std::span< File > files );
+
+	/**
+	 * List the byte ranges of the file backed by data. The holes of a sparse file
+	 * read back as zeros without occupying storage, so a copy need only read and
+	 * write these ranges, and resize() the copy to the size of the file.
+	 * Include "FileChunks.hpp".
+	 * @return The ranges, in order. If the resource has no notion of holes, the whole
+	 *         file is returned as one range. An empty vector is returned on error,
+	 *         or if the file is empty or entirely a hole.
+	 */
+	std::vector< FileChunk > dataRegions();
+
+	/**
+	 * Digest of the bytes read or written contiguously from the beginning of the file,
+	 * computed as they stream through read/write/append. The digest is selected when
+	 * opening, e.g. "file:///data/x.bin?digest=crc32c" (or "digest=xxh3"). Adding
+	 * "block_checksums=65536" also keeps a CRC32C per 64 KiB block in a sidecar file,
+	 * against which every read is verified.
+	 * @return The digest as a lowercase hexadecimal string. An empty string is returned
+	 *         on error, or if bytes already digested have since been overwritten.
+	 */
+	std::string digest();
+
+	/**
+	 * Open another handle on the file, with a file position and I/O stats of its own,
+	 * which shares what was opened (e.g. the file descriptor of a local file) rather than
+	 * opening the file again. Unlike copies of this File, which share one file position,
+	 * handles can each read through the file without contending, e.g. one per thread.
+	 * The handle is read only, and starts at the file position of this file. What was
+	 * opened is closed once every handle on it is. The file must be open for reading.
+	 * @return The handle is returned. On error, a null File is returned and the error
+	 *         code is set; ENOTSUP if the file is a stream, or its scheme can't share it.
+	 */
+	File dup();
+
+	/**
+	 * Divide the file into byte ranges that begin and end on record boundaries.
+	 * Each range starts just after a delimiter, so no record is split between ranges.
+	 * Include "FileChunks.hpp".
+	 * @param count The number of ranges requested. Fewer are returned if records span
+	 *              the nominal boundaries, or the file is smaller than {@param count} bytes.
+	 * @param delimiter The byte terminating each record. [default: '\n']
+	 * @return The ranges, in order, covering the whole file. An empty vector is returned
+	 *         on error, or if the size of the file is indeterminate.
+	 */
+	std::vector< FileChunk > chunks( size_t count, uint8_t delimiter = '\n' );
 
 	/**
-	 * If applicable, close the file and release the resources.
+	 * If applicable, close the file and release the resources. The resource itself is
+	 * closed along with the last copy of the File referencing it, which writes the final
+	 * frame of a codec, checkpoints a journal, and commits an atomic write.
 	 * Should no file be open, this method does nothing.
 	 */
 	void close();
@@ -106,6 +263,43 @@ public:
 	 */
 	std::string errorMessage( bool clearAfterRead = true );
 
+	/**
+	 * Get the counters of the handle budget of local files; see setHandleBudget().
+	 * @return The counters are returned.
+	 */
+	static File::HandleStats handleStats();
+
+	/**
+	 * Iterate over the lines of the file from the current file position. Lines are
+	 * delimited by '\n', and a trailing '\r' is stripped. Include "FileRecords.hpp".
+	 * @return A range of std::string_view over the lines of the file. An error ends
+	 *         the range early, and can be retrieved via the range's errorMessage().
+	 */
+	FileRecords lines();
+
+	/**
+	 * List the entries of a directory, e.g. File::list( "/data", "*.csv" ).
+	 * Include "FileDirectory.hpp".
+	 * @param uri Path to a directory or a URI.
+	 * @param pattern Only list the entries whose names match this shell wildcard pattern. [default: all]
+	 * @param metadata Stat the entries for their size, modification time, and mode. [default: false]
+	 * @return A range over the entries of the directory. Should listing fail,
+	 *         the range is empty and the cause can be retrieved via its errorMessage().
+	 */
+	static FileDirectory list( const std::string& uri, const std::string& pattern = "", bool metadata = false );
+
+	/**
+	 * Open many files at once. The paths are normalized up front, the resources
+	 * are opened in parallel on a pool of threads, and all of the opened files
+	 * are registered together, which amortizes the cost of opening each in turn.
+	 * @param filepaths Paths to files or URIs.
+	 * @param mode Mode in which to open the files.
+	 * @return A File instance is returned for each of {@param filepaths}, in order.
+	 *         A File that failed to open is a null file handle, and the cause can
+	 *         be retrieved via its errorMessage().
+	 */
+	static std::vector< File > openMany( std::span< const std::string > filepaths, File::IOFlag mode );
+
 	/**
 	 * Open a file to this File instance.
 	 * @param filepath Path to a file or a URI.
@@ -137,7 +331,20 @@ public:
 	 *         via errorMessage(). On error, -1 is returned and the error message can
 	 *         be retrieved via errorMessage().
 	 */
-	int64_t peek( uint8_t* buffer, uint32_t count );
+	int64_t peek( uint8_t* buffer, size_t count );
+
+	/**
+	 * Pin the file to the calling thread, for tight loops of reads and writes.
+	 * The context of the file is cached rather than looked up in the registry on
+	 * each read(), peek(), pread(), write(), and append(), and while this is the only
+	 * File referencing it, isn't locked either. The cache is refreshed whenever
+	 * a File is copied or closed, anywhere. Until unpin() or close(), the file must
+	 * only be used by the calling thread, and not be followed or polled from another;
+	 * copies of it may be used by any thread, and aren't pinned. A file whose open
+	 * was deferred is opened first, and isn't pinned should that fail.
+	 * @return True is returned on success, else false is returned and the error code is set.
+	 */
+	bool pin();
 
 	/**
 	 * Get the current file position from the beginning of the file, in bytes.
@@ -145,9 +352,58 @@ public:
 	 */
 	int64_t position() const;
 
+	/**
+	 * Read from the file the requested number of bytes at the given offset,
+	 * neither using nor updating the file position.
+	 * @param buffer Pointer to a byte array large enough to hold the requested data.
+	 * @param count The number of bytes to read into {@param buffer}.
+	 * @param offset The offset from the beginning of the file to read from.
+	 * @return The number of bytes read from the file is returned. On error, -1 is
+	 *         returned and the error message can be retrieved via errorMessage().
+	 */
+	int64_t pread( uint8_t* buffer, size_t count, int64_t offset );
+
+	/**
+	 * Open the resources of files opened with IOFlag::LAZY in the background, e.g. the
+	 * next few of a list about to be worked through, so that their first use doesn't wait
+	 * on it. Files already open are skipped, and errors are left to their first use.
+	 * The files may be used, and closed, while their resources are opening.
+	 * @param files The files to open.
+	 */
+	static void prefetch( std::span< const File > files );
+
+	/**
+	 * Process the file in parallel, in chunks aligned to record boundaries. The file is
+	 * divided into {@param chunkCount} chunks, and each of {@param threadCount} workers
+	 * starts with a contiguous share of them. A worker that runs out of chunks steals
+	 * from the far end of another worker's share, which rebalances skewed chunks.
+	 * Include "FileChunks.hpp".
+	 * @param threadCount The number of workers, which run on the threads of a process-wide pool
+	 *                    and the calling thread. Zero selects the number of hardware threads.
+	 * @param chunkCount The number of chunks, which ought to be several per thread to allow stealing.
+	 * @param delimiter The byte terminating each record.
+	 * @param work Called once per chunk, on a worker's thread, with a reader over the chunk.
+	 *             It must not throw, and it must not close this File.
+	 * @return True is returned once every chunk has been processed, false on error.
+	 */
+	bool processChunks( unsigned int threadCount, size_t chunkCount, uint8_t delimiter,
+		const std::function< void( FileChunkReader& ) >& work );
+
+	/**
+	 * Deallocate the storage of the requested byte range, which then reads back as
+	 * zeros. The file size is left unchanged. Where the file system can't deallocate
+	 * the range, it is zeroed in place instead.
+	 * @param offset The offset from the beginning of the file of the range.
+	 * @param length The length of the range in bytes.
+	 * @return True is returned on success, false on error and the error code is set.
+	 */
+	bool punchHole( int64_t offset, int64_t length );
+
 	/**
 	 * Read from the file the requested number of bytes and
 	 * update the file position by the corresponding count.
+	 * Any count may be requested; the scheme splits large requests into
+	 * transfers of the size it handles best.
 	 * @param buffer Pointer to a byte array large enough to hold the requested data.
 	 * @param count The number of bytes to read into {@param buffer}.
 	 * @return The number of bytes read from the file is returned. This value may be
@@ -155,14 +411,24 @@ public:
 	 *         via errorMessage(). On error, -1 is returned and the error message can
 	 *         be retrieved via errorMessage().
 	 */
-	int64_t read( uint8_t* buffer, uint32_t count );
+	int64_t read( uint8_t* buffer, size_t count );
+
+	/**
+	 * Iterate over the delimited records of the file from the current file position.
+	 * Include "FileRecords.hpp".
+	 * @param delimiter The byte terminating each record.
+	 * @return A range of std::string_view over the records of the file. An error ends
+	 *         the range early, and can be retrieved via the range's errorMessage().
+	 */
+	FileRecords records( uint8_t delimiter );
 
 	/**
 	 * Reserve the requested number of bytes for the file size.
 	 * If the requested size is less than the current file size,
 	 * then this method does nothing. If the requested size is
 	 * greater than the current file size, then the file size will be
-	 * increased on disk to occupy the requested space. If there was
+	 * increased on disk to occupy the requested space. Zero fills are
+	 * allocated without writing the bytes where the file system allows. If there was
 	 * an issue allocating the requested space, then false is returned
 	 * and an error code will be assigned to the error code.
 	 * @param size The number of bytes requested that the file ought to occupy.
@@ -192,12 +458,67 @@ public:
 	 */
 	int64_t seek( int64_t offset, bool relative = false );
 
+	/**
+	 * Limit the combined bandwidth of the reads and writes of every file with a tag,
+	 * which is the scheme (e.g. "file") unless the URI selects another with "?iotag=".
+	 * Operations wait for the bytes they transfer to be available in a token bucket.
+	 * @param tag The tag, or scheme, to limit.
+	 * @param bytesPerSecond The sustained bandwidth. Zero removes the limit.
+	 * @param burstBytes The bytes that may be transferred at once after a pause. [default: a second's worth]
+	 */
+	static void setBandwidthLimit( const std::string& tag, double bytesPerSecond, double burstBytes = 0 );
+
+	/**
+	 * Set the most handles that local files may hold open at once. Past it, the handle
+	 * of the least recently used idle file is closed, keeping its path, mode, and file
+	 * position, and reopened transparently on the next use; so more files can be open
+	 * than the process has descriptors. Files that are followed or polled keep theirs,
+	 * as do those open for an atomic write or a group commit. A file replaced or removed
+	 * while its handle is closed fails to reopen, with ESTALE or ENOENT.
+	 * @param handles The most handles held open. Zero restores the default, which is
+	 *                the RLIMIT_NOFILE soft limit less 64, and at least half of it.
+	 */
+	static void setHandleBudget( size_t handles );
+
+	/**
+	 * Set the priority class of the reads and writes of the file, which is NORMAL
+	 * unless the URI selects another with "?priority=foreground|normal|background".
+	 * @param priority The priority class.
+	 * @return True is returned on success, else false is returned and the error code is set.
+	 */
+	bool setPriority( File::IOPriority priority );
+
 	/**
 	 * Length of the file in bytes.
 	 * @return Length of the file in bytes. If the length is indeterminate, then -1 is returned.
 	 */
 	int64_t size() const;
 
+	/**
+	 * Take a read-only snapshot of the file as it is now. Unlike a copy of this File,
+	 * which shares the same handle, the snapshot has a handle of its own: it doesn't
+	 * see later writes, and reading it doesn't contend with them. On file systems
+	 * supporting reflinks (e.g. Btrfs, XFS) the snapshot shares the storage of the file
+	 * until either is written, so taking one is cheap; elsewhere the file is copied.
+	 * The snapshot is discarded once closed. The file must be open for reading.
+	 * @return The snapshot is returned. On error, a null File is returned and
+	 *         the error code is set.
+	 */
+	File snapshot();
+
+	/**
+	 * Move bytes from the file position of this file to the file position of another,
+	 * advancing both, e.g. draining a pipe or device into a regular file. Between local
+	 * files, the bytes are moved within the kernel (with splice, copy_file_range, or
+	 * sendfile), never being copied through user space; otherwise they're read and written.
+	 * @param destination Reference to the File to write to, open for writing.
+	 * @param count The number of bytes to move.
+	 * @return The number of bytes moved is returned, which is less than {@param count}
+	 *         at the end of the file, or where a non-blocking file has no more ready.
+	 *         On error, -1 is returned and the error code is set.
+	 */
+	int64_t splice( File& destination, int64_t count );
+
 	/**
 	 * Synchronize the File instance with its source.
 	 * @return True is returned on success, else false is returned and the error code is set.
@@ -214,9 +535,41 @@ public:
 	 */
 	bool truncate( int64_t size );
 
+	/**
+	 * Unpin the file from the thread it was pinned to by pin(), after which it may
+	 * be used by any thread. Should the file not be pinned, this method does nothing.
+	 */
+	void unpin();
+
+	/**
+	 * Get a read-only view of bytes of the file, e.g. to parse them in place, without
+	 * changing the file position. Where the scheme can lend them (e.g. local files,
+	 * which are memory mapped) the bytes aren't copied; otherwise they're read into a
+	 * pooled buffer, by seeking and reading under the file's lock where the file can't
+	 * be read positionally (e.g. through a codec). The view remains valid after the file
+	 * is closed.
+	 * @param offset The offset of the first byte to view.
+	 * @param length The number of bytes to view, clamped to the end of the file.
+	 * @return The view is returned, empty past the end of the file. On error, an empty
+	 *         view is returned and the error code is set; ENOTSUP if the file can't be viewed.
+	 */
+	FileView view( int64_t offset, int64_t length );
+
+	/**
+	 * Wait until the file has bytes past the file position to be read, e.g. for a log
+	 * being appended to by another process. Local files are watched with inotify rather
+	 * than polled. A log that is rotated is read to the end first, and then reopened at
+	 * its path; see FileFollower, in "FileFollower.hpp", for following many files at once.
+	 * @param timeoutMilliseconds The longest time to wait, or a negative number to wait indefinitely.
+	 * @return True is returned once there are bytes to be read. False is returned
+	 *         on error, or with the error code set to ETIMEDOUT on timeout.
+	 */
+	bool waitForData( int64_t timeoutMilliseconds );
+
 	/**
 	 * Write to the file the requested number of bytes and
 	 * update the file position by the corresponding count.
+	 * As with read(), any count may be requested.
 	 * @param buffer Pointer to an array of const bytes.
 	 * @param count The number of byte to write from {@param buffer}.
 	 * @return The number of bytes written to the file is returned. This may be less
@@ -224,5 +577,5 @@ public:
 	 *         errorMessage(). On error, -1 is returned and the error message can
 	 *         be retrieved via errorMessage().
 	 */
-	int64_t write( const uint8_t* buffer, uint32_t count );
+	int64_t write( const uint8_t* buffer, size_t count );
 };
@@ -0,0 +1,67 @@
+/**
+ * Copyright ©2021. Brent Weichel. All Rights Reserved.
+ * Permission to use, copy, modify, and/or distribute this software, in whole
+ * or part by any means, without express prior written agreement is prohibited.
+ */
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "File.hpp"
+
+/**
+ * A byte range [ begin, end ) of a file.
+ */
+struct FileChunk
+{
+	int64_t begin;
+	int64_t end;
+};
+
+/**
+ * A reader over a single chunk of a file, with its own position. Reads are
+ * positional, so readers over handles on one file don't contend on a file
+ * position; processChunks() gives each of its workers a handle of its own.
+ */
+class FileChunkReader
+{
+private:
+	File* mFile;
+	FileChunk mChunk;
+	int64_t mPosition;
+
+public:
+	/**
+	 * Constructor to read a chunk of a file.
+	 * @param file Reference to the File to read from. It must outlive this instance.
+	 * @param chunk The byte range to read.
+	 */
+	FileChunkReader( File& file, const FileChunk& chunk ) noexcept;
+
+	/**
+	 * @return The byte range being read.
+	 */
+	const FileChunk& chunk() const noexcept;
+
+	/**
+	 * Get the message of the error that failed the last read.
+	 * @return A string containing the error message is returned.
+	 */
+	std::string errorMessage();
+
+	/**
+	 * @return The offset of the next byte to be read, from the beginning of the file.
+	 */
+	int64_t position() const noexcept;
+
+	/**
+	 * Read from the chunk, no further than its end, and advance the reader's position.
+	 * @param buffer Pointer to a byte array large enough to hold the requested data.
+	 * @param count The number of bytes to read into {@param buffer}.
+	 * @return The number of bytes read is returned, zero at the end of the chunk.
+	 *         On error, -1 is returned and the error message can be retrieved via
+	 *         errorMessage().
+	 */
+	int64_t read( uint8_t* buffer, size_t count );
+};
@@ -0,0 +1,151 @@
+/**
+ * Copyright ©2021. Brent Weichel. All Rights Reserved.
+ * Permission to use, copy, modify, and/or distribute this software, in whole
+ * or part by any means, without express prior written agreement is prohibited.
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <string>
+#include <vector>
+
+struct DirectoryContext;
+
+/**
+ * An entry of a directory listing.
+ */
+struct FileEntry
+{
+	enum Type : uint8_t
+	{
+		UNKNOWN,
+		REGULAR,
+		DIRECTORY,
+		SYMBOLIC_LINK,
+		FIFO,
+		CHARACTER_DEVICE,
+		BLOCK_DEVICE,
+		SOCKET
+	};
+
+	std::string name;
+	Type type;
+
+	// The following are only valid when hasMetadata is set.
+	// Symbolic links are described themselves, not their targets.
+	bool hasMetadata;
+	int64_t size;
+	int64_t modifiedTime; // Nanoseconds since the epoch
+	uint32_t mode; // Permission bits, zero where the scheme doesn't provide them
+};
+
+/**
+ * A single pass range over the entries of a directory, excluding "." and "..".
+ * Entries are listed in batches as the range is iterated, so a large directory
+ * is never held in memory at once, and come in no particular order. The type of
+ * an entry is usually known from the listing itself; the resource is only stat'd
+ * where it isn't, or where the metadata is requested, and then for many entries
+ * in parallel.
+ */
+class FileDirectory
+{
+private:
+	struct DirectoryContext* mContext;
+	std::string mPattern;
+	bool mMetadata;
+	int mErrorCode;
+
+	std::vector< FileEntry > mEntries;
+	size_t mEntryIndex;
+	bool mExhausted;
+
+	bool next();
+
+public:
+	class Iterator
+	{
+	private:
+		FileDirectory* mDirectory;
+
+	public:
+		using iterator_category = std::input_iterator_tag;
+		using value_type = FileEntry;
+		using difference_type = std::ptrdiff_t;
+
+		Iterator() noexcept :
+			mDirectory( nullptr )
+		{
+		}
+
+		explicit Iterator( FileDirectory* directory ) noexcept :
+			mDirectory( directory )
+		{
+		}
+
+		const FileEntry& operator*() const
+		{
+			return mDirectory->mEntries[ mDirectory->mEntryIndex ];
+		}
+
+		const FileEntry* operator->() const
+		{
+			return &mDirectory->mEntries[ mDirectory->mEntryIndex ];
+		}
+
+		Iterator& operator++()
+		{
+			mDirectory->next();
+			return *this;
+		}
+
+		void operator++( int )
+		{
+			mDirectory->next();
+		}
+
+		bool operator==( std::default_sentinel_t ) const
+		{
+			return mDirectory->mExhausted;
+		}
+	};
+
+	/**
+	 * Constructor to list a directory.
+	 * @param uri Path to a directory or a URI.
+	 * @param pattern Only list the entries whose names match this shell wildcard pattern,
+	 *                e.g. "*.csv". A leading '.' must be matched explicitly. [default: all]
+	 * @param metadata Stat the entries, so that their size, modification time, and mode
+	 *                 are available. Otherwise only those the listing provides are. [default: false]
+	 */
+	FileDirectory( const std::string& uri, const std::string& pattern = "", bool metadata = false );
+
+	FileDirectory( const FileDirectory& other ) = delete;
+	FileDirectory& operator=( const FileDirectory& other ) = delete;
+
+	/**
+	 * Destructor, which stops listing the directory.
+	 */
+	~FileDirectory();
+
+	/**
+	 * Get the current error message. An error ends the range early.
+	 * @return A string containing the error message, empty if there was no error.
+	 */
+	std::string errorMessage() const;
+
+	/**
+	 * List the first entry and get an iterator to it.
+	 * @return An iterator to the first entry.
+	 */
+	Iterator begin();
+
+	/**
+	 * @return The sentinel marking the end of the entries.
+	 */
+	std::default_sentinel_t end() const noexcept
+	{
+		return std::default_sentinel;
+	}
+};
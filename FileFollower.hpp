@@ -0,0 +1,80 @@
+/**
+ * Copyright ©2021. Brent Weichel. All Rights Reserved.
+ * Permission to use, copy, modify, and/or distribute this software, in whole
+ * or part by any means, without express prior written agreement is prohibited.
+ */
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+#include "File.hpp"
+
+/**
+ * Follows files as they're appended to, as "tail -F" does, waking as soon as any of
+ * them has bytes past its file position to be read. Local files are watched with
+ * inotify, so many can be followed from one thread without polling; others are polled.
+ * A followed file that is rotated (renamed or removed, and another created at its
+ * path) is read to the end, and then reopened at its path and read from the beginning.
+ * A followed file truncated below its file position is read again from the beginning.
+ * Errors are set on the file they concern; errors of the follower itself are set on
+ * every followed file.
+ */
+class FileFollower
+{
+private:
+	struct FollowedFile
+	{
+		File* mFile;
+		int mFileWatch; // -1 if the file is polled
+		int mDirectoryWatch;
+		bool mChanged; // To be refreshed on the next wait
+	};
+
+	int mNotifyHandle;
+	int mNotifyErrorCode;
+	std::vector< FollowedFile > mFollowedFiles;
+	std::chrono::steady_clock::time_point mNextPoll;
+
+	bool refresh( FollowedFile& followedFile );
+	void setErrorCode( int errorCode );
+
+public:
+	/**
+	 * Default constructor, following no files.
+	 */
+	FileFollower();
+
+	FileFollower( const FileFollower& other ) = delete;
+	FileFollower& operator=( const FileFollower& other ) = delete;
+
+	/**
+	 * Destructor, which stops following the files.
+	 */
+	~FileFollower();
+
+	/**
+	 * Follow a file, which is read from its current file position on.
+	 * @param file Reference to the File to follow. It must outlive this instance, or be removed first.
+	 * @return True is returned on success. False is returned on error, and the
+	 *         error code of {@param file} is set; ENOTSUP if it can't be followed.
+	 */
+	bool add( File& file );
+
+	/**
+	 * Stop following a file.
+	 * @param file Reference to a File being followed.
+	 */
+	void remove( File& file );
+
+	/**
+	 * Wait until any of the followed files has bytes to be read. The files returned remain
+	 * ready until read to the end, or rotated, so each ought to be read until it is.
+	 * For pipes and devices, which have no size, readiness is only a hint.
+	 * @param timeoutMilliseconds The longest time to wait, or a negative number to wait indefinitely.
+	 * @return The files with bytes to be read are returned. Should none be returned,
+	 *         either the timeout expired, or an error occurred and was set on the files.
+	 */
+	std::vector< File* > wait( int64_t timeoutMilliseconds );
+};
@@ -0,0 +1,90 @@
+/**
+ * Copyright ©2021. Brent Weichel. All Rights Reserved.
+ * Permission to use, copy, modify, and/or distribute this software, in whole
+ * or part by any means, without express prior written agreement is prohibited.
+ */
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <vector>
+
+#include "File.hpp"
+
+/**
+ * Waits on many pipes, devices, and sockets at once for them to be ready to be read
+ * from or written to, with epoll, so that one thread can serve them all; best paired
+ * with files opened with File::IOFlag::NONBLOCK, which are read until they fail with
+ * EAGAIN. Readiness is level-triggered: a file is returned by every wait for as long
+ * as it remains ready. Regular files, and files of schemes that can't be waited on,
+ * are always ready. Errors are set on the file they concern; errors of the poller
+ * itself are set on every polled file.
+ */
+class FilePoller
+{
+private:
+	struct PolledFile
+	{
+		File* mFile;
+		File::IOFlag mEvents;
+		int mPollHandle; // -1 if the file is always ready
+	};
+
+	int mPollHandle;
+	int mPollErrorCode;
+
+	// A list, so that the epoll events can point at their files.
+	std::list< PolledFile > mPolledFiles;
+
+	void setErrorCode( int errorCode );
+
+public:
+	/**
+	 * A file returned by wait(), and what it is ready for.
+	 */
+	struct ReadyFile
+	{
+		File* file;
+		File::IOFlag ready; // READ and/or WRITE
+	};
+
+	/**
+	 * Default constructor, polling no files.
+	 */
+	FilePoller();
+
+	FilePoller( const FilePoller& other ) = delete;
+	FilePoller& operator=( const FilePoller& other ) = delete;
+
+	/**
+	 * Destructor, which stops polling the files.
+	 */
+	~FilePoller();
+
+	/**
+	 * Poll a file, or change what it's polled for should it be polled already.
+	 * @param file Reference to the File to poll. It must remain open, and outlive
+	 *             this instance, or be removed first.
+	 * @param events Wait for the file to be ready to be read from (File::IOFlag::READ),
+	 *               written to (File::IOFlag::WRITE), or either. [default: File::IOFlag::READ]
+	 * @return True is returned on success. False is returned on error, and the
+	 *         error code of {@param file} is set.
+	 */
+	bool add( File& file, File::IOFlag events = File::IOFlag::READ );
+
+	/**
+	 * Stop polling a file.
+	 * @param file Reference to a File being polled.
+	 */
+	void remove( File& file );
+
+	/**
+	 * Wait until any of the polled files is ready. A file that has reached its end, or
+	 * failed, is ready for everything it's polled for, so that reading or writing it
+	 * reports as much.
+	 * @param timeoutMilliseconds The longest time to wait, or a negative number to wait indefinitely.
+	 * @return The files that are ready are returned. Should none be returned, either
+	 *         the timeout expired, or an error occurred and was set on the files.
+	 */
+	std::vector< ReadyFile > wait( int64_t timeoutMilliseconds );
+};
@@ -0,0 +1,126 @@
+/**
+ * Copyright ©2021. Brent Weichel. All Rights Reserved.
+ * Permission to use, copy, modify, and/or distribute this software, in whole
+ * or part by any means, without express prior written agreement is prohibited.
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "File.hpp"
+#include "FileView.hpp"
+
+/**
+ * A single pass range over the delimited records of a File, read from the current
+ * file position. Each record is a view into an internal buffer, or where the scheme
+ * can lend the bytes in place (e.g. memory mapped local files) into a window over
+ * them, without its delimiter, and is only valid until the iterator is advanced.
+ * A final record need not be terminated by the delimiter. An error ends the range
+ * early, without the record it interrupted.
+ */
+class FileRecords
+{
+private:
+	File* mFile;
+	uint8_t mDelimiter;
+	bool mStripCarriageReturn;
+
+	// Bytes [ mRecordStart, mBufferEnd ) of mData have been read but not yet
+	// consumed, and [ mRecordStart, mScanPosition ) are known to hold no delimiter.
+	// mData is either mBuffer, or mWindow, which views the file from mWindowPosition.
+	std::vector< uint8_t > mBuffer;
+	size_t mBufferSize;
+	FileView mWindow;
+	int64_t mWindowPosition;
+	bool mViewable;
+	const uint8_t* mData;
+	size_t mRecordStart;
+	size_t mScanPosition;
+	size_t mBufferEnd;
+	bool mEndOfFile;
+	bool mExhausted;
+	std::string_view mRecord;
+	int mErrorCode;
+
+	void fillBuffer();
+	void fillWindow();
+	bool next();
+
+public:
+	class Iterator
+	{
+	private:
+		FileRecords* mRecords;
+
+	public:
+		using iterator_category = std::input_iterator_tag;
+		using value_type = std::string_view;
+		using difference_type = std::ptrdiff_t;
+
+		Iterator() noexcept :
+			mRecords( nullptr )
+		{
+		}
+
+		explicit Iterator( FileRecords* records ) noexcept :
+			mRecords( records )
+		{
+		}
+
+		std::string_view operator*() const
+		{
+			return mRecords->mRecord;
+		}
+
+		Iterator& operator++()
+		{
+			mRecords->next();
+			return *this;
+		}
+
+		void operator++( int )
+		{
+			mRecords->next();
+		}
+
+		bool operator==( std::default_sentinel_t ) const
+		{
+			return mRecords->mExhausted;
+		}
+	};
+
+	/**
+	 * Constructor to iterate over the records of a file.
+	 * @param file Reference to the File to read from. It must outlive this instance.
+	 * @param delimiter The byte terminating each record.
+	 * @param stripCarriageReturn Strip a trailing '\r' from each record. [default: false]
+	 * @param bufferSize The initial size of the read buffer, or window, which grows to fit the longest record. [default: 1 MiB]
+	 */
+	FileRecords( File& file, uint8_t delimiter, bool stripCarriageReturn = false, size_t bufferSize = 1024 * 1024 );
+
+	/**
+	 * Read the first record and get an iterator to it. Should the range have ended on
+	 * an error, e.g. EAGAIN, this resumes it from the record the error interrupted.
+	 * @return An iterator to the first record.
+	 */
+	Iterator begin();
+
+	/**
+	 * Get the current error message. An error ends the range early.
+	 * @return A string containing the error message, empty if there was no error.
+	 */
+	std::string errorMessage() const;
+
+	/**
+	 * @return The sentinel marking the end of the records.
+	 */
+	std::default_sentinel_t end() const noexcept
+	{
+		return std::default_sentinel;
+	}
+};
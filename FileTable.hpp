@@ -0,0 +1,161 @@
+/**
+ * Copyright ©2021. Brent Weichel. All Rights Reserved.
+ * Permission to use, copy, modify, and/or distribute this software, in whole
+ * or part by any means, without express prior written agreement is prohibited.
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "File.hpp"
+#include "FileView.hpp"
+
+/*
+ * A table is a sorted run of key-value records, for looking keys up in files too large
+ * to search record by record. The records are packed into data blocks of about the
+ * same size, each followed by its CRC32C. After the blocks comes a sparse index, of
+ * the first key, offset, and length of every block; then a blocked Bloom filter of
+ * the keys; and then a footer of fixed size locating the index and filter, and holding
+ * their CRC32Cs. A lookup probes the filter and searches the index, both held in memory,
+ * and then reads the one block that can hold the key. Most lookups of keys that aren't
+ * in the table are answered by the filter alone, without reading the file.
+ */
+
+/**
+ * Writes a table to the end of a File, appending each data block as it fills, and
+ * then the index, filter, and footer once finished. Keys must be added in ascending order of
+ * their bytes, without duplicates. A table isn't readable until finish() is called.
+ */
+class FileTableWriter
+{
+private:
+	File* mFile;
+	size_t mBlockSize;
+	int mErrorCode;
+
+	// The records of the block being filled, and the index of the blocks already written.
+	std::vector< uint8_t > mBlock;
+	std::vector< uint8_t > mIndex;
+	std::string mBlockFirstKey;
+	std::string mLastKey;
+	uint64_t mRecordCount;
+	bool mFinished;
+
+	// The hashes of the keys, from which finish() builds the filter.
+	size_t mFilterBitsPerKey;
+	std::vector< uint64_t > mKeyHashes;
+
+	bool writeBlock();
+
+public:
+	/**
+	 * Constructor to write a table to a file.
+	 * @param file Reference to the File to append the table to, open for writing. It must outlive this instance.
+	 * @param blockSize The size data blocks are filled to, which is read whole for every lookup. [default: 16 KiB]
+	 * @param filterBitsPerKey The size of the filter, in bits per key; 10 gives about 1% false positives,
+	 *                         and 0 writes no filter. Eight bytes per key are held until finish(). [default: 10]
+	 */
+	FileTableWriter( File& file, size_t blockSize = 16 * 1024, size_t filterBitsPerKey = 10 );
+
+	FileTableWriter( const FileTableWriter& other ) = delete;
+	FileTableWriter& operator=( const FileTableWriter& other ) = delete;
+
+	/**
+	 * Add a record to the table.
+	 * @param key The key of the record, greater than that of the previous record.
+	 * @param value The value of the record.
+	 * @return True is returned on success. False is returned on error, and the error
+	 *         code is set; EINVAL if the key is out of order.
+	 */
+	bool add( std::string_view key, std::string_view value );
+
+	/**
+	 * Write the last data block, the index, the filter, and the footer. No more records can be added.
+	 * @return True is returned on success. False is returned on error, and the error code is set.
+	 */
+	bool finish();
+
+	/**
+	 * Get the current error message. Errors of the File are copied here as they occur.
+	 * @return A string containing the error message, empty if there was no error.
+	 */
+	std::string errorMessage() const;
+};
+
+/**
+ * Looks keys up in a table written by FileTableWriter. The footer, index, and filter
+ * are read once when constructed, the index and filter by way of File::view(), so that
+ * a local file's are mapped rather than copied. Every lookup then takes at most a
+ * single positional read. A reader must only be used by one thread at a time; each
+ * thread can have its own, over its own File::dup() of the file.
+ */
+class FileTableReader
+{
+private:
+	struct BlockHandle
+	{
+		std::string_view mFirstKey; // Into mIndex
+		int64_t mOffset;
+		uint32_t mLength; // Without the trailing CRC32C
+	};
+
+	File* mFile;
+	int mErrorCode;
+	FileView mIndex;
+	FileView mFilter;
+	size_t mFilterBlockCount;
+	std::vector< BlockHandle > mBlocks;
+	std::vector< uint8_t > mBlock;
+	uint64_t mRecordCount;
+	bool mLoaded; // Whether the footer and index were read
+
+	bool readSection( int64_t offset, uint64_t length, uint32_t checksum, FileView& section );
+
+public:
+	/**
+	 * Constructor to look up keys in a table, which reads its footer, index, and filter.
+	 * Should that fail, every lookup fails, and the error code is set; EBADMSG if
+	 * the file doesn't end in a table, or the index or filter is corrupt.
+	 * @param file Reference to the File holding the table, open for reading. It must outlive this instance.
+	 */
+	explicit FileTableReader( File& file );
+
+	FileTableReader( const FileTableReader& other ) = delete;
+	FileTableReader& operator=( const FileTableReader& other ) = delete;
+
+	/**
+	 * Look up the value of a key.
+	 * @param key The key to look up.
+	 * @param value Reference to store the value of the key.
+	 * @return True is returned if the key was found. False is returned if it wasn't,
+	 *         with the error code clear, or on error, with the error code set;
+	 *         EBADMSG if the block read is corrupt.
+	 */
+	bool get( std::string_view key, std::string& value );
+
+	/**
+	 * Check whether a key may be in the table, without reading the file. Keys that
+	 * are in it always may be, as may a few that aren't; see the filter bits per key
+	 * of FileTableWriter. get() checks this first.
+	 * @param key The key to check.
+	 * @return False is returned if the key isn't in the table. True is returned if it
+	 *         may be, or if the table has no filter.
+	 */
+	bool mayContain( std::string_view key ) const;
+
+	/**
+	 * Get the number of records in the table.
+	 * @return The number of records is returned, zero if the table couldn't be read.
+	 */
+	uint64_t size() const;
+
+	/**
+	 * Get the current error message. Errors of the File are copied here as they occur.
+	 * @return A string containing the error message, empty if there was no error.
+	 */
+	std::string errorMessage() const;
+};
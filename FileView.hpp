@@ -0,0 +1,98 @@
+/**
+ * Copyright ©2021. Brent Weichel. All Rights Reserved.
+ * Permission to use, copy, modify, and/or distribute this software, in whole
+ * or part by any means, without express prior written agreement is prohibited.
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <utility>
+
+/**
+ * A read-only view of bytes of a file, borrowed in place where the scheme can lend
+ * them (e.g. memory mapped local files) rather than copied into a buffer of the caller.
+ * Copies of a view share the bytes, which remain valid for as long as any view of them
+ * does, even after the file is closed. Views of a mapped file see later writes to it,
+ * and the file mustn't be truncated beneath them by another process.
+ */
+class FileView
+{
+private:
+	std::shared_ptr< const uint8_t > mData;
+	size_t mSize;
+
+public:
+	/**
+	 * Default constructor to an empty view.
+	 */
+	FileView() noexcept :
+		mSize( 0 )
+	{
+	}
+
+	/**
+	 * Constructor to a view of bytes kept alive by their owner.
+	 * @param data Shared pointer to the first byte, owning the bytes.
+	 * @param size The number of bytes viewed.
+	 */
+	FileView( std::shared_ptr< const uint8_t > data, size_t size ) noexcept :
+		mData( std::move( data ) ),
+		mSize( size )
+	{
+	}
+
+	const uint8_t* data() const noexcept
+	{
+		return mData.get();
+	}
+
+	size_t size() const noexcept
+	{
+		return mSize;
+	}
+
+	bool empty() const noexcept
+	{
+		return 0 == mSize;
+	}
+
+	const uint8_t* begin() const noexcept
+	{
+		return mData.get();
+	}
+
+	const uint8_t* end() const noexcept
+	{
+		return mData.get() + mSize;
+	}
+
+	const uint8_t& operator[]( size_t index ) const
+	{
+		return mData.get()[ index ];
+	}
+
+	operator std::span< const uint8_t >() const noexcept
+	{
+		return std::span< const uint8_t >( mData.get(), mSize );
+	}
+
+	/**
+	 * Get a view of some of the bytes of this view, sharing them.
+	 * @param offset The offset of the first byte of the subview into this view.
+	 * @param length The number of bytes of the subview, clamped to the end of this view.
+	 * @return The subview is returned, empty if {@param offset} is past the end of this view.
+	 */
+	FileView subview( size_t offset, size_t length ) const
+	{
+		if ( offset >= mSize )
+		{
+			return FileView();
+		}
+
+		return FileView( std::shared_ptr< const uint8_t >( mData, mData.get() + offset ),
+			( length < mSize - offset ) ? length : mSize - offset );
+	}
+};
@@ -0,0 +1,272 @@
+/**
+ * Copyright ©2021. Brent Weichel. All Rights Reserved.
+ * Permission to use, copy, modify, and/or distribute this software, in whole
+ * or part by any means, without express prior written agreement is prohibited.
+ */
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <span>
+#include <type_traits>
+#include <utility>
+
+#include "File.hpp"
+#include "FileView.hpp"
+
+/**
+ * Typed access to a file of fixed-width binary records, e.g. ticks or sensor samples,
+ * each stored as the bytes of a T. Records are addressed by index, and read in batches
+ * at an offset, so they neither use nor update the file position of the File. A final
+ * record cut short by the end of the file is ignored. Errors are set on the File, and
+ * can be retrieved via its errorMessage(). Records are written by appending them.
+ */
+template< typename T >
+class RecordFile
+{
+	static_assert( std::is_trivially_copyable_v< T >, "records are read and written as bytes" );
+
+private:
+	// readColumns() gathers fields from this many bytes of records at a time.
+	static constexpr size_t COLUMN_BATCH_SIZE = 1024 * 1024;
+
+	File* mFile;
+	int64_t mOffset;
+
+	int64_t recordOffset( int64_t index ) const
+	{
+		return mOffset + index * static_cast< int64_t >( sizeof( T ) );
+	}
+
+	template< typename Field >
+	static void gather( const uint8_t* bytes, size_t count, size_t first, Field T::* member, std::span< Field > values )
+	{
+		for ( size_t recordIndex = 0; recordIndex < count; ++recordIndex )
+		{
+			// Only the field is loaded; the copy of the rest of the record is optimized away.
+			T record;
+			memcpy( &record, bytes + recordIndex * sizeof( T ), sizeof( T ) );
+			values[ first + recordIndex ] = record.*member;
+		}
+	}
+
+public:
+	/**
+	 * A field of the records to read with readColumns(), and where to store its values.
+	 */
+	template< typename Field >
+	struct Column
+	{
+		Field T::* member;
+		std::span< Field > values;
+	};
+
+	/**
+	 * Records viewed in place by view(), sharing their bytes.
+	 */
+	class View
+	{
+	private:
+		FileView mBytes;
+
+	public:
+		View() noexcept = default;
+
+		explicit View( FileView bytes ) noexcept :
+			mBytes( std::move( bytes ) )
+		{
+		}
+
+		const T* data() const noexcept
+		{
+			return reinterpret_cast< const T* >( mBytes.data() );
+		}
+
+		size_t size() const noexcept
+		{
+			return mBytes.size() / sizeof( T );
+		}
+
+		bool empty() const noexcept
+		{
+			return 0 == size();
+		}
+
+		const T* begin() const noexcept
+		{
+			return data();
+		}
+
+		const T* end() const noexcept
+		{
+			return data() + size();
+		}
+
+		const T& operator[]( size_t index ) const
+		{
+			return data()[ index ];
+		}
+
+		operator std::span< const T >() const noexcept
+		{
+			return std::span< const T >( data(), size() );
+		}
+	};
+
+	/**
+	 * Constructor to the records of a file.
+	 * @param file Reference to the File to read from and append to. It must outlive this instance.
+	 * @param offset The offset of the first record, after any header. [default: 0]
+	 */
+	explicit RecordFile( File& file, int64_t offset = 0 ) noexcept :
+		mFile( &file ),
+		mOffset( offset )
+	{
+	}
+
+	/**
+	 * Make a Column of the values of a field, for readColumns().
+	 * @param member Pointer to the field, e.g. &Tick::price.
+	 * @param values The span to store the values of the field in, one per record.
+	 * @return The Column is returned.
+	 */
+	template< typename Field >
+	static Column< Field > column( Field T::* member, std::span< Field > values ) noexcept
+	{
+		return Column< Field >{ member, values };
+	}
+
+	/**
+	 * Get the number of complete records in the file.
+	 * @return The number of records is returned. If the size of the file is indeterminate, then -1 is returned.
+	 */
+	int64_t size() const
+	{
+		int64_t fileSize = mFile->size();
+
+		if ( 0 > fileSize )
+		{
+			return -1;
+		}
+
+		return std::max< int64_t >( fileSize - mOffset, 0 ) / static_cast< int64_t >( sizeof( T ) );
+	}
+
+	/**
+	 * Read a record.
+	 * @param index The index of the record.
+	 * @param record Reference to store the record.
+	 * @return True is returned if the record was read. False is returned on error,
+	 *         or if there is no such record.
+	 */
+	bool read( int64_t index, T& record )
+	{
+		return 1 == readRange( index, std::span< T >( &record, 1 ) );
+	}
+
+	/**
+	 * Read consecutive records with as few reads of the file as the scheme allows.
+	 * @param index The index of the first record.
+	 * @param records The span to store the records in, which sets the number requested.
+	 * @return The number of records read is returned, fewer than requested at the
+	 *         end of the file. On error, -1 is returned.
+	 */
+	int64_t readRange( int64_t index, std::span< T > records )
+	{
+		int64_t bytesRead = mFile->pread( reinterpret_cast< uint8_t* >( records.data() ),
+			records.size_bytes(), recordOffset( index ) );
+
+		return ( 0 > bytesRead ) ? -1 : bytesRead / static_cast< int64_t >( sizeof( T ) );
+	}
+
+	/**
+	 * Read only some of the fields of consecutive records, into an array per field.
+	 * The fields are gathered straight out of the bytes of the file where the scheme
+	 * can lend them in place (see File::view()), so the records aren't copied whole.
+	 * e.g. readColumns( 0, RecordFile< Tick >::column( &Tick::price, std::span( prices ) ) );
+	 * @param index The index of the first record.
+	 * @param columns The fields to read, all with spans of the same size, which sets the number of records requested.
+	 * @return The number of records read is returned, fewer than requested at the
+	 *         end of the file. On error, -1 is returned.
+	 */
+	template< typename... Fields >
+	int64_t readColumns( int64_t index, const Column< Fields >&... columns )
+	{
+		static_assert( 0 < sizeof...( Fields ), "at least one column is read" );
+
+		size_t count = std::min( { columns.values.size()... } );
+		size_t batchSize = std::max< size_t >( COLUMN_BATCH_SIZE / sizeof( T ), 1 );
+		size_t recordsRead = 0;
+		int64_t recordCount = size();
+
+		if ( 0 <= recordCount )
+		{
+			count = std::min< size_t >( count, std::max< int64_t >( recordCount - index, 0 ) );
+		}
+
+		while ( recordsRead < count )
+		{
+			size_t batchCount = std::min( count - recordsRead, batchSize );
+			FileView bytes = mFile->view( recordOffset( index + recordsRead ), batchCount * sizeof( T ) );
+
+			// The records were counted up front, so falling short of them is an error.
+			if ( bytes.size() < sizeof( T ) )
+			{
+				return ( 0 == recordsRead ) ? -1 : recordsRead;
+			}
+
+			batchCount = std::min( batchCount, bytes.size() / sizeof( T ) );
+			( gather( bytes.data(), batchCount, recordsRead, columns.member, columns.values ), ... );
+			recordsRead += batchCount;
+		}
+
+		return recordsRead;
+	}
+
+	/**
+	 * View consecutive records in place, without copying them, where the scheme can
+	 * lend their bytes (e.g. local files, which are memory mapped); otherwise they're
+	 * read into a buffer. Records that aren't aligned for T in place are copied too.
+	 * The view remains valid after the file is closed.
+	 * @param index The index of the first record.
+	 * @param count The number of records to view, clamped to the end of the file.
+	 * @return The view is returned, empty past the end of the file. On error, an empty
+	 *         view is returned and the error code of the File is set.
+	 */
+	View view( int64_t index, size_t count )
+	{
+		FileView bytes = mFile->view( recordOffset( index ), count * sizeof( T ) );
+		size_t recordCount = bytes.size() / sizeof( T );
+
+		if ( 0 == reinterpret_cast< uintptr_t >( bytes.data() ) % alignof( T ) )
+		{
+			return View( bytes.subview( 0, recordCount * sizeof( T ) ) );
+		}
+
+		std::shared_ptr< T[] > records( new ( std::nothrow ) T[ recordCount ] );
+
+		if ( nullptr == records )
+		{
+			return View();
+		}
+
+		memcpy( records.get(), bytes.data(), recordCount * sizeof( T ) );
+		return View( FileView( std::shared_ptr< const uint8_t >( records, reinterpret_cast< const uint8_t* >( records.get() ) ),
+			recordCount * sizeof( T ) ) );
+	}
+
+	/**
+	 * Append records to the end of the file.
+	 * @param records The records to append.
+	 * @return The number of records appended is returned. On error, -1 is returned.
+	 */
+	int64_t append( std::span< const T > records )
+	{
+		int64_t bytesWritten = mFile->append( reinterpret_cast< const uint8_t* >( records.data() ), records.size_bytes() );
+		return ( 0 > bytesWritten ) ? -1 : bytesWritten / static_cast< int64_t >( sizeof( T ) );
+	}
+};
@@ -0,0 +1,90 @@
+/**
+ * Copyright ©2021. Brent Weichel. All Rights Reserved.
+ * Permission to use, copy, modify, and/or distribute this software, in whole
+ * or part by any means, without express prior written agreement is prohibited.
+ */
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+
+// The least time a measurement runs for, long enough to smooth out the scheduler.
+#define BENCH_MINIMUM_SECONDS ( 0.5 )
+
+/*
+ * Time a function, run repeatedly for at least BENCH_MINIMUM_SECONDS.
+ * @param run The function to time.
+ * @return The mean number of seconds a run took is returned.
+ */
+static inline double __seconds_per_run(
+	const std::function< void() >& run )
+{
+	auto start = std::chrono::steady_clock::now();
+	std::chrono::duration< double > elapsed( 0 );
+	size_t runCount = 0;
+
+	do
+	{
+		run();
+		++runCount;
+		elapsed = std::chrono::steady_clock::now() - start;
+	} while ( elapsed.count() < BENCH_MINIMUM_SECONDS );
+
+	return elapsed.count() / runCount;
+}
+
+/*
+ * Keep the compiler from discarding a result that is otherwise unused.
+ */
+static inline void __keep(
+	uint64_t value )
+{
+	asm volatile( "" : : "r"( value ) );
+}
+
+/*
+ * Print a result as a line of the form "<name> <value> <unit>".
+ */
+static inline void __report(
+	const char* name,
+	double value,
+	const char* unit )
+{
+	printf( "%-48s %12.3f %s\n", name, value, unit );
+}
+
+/*
+ * Fill a buffer with log-like lines, which compress about as well as real ones.
+ */
+static inline void __fill_text(
+	std::vector< uint8_t >& buffer )
+{
+	static const char* WORDS[] = { "GET", "PUT", "/index.html", "/api/v1/items", "200", "404",
+		"user", "session", "latency_ms=", "bytes=", "cache=hit", "cache=miss" };
+	std::mt19937_64 random( 28 );
+	size_t offset = 0;
+
+	while ( offset < buffer.size() )
+	{
+		std::string line = std::to_string( 1600000000 + random() % 100000 );
+
+		for ( int word = 0; word < 6; ++word )
+		{
+			line += ' ';
+			line += WORDS[ random() % ( sizeof( WORDS ) / sizeof( WORDS[ 0 ] ) ) ];
+			line += std::to_string( random() % 1000 );
+		}
+
+		line += '\n';
+
+		for ( size_t index = 0; ( index < line.size() ) and ( offset < buffer.size() ); ++index )
+		{
+			buffer[ offset++ ] = static_cast< uint8_t >( line[ index ] );
+		}
+	}
+}
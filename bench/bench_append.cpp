@@ -0,0 +1,108 @@
+/**
+ * Copyright ©2021. Brent Weichel. All Rights Reserved.
+ * Permission to use, copy, modify, and/or distribute this software, in whole
+ * or part by any means, without express prior written agreement is prohibited.
+ */
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "Bench.hpp"
+#include "File.hpp"
+
+// The size of each append, e.g. a log record, and the number each thread makes.
+#define APPEND_RECORD_SIZE ( 128 )
+#define APPEND_COUNT       ( 2000 )
+
+// The most threads appending to the file at once.
+#define APPEND_MAXIMUM_THREADS ( 16 )
+
+/*
+ * Time concurrent appends to one file, each thread appending through its own copy.
+ * @param uri The URI to open the file with.
+ * @param threadCount The number of threads appending.
+ * @return The appends made per second is returned, or a negative value should an append fail
+ *         or the file not end up holding every record.
+ */
+static double __appends_per_second(
+	const std::string& uri,
+	unsigned int threadCount )
+{
+	File file( uri, File::IOFlag::WRITE );
+	std::vector< std::thread > threads;
+	std::vector< uint8_t > record( APPEND_RECORD_SIZE, 'r' );
+	std::atomic_bool failed( false );
+
+	record.back() = '\n';
+
+	auto start = std::chrono::steady_clock::now();
+
+	for ( unsigned int threadIndex = 0; threadIndex < threadCount; ++threadIndex )
+	{
+		threads.emplace_back( [ & ]()
+		{
+			File threadFile( file );
+
+			for ( size_t appendIndex = 0; appendIndex < APPEND_COUNT; ++appendIndex )
+			{
+				if ( APPEND_RECORD_SIZE != threadFile.append( record.data(), record.size() ) )
+				{
+					failed = true;
+				}
+			}
+		} );
+	}
+
+	for ( std::thread& thread : threads )
+	{
+		thread.join();
+	}
+
+	std::chrono::duration< double > elapsed = std::chrono::steady_clock::now() - start;
+
+	if ( failed or ( static_cast< int64_t >( threadCount * APPEND_COUNT * APPEND_RECORD_SIZE ) != file.size() ) )
+	{
+		return -1;
+	}
+
+	return threadCount * APPEND_COUNT / elapsed.count();
+}
+
+/*
+ * Benchmark group-commit appends against the synchronous append of the file scheme,
+ * with one thread doubling up to APPEND_MAXIMUM_THREADS appending to the same file.
+ * Usage: bench_append [directory] [default: /tmp], which should be on the disk of interest.
+ */
+int main(
+	int argc,
+	char** argv )
+{
+	std::string path = std::string( ( 1 < argc ) ? argv[ 1 ] : "/tmp" ) + "/bench_append.log";
+
+	for ( unsigned int threadCount = 1; threadCount <= APPEND_MAXIMUM_THREADS; threadCount *= 2 )
+	{
+		for ( const char* query : { "", "?group_commit=1" } )
+		{
+			unlink( path.c_str() );
+			double rate = __appends_per_second( path + query, threadCount );
+
+			if ( 0 > rate )
+			{
+				fprintf( stderr, "Appending to %s%s failed\n", path.c_str(), query );
+				return EXIT_FAILURE;
+			}
+
+			std::string name = std::string( ( '\0' == *query ) ? "append" : "group commit append" )
+				+ " threads=" + std::to_string( threadCount );
+			__report( name.c_str(), rate, "appends/s" );
+		}
+	}
+
+	unlink( path.c_str() );
+	return EXIT_SUCCESS;
+}
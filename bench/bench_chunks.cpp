@@ -0,0 +1,144 @@
+/**
+ * Copyright ©2021. Brent Weichel. All Rights Reserved.
+ * Permission to use, copy, modify, and/or distribute this software, in whole
+ * or part by any means, without express prior written agreement is prohibited.
+ */
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "Bench.hpp"
+#include "File.hpp"
+#include "FileChunks.hpp"
+#include "Scan.hpp"
+
+// The size of the file processed, the chunks per worker, and the size of each chunk read.
+#define CHUNKS_FILE_SIZE ( 512 * 1024 * 1024 )
+#define CHUNKS_PER_THREAD ( 8 )
+#define CHUNKS_READ_SIZE ( 256 * 1024 )
+
+/*
+ * Write a file of lines of 32 to 160 bytes.
+ * @return The number of lines written is returned, or zero on error.
+ */
+static uint64_t __write_lines(
+	const std::string& path )
+{
+	std::mt19937_64 random( 32 );
+	std::vector< uint8_t > buffer( CHUNKS_FILE_SIZE );
+	uint64_t lineCount = 0;
+
+	for ( size_t offset = 0; offset < buffer.size(); ++offset )
+	{
+		buffer[ offset ] = static_cast< uint8_t >( 'a' + random() % 26 );
+	}
+
+	for ( size_t offset = 31; offset < buffer.size() - 1; offset += 32 + random() % 128 )
+	{
+		buffer[ offset ] = '\n';
+		++lineCount;
+	}
+
+	buffer.back() = '\n';
+
+	FILE* stream = fopen( path.c_str(), "wb" );
+	bool written = ( nullptr != stream ) and ( buffer.size() == fwrite( buffer.data(), 1, buffer.size(), stream ) );
+	return ( ( nullptr != stream ) and ( 0 == fclose( stream ) ) and written ) ? lineCount + 1 : 0;
+}
+
+/*
+ * Benchmark File::processChunks() counting the lines of a file, from one worker up to
+ * the number of hardware threads, reporting the throughput and the speedup over one
+ * worker. The file is read once beforehand, so that it's measured from the page cache.
+ * Usage: bench_chunks [directory] [default: /tmp]
+ */
+int main(
+	int argc,
+	char** argv )
+{
+	std::string path = std::string( ( 1 < argc ) ? argv[ 1 ] : "/tmp" ) + "/bench_chunks.txt";
+	uint64_t expectedLineCount = __write_lines( path );
+
+	if ( 0 == expectedLineCount )
+	{
+		fprintf( stderr, "Writing %s failed\n", path.c_str() );
+		return EXIT_FAILURE;
+	}
+
+	double gigabytes = CHUNKS_FILE_SIZE / 1e9;
+	unsigned int maximumThreadCount = std::max( 1U, std::thread::hardware_concurrency() );
+	File file( path, File::IOFlag::READ );
+	std::vector< unsigned int > threadCounts;
+	double singleThreadSeconds = 0;
+	bool counted = true;
+
+	// Powers of two, then the number of hardware threads.
+	for ( unsigned int threadCount = 1; threadCount < maximumThreadCount; threadCount *= 2 )
+	{
+		threadCounts.push_back( threadCount );
+	}
+
+	threadCounts.push_back( maximumThreadCount );
+
+	for ( unsigned int threadCount : threadCounts )
+	{
+		std::atomic< uint64_t > lineCount( 0 );
+		bool processed = true;
+
+		double seconds = __seconds_per_run( [ & ]()
+		{
+			lineCount = 0;
+			processed = processed and file.processChunks( threadCount, CHUNKS_PER_THREAD * threadCount, '\n',
+				[ & ]( FileChunkReader& reader )
+				{
+					std::vector< uint8_t > buffer( CHUNKS_READ_SIZE );
+					uint64_t chunkLineCount = 0;
+					int64_t bytesRead;
+
+					while ( 0 < ( bytesRead = reader.read( buffer.data(), buffer.size() ) ) )
+					{
+						const uint8_t* end = buffer.data() + bytesRead;
+
+						for ( const uint8_t* position = buffer.data(); end != ( position = _find_byte( position, end, '\n' ) ); ++position )
+						{
+							++chunkLineCount;
+						}
+					}
+
+					if ( 0 > bytesRead )
+					{
+						fprintf( stderr, "Reading a chunk failed: %s\n", reader.errorMessage().c_str() );
+					}
+
+					lineCount += chunkLineCount;
+				} );
+		} );
+
+		if ( 1 == threadCount )
+		{
+			singleThreadSeconds = seconds;
+		}
+
+		std::string name = "process chunks, " + std::to_string( threadCount ) + " threads";
+		__report( name.c_str(), gigabytes / seconds, "GB/s" );
+		__report( ( name + " speedup" ).c_str(), singleThreadSeconds / seconds, "x" );
+		counted = counted and processed and ( expectedLineCount == lineCount.load() );
+	}
+
+	unlink( path.c_str() );
+
+	if ( not counted )
+	{
+		fprintf( stderr, "processChunks() didn't count %lu lines\n", expectedLineCount );
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,113 @@
+/**
+ * Copyright ©2021. Brent Weichel. All Rights Reserved.
+ * Permission to use, copy, modify, and/or distribute this software, in whole
+ * or part by any means, without express prior written agreement is prohibited.
+ */
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "Bench.hpp"
+#include "File.hpp"
+
+// The bytes written per run, in writes of CODEC_WRITE_SIZE.
+#define CODEC_STREAM_SIZE ( 256 * 1024 * 1024 )
+#define CODEC_WRITE_SIZE  ( 1024 * 1024 )
+
+/*
+ * Check that a stream written by the benchmark decodes back to what was written.
+ */
+static bool __check_round_trip(
+	const std::string& path,
+	const std::vector< uint8_t >& buffer )
+{
+	File file( path, File::IOFlag::READ );
+	std::vector< uint8_t > decoded( buffer.size() );
+	size_t bytesDecoded = 0;
+
+	while ( true )
+	{
+		int64_t bytesRead = file.read( decoded.data(), decoded.size() );
+
+		if ( 0 == bytesRead )
+		{
+			return CODEC_STREAM_SIZE == bytesDecoded;
+		}
+
+		// Each write was the whole buffer, so the stream repeats it.
+		if ( ( 0 > bytesRead )
+			or not std::equal( decoded.begin(), decoded.begin() + bytesRead, buffer.begin() + bytesDecoded % buffer.size() ) )
+		{
+			return false;
+		}
+
+		bytesDecoded += bytesRead;
+	}
+}
+
+/*
+ * Benchmark how codec writes scale with the number of encoding threads: a stream is
+ * written through the codec layer with "threads=" of one, doubling up to every
+ * hardware thread, and the rate and speedup over a single thread are reported. Each
+ * stream is then read back and checked against what was written.
+ * Usage: bench_codec [directory] [suffix], e.g. bench_codec /tmp .zst [default: /tmp .gz]
+ */
+int main(
+	int argc,
+	char** argv )
+{
+	std::string directory = ( 1 < argc ) ? argv[ 1 ] : "/tmp";
+	std::string suffix = ( 2 < argc ) ? argv[ 2 ] : ".gz";
+	std::string path = directory + "/bench_codec" + suffix;
+	unsigned int hardwareThreads = std::max( 1u, std::thread::hardware_concurrency() );
+	std::vector< uint8_t > buffer( CODEC_WRITE_SIZE );
+	double singleThreadRate = 0;
+
+	__fill_text( buffer );
+
+	for ( unsigned int threadCount = 1; threadCount <= hardwareThreads; threadCount *= 2 )
+	{
+		std::string uri = path + "?threads=" + std::to_string( threadCount );
+		bool failed = false;
+
+		double seconds = __seconds_per_run( [ & ]()
+		{
+			unlink( path.c_str() );
+			File file( uri, File::IOFlag::WRITE );
+
+			for ( size_t written = 0; ( written < CODEC_STREAM_SIZE ) and not failed; written += buffer.size() )
+			{
+				failed = ( static_cast< int64_t >( buffer.size() ) != file.write( buffer.data(), buffer.size() ) );
+			}
+
+			file.close();
+		} );
+
+		if ( failed )
+		{
+			fprintf( stderr, "Writing %s failed\n", uri.c_str() );
+			return EXIT_FAILURE;
+		}
+
+		// Closing ends the stream, so what was timed is what reads back.
+		if ( not __check_round_trip( path, buffer ) )
+		{
+			fprintf( stderr, "%s doesn't decode to what was written\n", uri.c_str() );
+			return EXIT_FAILURE;
+		}
+
+		double rate = CODEC_STREAM_SIZE / 1e6 / seconds;
+		singleThreadRate = ( 1 == threadCount ) ? rate : singleThreadRate;
+
+		std::string name = "codec " + suffix + " threads=" + std::to_string( threadCount );
+		__report( name.c_str(), rate, "MB/s" );
+		__report( ( name + " speedup" ).c_str(), rate / singleThreadRate, "x" );
+	}
+
+	unlink( path.c_str() );
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,100 @@
+/**
+ * Copyright ©2021. Brent Weichel. All Rights Reserved.
+ * Permission to use, copy, modify, and/or distribute this software, in whole
+ * or part by any means, without express prior written agreement is prohibited.
+ */
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+#include "Bench.hpp"
+#include "File.hpp"
+
+// The bytes of each stream, written and read in blocks of CODEC_BLOCK_SIZE.
+#define CODEC_STREAM_SIZE ( 64 * 1024 * 1024 )
+#define CODEC_BLOCK_SIZE  ( 1024 * 1024 )
+
+/*
+ * Write a stream through the codec the path's suffix selects.
+ * @return True is returned on success.
+ */
+static bool __write_stream(
+	const std::string& path,
+	const std::vector< uint8_t >& stream )
+{
+	unlink( path.c_str() );
+	File file( path, File::IOFlag::WRITE );
+
+	for ( size_t written = 0; written < stream.size(); written += CODEC_BLOCK_SIZE )
+	{
+		if ( CODEC_BLOCK_SIZE != file.write( stream.data() + written, CODEC_BLOCK_SIZE ) )
+		{
+			return false;
+		}
+	}
+
+	// Closing writes the final frame.
+	file.close();
+	return true;
+}
+
+/*
+ * Benchmark decoding through each codec layer: a stream of log-like text is written
+ * with gzip, zstd, and lz4, and uncompressed for reference, then read back whole. The
+ * rate is that of the decoded bytes, alongside the ratio each codec compressed to.
+ * Usage: bench_codec_read [directory] [default: /tmp]
+ */
+int main(
+	int argc,
+	char** argv )
+{
+	std::string directory = ( 1 < argc ) ? argv[ 1 ] : "/tmp";
+	std::vector< uint8_t > stream( CODEC_STREAM_SIZE );
+	std::vector< uint8_t > decoded( CODEC_BLOCK_SIZE );
+
+	// The text doesn't repeat, which would flatter codecs with windows wider than the repeat.
+	__fill_text( stream );
+
+	for ( std::string suffix : { ".txt", ".gz", ".zst", ".lz4" } )
+	{
+		std::string path = directory + "/bench_codec_read" + suffix;
+		struct stat fileStat;
+		uint64_t bytesDecoded = 0;
+
+		if ( not __write_stream( path, stream ) or ( 0 != stat( path.c_str(), &fileStat ) ) )
+		{
+			fprintf( stderr, "Writing %s failed\n", path.c_str() );
+			return EXIT_FAILURE;
+		}
+
+		double seconds = __seconds_per_run( [ & ]()
+		{
+			File file( path, File::IOFlag::READ );
+			int64_t bytesRead;
+			bytesDecoded = 0;
+
+			while ( 0 < ( bytesRead = file.read( decoded.data(), decoded.size() ) ) )
+			{
+				bytesDecoded += bytesRead;
+			}
+		} );
+
+		unlink( path.c_str() );
+
+		if ( CODEC_STREAM_SIZE != bytesDecoded )
+		{
+			fprintf( stderr, "%s decoded to %lu bytes, not %d\n", path.c_str(), bytesDecoded, CODEC_STREAM_SIZE );
+			return EXIT_FAILURE;
+		}
+
+		std::string name = "decode " + suffix;
+		__report( name.c_str(), CODEC_STREAM_SIZE / 1e6 / seconds, "MB/s" );
+		__report( ( name + " ratio" ).c_str(), static_cast< double >( CODEC_STREAM_SIZE ) / fileStat.st_size, "x" );
+	}
+
+	return EXIT_SUCCESS;
+}
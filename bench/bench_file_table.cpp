@@ -0,0 +1,161 @@
+/**
+ * Copyright ©2021. Brent Weichel. All Rights Reserved.
+ * Permission to use, copy, modify, and/or distribute this software, in whole
+ * or part by any means, without express prior written agreement is prohibited.
+ */
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <string_view>
+#include <unistd.h>
+#include <vector>
+
+#include "Bench.hpp"
+#include "File.hpp"
+#include "FileRecords.hpp"
+#include "FileTable.hpp"
+
+// Keys are even numbers, so that the odd ones fall between them and miss.
+#define TABLE_KEY_COUNT ( 1000000 )
+
+// The lookups timed per run; a linear scan reads half the file per hit, so it takes fewer.
+#define TABLE_INDEXED_LOOKUPS ( 10000 )
+#define TABLE_SCANNED_LOOKUPS ( 10 )
+
+static std::string __key(
+	uint64_t number )
+{
+	char key[ 16 ];
+	snprintf( key, sizeof( key ), "key%08lu", number );
+	return key;
+}
+
+static std::string __value(
+	uint64_t number )
+{
+	return std::string( number % 50, 'v' ) + std::to_string( number );
+}
+
+/*
+ * Write the records as a table, and as lines of "key\tvalue" to be scanned.
+ * @return True is returned on success.
+ */
+static bool __write_records(
+	const std::string& tablePath,
+	const std::string& linesPath )
+{
+	unlink( tablePath.c_str() );
+	unlink( linesPath.c_str() );
+
+	File tableFile( tablePath, File::IOFlag::WRITE );
+	File linesFile( linesPath, File::IOFlag::WRITE );
+	FileTableWriter writer( tableFile );
+	std::string lines;
+
+	for ( uint64_t number = 0; number < TABLE_KEY_COUNT; ++number )
+	{
+		std::string key = __key( 2 * number );
+		std::string value = __value( 2 * number );
+
+		if ( not writer.add( key, value ) )
+		{
+			return false;
+		}
+
+		lines += key + "\t" + value + "\n";
+	}
+
+	return writer.finish()
+		and ( static_cast< int64_t >( lines.size() ) == linesFile.write( reinterpret_cast< const uint8_t* >( lines.data() ), lines.size() ) );
+}
+
+/*
+ * Benchmark point lookups of a table of a million records, against a linear scan of
+ * the same records as lines, reporting the mean latency of a lookup. Hits are looked
+ * up through the index, and misses are mostly answered by the filter alone.
+ * Usage: bench_file_table [directory] [default: /tmp]
+ */
+int main(
+	int argc,
+	char** argv )
+{
+	std::string directory = ( 1 < argc ) ? argv[ 1 ] : "/tmp";
+	std::string tablePath = directory + "/bench_file_table.tbl";
+	std::string linesPath = directory + "/bench_file_table.txt";
+
+	if ( not __write_records( tablePath, linesPath ) )
+	{
+		fprintf( stderr, "Writing %s or %s failed\n", tablePath.c_str(), linesPath.c_str() );
+		return EXIT_FAILURE;
+	}
+
+	std::mt19937_64 random( 47 );
+	std::vector< std::string > hits;
+	std::vector< std::string > misses;
+
+	for ( size_t lookup = 0; lookup < TABLE_INDEXED_LOOKUPS; ++lookup )
+	{
+		uint64_t number = random() % TABLE_KEY_COUNT;
+		hits.push_back( __key( 2 * number ) );
+		misses.push_back( __key( 2 * number + 1 ) );
+	}
+
+	File tableFile( tablePath, File::IOFlag::READ );
+	FileTableReader reader( tableFile );
+	File linesFile( linesPath, File::IOFlag::READ );
+	std::string value;
+	uint64_t found = 0;
+
+	auto indexedLookups = [ & ]( const std::vector< std::string >& keys )
+	{
+		found = 0;
+
+		for ( const std::string& key : keys )
+		{
+			found += reader.get( key, value );
+		}
+	};
+
+	double hitSeconds = __seconds_per_run( [ & ]() { indexedLookups( hits ); } );
+	bool hitsFound = ( TABLE_INDEXED_LOOKUPS == found );
+	double missSeconds = __seconds_per_run( [ & ]() { indexedLookups( misses ); } );
+	bool missesMissed = ( 0 == found );
+
+	double scanSeconds = __seconds_per_run( [ & ]()
+	{
+		found = 0;
+
+		for ( size_t lookup = 0; lookup < TABLE_SCANNED_LOOKUPS; ++lookup )
+		{
+			std::string_view key( hits[ lookup ] );
+			linesFile.seek( 0 );
+
+			for ( std::string_view line : linesFile.lines() )
+			{
+				if ( ( key.size() < line.size() ) and ( '\t' == line[ key.size() ] ) and line.starts_with( key ) )
+				{
+					++found;
+					break;
+				}
+			}
+		}
+	} );
+
+	bool scansFound = ( TABLE_SCANNED_LOOKUPS == found );
+
+	unlink( tablePath.c_str() );
+	unlink( linesPath.c_str() );
+
+	if ( not hitsFound or not missesMissed or not scansFound )
+	{
+		fprintf( stderr, "A lookup found the wrong records: %s\n", reader.errorMessage().c_str() );
+		return EXIT_FAILURE;
+	}
+
+	__report( "table lookup, hit", hitSeconds / TABLE_INDEXED_LOOKUPS * 1e6, "us" );
+	__report( "table lookup, miss", missSeconds / TABLE_INDEXED_LOOKUPS * 1e6, "us" );
+	__report( "linear scan, hit", scanSeconds / TABLE_SCANNED_LOOKUPS * 1e6, "us" );
+	return EXIT_SUCCESS;
+}
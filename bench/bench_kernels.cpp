@@ -0,0 +1,164 @@
+/**
+ * Copyright ©2021. Brent Weichel. All Rights Reserved.
+ * Permission to use, copy, modify, and/or distribute this software, in whole
+ * or part by any means, without express prior written agreement is prohibited.
+ */
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "Bench.hpp"
+#include "BloomFilter.hpp"
+#include "Checksum.hpp"
+#include "Scan.hpp"
+
+// Large enough to run from memory rather than cache, like the blocks of a file.
+#define KERNEL_BUFFER_SIZE ( 64 * 1024 * 1024 )
+
+// A sidecar block size of the integrity layer (its "block_checksums" parameter),
+// each block of which is checksummed on its own.
+#define KERNEL_BLOCK_SIZE ( 64 * 1024 )
+
+/*
+ * Compare the accelerated CRC32C against the table driven one, over a whole
+ * buffer and a block at a time, as the integrity layer checksums.
+ */
+static void __bench_crc32c(
+	const std::vector< uint8_t >& buffer )
+{
+	double gigabytes = buffer.size() / 1e9;
+
+	__report( "crc32c portable", gigabytes / __seconds_per_run( [ & ]()
+	{
+		__keep( _crc32c_portable( 0, buffer.data(), buffer.size() ) );
+	} ), "GB/s" );
+
+	__report( "crc32c", gigabytes / __seconds_per_run( [ & ]()
+	{
+		__keep( _crc32c( 0, buffer.data(), buffer.size() ) );
+	} ), "GB/s" );
+
+	__report( "crc32c per block", gigabytes / __seconds_per_run( [ & ]()
+	{
+		for ( size_t offset = 0; offset < buffer.size(); offset += KERNEL_BLOCK_SIZE )
+		{
+			__keep( _crc32c( 0, buffer.data() + offset, KERNEL_BLOCK_SIZE ) );
+		}
+	} ), "GB/s" );
+}
+
+/*
+ * Compare the delimiter scan of FileRecords against memchr(), which it calls, counting
+ * the delimiters of a buffer of records of about a hundred bytes.
+ */
+static void __bench_find_byte(
+	const std::vector< uint8_t >& buffer )
+{
+	double gigabytes = buffer.size() / 1e9;
+	const uint8_t* end = buffer.data() + buffer.size();
+
+	__report( "memchr", gigabytes / __seconds_per_run( [ & ]()
+	{
+		uint64_t delimiters = 0;
+		const void* position = buffer.data();
+
+		while ( nullptr != ( position = memchr( position, '\n', end - static_cast< const uint8_t* >( position ) ) ) )
+		{
+			position = static_cast< const uint8_t* >( position ) + 1;
+			++delimiters;
+		}
+
+		__keep( delimiters );
+	} ), "GB/s" );
+
+	__report( "find byte", gigabytes / __seconds_per_run( [ & ]()
+	{
+		uint64_t delimiters = 0;
+		const uint8_t* position = buffer.data();
+
+		while ( end != ( position = _find_byte( position, end, '\n' ) ) )
+		{
+			++position;
+			++delimiters;
+		}
+
+		__keep( delimiters );
+	} ), "GB/s" );
+}
+
+/*
+ * Compare the accelerated Bloom filter probe against the portable one, for filters
+ * of 10 bits per key that fit in cache and that don't.
+ */
+static void __bench_bloom_filter()
+{
+	std::mt19937_64 random( 48 );
+
+	for ( uint64_t keyCount : { 100000, 10000000 } )
+	{
+		size_t blockCount = _bloom_filter_block_count( keyCount, 10 );
+		std::vector< uint8_t > filter( blockCount * BLOOM_FILTER_BLOCK_SIZE, 0 );
+		std::vector< uint64_t > probes( 1024 * 1024 );
+
+		for ( uint64_t key = 0; key < keyCount; ++key )
+		{
+			_bloom_filter_add( filter.data(), blockCount, random() );
+		}
+
+		for ( uint64_t& probe : probes )
+		{
+			probe = random();
+		}
+
+		std::string keys = std::to_string( keyCount ) + " keys";
+
+		__report( ( "bloom filter portable probe, " + keys ).c_str(), probes.size() / 1e6 / __seconds_per_run( [ & ]()
+		{
+			uint64_t hits = 0;
+
+			for ( uint64_t probe : probes )
+			{
+				hits += _bloom_filter_may_contain_portable( filter.data(), blockCount, probe );
+			}
+
+			__keep( hits );
+		} ), "Mprobes/s" );
+
+		__report( ( "bloom filter probe, " + keys ).c_str(), probes.size() / 1e6 / __seconds_per_run( [ & ]()
+		{
+			uint64_t hits = 0;
+
+			for ( uint64_t probe : probes )
+			{
+				hits += _bloom_filter_may_contain( filter.data(), blockCount, probe );
+			}
+
+			__keep( hits );
+		} ), "Mprobes/s" );
+	}
+}
+
+int main()
+{
+	std::mt19937_64 random( 29 );
+	std::vector< uint8_t > buffer( KERNEL_BUFFER_SIZE );
+
+	for ( uint8_t& byte : buffer )
+	{
+		byte = static_cast< uint8_t >( random() );
+	}
+
+	__bench_crc32c( buffer );
+
+	// Records of 32 to 160 bytes.
+	for ( size_t offset = 0; offset < buffer.size(); offset += 32 + random() % 128 )
+	{
+		buffer[ offset ] = '\n';
+	}
+
+	__bench_find_byte( buffer );
+	__bench_bloom_filter();
+	return 0;
+}
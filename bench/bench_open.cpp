@@ -0,0 +1,81 @@
+/**
+ * Copyright ©2021. Brent Weichel. All Rights Reserved.
+ * Permission to use, copy, modify, and/or distribute this software, in whole
+ * or part by any means, without express prior written agreement is prohibited.
+ */
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "Bench.hpp"
+#include "File.hpp"
+
+// The number of files opened per run, each of a short line.
+#define OPEN_FILE_COUNT ( 10000 )
+
+/*
+ * Benchmark startup over many small files: File::openMany() against opening each with
+ * File( path ) in turn. Each run opens every file, and closes them all again.
+ * Usage: bench_open [directory] [default: /tmp]
+ */
+int main(
+	int argc,
+	char** argv )
+{
+	std::filesystem::path directory = std::filesystem::path( ( 1 < argc ) ? argv[ 1 ] : "/tmp" ) / "bench_open.d";
+	std::vector< std::string > paths;
+
+	std::filesystem::remove_all( directory );
+	std::filesystem::create_directories( directory );
+
+	for ( size_t fileIndex = 0; fileIndex < OPEN_FILE_COUNT; ++fileIndex )
+	{
+		paths.push_back( ( directory / ( std::to_string( fileIndex ) + ".txt" ) ).string() );
+		std::ofstream( paths.back() ) << "file " << fileIndex << "\n";
+	}
+
+	size_t openCount = 0;
+
+	double loopSeconds = __seconds_per_run( [ & ]()
+	{
+		std::vector< File > files;
+		files.reserve( paths.size() );
+		openCount = 0;
+
+		for ( const std::string& path : paths )
+		{
+			files.emplace_back( path, File::IOFlag::READ );
+			openCount += ( 0 <= files.back().size() );
+		}
+	} );
+
+	bool loopOpened = ( OPEN_FILE_COUNT == openCount );
+
+	double openManySeconds = __seconds_per_run( [ & ]()
+	{
+		std::vector< File > files = File::openMany( paths, File::IOFlag::READ );
+		openCount = 0;
+
+		for ( const File& file : files )
+		{
+			openCount += ( 0 <= file.size() );
+		}
+	} );
+
+	std::filesystem::remove_all( directory );
+
+	if ( not loopOpened or ( OPEN_FILE_COUNT != openCount ) )
+	{
+		fprintf( stderr, "Not every file opened\n" );
+		return EXIT_FAILURE;
+	}
+
+	__report( "open in turn", OPEN_FILE_COUNT / 1e3 / loopSeconds, "Kfiles/s" );
+	__report( "openMany", OPEN_FILE_COUNT / 1e3 / openManySeconds, "Kfiles/s" );
+	__report( "openMany speedup", loopSeconds / openManySeconds, "x" );
+	return EXIT_SUCCESS;
+}
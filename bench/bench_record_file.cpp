@@ -0,0 +1,155 @@
+/**
+ * Copyright ©2021. Brent Weichel. All Rights Reserved.
+ * Permission to use, copy, modify, and/or distribute this software, in whole
+ * or part by any means, without express prior written agreement is prohibited.
+ */
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <span>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#include "Bench.hpp"
+#include "File.hpp"
+#include "RecordFile.hpp"
+
+// A record of a cache line, of which every access path below sums one field.
+struct Trade
+{
+	uint64_t mIdentifier;
+	double mPrice;
+	uint32_t mQuantity;
+	uint32_t mFlags;
+	char mSymbol[ 40 ];
+};
+
+// The records in the file, and in each batch read at once.
+#define RECORD_FILE_RECORD_COUNT ( 4 * 1024 * 1024 )
+#define RECORD_FILE_BATCH_COUNT  ( 16 * 1024 )
+
+/*
+ * Benchmark RecordFile's readRange(), view(), and readColumns() against a raw read()
+ * loop copying records out of a byte buffer, each summing the prices of every record.
+ * Usage: bench_record_file [directory] [default: /tmp]
+ */
+int main(
+	int argc,
+	char** argv )
+{
+	std::string path = std::string( ( 1 < argc ) ? argv[ 1 ] : "/tmp" ) + "/bench_record_file.bin";
+	std::vector< Trade > batch( RECORD_FILE_BATCH_COUNT );
+	double expectedSum = 0;
+
+	{
+		unlink( path.c_str() );
+		File file( path, File::IOFlag::WRITE );
+		RecordFile< Trade > records( file );
+
+		for ( int64_t index = 0; index < RECORD_FILE_RECORD_COUNT; index += RECORD_FILE_BATCH_COUNT )
+		{
+			for ( size_t batchIndex = 0; batchIndex < batch.size(); ++batchIndex )
+			{
+				batch[ batchIndex ] = Trade{ static_cast< uint64_t >( index + batchIndex ), static_cast< double >( ( index + batchIndex ) % 1000 ), 1, 0, "SYMBOL" };
+				expectedSum += batch[ batchIndex ].mPrice;
+			}
+
+			if ( static_cast< int64_t >( batch.size() ) != records.append( batch ) )
+			{
+				fprintf( stderr, "Writing %s failed\n", path.c_str() );
+				return EXIT_FAILURE;
+			}
+		}
+	}
+
+	double gigabytes = RECORD_FILE_RECORD_COUNT * sizeof( Trade ) / 1e9;
+	File file( path, File::IOFlag::READ );
+	RecordFile< Trade > records( file );
+	std::vector< uint8_t > buffer( RECORD_FILE_BATCH_COUNT * sizeof( Trade ) );
+	std::vector< double > prices( RECORD_FILE_BATCH_COUNT );
+	bool mismatched = false;
+	double sum = 0;
+
+	auto check = [ & ]()
+	{
+		mismatched = mismatched or ( sum != expectedSum );
+		__keep( static_cast< uint64_t >( sum ) );
+	};
+
+	__report( "read loop", gigabytes / __seconds_per_run( [ & ]()
+	{
+		int64_t bytesRead;
+		sum = 0;
+		file.seek( 0 );
+
+		while ( 0 < ( bytesRead = file.read( buffer.data(), buffer.size() ) ) )
+		{
+			for ( size_t offset = 0; offset + sizeof( Trade ) <= static_cast< size_t >( bytesRead ); offset += sizeof( Trade ) )
+			{
+				Trade trade;
+				memcpy( &trade, buffer.data() + offset, sizeof( trade ) );
+				sum += trade.mPrice;
+			}
+		}
+
+		check();
+	} ), "GB/s" );
+
+	__report( "record file readRange", gigabytes / __seconds_per_run( [ & ]()
+	{
+		int64_t recordsRead;
+		sum = 0;
+
+		for ( int64_t index = 0; 0 < ( recordsRead = records.readRange( index, batch ) ); index += recordsRead )
+		{
+			for ( int64_t batchIndex = 0; batchIndex < recordsRead; ++batchIndex )
+			{
+				sum += batch[ batchIndex ].mPrice;
+			}
+		}
+
+		check();
+	} ), "GB/s" );
+
+	__report( "record file view", gigabytes / __seconds_per_run( [ & ]()
+	{
+		sum = 0;
+
+		for ( int64_t index = 0; index < RECORD_FILE_RECORD_COUNT; index += RECORD_FILE_BATCH_COUNT )
+		{
+			for ( const Trade& trade : records.view( index, RECORD_FILE_BATCH_COUNT ) )
+			{
+				sum += trade.mPrice;
+			}
+		}
+
+		check();
+	} ), "GB/s" );
+
+	__report( "record file readColumns", gigabytes / __seconds_per_run( [ & ]()
+	{
+		int64_t recordsRead;
+		sum = 0;
+
+		for ( int64_t index = 0; 0 < ( recordsRead = records.readColumns( index, RecordFile< Trade >::column( &Trade::mPrice, std::span< double >( prices ) ) ) ); index += recordsRead )
+		{
+			for ( int64_t batchIndex = 0; batchIndex < recordsRead; ++batchIndex )
+			{
+				sum += prices[ batchIndex ];
+			}
+		}
+
+		check();
+	} ), "GB/s" );
+
+	unlink( path.c_str() );
+
+	if ( mismatched )
+	{
+		fprintf( stderr, "The records read didn't add up to those written\n" );
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
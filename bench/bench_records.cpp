@@ -0,0 +1,126 @@
+/**
+ * Copyright ©2021. Brent Weichel. All Rights Reserved.
+ * Permission to use, copy, modify, and/or distribute this software, in whole
+ * or part by any means, without express prior written agreement is prohibited.
+ */
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <random>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#include "Bench.hpp"
+#include "File.hpp"
+#include "FileRecords.hpp"
+#include "Scan.hpp"
+
+// The size of the file iterated, and of the reads of the raw read() loop.
+#define RECORDS_FILE_SIZE ( 512 * 1024 * 1024 )
+#define RECORDS_READ_SIZE ( 1024 * 1024 )
+
+/*
+ * Write a file of lines of 32 to 160 bytes.
+ * @return True is returned on success.
+ */
+static bool __write_lines(
+	const std::string& path )
+{
+	std::mt19937_64 random( 31 );
+	std::vector< uint8_t > buffer( RECORDS_FILE_SIZE );
+
+	for ( size_t offset = 0; offset < buffer.size(); ++offset )
+	{
+		buffer[ offset ] = static_cast< uint8_t >( 'a' + random() % 26 );
+	}
+
+	for ( size_t offset = 0; offset < buffer.size(); offset += 32 + random() % 128 )
+	{
+		buffer[ offset ] = '\n';
+	}
+
+	buffer.back() = '\n';
+
+	FILE* stream = fopen( path.c_str(), "wb" );
+	bool written = ( nullptr != stream ) and ( buffer.size() == fwrite( buffer.data(), 1, buffer.size(), stream ) );
+	return ( nullptr != stream ) and ( 0 == fclose( stream ) ) and written;
+}
+
+/*
+ * Benchmark File::lines() against a raw read() loop scanning each buffer for
+ * delimiters, which does no more than lines() must, and against std::getline().
+ * Usage: bench_records [directory] [default: /tmp]
+ */
+int main(
+	int argc,
+	char** argv )
+{
+	std::string path = std::string( ( 1 < argc ) ? argv[ 1 ] : "/tmp" ) + "/bench_records.txt";
+
+	if ( not __write_lines( path ) )
+	{
+		fprintf( stderr, "Writing %s failed\n", path.c_str() );
+		return EXIT_FAILURE;
+	}
+
+	double gigabytes = RECORDS_FILE_SIZE / 1e9;
+	File file( path, File::IOFlag::READ );
+	std::vector< uint8_t > buffer( RECORDS_READ_SIZE );
+	uint64_t lineCount = 0;
+	uint64_t expectedLineCount = 0;
+
+	__report( "read loop", gigabytes / __seconds_per_run( [ & ]()
+	{
+		int64_t bytesRead;
+		expectedLineCount = 0;
+		file.seek( 0 );
+
+		while ( 0 < ( bytesRead = file.read( buffer.data(), buffer.size() ) ) )
+		{
+			const uint8_t* end = buffer.data() + bytesRead;
+
+			for ( const uint8_t* position = buffer.data(); end != ( position = _find_byte( position, end, '\n' ) ); ++position )
+			{
+				++expectedLineCount;
+			}
+		}
+	} ), "GB/s" );
+
+	__report( "lines", gigabytes / __seconds_per_run( [ & ]()
+	{
+		lineCount = 0;
+		file.seek( 0 );
+
+		for ( std::string_view line : file.lines() )
+		{
+			__keep( line.size() );
+			++lineCount;
+		}
+	} ), "GB/s" );
+
+	__report( "std::getline", gigabytes / __seconds_per_run( [ & ]()
+	{
+		std::ifstream stream( path );
+		std::string line;
+		uint64_t getlineCount = 0;
+
+		while ( std::getline( stream, line ) )
+		{
+			++getlineCount;
+		}
+
+		__keep( getlineCount );
+	} ), "GB/s" );
+
+	unlink( path.c_str() );
+
+	if ( lineCount != expectedLineCount )
+	{
+		fprintf( stderr, "lines() gave %lu lines, not %lu\n", lineCount, expectedLineCount );
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,155 @@
+/**
+ * Copyright ©2021. Brent Weichel. All Rights Reserved.
+ * Permission to use, copy, modify, and/or distribute this software, in whole
+ * or part by any means, without express prior written agreement is prohibited.
+ */
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "Bench.hpp"
+#include "File.hpp"
+
+// The foreground reads are small and random, e.g. point lookups, the background
+// reads large and sequential, e.g. a compaction or backup.
+#define SCHEDULER_FOREGROUND_READ_SIZE  ( 4096 )
+#define SCHEDULER_FOREGROUND_READ_COUNT ( 20000 )
+#define SCHEDULER_BACKGROUND_READ_SIZE  ( 1024 * 1024 )
+#define SCHEDULER_BACKGROUND_THREADS    ( 4 )
+
+/*
+ * Time random foreground reads of a file while background threads read it through.
+ * @param path The path of the file.
+ * @param foregroundQuery The query selecting the priority of the foreground reads.
+ * @param backgroundQuery The query selecting the priority of the background reads,
+ *                        or nullptr for no background reads.
+ * @param latencies Reference to store the latency of each foreground read, in microseconds, sorted.
+ * @return False is returned should a read fail.
+ */
+static bool __time_foreground_reads(
+	const std::string& path,
+	const char* foregroundQuery,
+	const char* backgroundQuery,
+	std::vector< double >& latencies )
+{
+	std::atomic_bool stopped( false );
+	std::atomic_bool failed( false );
+	std::vector< std::thread > backgroundThreads;
+
+	for ( int threadIndex = 0; ( nullptr != backgroundQuery ) and ( threadIndex < SCHEDULER_BACKGROUND_THREADS ); ++threadIndex )
+	{
+		backgroundThreads.emplace_back( [ & ]()
+		{
+			File file( path + backgroundQuery, File::IOFlag::READ );
+			std::vector< uint8_t > buffer( SCHEDULER_BACKGROUND_READ_SIZE );
+			int64_t fileSize = file.size();
+			int64_t offset = 0;
+
+			while ( not stopped )
+			{
+				if ( 0 > file.pread( buffer.data(), buffer.size(), offset ) )
+				{
+					failed = true;
+					return;
+				}
+
+				offset = ( offset + SCHEDULER_BACKGROUND_READ_SIZE ) % fileSize;
+			}
+		} );
+	}
+
+	File file( path + foregroundQuery, File::IOFlag::READ );
+	std::vector< uint8_t > buffer( SCHEDULER_FOREGROUND_READ_SIZE );
+	std::mt19937_64 random( 43 );
+	int64_t blockCount = file.size() / SCHEDULER_FOREGROUND_READ_SIZE;
+
+	latencies.clear();
+
+	for ( size_t readIndex = 0; ( readIndex < SCHEDULER_FOREGROUND_READ_COUNT ) and ( 0 < blockCount ); ++readIndex )
+	{
+		int64_t offset = static_cast< int64_t >( random() % blockCount ) * SCHEDULER_FOREGROUND_READ_SIZE;
+		auto start = std::chrono::steady_clock::now();
+
+		if ( SCHEDULER_FOREGROUND_READ_SIZE != file.pread( buffer.data(), buffer.size(), offset ) )
+		{
+			failed = true;
+			break;
+		}
+
+		latencies.push_back( std::chrono::duration< double, std::micro >( std::chrono::steady_clock::now() - start ).count() );
+	}
+
+	stopped = true;
+
+	for ( std::thread& thread : backgroundThreads )
+	{
+		thread.join();
+	}
+
+	std::sort( latencies.begin(), latencies.end() );
+	return not ( failed or latencies.empty() );
+}
+
+/*
+ * Benchmark the latency of foreground reads under background load: alone, with the
+ * load at the same priority, and with the load in the background class of the I/O
+ * scheduler. The file should be larger than memory for the reads to reach the disk.
+ * Usage: bench_scheduler [directory] [file size in MiB] [default: /tmp 256]
+ */
+int main(
+	int argc,
+	char** argv )
+{
+	std::string path = std::string( ( 1 < argc ) ? argv[ 1 ] : "/tmp" ) + "/bench_scheduler.bin";
+	int64_t fileSize = ( ( 2 < argc ) ? atoll( argv[ 2 ] ) : 256 ) * 1024 * 1024;
+	std::vector< uint8_t > block( SCHEDULER_BACKGROUND_READ_SIZE, 's' );
+
+	{
+		unlink( path.c_str() );
+		File file( path, File::IOFlag::WRITE );
+
+		for ( int64_t written = 0; written < fileSize; written += block.size() )
+		{
+			if ( static_cast< int64_t >( block.size() ) != file.write( block.data(), block.size() ) )
+			{
+				fprintf( stderr, "Writing %s failed\n", path.c_str() );
+				return EXIT_FAILURE;
+			}
+		}
+	}
+
+	struct
+	{
+		const char* mName;
+		const char* mForegroundQuery;
+		const char* mBackgroundQuery;
+	} runs[] = {
+		{ "foreground reads alone", "?priority=foreground", nullptr },
+		{ "foreground reads, unprioritized load", "?priority=normal", "?priority=normal" },
+		{ "foreground reads, background load", "?priority=foreground", "?priority=background" }
+	};
+
+	for ( const auto& run : runs )
+	{
+		std::vector< double > latencies;
+
+		if ( not __time_foreground_reads( path, run.mForegroundQuery, run.mBackgroundQuery, latencies ) )
+		{
+			fprintf( stderr, "Reading %s failed\n", path.c_str() );
+			return EXIT_FAILURE;
+		}
+
+		__report( ( std::string( run.mName ) + " p50" ).c_str(), latencies[ latencies.size() / 2 ], "us" );
+		__report( ( std::string( run.mName ) + " p99" ).c_str(), latencies[ latencies.size() * 99 / 100 ], "us" );
+	}
+
+	unlink( path.c_str() );
+	return EXIT_SUCCESS;
+}
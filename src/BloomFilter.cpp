@@ -0,0 +1,121 @@
+/**
+ * Copyright ©2021. Brent Weichel. All Rights Reserved.
+ * Permission to use, copy, modify, and/or distribute this software, in whole
+ * or part by any means, without express prior written agreement is prohibited.
+ */
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#if defined( __x86_64__ )
+#include <immintrin.h>
+#endif
+
+#include "BloomFilter.hpp"
+
+#define BLOOM_FILTER_WORD_COUNT ( BLOOM_FILTER_BLOCK_SIZE / sizeof( uint64_t ) )
+
+// Odd multipliers spreading the low half of the hash into a bit of each word of a block.
+alignas( 32 ) static const uint32_t BLOOM_FILTER_SALTS[ BLOOM_FILTER_WORD_COUNT ] = {
+	0x47B6137B, 0x44974D91, 0x8824AD5B, 0xA2B7289D,
+	0x705495C7, 0x2DF1424B, 0x9EFC4947, 0x5C6BFB31
+};
+
+/*
+ * Pick the block of a hash from its high half, by multiplying rather than dividing.
+ */
+static inline size_t __block_offset(
+	size_t blockCount,
+	uint64_t hash )
+{
+	return ( ( ( hash >> 32 ) * blockCount ) >> 32 ) * BLOOM_FILTER_BLOCK_SIZE;
+}
+
+static inline uint64_t __word_mask(
+	uint64_t hash,
+	size_t word )
+{
+	return static_cast< uint64_t >( 1 ) << ( ( static_cast< uint32_t >( hash ) * BLOOM_FILTER_SALTS[ word ] ) >> 26 );
+}
+
+#if defined( __x86_64__ )
+__attribute__(( target( "avx2" ) ))
+static bool __bloom_filter_may_contain_avx2(
+	const uint8_t* filter,
+	size_t blockCount,
+	uint64_t hash )
+{
+	const uint8_t* block = filter + __block_offset( blockCount, hash );
+
+	// Compute the bits of all eight words at once, then test each half of the block.
+	__m256i bits = _mm256_srli_epi32( _mm256_mullo_epi32( _mm256_set1_epi32( static_cast< int >( hash ) ),
+		_mm256_load_si256( reinterpret_cast< const __m256i* >( BLOOM_FILTER_SALTS ) ) ), 26 );
+	__m256i lowMask = _mm256_sllv_epi64( _mm256_set1_epi64x( 1 ), _mm256_cvtepu32_epi64( _mm256_castsi256_si128( bits ) ) );
+	__m256i highMask = _mm256_sllv_epi64( _mm256_set1_epi64x( 1 ), _mm256_cvtepu32_epi64( _mm256_extracti128_si256( bits, 1 ) ) );
+
+	return _mm256_testc_si256( _mm256_loadu_si256( reinterpret_cast< const __m256i* >( block ) ), lowMask )
+		and _mm256_testc_si256( _mm256_loadu_si256( reinterpret_cast< const __m256i* >( block + 32 ) ), highMask );
+}
+#endif
+
+bool _bloom_filter_may_contain_portable(
+	const uint8_t* filter,
+	size_t blockCount,
+	uint64_t hash )
+{
+	const uint8_t* block = filter + __block_offset( blockCount, hash );
+	uint64_t missing = 0;
+
+	for ( size_t word = 0; word < BLOOM_FILTER_WORD_COUNT; ++word )
+	{
+		uint64_t bits;
+		memcpy( &bits, block + word * sizeof( bits ), sizeof( bits ) );
+		missing |= ~bits & __word_mask( hash, word );
+	}
+
+	return 0 == missing;
+}
+
+size_t _bloom_filter_block_count(
+	uint64_t keyCount,
+	size_t bitsPerKey )
+{
+	uint64_t bitCount = keyCount * bitsPerKey;
+	uint64_t blockBits = BLOOM_FILTER_BLOCK_SIZE * 8;
+
+	// Blocks are picked with the high 32 bits of the hash, which can't address more.
+	return std::clamp< uint64_t >( ( bitCount + blockBits - 1 ) / blockBits, 1, UINT32_MAX );
+}
+
+void _bloom_filter_add(
+	uint8_t* filter,
+	size_t blockCount,
+	uint64_t hash )
+{
+	uint8_t* block = filter + __block_offset( blockCount, hash );
+
+	for ( size_t word = 0; word < BLOOM_FILTER_WORD_COUNT; ++word )
+	{
+		uint64_t bits;
+		memcpy( &bits, block + word * sizeof( bits ), sizeof( bits ) );
+		bits |= __word_mask( hash, word );
+		memcpy( block + word * sizeof( bits ), &bits, sizeof( bits ) );
+	}
+}
+
+bool _bloom_filter_may_contain(
+	const uint8_t* filter,
+	size_t blockCount,
+	uint64_t hash )
+{
+#if defined( __x86_64__ )
+	static const bool AVX2_SUPPORTED = __builtin_cpu_supports( "avx2" );
+
+	if ( AVX2_SUPPORTED )
+	{
+		return __bloom_filter_may_contain_avx2( filter, blockCount, hash );
+	}
+#endif
+
+	return _bloom_filter_may_contain_portable( filter, blockCount, hash );
+}
@@ -0,0 +1,57 @@
+/**
+ * Copyright ©2021. Brent Weichel. All Rights Reserved.
+ * Permission to use, copy, modify, and/or distribute this software, in whole
+ * or part by any means, without express prior written agreement is prohibited.
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * A blocked Bloom filter is an array of blocks of one cache line, each of eight 64-bit
+ * words. A key sets, and is probed for, one bit in every word of the one block picked
+ * by its hash, so that a probe touches a single cache line.
+ */
+#define BLOOM_FILTER_BLOCK_SIZE ( 64 )
+
+/*
+ * Get the number of blocks of a filter for a number of keys.
+ * @param keyCount The number of keys to be added.
+ * @param bitsPerKey The number of bits of the filter per key; 10 gives about 1% false positives.
+ * @return The number of blocks is returned, at least one.
+ */
+size_t _bloom_filter_block_count(
+	uint64_t keyCount,
+	size_t bitsPerKey );
+
+/*
+ * Add the hash of a key to a filter.
+ * @param filter Pointer to the blocks of the filter, of any alignment.
+ * @param blockCount The number of blocks of the filter.
+ * @param hash The 64-bit hash of the key.
+ */
+void _bloom_filter_add(
+	uint8_t* filter,
+	size_t blockCount,
+	uint64_t hash );
+
+/*
+ * Probe a filter for the hash of a key. AVX2 is used when the processor supports it.
+ * @param filter Pointer to the blocks of the filter, of any alignment.
+ * @param blockCount The number of blocks of the filter.
+ * @param hash The 64-bit hash of the key.
+ * @return False is returned if the key was never added, true if it may have been.
+ */
+bool _bloom_filter_may_contain(
+	const uint8_t* filter,
+	size_t blockCount,
+	uint64_t hash );
+
+/*
+ * The portable probe, exposed so that the accelerated one can be checked against it.
+ */
+bool _bloom_filter_may_contain_portable(
+	const uint8_t* filter,
+	size_t blockCount,
+	uint64_t hash );
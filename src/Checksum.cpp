@@ -0,0 +1,276 @@
+/**
+ * Copyright ©2021. Brent Weichel. All Rights Reserved.
+ * Permission to use, copy, modify, and/or distribute this software, in whole
+ * or part by any means, without express prior written agreement is prohibited.
+ */
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+
+#if defined( __x86_64__ )
+#include <nmmintrin.h>
+#elif defined( __aarch64__ )
+#include <arm_acle.h>
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+
+#include "Checksum.hpp"
+
+// Reflected Castagnoli polynomial
+#define CRC32C_POLYNOMIAL ( 0x82F63B78U )
+
+// The accelerated implementations run three independent CRC streams over
+// consecutive lanes of this many bytes, hiding the latency of the CRC
+// instruction, and then merge the lanes with the shift tables below.
+#define CRC32C_LANE_SIZE ( 4096 )
+
+static uint32_t _G_CRC32CTable[ 8 ][ 256 ];
+
+// _G_CRC32CShiftTable[ k ][ b ] is the effect of appending CRC32C_LANE_SIZE
+// zero bytes on the CRC state ( b << 8k ). The operation is linear in the
+// state, so shifting any state is the XOR of its four byte contributions.
+static uint32_t _G_CRC32CShiftTable[ 4 ][ 256 ];
+
+static std::once_flag _G_CRC32CTableOnce;
+
+static uint32_t __crc32c_portable_state(
+	uint32_t state,
+	const uint8_t* buffer,
+	size_t bytes )
+{
+	// Slicing-by-8
+	while ( 8 <= bytes )
+	{
+		uint64_t word;
+		memcpy( &word, buffer, sizeof( word ) );
+		word ^= state;
+
+		state = _G_CRC32CTable[ 7 ][ word & 0xFF ]
+			^ _G_CRC32CTable[ 6 ][ ( word >> 8 ) & 0xFF ]
+			^ _G_CRC32CTable[ 5 ][ ( word >> 16 ) & 0xFF ]
+			^ _G_CRC32CTable[ 4 ][ ( word >> 24 ) & 0xFF ]
+			^ _G_CRC32CTable[ 3 ][ ( word >> 32 ) & 0xFF ]
+			^ _G_CRC32CTable[ 2 ][ ( word >> 40 ) & 0xFF ]
+			^ _G_CRC32CTable[ 1 ][ ( word >> 48 ) & 0xFF ]
+			^ _G_CRC32CTable[ 0 ][ word >> 56 ];
+
+		buffer += 8;
+		bytes -= 8;
+	}
+
+	while ( 0 < bytes-- )
+	{
+		state = _G_CRC32CTable[ 0 ][ ( state ^ *buffer++ ) & 0xFF ] ^ ( state >> 8 );
+	}
+
+	return state;
+}
+
+static void __initialize_crc32c_tables()
+{
+	for ( uint32_t byteValue = 0; byteValue < 256; ++byteValue )
+	{
+		uint32_t state = byteValue;
+
+		for ( int bit = 0; bit < 8; ++bit )
+		{
+			state = ( state >> 1 ) ^ ( ( state & 1 ) ? CRC32C_POLYNOMIAL : 0 );
+		}
+
+		_G_CRC32CTable[ 0 ][ byteValue ] = state;
+	}
+
+	for ( uint32_t byteValue = 0; byteValue < 256; ++byteValue )
+	{
+		for ( int slice = 1; slice < 8; ++slice )
+		{
+			uint32_t previous = _G_CRC32CTable[ slice - 1 ][ byteValue ];
+			_G_CRC32CTable[ slice ][ byteValue ] = ( previous >> 8 ) ^ _G_CRC32CTable[ 0 ][ previous & 0xFF ];
+		}
+	}
+
+	// Derive the lane shift operator column by column.
+	static const uint8_t ZEROS[ CRC32C_LANE_SIZE ] = { 0 };
+	uint32_t shiftedBasis[ 32 ];
+
+	for ( int bit = 0; bit < 32; ++bit )
+	{
+		shiftedBasis[ bit ] = __crc32c_portable_state( 1U << bit, ZEROS, sizeof( ZEROS ) );
+	}
+
+	for ( int slice = 0; slice < 4; ++slice )
+	{
+		for ( uint32_t byteValue = 0; byteValue < 256; ++byteValue )
+		{
+			uint32_t shifted = 0;
+
+			for ( int bit = 0; bit < 8; ++bit )
+			{
+				if ( byteValue & ( 1U << bit ) )
+				{
+					shifted ^= shiftedBasis[ 8 * slice + bit ];
+				}
+			}
+
+			_G_CRC32CShiftTable[ slice ][ byteValue ] = shifted;
+		}
+	}
+}
+
+static inline uint32_t __crc32c_shift_lane(
+	uint32_t state )
+{
+	return _G_CRC32CShiftTable[ 0 ][ state & 0xFF ]
+		^ _G_CRC32CShiftTable[ 1 ][ ( state >> 8 ) & 0xFF ]
+		^ _G_CRC32CShiftTable[ 2 ][ ( state >> 16 ) & 0xFF ]
+		^ _G_CRC32CShiftTable[ 3 ][ state >> 24 ];
+}
+
+#if defined( __x86_64__ )
+__attribute__(( target( "sse4.2" ) ))
+static uint32_t __crc32c_hardware_state(
+	uint32_t state,
+	const uint8_t* buffer,
+	size_t bytes )
+{
+	uint64_t state0 = state;
+
+	while ( 3 * CRC32C_LANE_SIZE <= bytes )
+	{
+		uint64_t state1 = 0;
+		uint64_t state2 = 0;
+
+		for ( size_t offset = 0; offset < CRC32C_LANE_SIZE; offset += 8 )
+		{
+			uint64_t word0, word1, word2;
+			memcpy( &word0, buffer + offset, 8 );
+			memcpy( &word1, buffer + CRC32C_LANE_SIZE + offset, 8 );
+			memcpy( &word2, buffer + 2 * CRC32C_LANE_SIZE + offset, 8 );
+			state0 = _mm_crc32_u64( state0, word0 );
+			state1 = _mm_crc32_u64( state1, word1 );
+			state2 = _mm_crc32_u64( state2, word2 );
+		}
+
+		state0 = __crc32c_shift_lane( static_cast< uint32_t >( state0 ) ) ^ static_cast< uint32_t >( state1 );
+		state0 = __crc32c_shift_lane( static_cast< uint32_t >( state0 ) ) ^ static_cast< uint32_t >( state2 );
+
+		buffer += 3 * CRC32C_LANE_SIZE;
+		bytes -= 3 * CRC32C_LANE_SIZE;
+	}
+
+	while ( 8 <= bytes )
+	{
+		uint64_t word;
+		memcpy( &word, buffer, 8 );
+		state0 = _mm_crc32_u64( state0, word );
+		buffer += 8;
+		bytes -= 8;
+	}
+
+	uint32_t tailState = static_cast< uint32_t >( state0 );
+
+	while ( 0 < bytes-- )
+	{
+		tailState = _mm_crc32_u8( tailState, *buffer++ );
+	}
+
+	return tailState;
+}
+
+static bool __crc32c_hardware_supported()
+{
+	return __builtin_cpu_supports( "sse4.2" );
+}
+#elif defined( __aarch64__ )
+__attribute__(( target( "+crc" ) ))
+static uint32_t __crc32c_hardware_state(
+	uint32_t state,
+	const uint8_t* buffer,
+	size_t bytes )
+{
+	while ( 3 * CRC32C_LANE_SIZE <= bytes )
+	{
+		uint32_t state1 = 0;
+		uint32_t state2 = 0;
+
+		for ( size_t offset = 0; offset < CRC32C_LANE_SIZE; offset += 8 )
+		{
+			uint64_t word0, word1, word2;
+			memcpy( &word0, buffer + offset, 8 );
+			memcpy( &word1, buffer + CRC32C_LANE_SIZE + offset, 8 );
+			memcpy( &word2, buffer + 2 * CRC32C_LANE_SIZE + offset, 8 );
+			state = __crc32cd( state, word0 );
+			state1 = __crc32cd( state1, word1 );
+			state2 = __crc32cd( state2, word2 );
+		}
+
+		state = __crc32c_shift_lane( state ) ^ state1;
+		state = __crc32c_shift_lane( state ) ^ state2;
+
+		buffer += 3 * CRC32C_LANE_SIZE;
+		bytes -= 3 * CRC32C_LANE_SIZE;
+	}
+
+	while ( 8 <= bytes )
+	{
+		uint64_t word;
+		memcpy( &word, buffer, 8 );
+		state = __crc32cd( state, word );
+		buffer += 8;
+		bytes -= 8;
+	}
+
+	while ( 0 < bytes-- )
+	{
+		state = __crc32cb( state, *buffer++ );
+	}
+
+	return state;
+}
+
+static bool __crc32c_hardware_supported()
+{
+	return 0 != ( getauxval( AT_HWCAP ) & HWCAP_CRC32 );
+}
+#else
+static uint32_t __crc32c_hardware_state(
+	uint32_t state,
+	const uint8_t* buffer,
+	size_t bytes )
+{
+	return __crc32c_portable_state( state, buffer, bytes );
+}
+
+static bool __crc32c_hardware_supported()
+{
+	return false;
+}
+#endif
+
+uint32_t _crc32c_portable(
+	uint32_t crc,
+	const uint8_t* buffer,
+	size_t bytes )
+{
+	std::call_once( _G_CRC32CTableOnce, __initialize_crc32c_tables );
+	return ~__crc32c_portable_state( ~crc, buffer, bytes );
+}
+
+uint32_t _crc32c(
+	uint32_t crc,
+	const uint8_t* buffer,
+	size_t bytes )
+{
+	static const bool HARDWARE_SUPPORTED = __crc32c_hardware_supported();
+
+	std::call_once( _G_CRC32CTableOnce, __initialize_crc32c_tables );
+
+	if ( HARDWARE_SUPPORTED )
+	{
+		return ~__crc32c_hardware_state( ~crc, buffer, bytes );
+	}
+
+	return ~__crc32c_portable_state( ~crc, buffer, bytes );
+}
@@ -0,0 +1,32 @@
+/**
+ * Copyright ©2021. Brent Weichel. All Rights Reserved.
+ * Permission to use, copy, modify, and/or distribute this software, in whole
+ * or part by any means, without express prior written agreement is prohibited.
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * Compute the CRC32C (Castagnoli) of a buffer, continuing from a previous value.
+ * The hardware CRC instructions (SSE4.2 on x86-64, CRC on ARMv8) are used when
+ * the processor supports them, otherwise a table driven implementation is used.
+ * @param crc The CRC32C of the preceding bytes, zero for the start of a stream.
+ * @param buffer Pointer to the bytes to checksum.
+ * @param bytes The number of bytes in {@param buffer}.
+ * @return The CRC32C of the preceding bytes followed by {@param buffer}.
+ */
+uint32_t _crc32c(
+	uint32_t crc,
+	const uint8_t* buffer,
+	size_t bytes );
+
+/*
+ * The table driven CRC32C, exposed so that the accelerated
+ * implementations can be checked against it.
+ */
+uint32_t _crc32c_portable(
+	uint32_t crc,
+	const uint8_t* buffer,
+	size_t bytes );
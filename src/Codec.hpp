@@ -0,0 +1,79 @@
+/**
+ * Copyright ©2021. Brent Weichel. All Rights Reserved.
+ * Permission to use, copy, modify, and/or distribute this software, in whole
+ * or part by any means, without express prior written agreement is prohibited.
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#define CODEC_STATUS_ERROR   ( -1 )
+#define CODEC_STATUS_DONE    ( 0 )
+#define CODEC_STATUS_PENDING ( 1 )
+
+struct CodecAPI
+{
+	/**
+	 * Allocate the state for a streaming decoder.
+	 * @return Pointer to the decoder state, or nullptr on error.
+	 */
+	void* ( *_F_create_decoder )();
+
+	/**
+	 * Release the resources held by a decoder.
+	 * @param decoder Pointer to the decoder state.
+	 */
+	void ( *_F_free_decoder )( void* );
+
+	/**
+	 * Discard any partially decoded frame so that decoding may
+	 * restart at the beginning of a frame.
+	 * @param decoder Pointer to the decoder state.
+	 * @return True is returned on success, false on error.
+	 */
+	bool ( *_F_reset_decoder )( void* );
+
+	/**
+	 * Decode as much of the input as will fit into the output. Decoding shall
+	 * stop at the end of a frame so that the caller can record frame boundaries.
+	 * @param decoder Pointer to the decoder state.
+	 * @param input Pointer to the compressed bytes.
+	 * @param inputSize The number of compressed bytes available.
+	 * @param inputConsumed Reference to store the number of compressed bytes consumed.
+	 * @param output Pointer to the buffer to store decoded bytes.
+	 * @param outputSize The number of bytes available in {@param output}.
+	 * @param outputProduced Reference to store the number of decoded bytes produced.
+	 * @param frameEnd Reference set to true if the end of a frame was reached.
+	 * @return CODEC_STATUS_DONE on success, CODEC_STATUS_ERROR on malformed input.
+	 */
+	int ( *_F_decode )( void*, const uint8_t*, size_t, size_t&, uint8_t*, size_t, size_t&, bool& );
+
+	/**
+	 * Allocate the state for a streaming encoder.
+	 * @return Pointer to the encoder state, or nullptr on error.
+	 */
+	void* ( *_F_create_encoder )();
+
+	/**
+	 * Release the resources held by an encoder.
+	 * @param encoder Pointer to the encoder state.
+	 */
+	void ( *_F_free_encoder )( void* );
+
+	/**
+	 * Encode the input into the output, optionally ending the current frame.
+	 * @param encoder Pointer to the encoder state.
+	 * @param input Pointer to the bytes to be encoded.
+	 * @param inputSize The number of bytes to be encoded.
+	 * @param inputConsumed Reference to store the number of input bytes consumed.
+	 * @param output Pointer to the buffer to store the encoded bytes.
+	 * @param outputSize The number of bytes available in {@param output}.
+	 * @param outputProduced Reference to store the number of encoded bytes produced.
+	 * @param endFrame Should the frame be completed once all of the input is consumed.
+	 * @return CODEC_STATUS_DONE once the input is consumed (and the frame ended if requested),
+	 *         CODEC_STATUS_PENDING if the call must be repeated after draining the output,
+	 *         CODEC_STATUS_ERROR on error.
+	 */
+	int ( *_F_encode )( void*, const uint8_t*, size_t, size_t&, uint8_t*, size_t, size_t&, bool );
+};
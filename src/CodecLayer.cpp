@@ -0,0 +1,1021 @@
+/**
+ * Copyright ©2021. Brent Weichel. All Rights Reserved.
+ * Permission to use, copy, modify, and/or distribute this software, in whole
+ * or part by any means, without express prior written agreement is prohibited.
+ */
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "Codec.hpp"
+#include "CodecLayer.hpp"
+#include "File.hpp"
+#include "FileContext.hpp"
+#include "Util.hpp"
+#include "WorkerPool.hpp"
+
+// Here is the list of supported codecs
+#include "codec/codec_gzip.hpp"
+#include "codec/codec_lz4.hpp"
+#include "codec/codec_zstd.hpp"
+
+#define CODEC_INPUT_BUFFER_SIZE   ( 128 * 1024 )
+#define CODEC_DECODE_CHUNK_SIZE   ( 128 * 1024 )
+#define CODEC_OUTPUT_BUFFER_SIZE  ( 256 * 1024 )
+
+// Parallel encoding compresses blocks of this size as independent frames,
+// with at most this many blocks per worker buffered at any one time.
+#define CODEC_PARALLEL_BLOCK_SIZE        ( 1024 * 1024 )
+#define CODEC_PARALLEL_BLOCKS_PER_WORKER ( 2 )
+
+static const std::map< std::string, const struct CodecAPI* > SUPPORTED_CODEC_API_MAP {
+	{ CODEC_GZIP_CANONICAL_NAME, &CODEC_GZIP_API },
+	{ CODEC_LZ4_CANONICAL_NAME, &CODEC_LZ4_API },
+	{ CODEC_ZSTD_CANONICAL_NAME, &CODEC_ZSTD_API }
+};
+
+static const std::map< std::string, const struct CodecAPI* > SUPPORTED_CODEC_SUFFIX_MAP {
+	{ CODEC_GZIP_SUFFIX, &CODEC_GZIP_API },
+	{ CODEC_LZ4_SUFFIX, &CODEC_LZ4_API },
+	{ CODEC_ZSTD_SUFFIX, &CODEC_ZSTD_API }
+};
+
+struct CodecBlock
+{
+	std::vector< uint8_t > mInput;
+	std::vector< uint8_t > mOutput;
+	bool mComplete;
+	bool mFailed;
+};
+
+// The blocks of a parallel encoder, in submission order. The work queued for
+// them on the process-wide pool shares this, as it may run after the codec has
+// been closed, and takes the first block yet to be taken, as does a writer
+// waiting on a block, which then can't wait on work queued behind its own.
+struct CodecBlockQueue
+{
+	const struct CodecAPI* mCodec;
+	std::mutex mMutex;
+	std::condition_variable mBlockCompleted;
+	std::deque< std::shared_ptr< struct CodecBlock > > mBlocks;
+	size_t mBlocksTaken;
+	std::vector< void* > mIdleEncoders;
+
+	~CodecBlockQueue()
+	{
+		for ( void* encoder : mIdleEncoders )
+		{
+			mCodec->_F_free_encoder( encoder );
+		}
+	}
+};
+
+struct CodecContext
+{
+	const struct CodecAPI* mCodec;
+	struct FileContext* mInnerContext; // The scheme (or layer) the codec is stacked on
+
+	// Decoded bytes are held in a window covering the file offsets
+	// [ mWindowPosition, mWindowPosition + mWindow.size() ), the end
+	// of which is where the decoder's next output belongs.
+	void* mDecoder;
+	std::vector< uint8_t > mInput;
+	size_t mInputOffset;
+	std::vector< uint8_t > mWindow;
+	int64_t mWindowPosition;
+	bool mEndOfStream;
+
+	// The start of every frame observed while decoding, as ( compressed offset,
+	// decoded offset ) pairs in increasing order. Any of these is a point from which
+	// decoding can restart, which is what lets seek() avoid decoding from zero.
+	std::vector< std::pair< int64_t, int64_t > > mFrameIndex;
+
+	void* mEncoder;
+	std::vector< uint8_t > mEncoded;
+	size_t mEncodedSize;
+	int64_t mFrameBytes; // Bytes encoded into the currently open frame
+
+	// Parallel encoding: full blocks are compressed by the worker pool,
+	// each as a complete frame, and written out in submission order.
+	std::shared_ptr< struct CodecBlockQueue > mBlockQueue;
+	std::vector< uint8_t > mPendingBlock;
+	size_t mMaximumInFlight;
+
+	// Set once encoded bytes have been lost, after which the stream has a hole
+	// in it, and so every later write, sync and close of it fails.
+	bool mStreamFailed;
+
+	int mErrorCode;
+};
+
+static void __free_codec_context(
+	struct CodecContext* codecContext )
+{
+	if ( nullptr != codecContext->mDecoder )
+	{
+		codecContext->mCodec->_F_free_decoder( codecContext->mDecoder );
+	}
+
+	if ( nullptr != codecContext->mEncoder )
+	{
+		codecContext->mCodec->_F_free_encoder( codecContext->mEncoder );
+	}
+
+	// Blocks left behind by a failed stream are never to be written.
+	if ( nullptr != codecContext->mBlockQueue )
+	{
+		std::lock_guard blockLock( codecContext->mBlockQueue->mMutex );
+		codecContext->mBlockQueue->mBlocks.clear();
+		codecContext->mBlockQueue->mBlocksTaken = 0;
+	}
+
+	delete codecContext;
+}
+
+/*
+ * Restart decoding from the frame recorded at {@param frame}.
+ */
+static bool __codec_restart_at_frame(
+	struct CodecContext* codecContext,
+	const std::pair< int64_t, int64_t >& frame )
+{
+	struct FileContext* innerContext = codecContext->mInnerContext;
+
+	if ( ( -1 == innerContext->_F_seek( innerContext, frame.first, false ) )
+		or not codecContext->mCodec->_F_reset_decoder( codecContext->mDecoder ) )
+	{
+		codecContext->mErrorCode = EIO;
+		return false;
+	}
+
+	codecContext->mInput.clear();
+	codecContext->mInputOffset = 0;
+	codecContext->mWindow.clear();
+	codecContext->mWindowPosition = frame.second;
+	codecContext->mEndOfStream = false;
+	return true;
+}
+
+/*
+ * Decode the next run of bytes onto the end of the window.
+ * @return The number of bytes decoded, zero at the end of the stream, -1 on error.
+ */
+static int64_t __codec_decode_more(
+	struct FileContext* context )
+{
+	struct CodecContext* codecContext = static_cast< struct CodecContext* >( context->_M_SchemeContext );
+	struct FileContext* innerContext = codecContext->mInnerContext;
+
+	if ( codecContext->mEndOfStream )
+	{
+		return 0;
+	}
+
+	while ( true )
+	{
+		if ( codecContext->mInputOffset == codecContext->mInput.size() )
+		{
+			codecContext->mInput.resize( CODEC_INPUT_BUFFER_SIZE );
+			codecContext->mInputOffset = 0;
+
+			int64_t bytesRead = innerContext->_F_read( innerContext, codecContext->mInput.data(), CODEC_INPUT_BUFFER_SIZE, true );
+
+			if ( 0 >= bytesRead )
+			{
+				codecContext->mInput.clear();
+
+				if ( 0 == bytesRead )
+				{
+					// Now that the whole stream has been seen, the decoded size is known.
+					codecContext->mEndOfStream = true;
+					context->_M_FileSize = codecContext->mWindowPosition + codecContext->mWindow.size();
+				}
+
+				return bytesRead;
+			}
+
+			codecContext->mInput.resize( bytesRead );
+		}
+
+		size_t windowSize = codecContext->mWindow.size();
+		size_t inputConsumed = 0;
+		size_t outputProduced = 0;
+		bool frameEnd = false;
+
+		codecContext->mWindow.resize( windowSize + CODEC_DECODE_CHUNK_SIZE );
+
+		int status = codecContext->mCodec->_F_decode( codecContext->mDecoder,
+			codecContext->mInput.data() + codecContext->mInputOffset,
+			codecContext->mInput.size() - codecContext->mInputOffset, inputConsumed,
+			codecContext->mWindow.data() + windowSize, CODEC_DECODE_CHUNK_SIZE, outputProduced, frameEnd );
+
+		codecContext->mWindow.resize( windowSize + outputProduced );
+
+		if ( CODEC_STATUS_ERROR == status )
+		{
+			codecContext->mErrorCode = EBADMSG;
+			return -1;
+		}
+
+		codecContext->mInputOffset += inputConsumed;
+
+		if ( frameEnd )
+		{
+			int64_t compressedOffset = innerContext->_M_FilePosition
+				- static_cast< int64_t >( codecContext->mInput.size() - codecContext->mInputOffset );
+			int64_t decodedOffset = codecContext->mWindowPosition + codecContext->mWindow.size();
+
+			if ( compressedOffset > codecContext->mFrameIndex.back().first )
+			{
+				codecContext->mFrameIndex.emplace_back( compressedOffset, decodedOffset );
+			}
+		}
+
+		if ( 0 < outputProduced )
+		{
+			return outputProduced;
+		}
+	}
+}
+
+/*
+ * Prepare the decoder to produce the byte at {@param position}. The decoder is
+ * restarted at the closest preceding frame if the position lies behind the window,
+ * or if a recorded frame lies closer to the position than the end of the window.
+ * Decoded bytes preceding {@param position} are dropped to keep memory bounded.
+ */
+static bool __codec_position_decoder(
+	struct CodecContext* codecContext,
+	int64_t position )
+{
+	int64_t windowEnd = codecContext->mWindowPosition + codecContext->mWindow.size();
+
+	auto frameIterator = std::upper_bound( codecContext->mFrameIndex.begin(), codecContext->mFrameIndex.end(),
+		position, []( int64_t value, const std::pair< int64_t, int64_t >& frame ) { return value < frame.second; } );
+	const std::pair< int64_t, int64_t >& frame = *std::prev( frameIterator );
+
+	if ( ( position < codecContext->mWindowPosition ) or ( frame.second > windowEnd ) )
+	{
+		return __codec_restart_at_frame( codecContext, frame );
+	}
+
+	int64_t dropCount = std::min( position, windowEnd ) - codecContext->mWindowPosition;
+
+	if ( 0 < dropCount )
+	{
+		codecContext->mWindow.erase( codecContext->mWindow.begin(), codecContext->mWindow.begin() + dropCount );
+		codecContext->mWindowPosition += dropCount;
+	}
+
+	return true;
+}
+
+/*
+ * Write out the encoded bytes waiting in the output buffer.
+ */
+static bool __codec_flush_encoded(
+	struct CodecContext* codecContext )
+{
+	struct FileContext* innerContext = codecContext->mInnerContext;
+	size_t bytesFlushed = 0;
+
+	while ( bytesFlushed < codecContext->mEncodedSize )
+	{
+		int64_t bytesWritten = innerContext->_F_write( innerContext, codecContext->mEncoded.data() + bytesFlushed,
+			codecContext->mEncodedSize - bytesFlushed, true );
+
+		if ( 0 >= bytesWritten )
+		{
+			// Keep what was not written so a later sync may retry.
+			codecContext->mEncoded.erase( codecContext->mEncoded.begin(), codecContext->mEncoded.begin() + bytesFlushed );
+			codecContext->mEncoded.resize( CODEC_OUTPUT_BUFFER_SIZE );
+			codecContext->mEncodedSize -= bytesFlushed;
+			return false;
+		}
+
+		bytesFlushed += bytesWritten;
+	}
+
+	codecContext->mEncodedSize = 0;
+	return true;
+}
+
+/*
+ * Run the encoder over {@param buffer}, flushing the output buffer as it fills.
+ * @param bytesEncoded Set to the number of bytes of {@param buffer} taken by the encoder.
+ */
+static bool __codec_encode(
+	struct CodecContext* codecContext,
+	const uint8_t* buffer,
+	size_t bytes,
+	bool endFrame,
+	size_t& bytesEncoded )
+{
+	bytesEncoded = 0;
+
+	while ( true )
+	{
+		size_t inputConsumed = 0;
+		size_t outputProduced = 0;
+
+		int status = codecContext->mCodec->_F_encode( codecContext->mEncoder,
+			buffer + bytesEncoded, bytes - bytesEncoded, inputConsumed,
+			codecContext->mEncoded.data() + codecContext->mEncodedSize,
+			CODEC_OUTPUT_BUFFER_SIZE - codecContext->mEncodedSize, outputProduced, endFrame );
+
+		if ( CODEC_STATUS_ERROR == status )
+		{
+			// The encoder's state, and whatever it had buffered, is now lost.
+			codecContext->mStreamFailed = true;
+			codecContext->mErrorCode = EIO;
+			return false;
+		}
+
+		bytesEncoded += inputConsumed;
+		codecContext->mEncodedSize += outputProduced;
+		codecContext->mFrameBytes += inputConsumed;
+
+		if ( CODEC_STATUS_DONE == status )
+		{
+			return true;
+		}
+
+		if ( not __codec_flush_encoded( codecContext ) )
+		{
+			return false;
+		}
+	}
+}
+
+/*
+ * Take the first block yet to be taken, and compress it as a single, complete
+ * frame, borrowing one of the idle encoders so they are reused across blocks.
+ * @return False is returned if there was no block to take.
+ */
+static bool __codec_compress_block(
+	const std::shared_ptr< struct CodecBlockQueue >& blockQueue )
+{
+	std::shared_ptr< struct CodecBlock > block;
+	void* encoder = nullptr;
+
+	{
+		std::lock_guard blockLock( blockQueue->mMutex );
+
+		if ( blockQueue->mBlocksTaken == blockQueue->mBlocks.size() )
+		{
+			return false;
+		}
+
+		block = blockQueue->mBlocks[ blockQueue->mBlocksTaken++ ];
+
+		if ( not blockQueue->mIdleEncoders.empty() )
+		{
+			encoder = blockQueue->mIdleEncoders.back();
+			blockQueue->mIdleEncoders.pop_back();
+		}
+	}
+
+	if ( nullptr == encoder )
+	{
+		encoder = blockQueue->mCodec->_F_create_encoder();
+	}
+
+	bool failed = ( nullptr == encoder );
+	size_t bytesEncoded = 0;
+	size_t outputSize = 0;
+
+	block->mOutput.resize( block->mInput.size() / 2 + CODEC_OUTPUT_BUFFER_SIZE );
+
+	while ( not failed )
+	{
+		size_t inputConsumed = 0;
+		size_t outputProduced = 0;
+
+		int status = blockQueue->mCodec->_F_encode( encoder,
+			block->mInput.data() + bytesEncoded, block->mInput.size() - bytesEncoded, inputConsumed,
+			block->mOutput.data() + outputSize, block->mOutput.size() - outputSize, outputProduced, true );
+
+		bytesEncoded += inputConsumed;
+		outputSize += outputProduced;
+
+		if ( CODEC_STATUS_DONE == status )
+		{
+			break;
+		}
+
+		failed = ( CODEC_STATUS_ERROR == status );
+		block->mOutput.resize( 2 * block->mOutput.size() );
+	}
+
+	block->mOutput.resize( outputSize );
+	block->mInput = std::vector< uint8_t >();
+
+	{
+		std::lock_guard blockLock( blockQueue->mMutex );
+
+		if ( nullptr != encoder )
+		{
+			// An encoder that failed mid-frame is in an unknown state.
+			if ( failed )
+			{
+				blockQueue->mCodec->_F_free_encoder( encoder );
+			}
+			else
+			{
+				blockQueue->mIdleEncoders.push_back( encoder );
+			}
+		}
+
+		block->mFailed = failed;
+		block->mComplete = true;
+	}
+
+	blockQueue->mBlockCompleted.notify_all();
+	return true;
+}
+
+/*
+ * Write out the completed blocks at the head of the queue, in order.
+ * @param codecContext Pointer to the codec context.
+ * @param maximumInFlight Wait for blocks to complete until no more than this many remain.
+ * @return False is returned if a block failed to compress or to be written out.
+ */
+static bool __codec_write_blocks(
+	struct CodecContext* codecContext,
+	size_t maximumInFlight )
+{
+	struct FileContext* innerContext = codecContext->mInnerContext;
+	std::shared_ptr< struct CodecBlockQueue > blockQueue = codecContext->mBlockQueue;
+	std::unique_lock< std::mutex > blockLock( blockQueue->mMutex );
+
+	while ( not blockQueue->mBlocks.empty() )
+	{
+		std::shared_ptr< struct CodecBlock > block = blockQueue->mBlocks.front();
+
+		if ( not block->mComplete )
+		{
+			if ( blockQueue->mBlocks.size() <= maximumInFlight )
+			{
+				break;
+			}
+
+			// Rather than wait on the pool, compress the blocks it has yet to start.
+			if ( blockQueue->mBlocksTaken < blockQueue->mBlocks.size() )
+			{
+				blockLock.unlock();
+				__codec_compress_block( blockQueue );
+				blockLock.lock();
+				continue;
+			}
+
+			blockQueue->mBlockCompleted.wait( blockLock, [ &block ]() { return block->mComplete; } );
+		}
+
+		blockQueue->mBlocks.pop_front();
+		--blockQueue->mBlocksTaken;
+		blockLock.unlock();
+
+		if ( block->mFailed )
+		{
+			codecContext->mStreamFailed = true;
+			codecContext->mErrorCode = EIO;
+			return false;
+		}
+
+		size_t bytesFlushed = 0;
+
+		while ( bytesFlushed < block->mOutput.size() )
+		{
+			int64_t bytesWritten = innerContext->_F_write( innerContext, block->mOutput.data() + bytesFlushed,
+				block->mOutput.size() - bytesFlushed, true );
+
+			if ( 0 >= bytesWritten )
+			{
+				// The rest of the block is dropped with it.
+				codecContext->mStreamFailed = true;
+				return false;
+			}
+
+			bytesFlushed += bytesWritten;
+		}
+
+		blockLock.lock();
+	}
+
+	return true;
+}
+
+/*
+ * Hand the pending block to the worker pool, first making room
+ * for it if the maximum number of blocks are already in flight.
+ */
+static bool __codec_submit_block(
+	struct CodecContext* codecContext )
+{
+	if ( codecContext->mPendingBlock.empty() )
+	{
+		return true;
+	}
+
+	if ( not __codec_write_blocks( codecContext, codecContext->mMaximumInFlight - 1 ) )
+	{
+		return false;
+	}
+
+	std::shared_ptr< struct CodecBlock > block = std::make_shared< struct CodecBlock >();
+	block->mInput.swap( codecContext->mPendingBlock );
+	block->mComplete = false;
+	block->mFailed = false;
+	codecContext->mPendingBlock.reserve( CODEC_PARALLEL_BLOCK_SIZE );
+
+	{
+		std::lock_guard blockLock( codecContext->mBlockQueue->mMutex );
+		codecContext->mBlockQueue->mBlocks.push_back( block );
+	}
+
+	_submit_work( _shared_worker_pool(),
+		[ blockQueue = codecContext->mBlockQueue ]() { __codec_compress_block( blockQueue ); } );
+	return true;
+}
+
+/*
+ * Complete the open frame, if any, and write it out. This
+ * leaves the compressed stream valid to the last byte written.
+ */
+static bool __codec_end_frame(
+	struct CodecContext* codecContext )
+{
+	if ( codecContext->mStreamFailed )
+	{
+		return false;
+	}
+
+	// With parallel encoding this is a barrier: every
+	// block submitted so far is waited on and written.
+	if ( nullptr != codecContext->mBlockQueue )
+	{
+		return __codec_submit_block( codecContext )
+			and __codec_write_blocks( codecContext, 0 );
+	}
+
+	if ( ( nullptr == codecContext->mEncoder )
+		or ( 0 == codecContext->mFrameBytes ) )
+	{
+		return __codec_flush_encoded( codecContext );
+	}
+
+	size_t bytesEncoded = 0;
+
+	if ( not __codec_encode( codecContext, nullptr, 0, true, bytesEncoded ) )
+	{
+		return false;
+	}
+
+	codecContext->mFrameBytes = 0;
+	return __codec_flush_encoded( codecContext );
+}
+
+static std::string __codec_error_string(
+	struct FileContext* context )
+{
+	if ( nullptr == context )
+	{
+		return std::string( strerror( EBADF ) );
+	}
+
+	if ( nullptr == context->_M_SchemeContext )
+	{
+		return std::string( strerror( EIDRM ) );
+	}
+
+	struct CodecContext* codecContext = static_cast< struct CodecContext* >( context->_M_SchemeContext );
+
+	if ( 0 != codecContext->mErrorCode )
+	{
+		return std::string( strerror( codecContext->mErrorCode ) );
+	}
+
+	return codecContext->mInnerContext->_F_error_string( codecContext->mInnerContext );
+}
+
+static void __codec_close(
+	struct FileContext* context )
+{
+	if ( ( nullptr == context )
+		or ( nullptr == context->_M_SchemeContext ) )
+	{
+		return;
+	}
+
+	struct CodecContext* codecContext = static_cast< struct CodecContext* >( context->_M_SchemeContext );
+	struct FileContext* innerContext = codecContext->mInnerContext;
+
+	// A failed stream is left as it is, rather than given a trailing frame after the hole.
+	__codec_end_frame( codecContext );
+	innerContext->_F_close( innerContext );
+	_free_context( innerContext );
+	__free_codec_context( codecContext );
+	context->_M_SchemeContext = nullptr;
+}
+
+static int64_t __codec_seek(
+	struct FileContext* context,
+	int64_t offset,
+	bool relative )
+{
+	if ( nullptr == context )
+	{
+		return -1;
+	}
+
+	if ( nullptr == context->_M_SchemeContext )
+	{
+		context->_M_ErrorCode = EIDRM;
+		return -1;
+	}
+
+	struct CodecContext* codecContext = static_cast< struct CodecContext* >( context->_M_SchemeContext );
+
+	// Seeking from the end requires the decoded size, which
+	// is only known once the whole stream has been decoded.
+	if ( not relative and ( 0 > offset ) and ( 0 > context->_M_FileSize ) )
+	{
+		int64_t windowEnd = codecContext->mWindowPosition + codecContext->mWindow.size();
+
+		if ( not __codec_position_decoder( codecContext, windowEnd ) )
+		{
+			return -1;
+		}
+
+		while ( not codecContext->mEndOfStream )
+		{
+			codecContext->mWindowPosition += codecContext->mWindow.size();
+			codecContext->mWindow.clear();
+
+			if ( -1 == __codec_decode_more( context ) )
+			{
+				return -1;
+			}
+		}
+	}
+
+	// The decoder is repositioned lazily by the next read.
+	int64_t requestedPosition = relative
+		? ( context->_M_FilePosition + offset )
+		: ( ( 0 > offset ) ? ( context->_M_FileSize + offset ) : offset );
+	context->_M_FilePosition = std::max< int64_t >( 0, requestedPosition );
+
+	if ( 0 <= context->_M_FileSize )
+	{
+		context->_M_FilePosition = std::min( context->_M_FilePosition, context->_M_FileSize );
+	}
+
+	return requestedPosition - context->_M_FilePosition;
+}
+
+static int64_t __codec_read(
+	struct FileContext* context,
+	uint8_t* buffer,
+	size_t bytes,
+	bool updatePosition )
+{
+	if ( nullptr == context )
+	{
+		return -1;
+	}
+
+	if ( nullptr == context->_M_SchemeContext )
+	{
+		context->_M_ErrorCode = EIDRM;
+		return -1;
+	}
+
+	struct CodecContext* codecContext = static_cast< struct CodecContext* >( context->_M_SchemeContext );
+	int64_t position = context->_M_FilePosition;
+	int64_t bytesRead = 0;
+
+	while ( bytesRead < static_cast< int64_t >( bytes ) )
+	{
+		int64_t windowEnd = codecContext->mWindowPosition + codecContext->mWindow.size();
+
+		if ( ( position >= codecContext->mWindowPosition ) and ( position < windowEnd ) )
+		{
+			int64_t copyCount = std::min< int64_t >( windowEnd - position, bytes - bytesRead );
+
+			memcpy( buffer + bytesRead,
+				codecContext->mWindow.data() + ( position - codecContext->mWindowPosition ), copyCount );
+			bytesRead += copyCount;
+			position += copyCount;
+			continue;
+		}
+
+		if ( not __codec_position_decoder( codecContext, position ) )
+		{
+			return ( 0 == bytesRead ) ? -1 : bytesRead;
+		}
+
+		int64_t bytesDecoded = __codec_decode_more( context );
+
+		if ( 0 >= bytesDecoded )
+		{
+			if ( ( -1 == bytesDecoded ) and ( 0 == bytesRead ) )
+			{
+				return -1;
+			}
+
+			break;
+		}
+	}
+
+	if ( updatePosition )
+	{
+		context->_M_FilePosition = position;
+	}
+
+	return bytesRead;
+}
+
+static int64_t __codec_resize(
+	struct FileContext* context,
+	int64_t,
+	uint8_t,
+	bool,
+	bool )
+{
+	if ( nullptr == context )
+	{
+		return -1;
+	}
+
+	if ( nullptr == context->_M_SchemeContext )
+	{
+		context->_M_ErrorCode = EIDRM;
+		return -1;
+	}
+
+	// A compressed stream can't be resized without re-encoding it.
+	static_cast< struct CodecContext* >( context->_M_SchemeContext )->mErrorCode = ENOTSUP;
+	return context->_M_FileSize;
+}
+
+static bool __codec_sync(
+	struct FileContext* context )
+{
+	if ( nullptr == context )
+	{
+		return false;
+	}
+
+	if ( nullptr == context->_M_SchemeContext )
+	{
+		context->_M_ErrorCode = EIDRM;
+		return false;
+	}
+
+	struct CodecContext* codecContext = static_cast< struct CodecContext* >( context->_M_SchemeContext );
+	struct FileContext* innerContext = codecContext->mInnerContext;
+
+	return __codec_end_frame( codecContext )
+		and innerContext->_F_sync( innerContext );
+}
+
+static int64_t __codec_write(
+	struct FileContext* context,
+	const uint8_t* buffer,
+	size_t bytes,
+	bool append )
+{
+	if ( nullptr == context )
+	{
+		return -1;
+	}
+
+	if ( nullptr == context->_M_SchemeContext )
+	{
+		context->_M_ErrorCode = EIDRM;
+		return -1;
+	}
+
+	struct CodecContext* codecContext = static_cast< struct CodecContext* >( context->_M_SchemeContext );
+
+	if ( codecContext->mStreamFailed )
+	{
+		return -1;
+	}
+
+	// The encoded stream can only be extended at its end.
+	if ( not append
+		and ( 0 <= context->_M_FileSize )
+		and ( context->_M_FilePosition != context->_M_FileSize ) )
+	{
+		codecContext->mErrorCode = ESPIPE;
+		return -1;
+	}
+
+	// Bytes taken by the encoder (or into a block) can't be handed back, so
+	// even when this fails part way they are reported, and not retried.
+	size_t bytesAccepted = 0;
+	bool succeeded = true;
+
+	if ( nullptr != codecContext->mBlockQueue )
+	{
+		while ( succeeded and ( bytesAccepted < bytes ) )
+		{
+			size_t copyCount = std::min< size_t >( bytes - bytesAccepted,
+				CODEC_PARALLEL_BLOCK_SIZE - codecContext->mPendingBlock.size() );
+
+			codecContext->mPendingBlock.insert( codecContext->mPendingBlock.end(),
+				buffer + bytesAccepted, buffer + bytesAccepted + copyCount );
+			bytesAccepted += copyCount;
+
+			if ( CODEC_PARALLEL_BLOCK_SIZE == codecContext->mPendingBlock.size() )
+			{
+				succeeded = __codec_submit_block( codecContext );
+			}
+		}
+
+		// Write out whatever has completed without waiting on the workers.
+		succeeded = succeeded
+			and __codec_write_blocks( codecContext, codecContext->mMaximumInFlight );
+	}
+	else
+	{
+		succeeded = __codec_encode( codecContext, buffer, bytes, false, bytesAccepted );
+	}
+
+	if ( 0 <= context->_M_FileSize )
+	{
+		context->_M_FileSize += bytesAccepted;
+	}
+
+	if ( not append )
+	{
+		context->_M_FilePosition += bytesAccepted;
+	}
+
+	if ( not succeeded and ( 0 == bytesAccepted ) )
+	{
+		return -1;
+	}
+
+	return static_cast< int64_t >( bytesAccepted );
+}
+
+bool _select_codec(
+	std::string& uri,
+	const struct CodecAPI*& codec,
+	unsigned int& threadCount )
+{
+	std::string codecName, threads;
+	codec = nullptr;
+	threadCount = 1;
+
+	if ( _extract_uri_parameter( uri, "threads", threads ) )
+	{
+		char* threadsEnd = nullptr;
+		threadCount = static_cast< unsigned int >( strtoul( threads.c_str(), &threadsEnd, 10 ) );
+
+		if ( threads.empty() or ( '\0' != *threadsEnd ) )
+		{
+			return false;
+		}
+	}
+
+	if ( _extract_uri_parameter( uri, "codec", codecName ) )
+	{
+		if ( "none" == codecName )
+		{
+			return true;
+		}
+
+		auto codecIterator = SUPPORTED_CODEC_API_MAP.find( codecName );
+
+		if ( SUPPORTED_CODEC_API_MAP.end() == codecIterator )
+		{
+			return false;
+		}
+
+		codec = codecIterator->second;
+		return true;
+	}
+
+	std::string path = uri.substr( 0, uri.find( '?' ) );
+	size_t suffixStart = path.rfind( '.' );
+
+	if ( ( std::string::npos != suffixStart )
+		and ( std::string::npos == path.find( '/', suffixStart ) ) )
+	{
+		auto codecIterator = SUPPORTED_CODEC_SUFFIX_MAP.find( path.substr( suffixStart ) );
+
+		if ( SUPPORTED_CODEC_SUFFIX_MAP.end() != codecIterator )
+		{
+			codec = codecIterator->second;
+		}
+	}
+
+	return true;
+}
+
+bool _push_codec_layer(
+	struct FileContext* context,
+	const struct CodecAPI* codec,
+	File::IOFlag mode,
+	unsigned int threadCount,
+	int& errorCode )
+{
+	if ( ( File::IOFlag::READ & mode )
+		and ( File::IOFlag::WRITE & mode ) )
+	{
+		errorCode = EINVAL;
+		return false;
+	}
+
+	struct CodecContext* codecContext = new ( std::nothrow ) CodecContext();
+
+	if ( nullptr == codecContext )
+	{
+		errorCode = ENOMEM;
+		return false;
+	}
+
+	codecContext->mCodec = codec;
+
+	if ( File::IOFlag::READ & mode )
+	{
+		codecContext->mDecoder = codec->_F_create_decoder();
+		codecContext->mFrameIndex.emplace_back( 0, 0 );
+	}
+	else if ( ( 1 != threadCount ) and ( nullptr != _shared_worker_pool() ) )
+	{
+		// The blocks are compressed on the process-wide pool, with no
+		// more in flight at a time than the threads asked for can keep busy.
+		codecContext->mBlockQueue = std::make_shared< struct CodecBlockQueue >();
+		codecContext->mBlockQueue->mCodec = codec;
+		codecContext->mBlockQueue->mBlocksTaken = 0;
+		codecContext->mMaximumInFlight = CODEC_PARALLEL_BLOCKS_PER_WORKER
+			* ( ( 0 == threadCount ) ? _worker_count( _shared_worker_pool() ) : threadCount );
+		codecContext->mPendingBlock.reserve( CODEC_PARALLEL_BLOCK_SIZE );
+	}
+	else
+	{
+		codecContext->mEncoder = codec->_F_create_encoder();
+		codecContext->mEncoded.resize( CODEC_OUTPUT_BUFFER_SIZE );
+	}
+
+	if ( ( nullptr == codecContext->mDecoder )
+		and ( nullptr == codecContext->mEncoder )
+		and ( nullptr == codecContext->mBlockQueue ) )
+	{
+		__free_codec_context( codecContext );
+		errorCode = ENOMEM;
+		return false;
+	}
+
+	codecContext->mInnerContext = _push_context_layer( context );
+
+	if ( nullptr == codecContext->mInnerContext )
+	{
+		__free_codec_context( codecContext );
+		errorCode = ENOMEM;
+		return false;
+	}
+
+	// The decoded size is unknown until the stream has been decoded, unless it is empty.
+	context->_M_FileSize = ( 0 == codecContext->mInnerContext->_M_FileSize ) ? 0 : -1;
+	context->_M_FilePosition = 0;
+	context->_M_Capabilities = static_cast< File::IOFlag >( codecContext->mInnerContext->_M_Capabilities
+		& ( mode | ( ( File::IOFlag::READ & mode ) ? static_cast< uint32_t >( File::IOFlag::SEEK ) : 0u ) ) );
+	context->_M_SchemeContext = static_cast< void* >( codecContext );
+
+	context->_F_error_string = __codec_error_string;
+	context->_F_close = __codec_close;
+	context->_F_seek = __codec_seek;
+	context->_F_read = __codec_read;
+	context->_F_pread = nullptr;
+	context->_F_group_append = nullptr;
+	context->_F_punch_hole = nullptr;
+	context->_F_data_regions = nullptr;
+	context->_F_publish = nullptr;
+	context->_F_snapshot = nullptr;
+	context->_F_dup = nullptr;
+	context->_F_refresh = nullptr;
+	context->_F_watch = nullptr;
+	context->_F_splice = nullptr;
+	context->_F_poll_handle = nullptr;
+	context->_F_view = nullptr;
+	context->_F_write = __codec_write;
+	context->_F_resize = __codec_resize;
+	context->_F_sync = __codec_sync;
+	return true;
+}
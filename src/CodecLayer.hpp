@@ -0,0 +1,49 @@
+/**
+ * Copyright ©2021. Brent Weichel. All Rights Reserved.
+ * Permission to use, copy, modify, and/or distribute this software, in whole
+ * or part by any means, without express prior written agreement is prohibited.
+ */
+#pragma once
+
+#include <string>
+
+#include "Codec.hpp"
+#include "File.hpp"
+#include "FileContext.hpp"
+
+/*
+ * Select the codec for the given URI. The "codec" query parameter takes
+ * precedence over the suffix of the path, and is removed from {@param uri}.
+ * A codec of "none" disables the suffix based selection. The "threads" query
+ * parameter requests parallel encoding, and is likewise removed from {@param uri}.
+ * @param uri Reference to the URI of the resource.
+ * @param codec Reference to store the selected codec, nullptr if none applies.
+ * @param threadCount Reference to store the number of encoding threads, zero for all hardware threads.
+ * @return False is returned if the requested codec is not supported.
+ */
+bool _select_codec(
+	std::string& uri,
+	const struct CodecAPI*& codec,
+	unsigned int& threadCount );
+
+/*
+ * Stack a streaming codec on top of the opened resource in {@param context}.
+ * Reads are decoded and writes are encoded, with the file position and size
+ * of {@param context} being those of the decoded stream. Compressed streams
+ * cannot be updated in place, so only one of READ or WRITE may be requested.
+ * When writing with a {@param threadCount} other than one, the stream is split
+ * into blocks that are compressed as independent frames on a worker pool, and
+ * written out in order; sync() then waits for every block written so far.
+ * @param context A pointer to an opened context.
+ * @param codec The codec to stack on top of the resource.
+ * @param mode The mode the resource was opened with.
+ * @param threadCount The number of encoding threads, zero for all hardware threads.
+ * @param errorCode A reference to an integer in which to store error codes.
+ * @return True is returned on success, false on error and {@param errorCode} is set.
+ */
+bool _push_codec_layer(
+	struct FileContext* context,
+	const struct CodecAPI* codec,
+	File::IOFlag mode,
+	unsigned int threadCount,
+	int& errorCode );
@@ -3,17 +3,139 @@
  * Permission to use, copy, modify, and/or distribute this software, in whole
  * or part by any means, without express prior written agreement is prohibited.
  */
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
 #include <cerrno>
 #include <cmath>
 #include <cstdint>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <memory>
 #include <mutex>
+#include <new>
+#include <span>
 #include <string>
 #include <sys/time.h>
+#include <thread>
 #include <utility>
+#include <vector>
 
 #include "File.hpp"
+#include "FileChunks.hpp"
 #include "FileContext.hpp"
+#include "FileDirectory.hpp"
+#include "FileFollower.hpp"
+#include "FileRecords.hpp"
+#include "FileView.hpp"
+#include "IOScheduler.hpp"
+#include "Scan.hpp"
 #include "Util.hpp"
+#include "WorkerPool.hpp"
+#include "scheme/scheme_file.hpp"
+
+// chunks() scans for the delimiter ending each chunk this many bytes at a time.
+#define CHUNK_SCAN_SIZE ( 4096 )
+
+// openMany() hands the opens to its workers in batches of this many files.
+#define OPEN_MANY_BATCH_SIZE ( 64 )
+
+// prefetch() opens files on a pool of this many threads, started on first use.
+#define FILE_PREFETCH_THREAD_COUNT ( 4 )
+
+// splice() copies between schemes through a buffer of this many bytes.
+#define FILE_SPLICE_BUFFER_SIZE ( 64 * 1024 )
+
+// view() copies bytes that can't be lent in place into pooled buffers, by power of
+// two size up to the largest pooled, keeping this many idle buffers of each size.
+#define VIEW_POOL_MAX_BUFFER_SIZE  ( 1024 * 1024 )
+#define VIEW_POOL_MAX_IDLE_BUFFERS ( 16 )
+
+static std::array< std::vector< uint8_t* >, std::countr_zero< size_t >( VIEW_POOL_MAX_BUFFER_SIZE ) + 1 > _G_ViewBufferPool;
+static std::mutex _G_ViewBufferPoolMutex;
+
+// The chunks not yet claimed by a processChunks() worker.
+struct ChunkQueue
+{
+	std::mutex mMutex;
+	std::deque< size_t > mChunks;
+};
+
+static void __release_view_buffer(
+	uint8_t* buffer,
+	size_t bufferSize )
+{
+	if ( VIEW_POOL_MAX_BUFFER_SIZE >= bufferSize )
+	{
+		std::lock_guard poolLock( _G_ViewBufferPoolMutex );
+		auto& idleBuffers = _G_ViewBufferPool[ std::countr_zero( bufferSize ) ];
+
+		if ( VIEW_POOL_MAX_IDLE_BUFFERS > idleBuffers.size() )
+		{
+			idleBuffers.push_back( buffer );
+			return;
+		}
+	}
+
+	delete[] buffer;
+}
+
+/*
+ * Take a buffer of at least the requested size from the pool, or allocate one,
+ * which is returned to the pool once the last view of it is released.
+ */
+static std::shared_ptr< uint8_t > __acquire_view_buffer(
+	size_t size )
+{
+	size_t bufferSize = std::bit_ceil( std::max< size_t >( size, 1 ) );
+	uint8_t* buffer = nullptr;
+
+	if ( VIEW_POOL_MAX_BUFFER_SIZE >= bufferSize )
+	{
+		std::lock_guard poolLock( _G_ViewBufferPoolMutex );
+		auto& idleBuffers = _G_ViewBufferPool[ std::countr_zero( bufferSize ) ];
+
+		if ( not idleBuffers.empty() )
+		{
+			buffer = idleBuffers.back();
+			idleBuffers.pop_back();
+		}
+	}
+
+	if ( nullptr == buffer )
+	{
+		buffer = new ( std::nothrow ) uint8_t[ bufferSize ];
+
+		if ( nullptr == buffer )
+		{
+			return nullptr;
+		}
+	}
+
+	return std::shared_ptr< uint8_t >( buffer,
+		[ bufferSize ]( uint8_t* buffer )
+		{
+			__release_view_buffer( buffer, bufferSize );
+		} );
+}
+
+/*
+ * Open the URI into the context, or only record it should the mode include IOFlag::LAZY.
+ */
+static bool __open_or_defer_uri(
+	struct FileContext* context,
+	const std::string& uri,
+	File::IOFlag mode,
+	int& errorCode )
+{
+	File::IOFlag openMode = static_cast< File::IOFlag >( mode & ~File::IOFlag::LAZY );
+
+	return ( File::IOFlag::LAZY & mode )
+		? _defer_open_uri( context, uri, openMode, errorCode )
+		: _open_uri( context, uri, openMode, errorCode );
+}
 
 static uint64_t __open_file(
 	const std::string& filepath,
@@ -30,64 +152,116 @@ static uint64_t __open_file(
 
 	struct FileContext* context = _allocate_context();
 
-	if ( not _open_uri( context, normalizedFilepath, mode, errorCode ) )
+	if ( nullptr == context )
 	{
-		_free_context( context );
+		errorCode = ENOMEM;
 		return 0;
 	}
 
-	uint64_t identifier = _assign_identifier( context );
-
-	if ( 0 != identifier )
+	if ( not __open_or_defer_uri( context, normalizedFilepath, mode, errorCode ) )
 	{
-		return identifier;
+		_free_context( context );
+		return 0;
 	}
 
-	_free_context( context );
-}
-
-static void __close_file(
-	uint64_t fileIdentifier )
-{
-	if ( 0 != fileIdentifier )
-	{
-	}
+	errorCode = 0;
+	return _register_context( context );
 }
 
 File::File() noexcept :
-	mFileIdentifier( 0 )
+	mFileIdentifier( 0 ),
+	mErrorCode( 0 ),
+	mPinnedContext( nullptr )
 {
 }
 
 File::File(
-	File&& other )
+	File&& other ) noexcept :
+	mPinnedContext( nullptr )
 {
 	mFileIdentifier.store( other.mFileIdentifier.exchange( 0 ) );
 	mErrorCode = std::exchange( other.mErrorCode, 0 );
+	other.mPinnedContext = nullptr;
 }
 
 File::File(
-	const File& other )
+	const File& other ) :
+	mPinnedContext( nullptr )
 {
-	mFileIdentifier.store( other.mFileIdentifier.load() );
+	// Retaining the context advances the epoch, so that a pinned original no
+	// longer takes itself to be the only reference.
+	if ( _retain_context( other.mFileIdentifier.load() ) )
+	{
+		mFileIdentifier.store( other.mFileIdentifier.load() );
+	}
+	else
+	{
+		mFileIdentifier.store( 0 );
+	}
+
 	mErrorCode = other.mErrorCode;
 }
 
 File::File(
 	const std::string& filepath,
-	File::IOFlag mode )
+	File::IOFlag mode ) :
+	mErrorCode( 0 ),
+	mPinnedContext( nullptr )
 {
-	uint64_t fileIdentifier = __open_file( filepath, mode, mErrorCode );
+	mFileIdentifier.store( __open_file( filepath, mode, mErrorCode ) );
+}
+
+File::~File()
+{
+	close();
+}
+
+struct FileContext* File::getContext(
+	std::unique_lock< std::mutex >& contextLock )
+{
+	if ( nullptr == mPinnedContext )
+	{
+		return _get_open_context( mFileIdentifier, contextLock, mErrorCode );
+	}
 
-	if ( 0 == fileIdentifier )
+	// The cache holds until a reference to any context is taken or released.
+	if ( _get_context_epoch() != mPinnedEpoch )
 	{
+		mPinnedContext = _pin_context( mFileIdentifier, mPinnedEpoch, mPinnedExclusive );
+
+		if ( nullptr == mPinnedContext )
+		{
+			mErrorCode = EBADF;
+			return nullptr;
+		}
+	}
+
+	// Only this File can reach a context it alone references, and only from the
+	// thread it's pinned to, so there's nothing to exclude.
+	if ( not mPinnedExclusive )
+	{
+		contextLock = std::unique_lock< std::mutex >( mPinnedContext->_M_Mutex );
 	}
+
+	// Any deferred open was completed by pin().
+	return mPinnedContext;
+}
+
+int64_t File::append(
+	const uint8_t* buffer,
+	size_t count )
+{
+	int64_t offset;
+	return append( buffer, count, offset );
 }
 
 int64_t File::append(
 	const uint8_t* buffer,
-	uint32_t count )
+	size_t count,
+	int64_t& offset )
 {
+	offset = -1;
+
 	if ( 0 == mFileIdentifier.load() )
 	{
 		mErrorCode = EBADF;
@@ -107,11 +281,10 @@ int64_t File::append(
 	}
 
 	std::unique_lock< std::mutex > contextLock;
-	auto context = _get_context( mFileIdentifier, contextLock );
+	auto context = getContext( contextLock );
 
 	if ( nullptr == context )
 	{
-		mErrorCode = EBADF;
 		return -1;
 	}
 
@@ -120,13 +293,59 @@ int64_t File::append(
 		bool ignoreIOStats = false;
 		struct timeval startTime, endTime;
 		int64_t bytesWritten;
+		File::IOPriority priority = _begin_io( context, contextLock, FILE_IO_STATS_WRITE, count );
 
 		if ( 0 != gettimeofday( &startTime, nullptr ) )
 		{
 			ignoreIOStats = true;
 		}
 
-		bytesWritten = context->_F_write( context, buffer, count, true );
+		offset = context->_M_FileSize;
+
+		if ( nullptr != context->_F_group_append )
+		{
+			// Reserve the range under the lock, then write it without, so that
+			// the scheme can commit concurrent appends together.
+			auto groupAppendFunction = context->_F_group_append;
+			bool locked = contextLock.owns_lock();
+			context->_M_FileSize += count;
+
+			if ( locked )
+			{
+				contextLock.unlock();
+			}
+
+			bytesWritten = groupAppendFunction( context, buffer, count, offset );
+
+			if ( locked )
+			{
+				contextLock.lock();
+			}
+
+			if ( static_cast< int64_t >( count ) != bytesWritten )
+			{
+				int64_t writtenEnd = offset + std::max< int64_t >( bytesWritten, 0 );
+
+				// Hand back the unwritten part of the range, unless later appends have
+				// been reserved past it. Then it's a hole beneath them, and so the file
+				// takes no more writes, rather than carry on with a hole in the middle.
+				if ( static_cast< int64_t >( offset + count ) == context->_M_FileSize )
+				{
+					context->_M_FileSize = writtenEnd;
+				}
+				else
+				{
+					context->_M_Capabilities = static_cast< File::IOFlag >( context->_M_Capabilities & ~File::IOFlag::WRITE );
+					context->_M_ErrorCode = EIO;
+				}
+			}
+		}
+		else
+		{
+			bytesWritten = context->_F_write( context, buffer, count, true );
+		}
+
+		_end_io( priority );
 
 		if ( ( not ignoreIOStats ) and ( 0 != gettimeofday( &endTime, nullptr ) ) )
 		{
@@ -145,6 +364,31 @@ int64_t File::append(
 	return -1;
 }
 
+bool File::beginBatch()
+{
+	if ( 0 == mFileIdentifier.load() )
+	{
+		mErrorCode = EBADF;
+		return false;
+	}
+
+	std::unique_lock< std::mutex > contextLock;
+	auto context = _get_open_context( mFileIdentifier, contextLock, mErrorCode );
+
+	if ( nullptr == context )
+	{
+		return false;
+	}
+
+	if ( nullptr == context->_F_begin_batch )
+	{
+		mErrorCode = ENOTSUP;
+		return false;
+	}
+
+	return context->_F_begin_batch( context );
+}
+
 double File::byteRate(
 	File::IOFlag ioFlag ) const
 {
@@ -181,21 +425,440 @@ double File::byteRate(
 		}
 
 		return static_cast< double >( context->_M_NumberObservations[ FILE_IO_STATS_WRITE ] )
-			/ context->_M_SumInverseRates( FILE_IO_STATS_WRITE ]
+			/ context->_M_SumInverseRates[ FILE_IO_STATS_WRITE ];
 	}
 
 	return std::nan( "0" );
 }
 
+std::vector< FileChunk > File::chunks(
+	size_t count,
+	uint8_t delimiter )
+{
+	std::vector< FileChunk > fileChunks;
+
+	if ( 0 == count )
+	{
+		mErrorCode = EINVAL;
+		return fileChunks;
+	}
+
+	int64_t fileSize = size();
+
+	if ( 0 > fileSize )
+	{
+		return fileChunks;
+	}
+
+	count = std::min< int64_t >( count, fileSize );
+
+	// Each nominal boundary moves forward to just past the first delimiter at or after it,
+	// where the delimiter ending the record straddling the boundary is found by scanning.
+	uint8_t scanBuffer[ CHUNK_SCAN_SIZE ];
+	int64_t chunkBegin = 0;
+
+	for ( size_t chunkIndex = 1; chunkIndex < count; ++chunkIndex )
+	{
+		int64_t nominalBoundary = ( fileSize / count ) * chunkIndex + ( fileSize % count ) * chunkIndex / count;
+		int64_t scanPosition = nominalBoundary - 1;
+		int64_t boundary = -1;
+
+		if ( nominalBoundary <= chunkBegin )
+		{
+			continue;
+		}
+
+		while ( ( -1 == boundary ) and ( scanPosition < fileSize ) )
+		{
+			int64_t bytesRead = pread( scanBuffer, CHUNK_SCAN_SIZE, scanPosition );
+
+			if ( 0 > bytesRead )
+			{
+				return std::vector< FileChunk >();
+			}
+
+			if ( 0 == bytesRead )
+			{
+				break;
+			}
+
+			const uint8_t* delimiterPosition = _find_byte( scanBuffer, scanBuffer + bytesRead, delimiter );
+
+			if ( delimiterPosition != scanBuffer + bytesRead )
+			{
+				boundary = scanPosition + ( delimiterPosition - scanBuffer ) + 1;
+			}
+
+			scanPosition += bytesRead;
+		}
+
+		if ( ( -1 == boundary ) or ( fileSize <= boundary ) )
+		{
+			break;
+		}
+
+		fileChunks.push_back( { chunkBegin, boundary } );
+		chunkBegin = boundary;
+	}
+
+	if ( chunkBegin < fileSize )
+	{
+		fileChunks.push_back( { chunkBegin, fileSize } );
+	}
+
+	mErrorCode = 0;
+	return fileChunks;
+}
+
 void File::close()
 {
-	
+	unpin();
+
+	// The last File referencing the context closes the resource.
+	uint64_t fileIdentifier = mFileIdentifier.exchange( 0 );
+
+	if ( 0 != fileIdentifier )
+	{
+		_release_context( fileIdentifier );
+	}
+}
+
+bool File::commit()
+{
+	if ( 0 == mFileIdentifier.load() )
+	{
+		mErrorCode = EBADF;
+		return false;
+	}
+
+	std::unique_lock< std::mutex > contextLock;
+	auto context = _get_open_context( mFileIdentifier, contextLock, mErrorCode );
+
+	if ( nullptr == context )
+	{
+		return false;
+	}
+
+	if ( nullptr != context->_F_commit )
+	{
+		return context->_F_commit( context );
+	}
+
+	if ( nullptr != context->_F_publish )
+	{
+		return context->_F_publish( context, true );
+	}
+
+	mErrorCode = ENOTSUP;
+	return false;
+}
+
+bool File::commitMany(
+	std::span< File > files )
+{
+	std::vector< char > published( files.size(), false );
+	bool committed = true;
+
+	// The replacements are flushed and renamed without syncing their directories...
+	std::atomic_size_t nextFile( 0 );
+	auto publishFiles = [ & ]()
+	{
+		size_t fileIndex;
+
+		while ( ( fileIndex = nextFile.fetch_add( 1 ) ) < files.size() )
+		{
+			File& file = files[ fileIndex ];
+			std::unique_lock< std::mutex > contextLock;
+			auto context = _get_open_context( file.mFileIdentifier, contextLock, file.mErrorCode );
+
+			if ( nullptr == context )
+			{
+				continue;
+			}
+
+			if ( nullptr == context->_F_publish )
+			{
+				file.mErrorCode = ENOTSUP;
+			}
+			else
+			{
+				published[ fileIndex ] = context->_F_publish( context, false );
+			}
+		}
+	};
+
+	unsigned int workerCount = std::min< size_t >( std::max( 1U, std::thread::hardware_concurrency() ), files.size() );
+	_run_parallel( _shared_worker_pool(), workerCount, [ &publishFiles ]( unsigned int ) { publishFiles(); } );
+
+	// ...and then published again, which syncs each directory the first time it comes up.
+	for ( size_t fileIndex = 0; fileIndex < files.size(); ++fileIndex )
+	{
+		if ( not published[ fileIndex ] )
+		{
+			committed = false;
+			continue;
+		}
+
+		std::unique_lock< std::mutex > contextLock;
+		auto context = _get_context( files[ fileIndex ].mFileIdentifier, contextLock );
+
+		if ( ( nullptr == context ) or not context->_F_publish( context, true ) )
+		{
+			committed = false;
+		}
+	}
+
+	return committed;
+}
+
+std::vector< FileChunk > File::dataRegions()
+{
+	std::vector< FileChunk > regions;
+
+	if ( 0 == mFileIdentifier.load() )
+	{
+		mErrorCode = EBADF;
+		return regions;
+	}
+
+	std::unique_lock< std::mutex > contextLock;
+	auto context = _get_open_context( mFileIdentifier, contextLock, mErrorCode );
+
+	if ( nullptr == context )
+	{
+		return regions;
+	}
+
+	if ( nullptr != context->_F_data_regions )
+	{
+		if ( not context->_F_data_regions( context, regions ) )
+		{
+			regions.clear();
+		}
+
+		return regions;
+	}
+
+	// Without a notion of holes, the whole file is data.
+	if ( 0 > context->_M_FileSize )
+	{
+		mErrorCode = ENOTSUP;
+		return regions;
+	}
+
+	if ( 0 < context->_M_FileSize )
+	{
+		regions.push_back( { 0, context->_M_FileSize } );
+	}
+
+	return regions;
+}
+
+std::string File::digest()
+{
+	if ( 0 == mFileIdentifier.load() )
+	{
+		mErrorCode = EBADF;
+		return std::string();
+	}
+
+	std::unique_lock< std::mutex > contextLock;
+	auto context = _get_open_context( mFileIdentifier, contextLock, mErrorCode );
+
+	if ( nullptr == context )
+	{
+		return std::string();
+	}
+
+	if ( nullptr == context->_F_digest )
+	{
+		mErrorCode = ENOTSUP;
+		return std::string();
+	}
+
+	return context->_F_digest( context );
+}
+
+File File::dup()
+{
+	File dupFile;
+
+	if ( 0 == mFileIdentifier.load() )
+	{
+		mErrorCode = EBADF;
+		return dupFile;
+	}
+
+	std::unique_lock< std::mutex > contextLock;
+	auto context = _get_open_context( mFileIdentifier, contextLock, mErrorCode );
+
+	if ( nullptr == context )
+	{
+		return dupFile;
+	}
+
+	if ( nullptr == context->_F_dup )
+	{
+		mErrorCode = ENOTSUP;
+		return dupFile;
+	}
+
+	struct FileContext* dupContext = _allocate_context();
+
+	if ( nullptr == dupContext )
+	{
+		mErrorCode = ENOMEM;
+		return dupFile;
+	}
+
+	if ( not context->_F_dup( context, dupContext, mErrorCode ) )
+	{
+		_free_context( dupContext );
+		return dupFile;
+	}
+
+	// Reads of the handle are scheduled as those of the file would be.
+	dupContext->_M_IOPriority = context->_M_IOPriority;
+	dupContext->_M_IOTag = context->_M_IOTag;
+	contextLock.unlock();
+	dupFile.mFileIdentifier.store( _register_context( dupContext ) );
+	return dupFile;
 }
 
 std::string File::errorMessage(
 	bool clearAfterRead )
 {
-	
+	std::string message;
+
+	if ( 0 != mErrorCode )
+	{
+		message = strerror( mErrorCode );
+	}
+	else if ( 0 != mFileIdentifier.load() )
+	{
+		// Failing that, the error of the context, and then of its scheme.
+		std::unique_lock< std::mutex > contextLock;
+		auto context = _get_context( mFileIdentifier, contextLock );
+
+		if ( nullptr != context )
+		{
+			if ( 0 != context->_M_ErrorCode )
+			{
+				message = strerror( context->_M_ErrorCode );
+			}
+			else if ( nullptr != context->_F_error_string )
+			{
+				message = context->_F_error_string( context );
+			}
+
+			if ( clearAfterRead )
+			{
+				context->_M_ErrorCode = 0;
+			}
+		}
+	}
+
+	if ( clearAfterRead )
+	{
+		mErrorCode = 0;
+	}
+
+	return message;
+}
+
+File::HandleStats File::handleStats()
+{
+	return __scheme_file_handle_stats();
+}
+
+FileRecords File::lines()
+{
+	return FileRecords( *this, '\n', true );
+}
+
+FileDirectory File::list(
+	const std::string& uri,
+	const std::string& pattern,
+	bool metadata )
+{
+	return FileDirectory( uri, pattern, metadata );
+}
+
+bool File::open(
+	const std::string& filepath,
+	File::IOFlag mode )
+{
+	close();
+	mFileIdentifier.store( __open_file( filepath, mode, mErrorCode ) );
+	return 0 != mFileIdentifier.load();
+}
+
+std::vector< File > File::openMany(
+	std::span< const std::string > filepaths,
+	File::IOFlag mode )
+{
+	std::vector< File > files( filepaths.size() );
+	std::vector< std::string > normalizedFilepaths( filepaths.size() );
+	std::vector< struct FileContext* > contexts( filepaths.size(), nullptr );
+	std::vector< int > errorCodes( filepaths.size(), 0 );
+	std::vector< uint64_t > identifiers;
+
+	for ( size_t fileIndex = 0; fileIndex < filepaths.size(); ++fileIndex )
+	{
+		if ( not _normalize_filepath( normalizedFilepaths[ fileIndex ], filepaths[ fileIndex ] ) )
+		{
+			errorCodes[ fileIndex ] = EINVAL;
+		}
+	}
+
+	// Workers claim batches of files from a shared cursor until none remain.
+	std::atomic_size_t nextBatch( 0 );
+	auto openBatches = [ & ]()
+	{
+		size_t batchStart;
+
+		while ( ( batchStart = nextBatch.fetch_add( OPEN_MANY_BATCH_SIZE ) ) < filepaths.size() )
+		{
+			size_t batchEnd = std::min< size_t >( batchStart + OPEN_MANY_BATCH_SIZE, filepaths.size() );
+
+			for ( size_t fileIndex = batchStart; fileIndex < batchEnd; ++fileIndex )
+			{
+				if ( 0 != errorCodes[ fileIndex ] )
+				{
+					continue;
+				}
+
+				struct FileContext* context = _allocate_context();
+
+				if ( nullptr == context )
+				{
+					errorCodes[ fileIndex ] = ENOMEM;
+				}
+				else if ( not __open_or_defer_uri( context, normalizedFilepaths[ fileIndex ], mode, errorCodes[ fileIndex ] ) )
+				{
+					_free_context( context );
+				}
+				else
+				{
+					contexts[ fileIndex ] = context;
+				}
+			}
+		}
+	};
+
+	unsigned int workerCount = std::min< size_t >( std::max( 1U, std::thread::hardware_concurrency() ),
+		( filepaths.size() + OPEN_MANY_BATCH_SIZE - 1 ) / OPEN_MANY_BATCH_SIZE );
+	_run_parallel( _shared_worker_pool(), workerCount, [ &openBatches ]( unsigned int ) { openBatches(); } );
+
+	_register_contexts( contexts, identifiers );
+
+	for ( size_t fileIndex = 0; fileIndex < filepaths.size(); ++fileIndex )
+	{
+		files[ fileIndex ].mFileIdentifier.store( identifiers[ fileIndex ] );
+		files[ fileIndex ].mErrorCode = errorCodes[ fileIndex ];
+	}
+
+	return files;
 }
 
 File& File::operator=(
@@ -203,8 +866,15 @@ File& File::operator=(
 {
 	if ( this != &other )
 	{
-		mFileIdentifier.store( other.mFileIdentifier.exchange( 0 ) );
+		uint64_t replacedIdentifier = mFileIdentifier.exchange( other.mFileIdentifier.exchange( 0 ) );
 		mErrorCode = std::exchange( other.mErrorCode, 0 );
+		mPinnedContext = nullptr;
+		other.mPinnedContext = nullptr;
+
+		if ( 0 != replacedIdentifier )
+		{
+			_release_context( replacedIdentifier );
+		}
 	}
 
 	return *this;
@@ -215,8 +885,17 @@ File& File::operator=(
 {
 	if ( this != &other )
 	{
-		mFileIdentifier.store( other.mFileIdentifier.load() );
+		// The reference to the other context is taken before the replaced one is
+		// released, in case this File held the last reference to the same context.
+		uint64_t replacedIdentifier = mFileIdentifier.exchange(
+			_retain_context( other.mFileIdentifier.load() ) ? other.mFileIdentifier.load() : 0 );
 		mErrorCode = other.mErrorCode;
+		mPinnedContext = nullptr;
+
+		if ( 0 != replacedIdentifier )
+		{
+			_release_context( replacedIdentifier );
+		}
 	}
 
 	return *this;
@@ -224,7 +903,7 @@ File& File::operator=(
 
 int64_t File::peek(
 	uint8_t* buffer,
-	uint32_t count )
+	size_t count )
 {
 	if ( 0 == mFileIdentifier.load() )
 	{
@@ -244,6 +923,84 @@ int64_t File::peek(
 		return 0;
 	}
 
+	std::unique_lock< std::mutex > contextLock;
+	auto context = getContext( contextLock );
+
+	if ( nullptr == context )
+	{
+		return -1;
+	}
+
+	if ( FILE_CAN_READ( context ) )
+	{
+		bool ignoreIOStats = false;
+		struct timeval startTime, endTime;
+		int64_t bytesRead;
+		File::IOPriority priority = _begin_io( context, contextLock, FILE_IO_STATS_READ, count );
+
+		if ( 0 != gettimeofday( &startTime, nullptr ) )
+		{
+			ignoreIOStats = true;
+		}
+
+		bytesRead = context->_F_read( context, buffer, count, false );
+		_end_io( priority );
+
+		if ( ( not ignoreIOStats ) and ( 0 != gettimeofday( &endTime, nullptr ) ) )
+		{
+			ignoreIOStats = true;
+		}
+
+		if ( not ignoreIOStats )
+		{
+			_update_io_stats( context, FILE_IO_STATS_READ, startTime, endTime, bytesRead );
+		}
+
+		return bytesRead;
+	}
+
+	mErrorCode = ENOTSUP;
+	return -1;
+}
+
+bool File::pin()
+{
+	if ( 0 == mFileIdentifier.load() )
+	{
+		mErrorCode = EBADF;
+		return false;
+	}
+
+	// Complete a deferred open now, under the context lock, since a prefetch() worker
+	// may be opening it too and the pinned context may later be used without the lock.
+	{
+		std::unique_lock< std::mutex > contextLock;
+
+		if ( nullptr == _get_open_context( mFileIdentifier, contextLock, mErrorCode ) )
+		{
+			return false;
+		}
+	}
+
+	mPinnedContext = _pin_context( mFileIdentifier, mPinnedEpoch, mPinnedExclusive );
+
+	if ( nullptr == mPinnedContext )
+	{
+		mErrorCode = EBADF;
+		return false;
+	}
+
+	return true;
+}
+
+int64_t File::position() const
+{
+	if ( 0 == mFileIdentifier )
+	{
+		mErrorCode = EBADF;
+		return -1;
+	}
+
 	std::unique_lock< std::mutex > contextLock;
 	auto context = _get_context( mFileIdentifier, contextLock );
 
@@ -253,59 +1010,271 @@ int64_t File::peek(
 		return -1;
 	}
 
+	return context->_M_FilePosition;
+}
+
+int64_t File::pread(
+	uint8_t* buffer,
+	size_t count,
+	int64_t offset )
+{
+	if ( 0 == mFileIdentifier )
+	{
+		mErrorCode = EBADF;
+		return -1;
+	}
+
+	if ( ( nullptr == buffer ) or ( 0 > offset ) )
+	{
+		mErrorCode = ( ( 0 != count ) or ( 0 > offset ) ) ? EINVAL : 0;
+		return -( ( 0 != count ) or ( 0 > offset ) );
+	}
+
+	if ( 0 == count )
+	{
+		mErrorCode = 0;
+		return 0;
+	}
+
+	std::unique_lock< std::mutex > contextLock;
+	auto context = getContext( contextLock );
+
+	if ( nullptr == context )
+	{
+		return -1;
+	}
+
 	if ( FILE_CAN_READ( context ) )
 	{
 		bool ignoreIOStats = false;
 		struct timeval startTime, endTime;
 		int64_t bytesRead;
+		File::IOPriority priority = _begin_io( context, contextLock, FILE_IO_STATS_READ, count );
 
 		if ( 0 != gettimeofday( &startTime, nullptr ) )
 		{
 			ignoreIOStats = true;
 		}
 
-		bytesRead = context->_F_read( context, buffer, count, false );
+		if ( nullptr != context->_F_pread )
+		{
+			// Positional reads leave the context untouched, so they run without the lock,
+			// and concurrent callers only serialize on recording the I/O stats.
+			auto preadFunction = context->_F_pread;
+			bool locked = contextLock.owns_lock();
+
+			if ( locked )
+			{
+				contextLock.unlock();
+			}
+
+			bytesRead = preadFunction( context, buffer, count, offset );
+
+			if ( locked )
+			{
+				contextLock.lock();
+			}
+		}
+		else
+		{
+			int64_t position = context->_M_FilePosition;
+
+			if ( -1 == context->_F_seek( context, offset, false ) )
+			{
+				_end_io( priority );
+				return -1;
+			}
+
+			bytesRead = context->_F_read( context, buffer, count, false );
+			context->_F_seek( context, position, false );
+		}
+
+		_end_io( priority );
+
+		if ( ( not ignoreIOStats ) and ( 0 != gettimeofday( &endTime, nullptr ) ) )
+		{
+			ignoreIOStats = true;
+		}
+
+		if ( not ignoreIOStats )
+		{
+			_update_io_stats( context, FILE_IO_STATS_READ, startTime, endTime, bytesRead );
+		}
+
+		return bytesRead;
+	}
+
+	mErrorCode = ENOTSUP;
+	return -1;
+}
+
+void File::prefetch(
+	std::span< const File > files )
+{
+	static struct WorkerPool* pool = _create_worker_pool( FILE_PREFETCH_THREAD_COUNT );
+
+	if ( nullptr == pool )
+	{
+		return;
+	}
+
+	// Files are looked up by identifier when their turn comes, so that one closed
+	// in the meantime is skipped.
+	for ( const File& file : files )
+	{
+		uint64_t fileIdentifier = file.mFileIdentifier.load();
+
+		if ( 0 != fileIdentifier )
+		{
+			_submit_work( pool,
+				[ fileIdentifier ]()
+				{
+					std::unique_lock< std::mutex > contextLock;
+					int errorCode;
+					_get_open_context( fileIdentifier, contextLock, errorCode );
+				} );
+		}
+	}
+}
+
+bool File::processChunks(
+	unsigned int threadCount,
+	size_t chunkCount,
+	uint8_t delimiter,
+	const std::function< void( FileChunkReader& ) >& work )
+{
+	std::vector< FileChunk > fileChunks = chunks( chunkCount, delimiter );
+
+	if ( fileChunks.empty() )
+	{
+		return 0 == mErrorCode;
+	}
+
+	if ( 0 == threadCount )
+	{
+		threadCount = std::max( 1U, std::thread::hardware_concurrency() );
+	}
+
+	unsigned int workerCount = std::min< size_t >( threadCount, fileChunks.size() );
+	std::vector< struct ChunkQueue > chunkQueues( workerCount );
+	std::vector< File > workerFiles( workerCount );
+
+	// Each worker reads through a handle of its own, so that the workers share neither
+	// this File's error code nor, where the scheme can dup() the file, a context and its
+	// lock. Otherwise they read through copies of this File, which share its context.
+	for ( File& workerFile : workerFiles )
+	{
+		workerFile = dup();
+
+		if ( 0 == workerFile.mFileIdentifier.load() )
+		{
+			workerFile = *this;
+		}
+	}
+
+	// Each worker starts with a contiguous share of the chunks, so its reads stay sequential.
+	for ( size_t chunkIndex = 0; chunkIndex < fileChunks.size(); ++chunkIndex )
+	{
+		chunkQueues[ chunkIndex * workerCount / fileChunks.size() ].mChunks.push_back( chunkIndex );
+	}
+
+	// Owners take chunks from the front of their queue, and thieves from the back of
+	// another's, so a stolen chunk is the one its owner would have reached last.
+	// No chunks are added once the workers start, so a worker finding every queue
+	// empty is done.
+	auto processQueue = [ & ]( unsigned int workerIndex )
+	{
+		// Pinned, a dup()'d handle is read without looking it up or locking it.
+		File& workerFile = workerFiles[ workerIndex ];
+		workerFile.pin();
 
-		if ( ( not ignoreIOStats ) and ( 0 != gettimeofday( &endTime, nullptr ) ) )
+		while ( true )
 		{
-			ignoreIOStats = true;
-		}
+			size_t chunkIndex = fileChunks.size();
 
-		if ( not ignoreIOStats )
-		{
-			_update_io_stats( context, FILE_IO_STATS_READ, startTime, endTime, bytesRead );
+			for ( unsigned int queueOffset = 0; queueOffset < workerCount; ++queueOffset )
+			{
+				struct ChunkQueue& chunkQueue = chunkQueues[ ( workerIndex + queueOffset ) % workerCount ];
+				std::lock_guard< std::mutex > queueLock( chunkQueue.mMutex );
+
+				if ( chunkQueue.mChunks.empty() )
+				{
+					continue;
+				}
+
+				if ( 0 == queueOffset )
+				{
+					chunkIndex = chunkQueue.mChunks.front();
+					chunkQueue.mChunks.pop_front();
+				}
+				else
+				{
+					chunkIndex = chunkQueue.mChunks.back();
+					chunkQueue.mChunks.pop_back();
+				}
+
+				break;
+			}
+
+			if ( fileChunks.size() == chunkIndex )
+			{
+				workerFile.unpin();
+				return;
+			}
+
+			FileChunkReader reader( workerFile, fileChunks[ chunkIndex ] );
+			work( reader );
 		}
+	};
 
-		return bytesRead;
-	}
+	_run_parallel( _shared_worker_pool(), workerCount, processQueue );
 
-	mErrorCode = ENOTSUP;
-	return -1;
+	mErrorCode = 0;
+	return true;
 }
 
-int64_t File::position() const
+bool File::punchHole(
+	int64_t offset,
+	int64_t length )
 {
-	if ( 0 == mFileIdentifier )
+	if ( 0 == mFileIdentifier.load() )
 	{
 		mErrorCode = EBADF;
-		return -1;
+		return false;
+	}
+
+	if ( ( 0 > offset ) or ( 0 > length ) )
+	{
+		mErrorCode = EINVAL;
+		return false;
+	}
+
+	if ( 0 == length )
+	{
+		mErrorCode = 0;
+		return true;
 	}
 
 	std::unique_lock< std::mutex > contextLock;
-	auto context = _get_context( mFileIdentifier, contextLock );
+	auto context = _get_open_context( mFileIdentifier, contextLock, mErrorCode );
 
 	if ( nullptr == context )
 	{
-		mErrorCode = EBADF;
-		return -1;
+		return false;
 	}
 
-	return context->_M_FilePosition;
+	if ( FILE_CAN_WRITE( context ) and ( nullptr != context->_F_punch_hole ) )
+	{
+		return context->_F_punch_hole( context, offset, length );
+	}
+
+	mErrorCode = ENOTSUP;
+	return false;
 }
 
 int64_t File::read(
 	uint8_t* buffer,
-	uint32_t count )
+	size_t count )
 {
 	if ( 0 == mFileIdentifier )
 	{
@@ -326,11 +1295,10 @@ int64_t File::read(
 	}
 
 	std::unique_lock< std::mutex > contextLock;
-	auto context = _get_context( mFileIdentifier, contextLock );
+	auto context = getContext( contextLock );
 
 	if ( nullptr == context )
 	{
-		mErrorCode = EBADF;
 		return -1;
 	}
 
@@ -339,6 +1307,7 @@ int64_t File::read(
 		bool ignoreIOStats = false;
 		struct timeval startTime, endTime;
 		int64_t bytesRead;
+		File::IOPriority priority = _begin_io( context, contextLock, FILE_IO_STATS_READ, count );
 
 		if ( 0 != gettimeofday( &startTime, nullptr ) )
 		{
@@ -346,6 +1315,7 @@ int64_t File::read(
 		}
 
 		bytesRead = context->_F_read( context, buffer, count, true );
+		_end_io( priority );
 
 		if ( ( not ignoreIOStats ) and ( 0 != gettimeofday( &endTime, nullptr ) ) )
 		{
@@ -364,6 +1334,12 @@ int64_t File::read(
 	return -1;
 }
 
+FileRecords File::records(
+	uint8_t delimiter )
+{
+	return FileRecords( *this, delimiter );
+}
+
 bool File::reserve(
 	int64_t size,
 	uint8_t fill )
@@ -375,11 +1351,10 @@ bool File::reserve(
 	}
 
 	std::unique_lock< std::mutex > contextLock;
-	auto context = _get_context( mFileIdentifier, contextLock );
+	auto context = _get_open_context( mFileIdentifier, contextLock, mErrorCode );
 
 	if ( nullptr == context )
 	{
-		mErrorCode = EBADF;
 		return false;
 	}
 
@@ -435,11 +1410,10 @@ bool File::resize(
 	}
 
 	std::unique_lock< std::mutex > contextLock;
-	auto context = _get_context( mFileIdentifier, contextLock );
+	auto context = _get_open_context( mFileIdentifier, contextLock, mErrorCode );
 
 	if ( nullptr == context )
 	{
-		mErrorCode = EBADF;
 		return false;
 	}
 
@@ -482,20 +1456,238 @@ bool File::resize(
 	return false;
 }
 
-int64_t File::size() const
+int64_t File::seek(
+	int64_t offset,
+	bool relative )
+{
+	if ( 0 == mFileIdentifier.load() )
+	{
+		mErrorCode = EBADF;
+		return -1;
+	}
+
+	std::unique_lock< std::mutex > contextLock;
+	auto context = getContext( contextLock );
+
+	if ( nullptr == context )
+	{
+		return -1;
+	}
+
+	if ( FILE_CAN_SEEK( context ) )
+	{
+		mErrorCode = 0;
+		return context->_F_seek( context, offset, relative );
+	}
+
+	mErrorCode = ENOTSUP;
+	return -1;
+}
+
+void File::setBandwidthLimit(
+	const std::string& tag,
+	double bytesPerSecond,
+	double burstBytes )
+{
+	_set_bandwidth_limit( tag, bytesPerSecond, burstBytes );
+}
+
+void File::setHandleBudget(
+	size_t handles )
+{
+	__scheme_file_set_handle_budget( handles );
+}
+
+bool File::setPriority(
+	File::IOPriority priority )
 {
+	if ( File::IOPriority::BACKGROUND < priority )
+	{
+		mErrorCode = EINVAL;
+		return false;
+	}
+
 	std::unique_lock< std::mutex > contextLock;
 	auto context = _get_context( mFileIdentifier, contextLock );
 
 	if ( nullptr == context )
 	{
 		mErrorCode = EBADF;
+		return false;
+	}
+
+	context->_M_IOPriority = priority;
+	return true;
+}
+
+int64_t File::size() const
+{
+	std::unique_lock< std::mutex > contextLock;
+	int errorCode;
+	auto context = _get_open_context( mFileIdentifier, contextLock, errorCode );
+
+	if ( nullptr == context )
+	{
+		mErrorCode = errorCode;
 		return -1;
 	}
 
 	return context->_M_FileSize;
 }
 
+File File::snapshot()
+{
+	File snapshotFile;
+
+	if ( 0 == mFileIdentifier.load() )
+	{
+		mErrorCode = EBADF;
+		return snapshotFile;
+	}
+
+	std::unique_lock< std::mutex > contextLock;
+	auto context = _get_open_context( mFileIdentifier, contextLock, mErrorCode );
+
+	if ( nullptr == context )
+	{
+		return snapshotFile;
+	}
+
+	if ( nullptr == context->_F_snapshot )
+	{
+		mErrorCode = ENOTSUP;
+		return snapshotFile;
+	}
+
+	struct FileContext* snapshotContext = _allocate_context();
+
+	if ( nullptr == snapshotContext )
+	{
+		mErrorCode = ENOMEM;
+		return snapshotFile;
+	}
+
+	// Holding the lock keeps writes through this file from landing mid-copy.
+	if ( not context->_F_snapshot( context, snapshotContext, mErrorCode ) )
+	{
+		_free_context( snapshotContext );
+		return snapshotFile;
+	}
+
+	// Reads of the snapshot are scheduled as those of the file would be.
+	snapshotContext->_M_IOPriority = context->_M_IOPriority;
+	snapshotContext->_M_IOTag = context->_M_IOTag;
+	contextLock.unlock();
+	snapshotFile.mFileIdentifier.store( _register_context( snapshotContext ) );
+	return snapshotFile;
+}
+
+int64_t File::splice(
+	File& destination,
+	int64_t count )
+{
+	if ( ( 0 == mFileIdentifier.load() )
+		or ( 0 == destination.mFileIdentifier.load() ) )
+	{
+		mErrorCode = EBADF;
+		return -1;
+	}
+
+	if ( ( 0 > count )
+		or ( mFileIdentifier.load() == destination.mFileIdentifier.load() ) )
+	{
+		mErrorCode = EINVAL;
+		return -1;
+	}
+
+	if ( 0 == count )
+	{
+		mErrorCode = 0;
+		return 0;
+	}
+
+	// The contexts are locked in the order of their identifiers, so that two
+	// files splicing into each other from different threads can't deadlock.
+	bool sourceFirst = ( mFileIdentifier.load() < destination.mFileIdentifier.load() );
+	std::unique_lock< std::mutex > firstLock;
+	std::unique_lock< std::mutex > secondLock;
+	int errorCode = 0;
+	auto firstContext = _get_open_context( sourceFirst ? mFileIdentifier.load() : destination.mFileIdentifier.load(), firstLock, errorCode );
+	auto secondContext = _get_open_context( sourceFirst ? destination.mFileIdentifier.load() : mFileIdentifier.load(), secondLock, errorCode );
+	auto context = sourceFirst ? firstContext : secondContext;
+	auto destinationContext = sourceFirst ? secondContext : firstContext;
+
+	if ( ( nullptr == context )
+		or ( nullptr == destinationContext ) )
+	{
+		mErrorCode = errorCode;
+		return -1;
+	}
+
+	if ( not FILE_CAN_READ( context )
+		or not FILE_CAN_WRITE( destinationContext ) )
+	{
+		mErrorCode = ENOTSUP;
+		return -1;
+	}
+
+	mErrorCode = 0;
+
+	if ( ( nullptr != context->_F_splice )
+		and ( context->_F_splice == destinationContext->_F_splice ) )
+	{
+		return context->_F_splice( context, destinationContext, count );
+	}
+
+	// Between schemes, the bytes are copied through a buffer instead.
+	std::vector< uint8_t > buffer( std::min< int64_t >( count, FILE_SPLICE_BUFFER_SIZE ) );
+	int64_t bytesSpliced = 0;
+
+	while ( bytesSpliced < count )
+	{
+		int64_t bytesRead = context->_F_read( context, buffer.data(),
+			std::min< int64_t >( count - bytesSpliced, buffer.size() ), true );
+
+		if ( 0 >= bytesRead )
+		{
+			return ( ( -1 == bytesRead ) and ( 0 == bytesSpliced ) ) ? -1 : bytesSpliced;
+		}
+
+		for ( int64_t bytesWritten = 0, writeResult; bytesWritten < bytesRead; bytesWritten += writeResult )
+		{
+			writeResult = destinationContext->_F_write( destinationContext, buffer.data() + bytesWritten, bytesRead - bytesWritten, false );
+
+			if ( 0 >= writeResult )
+			{
+				return ( 0 == bytesSpliced ) ? -1 : bytesSpliced;
+			}
+		}
+
+		bytesSpliced += bytesRead;
+	}
+
+	return bytesSpliced;
+}
+
+bool File::sync()
+{
+	if ( 0 == mFileIdentifier.load() )
+	{
+		mErrorCode = EBADF;
+		return false;
+	}
+
+	std::unique_lock< std::mutex > contextLock;
+	auto context = _get_open_context( mFileIdentifier, contextLock, mErrorCode );
+
+	if ( nullptr == context )
+	{
+		return false;
+	}
+
+	return context->_F_sync( context );
+}
+
 bool File::truncate(
 	int64_t size )
 {
@@ -506,11 +1698,10 @@ bool File::truncate(
 	}
 
 	std::unique_lock< std::mutex > contextLock;
-	auto context = _get_context( mFileIdentifier, contextLock );
+	auto context = _get_open_context( mFileIdentifier, contextLock, mErrorCode );
 
 	if ( nullptr == context )
 	{
-		mErrorCode = EBADF;
 		return false;
 	}
 
@@ -523,7 +1714,7 @@ bool File::truncate(
 	{
 		int64_t newFileSize;
 
-		newFileSize = context->_F_resize( context, size, fill, true, false );
+		newFileSize = context->_F_resize( context, size, '\0', true, false );
 
 		context->_M_FileSize = newFileSize;
 		return size == newFileSize;
@@ -533,9 +1724,133 @@ bool File::truncate(
 	return false;
 }
 
+void File::unpin()
+{
+	mPinnedContext = nullptr;
+}
+
+FileView File::view(
+	int64_t offset,
+	int64_t length )
+{
+	if ( 0 == mFileIdentifier.load() )
+	{
+		mErrorCode = EBADF;
+		return FileView();
+	}
+
+	if ( ( 0 > offset ) or ( 0 > length ) )
+	{
+		mErrorCode = EINVAL;
+		return FileView();
+	}
+
+	std::unique_lock< std::mutex > contextLock;
+	auto context = _get_open_context( mFileIdentifier, contextLock, mErrorCode );
+
+	if ( nullptr == context )
+	{
+		return FileView();
+	}
+
+	// Views are positional, so files without a size (pipes, devices) can't be viewed.
+	if ( not FILE_CAN_READ( context )
+		or ( 0 > context->_M_FileSize )
+		or ( ( nullptr == context->_F_view ) and ( nullptr == context->_F_pread ) and not FILE_CAN_SEEK( context ) ) )
+	{
+		mErrorCode = ENOTSUP;
+		return FileView();
+	}
+
+	mErrorCode = 0;
+	length = std::min( length, std::max< int64_t >( context->_M_FileSize - offset, 0 ) );
+
+	if ( 0 == length )
+	{
+		return FileView();
+	}
+
+	if ( nullptr != context->_F_view )
+	{
+		auto viewData = context->_F_view( context, offset, length );
+		return ( nullptr == viewData ) ? FileView() : FileView( std::move( viewData ), length );
+	}
+
+	auto viewBuffer = __acquire_view_buffer( length );
+
+	if ( nullptr == viewBuffer )
+	{
+		mErrorCode = ENOMEM;
+		return FileView();
+	}
+
+	int64_t bytesCopied = 0;
+	int64_t position = context->_M_FilePosition;
+
+	// Layers (codecs, integrity, journal) only read at the file position, so they're
+	// read from the offset under the lock, and the file position is restored after.
+	if ( ( nullptr == context->_F_pread ) and ( -1 == context->_F_seek( context, offset, false ) ) )
+	{
+		return FileView();
+	}
+
+	while ( bytesCopied < length )
+	{
+		int64_t bytesRead = ( nullptr != context->_F_pread )
+			? context->_F_pread( context, viewBuffer.get() + bytesCopied, length - bytesCopied, offset + bytesCopied )
+			: context->_F_read( context, viewBuffer.get() + bytesCopied, length - bytesCopied, false );
+
+		if ( -1 == bytesRead )
+		{
+			bytesCopied = -1;
+			break;
+		}
+
+		if ( 0 == bytesRead )
+		{
+			break;
+		}
+
+		bytesCopied += bytesRead;
+	}
+
+	if ( nullptr == context->_F_pread )
+	{
+		context->_F_seek( context, position, false );
+	}
+
+	return ( -1 == bytesCopied ) ? FileView() : FileView( std::move( viewBuffer ), bytesCopied );
+}
+
+bool File::waitForData(
+	int64_t timeoutMilliseconds )
+{
+	if ( 0 == mFileIdentifier.load() )
+	{
+		mErrorCode = EBADF;
+		return false;
+	}
+
+	FileFollower follower;
+	mErrorCode = 0;
+
+	if ( not follower.add( *this ) )
+	{
+		return false;
+	}
+
+	if ( follower.wait( timeoutMilliseconds ).empty() )
+	{
+		mErrorCode = ( 0 == mErrorCode ) ? ETIMEDOUT : mErrorCode;
+		return false;
+	}
+
+	return true;
+}
+
 int64_t File::write(
 	const uint8_t* buffer,
-	uint32_t count )
+	size_t count )
 {
 	if ( 0 == mFileIdentifier.load() )
 	{
@@ -556,11 +1871,10 @@ int64_t File::write(
 	}
 
 	std::unique_lock< std::mutex > contextLock;
-	auto context = _get_context( mFileIdentifier, contextLock );
+	auto context = getContext( contextLock );
 
 	if ( nullptr == context )
 	{
-		mErrorCode = EBADF;
 		return -1;
 	}
 
@@ -569,6 +1883,7 @@ int64_t File::write(
 		bool ignoreIOStats = false;
 		struct timeval startTime, endTime;
 		int64_t bytesWritten;
+		File::IOPriority priority = _begin_io( context, contextLock, FILE_IO_STATS_WRITE, count );
 
 		if ( 0 != gettimeofday( &startTime, nullptr ) )
 		{
@@ -576,6 +1891,7 @@ int64_t File::write(
 		}
 
 		bytesWritten = context->_F_write( context, buffer, count, false );
+		_end_io( priority );
 
 		if ( ( not ignoreIOStats ) and ( 0 != gettimeofday( &endTime, nullptr ) ) )
 		{
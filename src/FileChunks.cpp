@@ -0,0 +1,56 @@
+/**
+ * Copyright ©2021. Brent Weichel. All Rights Reserved.
+ * Permission to use, copy, modify, and/or distribute this software, in whole
+ * or part by any means, without express prior written agreement is prohibited.
+ */
+#include <algorithm>
+#include <cstdint>
+#include <string>
+
+#include "File.hpp"
+#include "FileChunks.hpp"
+
+FileChunkReader::FileChunkReader(
+	File& file,
+	const FileChunk& chunk ) noexcept :
+	mFile( &file ),
+	mChunk( chunk ),
+	mPosition( chunk.begin )
+{
+}
+
+const FileChunk& FileChunkReader::chunk() const noexcept
+{
+	return mChunk;
+}
+
+std::string FileChunkReader::errorMessage()
+{
+	return mFile->errorMessage();
+}
+
+int64_t FileChunkReader::position() const noexcept
+{
+	return mPosition;
+}
+
+int64_t FileChunkReader::read(
+	uint8_t* buffer,
+	size_t count )
+{
+	size_t readCount = std::min< int64_t >( count, mChunk.end - mPosition );
+
+	if ( 0 == readCount )
+	{
+		return 0;
+	}
+
+	int64_t bytesRead = mFile->pread( buffer, readCount, mPosition );
+
+	if ( 0 < bytesRead )
+	{
+		mPosition += bytesRead;
+	}
+
+	return bytesRead;
+}
@@ -3,26 +3,40 @@
  * Permission to use, copy, modify, and/or distribute this software, in whole
  * or part by any means, without express prior written agreement is prohibited.
  */
+#include <atomic>
+#include <cerrno>
 #include <cstdint>
 #include <cstdlib>
+#include <cstring>
+#include <map>
 #include <mutex>
 #include <string>
 #include <sys/time.h>
 #include <unordered_map>
 
+#include "CodecLayer.hpp"
 #include "File.hpp"
 #include "FileContext.hpp"
+#include "IOScheduler.hpp"
+#include "IntegrityLayer.hpp"
+#include "JournalLayer.hpp"
+#include "Scheme.hpp"
 #include "Util.hpp"
 
 // Here is the list of supported schemes
 #include "scheme/scheme_file.hpp"
+#include "scheme/scheme_ftp.hpp"
 
 static std::atomic_uint64_t _G_FileIdentifierCounter( 1 );
 static std::unordered_map< uint64_t, struct FileContext* > _G_FileIdentifierContextMap;
 static std::mutex _G_FileIdentifierContextMapMutex;
 
-static const std::map< std::string, struct SchemeFunctionPointers > SUPPORTED_SCHEME_API_MAP {
-	{ SCHEME_FILE_CANONICAL_PREFIX, SCHEME_FILE_API }
+// Advanced under the registry lock whenever a reference count changes, see _pin_context().
+static std::atomic_uint64_t _G_ContextEpoch( 1 );
+
+static const std::map< std::string, struct SchemeAPI > SUPPORTED_SCHEME_API_MAP {
+	{ SCHEME_FILE_CANONICAL_PREFIX, SCHEME_FILE_API },
+	{ SCHEME_FTP_CANONICAL_PREFIX, SCHEME_FTP_API }
 };
 
 struct FileContext* _allocate_context()
@@ -37,53 +51,394 @@ struct FileContext* _allocate_context()
 	return context;
 }
 
+void _free_context(
+	struct FileContext* context )
+{
+	if ( nullptr != context )
+	{
+		free( context->_M_DeferredURI );
+	}
+
+	free( context );
+}
+
+struct DirectoryContext* _allocate_directory_context()
+{
+	return static_cast< struct DirectoryContext* >( calloc( 1, sizeof( struct DirectoryContext ) ) );
+}
+
+void _free_directory_context(
+	struct DirectoryContext* context )
+{
+	free( context );
+}
+
+bool _open_directory_uri(
+	struct DirectoryContext* context,
+	const std::string& uri,
+	int& errorCode )
+{
+	auto schemeAPIIterator = SUPPORTED_SCHEME_API_MAP.find( _get_scheme( uri ) );
+	if ( SUPPORTED_SCHEME_API_MAP.end() == schemeAPIIterator )
+	{
+		errorCode = EPROTONOSUPPORT;
+		return false;
+	}
+
+	const struct SchemeAPI& schemeAPI = schemeAPIIterator->second;
+
+	if ( nullptr == schemeAPI._F_open_directory )
+	{
+		errorCode = ENOTSUP;
+		return false;
+	}
+
+	context->_F_read_directory = schemeAPI._F_read_directory;
+	context->_F_stat_entries = schemeAPI._F_stat_entries;
+	context->_F_close_directory = schemeAPI._F_close_directory;
+
+	return schemeAPI._F_open_directory( context, uri, errorCode );
+}
+
 bool _open_uri(
-	const FileContext* context,
+	struct FileContext* context,
 	const std::string& uri,
 	File::IOFlag mode,
 	int& errorCode )
 {
+	std::string schemeURI( uri );
 	std::string scheme = _get_scheme( uri );
 
 	auto schemeAPIIterator = SUPPORTED_SCHEME_API_MAP.find( scheme );
 	if ( SUPPORTED_SCHEME_API_MAP.end() == schemeAPIIterator )
 	{
+		errorCode = EPROTONOSUPPORT;
+		return false;
+	}
+
+	// Select any layers before opening, as their
+	// parameters are not meant for the scheme.
+	const struct CodecAPI* codec = nullptr;
+	unsigned int codecThreadCount = 1;
+	std::string digestAlgorithm;
+	uint32_t checksumBlockSize = 0;
+	bool journal = false;
+
+	if ( not _select_codec( schemeURI, codec, codecThreadCount )
+		or not _select_integrity( schemeURI, digestAlgorithm, checksumBlockSize )
+		or not _select_journal( schemeURI, journal )
+		or not _select_io_schedule( schemeURI, scheme, context->_M_IOPriority, context->_M_IOTag ) )
+	{
+		errorCode = EINVAL;
+		return false;
+	}
+
+	// The journal flushes the file at checkpoints of its own, so a
+	// local file needn't make each write durable as it's made.
+	if ( journal and ( "file" == scheme ) )
+	{
+		schemeURI += ( std::string::npos == schemeURI.find( '?' ) ) ? "?sync=0" : "&sync=0";
+	}
+
+	const struct SchemeAPI& schemeAPI = schemeAPIIterator->second;
+
+	// The functions are installed ahead of opening, so that a scheme
+	// may clear those it can't support for the resource it opened.
+	context->_F_error_string = schemeAPI._F_error_string;
+	context->_F_close = schemeAPI._F_close;
+	context->_F_seek = schemeAPI._F_seek;
+	context->_F_read = schemeAPI._F_read;
+	context->_F_pread = schemeAPI._F_pread;
+	context->_F_write = schemeAPI._F_write;
+	context->_F_group_append = schemeAPI._F_group_append;
+	context->_F_resize = schemeAPI._F_resize;
+	context->_F_punch_hole = schemeAPI._F_punch_hole;
+	context->_F_data_regions = schemeAPI._F_data_regions;
+	context->_F_sync = schemeAPI._F_sync;
+	context->_F_publish = schemeAPI._F_publish;
+	context->_F_snapshot = schemeAPI._F_snapshot;
+	context->_F_dup = schemeAPI._F_dup;
+	context->_F_refresh = schemeAPI._F_refresh;
+	context->_F_watch = schemeAPI._F_watch;
+	context->_F_splice = schemeAPI._F_splice;
+	context->_F_poll_handle = schemeAPI._F_poll_handle;
+	context->_F_view = schemeAPI._F_view;
+
+	if ( not schemeAPI._F_open( context, schemeURI, mode, errorCode ) )
+	{
+		return false;
+	}
+
+	if ( ( nullptr != codec )
+		and not _push_codec_layer( context, codec, mode, codecThreadCount, errorCode ) )
+	{
+		context->_F_close( context );
+		return false;
+	}
+
+	// The integrity layer sits above any codec, so it covers the decoded bytes.
+	if ( ( not digestAlgorithm.empty() or ( 0 != checksumBlockSize ) )
+		and not _push_integrity_layer( context, schemeURI, digestAlgorithm, checksumBlockSize, mode, errorCode ) )
+	{
+		context->_F_close( context );
+		return false;
+	}
+
+	// The journal sits on top, so that recovery replays writes exactly as they were made.
+	if ( journal and not _push_journal_layer( context, schemeURI, mode, errorCode ) )
+	{
+		context->_F_close( context );
+		return false;
+	}
+
+	return true;
+}
+
+bool _defer_open_uri(
+	struct FileContext* context,
+	const std::string& uri,
+	File::IOFlag mode,
+	int& errorCode )
+{
+	std::string schemeURI( uri );
+	std::string scheme = _get_scheme( uri );
+
+	if ( SUPPORTED_SCHEME_API_MAP.end() == SUPPORTED_SCHEME_API_MAP.find( scheme ) )
+	{
+		errorCode = EPROTONOSUPPORT;
+		return false;
+	}
+
+	if ( not _select_io_schedule( schemeURI, scheme, context->_M_IOPriority, context->_M_IOTag ) )
+	{
+		errorCode = EINVAL;
+		return false;
+	}
+
+	context->_M_DeferredURI = strdup( uri.c_str() );
+
+	if ( nullptr == context->_M_DeferredURI )
+	{
+		errorCode = ENOMEM;
 		return false;
 	}
 
+	context->_M_DeferredMode = mode;
 	return true;
 }
 
+bool _open_deferred_uri(
+	struct FileContext* context,
+	int& errorCode )
+{
+	if ( nullptr == context->_M_DeferredURI )
+	{
+		return true;
+	}
+
+	// The file may have been reprioritized since, which opening would undo.
+	File::IOPriority priority = context->_M_IOPriority;
+
+	if ( not _open_uri( context, context->_M_DeferredURI, context->_M_DeferredMode, errorCode ) )
+	{
+		context->_M_IOPriority = priority;
+		return false;
+	}
+
+	context->_M_IOPriority = priority;
+	free( context->_M_DeferredURI );
+	context->_M_DeferredURI = nullptr;
+	return true;
+}
+
+struct FileContext* _push_context_layer(
+	struct FileContext* context )
+{
+	struct FileContext* innerContext = _allocate_context();
+
+	if ( nullptr != innerContext )
+	{
+		innerContext->_M_FileSize = context->_M_FileSize;
+		innerContext->_M_FilePosition = context->_M_FilePosition;
+		innerContext->_M_Capabilities = context->_M_Capabilities;
+		innerContext->_M_SchemeContext = context->_M_SchemeContext;
+		innerContext->_F_error_string = context->_F_error_string;
+		innerContext->_F_close = context->_F_close;
+		innerContext->_F_seek = context->_F_seek;
+		innerContext->_F_read = context->_F_read;
+		innerContext->_F_pread = context->_F_pread;
+		innerContext->_F_write = context->_F_write;
+		innerContext->_F_group_append = context->_F_group_append;
+		innerContext->_F_resize = context->_F_resize;
+		innerContext->_F_punch_hole = context->_F_punch_hole;
+		innerContext->_F_data_regions = context->_F_data_regions;
+		innerContext->_F_sync = context->_F_sync;
+		innerContext->_F_publish = context->_F_publish;
+		innerContext->_F_snapshot = context->_F_snapshot;
+		innerContext->_F_dup = context->_F_dup;
+		innerContext->_F_refresh = context->_F_refresh;
+		innerContext->_F_watch = context->_F_watch;
+		innerContext->_F_splice = context->_F_splice;
+		innerContext->_F_poll_handle = context->_F_poll_handle;
+		innerContext->_F_view = context->_F_view;
+		innerContext->_F_digest = context->_F_digest;
+		innerContext->_F_begin_batch = context->_F_begin_batch;
+		innerContext->_F_commit = context->_F_commit;
+
+		context->_M_SchemeContext = nullptr;
+	}
+
+	return innerContext;
+}
+
 uint64_t _register_context(
 	FileContext* context )
 {
 	uint64_t identifier = _G_FileIdentifierCounter++;
 	std::lock_guard mapLock( _G_FileIdentifierContextMapMutex );
+
+	// The File the identifier is handed to holds the first reference.
+	context->_M_ReferenceCount = 1;
 	_G_FileIdentifierContextMap[ identifier ] = context;
 	return identifier;
 }
 
+void _register_contexts(
+	std::span< struct FileContext* const > contexts,
+	std::vector< uint64_t >& identifiers )
+{
+	identifiers.assign( contexts.size(), 0 );
+
+	std::lock_guard mapLock( _G_FileIdentifierContextMapMutex );
+	_G_FileIdentifierContextMap.reserve( _G_FileIdentifierContextMap.size() + contexts.size() );
+
+	for ( size_t contextIndex = 0; contextIndex < contexts.size(); ++contextIndex )
+	{
+		if ( nullptr != contexts[ contextIndex ] )
+		{
+			identifiers[ contextIndex ] = _G_FileIdentifierCounter++;
+			contexts[ contextIndex ]->_M_ReferenceCount = 1;
+			_G_FileIdentifierContextMap[ identifiers[ contextIndex ] ] = contexts[ contextIndex ];
+		}
+	}
+}
+
 struct FileContext* _get_context(
 	uint64_t fileIdentifier,
 	std::unique_lock< std::mutex >& contextLock )
 {
+	std::lock_guard mapLock( _G_FileIdentifierContextMapMutex );
+	auto contextIterator = _G_FileIdentifierContextMap.find( fileIdentifier );
+
+	if ( _G_FileIdentifierContextMap.end() == contextIterator )
+	{
+		return nullptr;
+	}
+
+	// The context is locked while the registry still is, so that it can't be
+	// released out from under the caller; see _release_context().
+	contextLock = std::unique_lock< std::mutex >( contextIterator->second->_M_Mutex );
+	return contextIterator->second;
 }
 
-void _release_context(
+struct FileContext* _get_open_context(
+	uint64_t fileIdentifier,
+	std::unique_lock< std::mutex >& contextLock,
+	int& errorCode )
+{
+	struct FileContext* context = _get_context( fileIdentifier, contextLock );
+
+	if ( nullptr == context )
+	{
+		errorCode = EBADF;
+		return nullptr;
+	}
+
+	return _open_deferred_uri( context, errorCode ) ? context : nullptr;
+}
+
+uint64_t _get_context_epoch()
+{
+	return _G_ContextEpoch.load();
+}
+
+struct FileContext* _pin_context(
+	uint64_t fileIdentifier,
+	uint64_t& epoch,
+	bool& exclusive )
+{
+	std::lock_guard mapLock( _G_FileIdentifierContextMapMutex );
+	auto contextIterator = _G_FileIdentifierContextMap.find( fileIdentifier );
+
+	if ( _G_FileIdentifierContextMap.end() == contextIterator )
+	{
+		return nullptr;
+	}
+
+	epoch = _G_ContextEpoch.load();
+	exclusive = ( 1 == contextIterator->second->_M_ReferenceCount );
+	return contextIterator->second;
+}
+
+bool _retain_context(
 	uint64_t fileIdentifier )
 {
 	std::lock_guard mapLock( _G_FileIdentifierContextMapMutex );
-	struct FileContext* context = _G_FileIdentifierContextMap[ fileIdentifier ];
-	if ( 1 == context->_M_ReferenceCount-- )
+	auto contextIterator = _G_FileIdentifierContextMap.find( fileIdentifier );
+
+	if ( _G_FileIdentifierContextMap.end() == contextIterator )
 	{
-		// Remove the context from the map.
-		// Release the lock.
-		// close the resource.
+		return false;
 	}
+
+	++contextIterator->second->_M_ReferenceCount;
+	++_G_ContextEpoch;
+	return true;
+}
+
+void _release_context(
+	uint64_t fileIdentifier )
+{
+	struct FileContext* context;
+
+	{
+		std::lock_guard mapLock( _G_FileIdentifierContextMapMutex );
+		auto contextIterator = _G_FileIdentifierContextMap.find( fileIdentifier );
+
+		if ( _G_FileIdentifierContextMap.end() == contextIterator )
+		{
+			return;
+		}
+
+		context = contextIterator->second;
+		++_G_ContextEpoch;
+
+		if ( 0 != --context->_M_ReferenceCount )
+		{
+			return;
+		}
+
+		_G_FileIdentifierContextMap.erase( contextIterator );
+	}
+
+	// Callers of _get_context() lock the context before letting go of the registry,
+	// so once the lock is free, no one is using the context and no one can find it.
+	std::unique_lock< std::mutex > contextLock( context->_M_Mutex );
+
+	// Close the resource down through its layers, each of which closes the one beneath
+	// it, e.g. flushing a codec's last frame or publishing an atomic write; unless its
+	// open was deferred and never happened.
+	if ( ( nullptr == context->_M_DeferredURI ) and ( nullptr != context->_F_close ) )
+	{
+		context->_F_close( context );
+	}
+
+	contextLock.unlock();
+	_free_context( context );
 }
 
 void _update_io_stats(
-	struct FileContext& context,
+	struct FileContext* context,
 	uint32_t ioStat,
 	struct timeval& startTime,
 	struct timeval& endTime,
@@ -94,7 +449,7 @@ void _update_io_stats(
 	{
 		long double duration = ( endTime.tv_usec - startTime.tv_usec )
 			+ MICROSECONDS_IN_SECOND * ( endTime.tv_sec - startTime.tv_sec );
-		context._M_SumInverseRates[ ioStat ] += duration / ( MICROSECONDS_IN_SECOND * bytes );
-		context._M_NumberObservations[ ioStat ] += 1;
+		context->_M_SumInverseRates[ ioStat ] += duration / ( MICROSECONDS_IN_SECOND * bytes );
+		context->_M_NumberObservations[ ioStat ] += 1;
 	}
 }
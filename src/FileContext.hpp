@@ -6,8 +6,11 @@
 #pragma once
 
 #include <cstdint>
+#include <memory>
 #include <mutex>
+#include <span>
 #include <sys/time.h>
+#include <vector>
 
 #include "File.hpp"
 
@@ -28,6 +31,12 @@ struct FileContext
 	int64_t _M_FilePosition; // Current file position
 	File::IOFlag _M_Capabilities; // Read | Write | Seek flags
 	int _M_ErrorCode; // Context level error codes, scheme specific codes are stored in _M_SchemeContext
+	File::IOPriority _M_IOPriority;
+	uint32_t _M_IOTag; // The tag its bandwidth is accounted against, see IOScheduler.hpp
+
+	// Set while opening the resource is deferred, see _defer_open_uri().
+	char* _M_DeferredURI;
+	File::IOFlag _M_DeferredMode;
 
 	void* _M_SchemeContext;
 
@@ -49,12 +58,24 @@ struct FileContext
 	/*
 	 * The number of bytes read from the resource is returned.
 	 */
-	int64_t ( *_F_read )( struct FileContext*, uint8_t*, uint32_t, bool );
+	int64_t ( *_F_read )( struct FileContext*, uint8_t*, size_t, bool );
+
+	/*
+	 * The number of bytes read from the given offset is returned. Safe to call without
+	 * the context lock. nullptr if the scheme (or a layer) can't provide it.
+	 */
+	int64_t ( *_F_pread )( struct FileContext*, uint8_t*, size_t, int64_t );
 
 	/*
 	 * The number of bytes written out to the resource is returned.
 	 */
-	int64_t ( *_F_write )( struct FileContext*, uint8_t*, uint32_t, bool );
+	int64_t ( *_F_write )( struct FileContext*, const uint8_t*, size_t, bool );
+
+	/*
+	 * The number of bytes durably written at the reserved offset is returned.
+	 * Safe to call without the context lock. nullptr unless appends are group committed.
+	 */
+	int64_t ( *_F_group_append )( struct FileContext*, const uint8_t*, size_t, int64_t );
 
 	/*
 	 * Resize the file to the desired size.
@@ -67,11 +88,114 @@ struct FileContext
 	 */
 	int64_t ( *_F_resize )( struct FileContext*, int64_t, uint8_t, bool, bool );
 
+	/*
+	 * Deallocate the storage of a byte range without changing the file size.
+	 * signature: ( context: FileContext*, offset: int64_t, length: int64_t ) -> bool
+	 * nullptr if the scheme (or a layer) has no notion of holes.
+	 */
+	bool ( *_F_punch_hole )( struct FileContext*, int64_t, int64_t );
+
+	/*
+	 * Store the byte ranges backed by data in the given vector.
+	 * nullptr if the scheme (or a layer) has no notion of holes.
+	 */
+	bool ( *_F_data_regions )( struct FileContext*, std::vector< struct FileChunk >& );
+
 	/*
 	 * Synchronize the contents of the memory buffer with the resource if applicable.
 	 * False is returned if an error occurred, true on success or no-op.
 	 */
 	bool ( *_F_sync )( struct FileContext* );
+
+	/*
+	 * Atomically replace the target with what was written, syncing its directory if requested.
+	 * nullptr unless the resource was opened with File::IOFlag::ATOMIC.
+	 */
+	bool ( *_F_publish )( struct FileContext*, bool );
+
+	/*
+	 * Open a read-only, point in time copy of the resource into the second context.
+	 * signature: ( context: FileContext*, snapshotContext: FileContext*, errorCode: int& ) -> bool
+	 */
+	bool ( *_F_snapshot )( struct FileContext*, struct FileContext*, int& );
+
+	/*
+	 * Open another read-only handle, with a file position of its own, on what was opened into the second context.
+	 * signature: ( context: FileContext*, dupContext: FileContext*, errorCode: int& ) -> bool
+	 * nullptr if the scheme (or a layer) can't share what it opened.
+	 */
+	bool ( *_F_dup )( struct FileContext*, struct FileContext*, int& );
+
+	/*
+	 * Update the file size from the resource, reopening it once replaced and read to the end.
+	 * signature: ( context: FileContext*, replaced: bool& ) -> bool
+	 */
+	bool ( *_F_refresh )( struct FileContext*, bool& );
+
+	/*
+	 * Add inotify watches for the resource changing.
+	 * signature: ( context: FileContext*, notifyHandle: int, fileWatch: int&, directoryWatch: int& ) -> bool
+	 * nullptr unless the resource is local, in which case it's polled with _F_refresh instead.
+	 */
+	bool ( *_F_watch )( struct FileContext*, int, int&, int& );
+
+	/*
+	 * Move bytes from the resource into another of the same scheme within the kernel.
+	 * signature: ( context: FileContext*, destinationContext: FileContext*, bytes: int64_t ) -> int64_t
+	 * The number of bytes moved is returned. nullptr if the scheme (or a layer) can't.
+	 */
+	int64_t ( *_F_splice )( struct FileContext*, struct FileContext*, int64_t );
+
+	/*
+	 * Get the file descriptor to wait on with epoll for the resource to be ready.
+	 * nullptr if the scheme (or a layer) has none.
+	 */
+	int ( *_F_poll_handle )( struct FileContext* );
+
+	/*
+	 * Lend a read-only view of bytes of the resource in place, e.g. by mapping them.
+	 * signature: ( context: FileContext*, offset: int64_t, length: int64_t ) -> std::shared_ptr< const uint8_t >
+	 * nullptr if the scheme (or a layer) can't, in which case the bytes are copied.
+	 */
+	std::shared_ptr< const uint8_t > ( *_F_view )( struct FileContext*, int64_t, int64_t );
+
+	/*
+	 * Get the digest of the bytes streamed through the context, if a layer computes one.
+	 * This is left as nullptr by the schemes.
+	 */
+	std::string ( *_F_digest )( struct FileContext* );
+
+	/*
+	 * Group the writes that follow into one batch, made durable together by _F_commit.
+	 * These are left as nullptr by the schemes, and set by the journal layer.
+	 */
+	bool ( *_F_begin_batch )( struct FileContext* );
+	bool ( *_F_commit )( struct FileContext* );
+};
+
+struct DirectoryContext
+{
+	int _M_ErrorCode; // Error code of the last failed listing operation
+
+	void* _M_SchemeContext;
+
+	/*
+	 * Append the next batch of entries to the vector.
+	 * The number of entries appended is returned, zero at the end, and -1 on error.
+	 */
+	int64_t ( *_F_read_directory )( struct DirectoryContext*, std::vector< struct FileEntry >& );
+
+	/*
+	 * Fill in the unknown types, and if requested the metadata, of the given entries.
+	 * signature: ( context: DirectoryContext*, entries: span< FileEntry >, metadata: bool ) -> bool
+	 * nullptr if the listing itself carries all that the scheme can provide.
+	 */
+	bool ( *_F_stat_entries )( struct DirectoryContext*, std::span< struct FileEntry >, bool );
+
+	/*
+	 * Stop listing and release the resources.
+	 */
+	void ( *_F_close_directory )( struct DirectoryContext* );
 };
 
 #define FILE_CAN_READ( context )  ( ( context )->_M_Capabilities & File::IOFlag::READ )
@@ -84,6 +208,14 @@ struct FileContext
  */
 struct FileContext* _allocate_context();
 
+/*
+ * Release a FileContext object allocated with _allocate_context().
+ * The resource, if any, is expected to have already been closed.
+ * @param context A pointer to the context to release.
+ */
+void _free_context(
+	struct FileContext* context );
+
 /*
  * Open the URI into the provided context.
  * @param context A pointer to the context to store the handle to the file.
@@ -93,11 +225,77 @@ struct FileContext* _allocate_context();
  * @return True is returned upon successfully opening the resource, false is returned on error and {@param errorCode} is set.
  */
 bool _open_uri(
-	const FileContext* context,
+	struct FileContext* context,
+	const std::string& uri,
+	File::IOFlag mode,
+	int& errorCode );
+
+/*
+ * Record the URI in the provided context, for _open_deferred_uri() to open into it on
+ * first use. Only the scheme and the I/O schedule of the URI are checked up front; the
+ * scheduling parameters take effect straight away, so that the file can be reprioritized.
+ * @param context A pointer to the context to record the URI in.
+ * @param uri The URI to the resource to be opened.
+ * @param mode The mode in which to open the resource.
+ * @param errorCode A reference to an integer in which to store error codes related to checking the URI.
+ * @return True is returned upon recording the URI, false is returned on error and {@param errorCode} is set.
+ */
+bool _defer_open_uri(
+	struct FileContext* context,
 	const std::string& uri,
 	File::IOFlag mode,
 	int& errorCode );
 
+/*
+ * Open the URI recorded by _defer_open_uri() into the context, if it hasn't been yet.
+ * Called with the context lock held. Should the open fail, the URI is kept, and the
+ * next call retries it.
+ * @param context A pointer to the context.
+ * @param errorCode A reference to an integer in which to store error codes related to opening the file.
+ * @return True is returned if the resource is open, false is returned on error and {@param errorCode} is set.
+ */
+bool _open_deferred_uri(
+	struct FileContext* context,
+	int& errorCode );
+
+/*
+ * Allocate a DirectoryContext object initialized to a zero state.
+ * @return A pointer to a DirectoryContext object is returned, or nullptr on allocation failure.
+ */
+struct DirectoryContext* _allocate_directory_context();
+
+/*
+ * Release a DirectoryContext object allocated with _allocate_directory_context().
+ * The listing, if any, is expected to have already been closed.
+ * @param context A pointer to the context to release.
+ */
+void _free_directory_context(
+	struct DirectoryContext* context );
+
+/*
+ * Open the directory at the URI for listing into the provided context.
+ * @param context A pointer to the context to store the handle to the listing.
+ * @param uri The URI to the directory to be listed.
+ * @param errorCode A reference to an integer in which to store error codes related to opening the directory.
+ * @return True is returned upon successfully opening the directory, false is returned on error and {@param errorCode} is set.
+ *         ENOTSUP is set if the scheme can't list directories.
+ */
+bool _open_directory_uri(
+	struct DirectoryContext* context,
+	const std::string& uri,
+	int& errorCode );
+
+/*
+ * Move the opened resource of {@param context} into a newly allocated context,
+ * so that a layer (e.g. a codec) may install its own functions in its place.
+ * The layer is expected to forward to the returned context, and to close
+ * and free it from within its own _F_close.
+ * @param context A pointer to an opened context.
+ * @return A pointer to the inner context, or nullptr on allocation failure.
+ */
+struct FileContext* _push_context_layer(
+	struct FileContext* context );
+
 /*
  * @param context A pointer to the context to register.
  * @return A file identifier that the context is registered to.
@@ -105,6 +303,15 @@ bool _open_uri(
 uint64_t _register_context(
 	FileContext* context );
 
+/*
+ * Register many contexts under a single acquisition of the registry lock.
+ * @param contexts The contexts to register. Null entries are skipped.
+ * @param identifiers Reference to store the file identifier of each context, zero for skipped entries.
+ */
+void _register_contexts(
+	std::span< struct FileContext* const > contexts,
+	std::vector< uint64_t >& identifiers );
+
 /*
  * Get the context for the file associated with the given identifier.
  * @param fileIdentifier Identifier to the file context.
@@ -116,6 +323,50 @@ struct FileContext* _get_context(
 	uint64_t fileIdentifier,
 	std::unique_lock< std::mutex >& contextLock );
 
+/*
+ * Get the context for the file associated with the given identifier as _get_context()
+ * does, first opening its resource should that have been deferred.
+ * @param fileIdentifier Identifier to the file context.
+ * @param contextLock The lock for acquiring the context.
+ * @param errorCode A reference to an integer in which to store the error code on failure.
+ * @return A pointer to the opened context is returned. If nullptr is returned then
+ *         {@param errorCode} is set; EBADF if there is no file context for the provided identifier.
+ */
+struct FileContext* _get_open_context(
+	uint64_t fileIdentifier,
+	std::unique_lock< std::mutex >& contextLock,
+	int& errorCode );
+
+/*
+ * Get the epoch of the registry, which advances whenever a context gains or loses
+ * a reference. A context, and whether it has a single reference, cached with
+ * _pin_context() remain current for as long as the epoch doesn't advance.
+ * @return The epoch is returned.
+ */
+uint64_t _get_context_epoch();
+
+/*
+ * Get the context for the file associated with the given identifier, to be cached
+ * by a File pinned to a thread, without locking it.
+ * @param fileIdentifier Identifier to the file context.
+ * @param epoch Reference to store the epoch of the registry at which the context was got.
+ * @param exclusive Reference to store whether the context has a single reference.
+ * @return A pointer to the context is returned. If nullptr is returned then
+ *         there is no file context for the provided identifier.
+ */
+struct FileContext* _pin_context(
+	uint64_t fileIdentifier,
+	uint64_t& epoch,
+	bool& exclusive );
+
+/*
+ * Increment the reference count of the context, for another File instance to point to it.
+ * @param fileIdentifier identifier for the file to be retained.
+ * @return True is returned if the context exists, else false is returned.
+ */
+bool _retain_context(
+	uint64_t fileIdentifier );
+
 /*
  * Decrement the reference count, and release the resources if
  * no additional File instances point to the context.
@@ -126,14 +377,14 @@ void _release_context(
 
 /*
  * Updated the IO stats with the latest information.
- * @param sumInverseRates A reference to the sum of the inverse of the rate.
- * @param numberObservations A reference to the count of the number of rate observations made.
+ * @param context A pointer to the context whose stats to update.
+ * @param ioStat FILE_IO_STATS_READ or FILE_IO_STATS_WRITE.
  * @param startTime The logged time just before a read or write is called.
  * @param endTime The logged time just after a read or write is called.
  * @param bytes The number of bytes written or read from the file.
  */
 void _update_io_stats(
-	struct FileContext& context,
+	struct FileContext* context,
 	uint32_t ioStat,
 	struct timeval& startTime,
 	struct timeval& endTime,
@@ -0,0 +1,138 @@
+/**
+ * Copyright ©2021. Brent Weichel. All Rights Reserved.
+ * Permission to use, copy, modify, and/or distribute this software, in whole
+ * or part by any means, without express prior written agreement is prohibited.
+ */
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fnmatch.h>
+#include <string>
+
+#include "FileContext.hpp"
+#include "FileDirectory.hpp"
+#include "Util.hpp"
+
+FileDirectory::FileDirectory(
+	const std::string& uri,
+	const std::string& pattern,
+	bool metadata ) :
+	mContext( nullptr ),
+	mPattern( pattern ),
+	mMetadata( metadata ),
+	mErrorCode( 0 ),
+	mEntryIndex( 0 ),
+	mExhausted( false )
+{
+	std::string normalizedURI;
+
+	if ( not _normalize_filepath( normalizedURI, uri ) )
+	{
+		mErrorCode = EINVAL;
+		return;
+	}
+
+	mContext = _allocate_directory_context();
+
+	if ( nullptr == mContext )
+	{
+		mErrorCode = ENOMEM;
+		return;
+	}
+
+	// Schemes may set the error code along the way to succeeding.
+	int errorCode = 0;
+
+	if ( not _open_directory_uri( mContext, normalizedURI, errorCode ) )
+	{
+		mErrorCode = errorCode;
+		_free_directory_context( mContext );
+		mContext = nullptr;
+	}
+}
+
+FileDirectory::~FileDirectory()
+{
+	if ( nullptr != mContext )
+	{
+		mContext->_F_close_directory( mContext );
+		_free_directory_context( mContext );
+	}
+}
+
+FileDirectory::Iterator FileDirectory::begin()
+{
+	next();
+	return Iterator( this );
+}
+
+std::string FileDirectory::errorMessage() const
+{
+	return ( 0 == mErrorCode ) ? std::string() : std::string( strerror( mErrorCode ) );
+}
+
+bool FileDirectory::next()
+{
+	if ( mEntryIndex + 1 < mEntries.size() )
+	{
+		++mEntryIndex;
+		return true;
+	}
+
+	mEntries.clear();
+	mEntryIndex = 0;
+
+	while ( nullptr != mContext )
+	{
+		int64_t entryCount = mContext->_F_read_directory( mContext, mEntries );
+
+		if ( 0 >= entryCount )
+		{
+			if ( -1 == entryCount )
+			{
+				mErrorCode = mContext->_M_ErrorCode;
+			}
+
+			break;
+		}
+
+		// Entries are filtered ahead of being stat'd, so only those listed are.
+		if ( not mPattern.empty() )
+		{
+			std::erase_if( mEntries, [ this ]( const FileEntry& entry )
+			{
+				return 0 != fnmatch( mPattern.c_str(), entry.name.c_str(), FNM_PERIOD );
+			} );
+		}
+
+		bool statRequired = std::any_of( mEntries.begin(), mEntries.end(), [ this ]( const FileEntry& entry )
+		{
+			return ( FileEntry::UNKNOWN == entry.type ) or ( mMetadata and not entry.hasMetadata );
+		} );
+
+		if ( statRequired
+			and ( nullptr != mContext->_F_stat_entries )
+			and not mContext->_F_stat_entries( mContext, mEntries, mMetadata ) )
+		{
+			mErrorCode = mContext->_M_ErrorCode;
+			mEntries.clear();
+			break;
+		}
+
+		if ( not mEntries.empty() )
+		{
+			return true;
+		}
+	}
+
+	// Release the listing as soon as it's done with, rather than when the range is.
+	if ( nullptr != mContext )
+	{
+		mContext->_F_close_directory( mContext );
+		_free_directory_context( mContext );
+		mContext = nullptr;
+	}
+
+	mExhausted = true;
+	return false;
+}
@@ -0,0 +1,273 @@
+/**
+ * Copyright ©2021. Brent Weichel. All Rights Reserved.
+ * Permission to use, copy, modify, and/or distribute this software, in whole
+ * or part by any means, without express prior written agreement is prohibited.
+ */
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <vector>
+
+#include "File.hpp"
+#include "FileContext.hpp"
+#include "FileFollower.hpp"
+
+// Files that can't be watched are refreshed this often while waiting.
+#define FOLLOW_POLL_INTERVAL_MILLISECONDS ( 1000 )
+
+// Notifications are drained this many bytes at a time.
+#define FOLLOW_EVENT_BUFFER_SIZE ( 64 * 1024 )
+
+FileFollower::FileFollower() :
+	mNotifyHandle( inotify_init1( IN_NONBLOCK | IN_CLOEXEC ) ),
+	mNotifyErrorCode( ( -1 == mNotifyHandle ) ? errno : 0 ),
+	mNextPoll( std::chrono::steady_clock::now() )
+{
+}
+
+FileFollower::~FileFollower()
+{
+	if ( -1 != mNotifyHandle )
+	{
+		close( mNotifyHandle );
+	}
+}
+
+bool FileFollower::add(
+	File& file )
+{
+	if ( 0 != mNotifyErrorCode )
+	{
+		file.mErrorCode = mNotifyErrorCode;
+		return false;
+	}
+
+	std::unique_lock< std::mutex > contextLock;
+	auto context = _get_open_context( file.mFileIdentifier, contextLock, file.mErrorCode );
+
+	if ( nullptr == context )
+	{
+		return false;
+	}
+
+	// Only schemes that can refresh the file size can be followed.
+	if ( not FILE_CAN_READ( context ) or ( nullptr == context->_F_refresh ) )
+	{
+		file.mErrorCode = ENOTSUP;
+		return false;
+	}
+
+	struct FollowedFile followedFile = { &file, -1, -1, true };
+
+	if ( ( nullptr != context->_F_watch )
+		and not context->_F_watch( context, mNotifyHandle, followedFile.mFileWatch, followedFile.mDirectoryWatch ) )
+	{
+		file.mErrorCode = EIO;
+		return false;
+	}
+
+	mFollowedFiles.push_back( followedFile );
+	return true;
+}
+
+bool FileFollower::refresh(
+	FollowedFile& followedFile )
+{
+	std::unique_lock< std::mutex > contextLock;
+	auto context = _get_context( followedFile.mFile->mFileIdentifier, contextLock );
+
+	if ( nullptr == context )
+	{
+		followedFile.mFile->mErrorCode = EBADF;
+		return false;
+	}
+
+	bool replaced = false;
+
+	if ( not context->_F_refresh( context, replaced ) )
+	{
+		followedFile.mFile->mErrorCode = EIO;
+		return false;
+	}
+
+	// The watch on a replaced file is moved over to the file that took its place.
+	// Should that fail, the file is polled from then on.
+	if ( replaced and ( -1 != followedFile.mFileWatch ) )
+	{
+		inotify_rm_watch( mNotifyHandle, followedFile.mFileWatch );
+		followedFile.mFileWatch = -1;
+
+		if ( not context->_F_watch( context, mNotifyHandle, followedFile.mFileWatch, followedFile.mDirectoryWatch ) )
+		{
+			followedFile.mFileWatch = -1;
+		}
+	}
+
+	// A file without a size was woken by a write to it; a file with a size is
+	// ready until read to the end, and so is refreshed again on the next wait.
+	if ( 0 > context->_M_FileSize )
+	{
+		return true;
+	}
+
+	followedFile.mChanged = ( context->_M_FilePosition < context->_M_FileSize );
+	return followedFile.mChanged;
+}
+
+void FileFollower::remove(
+	File& file )
+{
+	auto followedFile = std::find_if( mFollowedFiles.begin(), mFollowedFiles.end(),
+		[ &file ]( const FollowedFile& other )
+		{
+			return &file == other.mFile;
+		} );
+
+	if ( mFollowedFiles.end() == followedFile )
+	{
+		return;
+	}
+
+	if ( -1 != followedFile->mFileWatch )
+	{
+		inotify_rm_watch( mNotifyHandle, followedFile->mFileWatch );
+	}
+
+	// Files in the same directory share its watch.
+	int directoryWatch = followedFile->mDirectoryWatch;
+	mFollowedFiles.erase( followedFile );
+
+	if ( ( -1 != directoryWatch )
+		and std::none_of( mFollowedFiles.begin(), mFollowedFiles.end(),
+			[ directoryWatch ]( const FollowedFile& other )
+			{
+				return directoryWatch == other.mDirectoryWatch;
+			} ) )
+	{
+		inotify_rm_watch( mNotifyHandle, directoryWatch );
+	}
+}
+
+void FileFollower::setErrorCode(
+	int errorCode )
+{
+	for ( auto& followedFile : mFollowedFiles )
+	{
+		followedFile.mFile->mErrorCode = errorCode;
+	}
+}
+
+std::vector< File* > FileFollower::wait(
+	int64_t timeoutMilliseconds )
+{
+	std::vector< File* > readyFiles;
+	auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds( timeoutMilliseconds );
+	alignas( struct inotify_event ) uint8_t eventBuffer[ FOLLOW_EVENT_BUFFER_SIZE ];
+
+	while ( true )
+	{
+		auto now = std::chrono::steady_clock::now();
+		bool pollDue = ( now >= mNextPoll );
+		bool polling = false;
+
+		if ( pollDue )
+		{
+			mNextPoll = now + std::chrono::milliseconds( FOLLOW_POLL_INTERVAL_MILLISECONDS );
+		}
+
+		// Only the files with notifications since the last wait (or still
+		// holding bytes to be read, or due to be polled) are refreshed.
+		for ( auto& followedFile : mFollowedFiles )
+		{
+			if ( -1 == followedFile.mFileWatch )
+			{
+				polling = true;
+				followedFile.mChanged |= pollDue;
+			}
+
+			if ( followedFile.mChanged )
+			{
+				followedFile.mChanged = false;
+
+				if ( refresh( followedFile ) )
+				{
+					readyFiles.push_back( followedFile.mFile );
+				}
+			}
+		}
+
+		if ( not readyFiles.empty() )
+		{
+			return readyFiles;
+		}
+
+		int pollTimeout = -1;
+
+		if ( 0 <= timeoutMilliseconds )
+		{
+			if ( now >= deadline )
+			{
+				return readyFiles;
+			}
+
+			pollTimeout = std::chrono::ceil< std::chrono::milliseconds >( deadline - now ).count();
+		}
+
+		if ( polling )
+		{
+			int pollInterval = std::chrono::ceil< std::chrono::milliseconds >( mNextPoll - now ).count();
+			pollTimeout = ( -1 == pollTimeout ) ? pollInterval : std::min( pollTimeout, pollInterval );
+		}
+
+		struct pollfd notifyPoll = { mNotifyHandle, POLLIN, 0 };
+		int pollCount = poll( &notifyPoll, 1, pollTimeout );
+
+		if ( -1 == pollCount )
+		{
+			if ( EINTR == errno )
+			{
+				continue;
+			}
+
+			setErrorCode( errno );
+			return readyFiles;
+		}
+
+		if ( 0 == pollCount )
+		{
+			continue;
+		}
+
+		ssize_t bytesRead;
+
+		while ( 0 < ( bytesRead = read( mNotifyHandle, eventBuffer, sizeof( eventBuffer ) ) ) )
+		{
+			for ( ssize_t offset = 0; offset < bytesRead; )
+			{
+				const struct inotify_event* event = reinterpret_cast< const struct inotify_event* >( eventBuffer + offset );
+				offset += sizeof( struct inotify_event ) + event->len;
+
+				// Notifications were dropped, so any of the files may have changed.
+				bool overflow = ( IN_Q_OVERFLOW & event->mask );
+
+				for ( auto& followedFile : mFollowedFiles )
+				{
+					followedFile.mChanged |= overflow
+						or ( event->wd == followedFile.mFileWatch )
+						or ( event->wd == followedFile.mDirectoryWatch );
+				}
+			}
+		}
+
+		if ( ( -1 == bytesRead ) and ( EAGAIN != errno ) and ( EINTR != errno ) )
+		{
+			setErrorCode( errno );
+			return readyFiles;
+		}
+	}
+}
@@ -0,0 +1,216 @@
+/**
+ * Copyright ©2021. Brent Weichel. All Rights Reserved.
+ * Permission to use, copy, modify, and/or distribute this software, in whole
+ * or part by any means, without express prior written agreement is prohibited.
+ */
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <sys/epoll.h>
+#include <unistd.h>
+#include <vector>
+
+#include "File.hpp"
+#include "FileContext.hpp"
+#include "FilePoller.hpp"
+
+// Events are collected from epoll this many at a time.
+#define FILE_POLL_EVENT_COUNT ( 256 )
+
+FilePoller::FilePoller() :
+	mPollHandle( epoll_create1( EPOLL_CLOEXEC ) ),
+	mPollErrorCode( ( -1 == mPollHandle ) ? errno : 0 )
+{
+}
+
+FilePoller::~FilePoller()
+{
+	if ( -1 != mPollHandle )
+	{
+		close( mPollHandle );
+	}
+}
+
+bool FilePoller::add(
+	File& file,
+	File::IOFlag events )
+{
+	if ( 0 != mPollErrorCode )
+	{
+		file.mErrorCode = mPollErrorCode;
+		return false;
+	}
+
+	if ( 0 == ( ( File::IOFlag::READ | File::IOFlag::WRITE ) & events ) )
+	{
+		file.mErrorCode = EINVAL;
+		return false;
+	}
+
+	std::unique_lock< std::mutex > contextLock;
+	auto context = _get_open_context( file.mFileIdentifier, contextLock, file.mErrorCode );
+
+	if ( nullptr == context )
+	{
+		return false;
+	}
+
+	if ( ( ( File::IOFlag::READ & events ) and not FILE_CAN_READ( context ) )
+		or ( ( File::IOFlag::WRITE & events ) and not FILE_CAN_WRITE( context ) ) )
+	{
+		file.mErrorCode = ENOTSUP;
+		return false;
+	}
+
+	auto polledFile = std::find_if( mPolledFiles.begin(), mPolledFiles.end(),
+		[ &file ]( const PolledFile& other )
+		{
+			return &file == other.mFile;
+		} );
+	bool polled = ( mPolledFiles.end() != polledFile );
+
+	if ( not polled )
+	{
+		int pollHandle = ( nullptr == context->_F_poll_handle ) ? -1 : context->_F_poll_handle( context );
+		polledFile = mPolledFiles.insert( mPolledFiles.end(), { &file, events, pollHandle } );
+	}
+
+	polledFile->mEvents = events;
+
+	if ( -1 == polledFile->mPollHandle )
+	{
+		return true;
+	}
+
+	struct epoll_event pollEvent = {};
+	pollEvent.events = ( ( File::IOFlag::READ & events ) ? static_cast< uint32_t >( EPOLLIN ) : 0u )
+		| ( ( File::IOFlag::WRITE & events ) ? static_cast< uint32_t >( EPOLLOUT ) : 0u )
+		| EPOLLRDHUP;
+	pollEvent.data.ptr = &*polledFile;
+
+	if ( 0 == epoll_ctl( mPollHandle, polled ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, polledFile->mPollHandle, &pollEvent ) )
+	{
+		return true;
+	}
+
+	// epoll refuses regular files, which never block.
+	if ( EPERM == errno )
+	{
+		polledFile->mPollHandle = -1;
+		return true;
+	}
+
+	file.mErrorCode = errno;
+
+	if ( not polled )
+	{
+		mPolledFiles.erase( polledFile );
+	}
+
+	return false;
+}
+
+void FilePoller::remove(
+	File& file )
+{
+	auto polledFile = std::find_if( mPolledFiles.begin(), mPolledFiles.end(),
+		[ &file ]( const PolledFile& other )
+		{
+			return &file == other.mFile;
+		} );
+
+	if ( mPolledFiles.end() == polledFile )
+	{
+		return;
+	}
+
+	if ( -1 != polledFile->mPollHandle )
+	{
+		epoll_ctl( mPollHandle, EPOLL_CTL_DEL, polledFile->mPollHandle, nullptr );
+	}
+
+	mPolledFiles.erase( polledFile );
+}
+
+void FilePoller::setErrorCode(
+	int errorCode )
+{
+	for ( auto& polledFile : mPolledFiles )
+	{
+		polledFile.mFile->mErrorCode = errorCode;
+	}
+}
+
+std::vector< FilePoller::ReadyFile > FilePoller::wait(
+	int64_t timeoutMilliseconds )
+{
+	std::vector< ReadyFile > readyFiles;
+	auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds( timeoutMilliseconds );
+	struct epoll_event pollEvents[ FILE_POLL_EVENT_COUNT ];
+
+	if ( 0 != mPollErrorCode )
+	{
+		setErrorCode( mPollErrorCode );
+		return readyFiles;
+	}
+
+	for ( auto& polledFile : mPolledFiles )
+	{
+		if ( -1 == polledFile.mPollHandle )
+		{
+			readyFiles.push_back( { polledFile.mFile, polledFile.mEvents } );
+		}
+	}
+
+	while ( true )
+	{
+		int pollTimeout = -1;
+
+		// Files that are always ready are returned along with those ready now, without waiting.
+		if ( not readyFiles.empty() )
+		{
+			pollTimeout = 0;
+		}
+		else if ( 0 <= timeoutMilliseconds )
+		{
+			auto now = std::chrono::steady_clock::now();
+			pollTimeout = ( now >= deadline ) ? 0 : std::chrono::ceil< std::chrono::milliseconds >( deadline - now ).count();
+		}
+
+		int eventCount = epoll_wait( mPollHandle, pollEvents, FILE_POLL_EVENT_COUNT, pollTimeout );
+
+		if ( -1 == eventCount )
+		{
+			if ( EINTR == errno )
+			{
+				continue;
+			}
+
+			setErrorCode( errno );
+			return readyFiles;
+		}
+
+		for ( int eventIndex = 0; eventIndex < eventCount; ++eventIndex )
+		{
+			const PolledFile* polledFile = static_cast< const PolledFile* >( pollEvents[ eventIndex ].data.ptr );
+			uint32_t events = pollEvents[ eventIndex ].events;
+			uint32_t ready = ( ( EPOLLIN & events ) ? static_cast< uint32_t >( File::IOFlag::READ ) : 0u )
+				| ( ( EPOLLOUT & events ) ? static_cast< uint32_t >( File::IOFlag::WRITE ) : 0u );
+
+			// A hang up or error leaves the file ready for whatever it's polled for.
+			if ( ( EPOLLHUP | EPOLLRDHUP | EPOLLERR ) & events )
+			{
+				ready = polledFile->mEvents;
+			}
+
+			readyFiles.push_back( { polledFile->mFile, static_cast< File::IOFlag >( ready & polledFile->mEvents ) } );
+		}
+
+		if ( ( 0 < eventCount ) or not readyFiles.empty() or ( 0 == pollTimeout ) )
+		{
+			return readyFiles;
+		}
+	}
+}
@@ -0,0 +1,188 @@
+/**
+ * Copyright ©2021. Brent Weichel. All Rights Reserved.
+ * Permission to use, copy, modify, and/or distribute this software, in whole
+ * or part by any means, without express prior written agreement is prohibited.
+ */
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <string_view>
+
+#include "File.hpp"
+#include "FileContext.hpp"
+#include "FileRecords.hpp"
+#include "FileView.hpp"
+#include "Scan.hpp"
+
+// Mapping a window costs the same whatever its size, and only the pages
+// touched are read, so windows are at least this size, whatever the buffer's.
+#define FILE_RECORDS_MINIMUM_WINDOW_SIZE ( 16 * 1024 * 1024 )
+
+FileRecords::FileRecords(
+	File& file,
+	uint8_t delimiter,
+	bool stripCarriageReturn,
+	size_t bufferSize ) :
+	mFile( &file ),
+	mDelimiter( delimiter ),
+	mStripCarriageReturn( stripCarriageReturn ),
+	mBufferSize( std::max< size_t >( 1, bufferSize ) ),
+	mWindowPosition( 0 ),
+	mViewable( false ),
+	mData( nullptr ),
+	mRecordStart( 0 ),
+	mScanPosition( 0 ),
+	mBufferEnd( 0 ),
+	mEndOfFile( false ),
+	mExhausted( false ),
+	mErrorCode( 0 )
+{
+	std::unique_lock< std::mutex > contextLock;
+	struct FileContext* context = mFile->getContext( contextLock );
+
+	// Records are found in place where the scheme can lend the bytes, saving
+	// the copy into the buffer. Views are positional, so this needs a size.
+	if ( ( nullptr != context )
+		and FILE_CAN_READ( context )
+		and ( nullptr != context->_F_view )
+		and ( 0 <= context->_M_FileSize ) )
+	{
+		mWindowPosition = context->_M_FilePosition;
+		mViewable = true;
+	}
+}
+
+FileRecords::Iterator FileRecords::begin()
+{
+	mErrorCode = 0;
+	mExhausted = false;
+	next();
+	return Iterator( this );
+}
+
+std::string FileRecords::errorMessage() const
+{
+	return ( 0 == mErrorCode ) ? std::string() : std::string( strerror( mErrorCode ) );
+}
+
+/*
+ * Read more of the file onto the end of the buffer, first moving only the
+ * partial record to the front of it, and growing it if the record fills it.
+ * At the end of the file this sets mEndOfFile, and on error, the error code.
+ */
+void FileRecords::fillBuffer()
+{
+	if ( 0 != mRecordStart )
+	{
+		memmove( mBuffer.data(), mBuffer.data() + mRecordStart, mBufferEnd - mRecordStart );
+		mBufferEnd -= mRecordStart;
+		mRecordStart = 0;
+	}
+	else if ( mBufferEnd == mBuffer.size() )
+	{
+		mBuffer.resize( std::max( mBufferSize, 2 * mBuffer.size() ) );
+	}
+
+	mData = mBuffer.data();
+	mScanPosition = mBufferEnd;
+
+	int64_t bytesRead = mFile->read( mBuffer.data() + mBufferEnd, mBuffer.size() - mBufferEnd );
+
+	if ( 0 > bytesRead )
+	{
+		mErrorCode = ( 0 != mFile->mErrorCode ) ? mFile->mErrorCode : EIO;
+		return;
+	}
+
+	if ( 0 == bytesRead )
+	{
+		mEndOfFile = true;
+		return;
+	}
+
+	mBufferEnd += bytesRead;
+}
+
+/*
+ * Move the window on to start at the partial record, taking in the bytes after
+ * it, and growing the window if the record fills it. The file position is kept
+ * at the end of the window, where reading the same bytes would have left it.
+ * At the end of the file this sets mEndOfFile, and on error, the error code.
+ */
+void FileRecords::fillWindow()
+{
+	size_t partialSize = mBufferEnd - mRecordStart;
+	int64_t windowPosition = mWindowPosition + mRecordStart;
+	FileView window = mFile->view( windowPosition,
+		std::max( { mBufferSize, 2 * partialSize, static_cast< size_t >( FILE_RECORDS_MINIMUM_WINDOW_SIZE ) } ) );
+
+	if ( window.size() <= partialSize )
+	{
+		// Short of the end of the file, the view failed.
+		if ( static_cast< int64_t >( windowPosition + partialSize ) < mFile->size() )
+		{
+			mErrorCode = ( 0 != mFile->mErrorCode ) ? mFile->mErrorCode : EIO;
+		}
+		else
+		{
+			mEndOfFile = true;
+		}
+
+		return;
+	}
+
+	mWindow = std::move( window );
+	mWindowPosition = windowPosition;
+	mData = mWindow.data();
+	mRecordStart = 0;
+	mScanPosition = partialSize;
+	mBufferEnd = mWindow.size();
+
+	if ( 0 != mFile->seek( mWindowPosition + mBufferEnd ) )
+	{
+		mErrorCode = ( 0 != mFile->mErrorCode ) ? mFile->mErrorCode : EIO;
+	}
+}
+
+bool FileRecords::next()
+{
+	while ( true )
+	{
+		const uint8_t* delimiter = _find_byte( mData + mScanPosition, mData + mBufferEnd, mDelimiter );
+		size_t recordEnd = delimiter - mData;
+
+		if ( ( recordEnd < mBufferEnd ) or ( mEndOfFile and ( mRecordStart < mBufferEnd ) ) )
+		{
+			size_t recordLength = recordEnd - mRecordStart;
+
+			if ( mStripCarriageReturn and ( 0 < recordLength ) and ( '\r' == mData[ recordEnd - 1 ] ) )
+			{
+				--recordLength;
+			}
+
+			mRecord = std::string_view( reinterpret_cast< const char* >( mData + mRecordStart ), recordLength );
+			mRecordStart = mScanPosition = std::min( recordEnd + 1, mBufferEnd );
+			return true;
+		}
+
+		if ( mEndOfFile or ( 0 != mErrorCode ) )
+		{
+			mRecord = std::string_view();
+			mExhausted = true;
+			return false;
+		}
+
+		// The record continues past the bytes at hand.
+		if ( mViewable )
+		{
+			fillWindow();
+		}
+		else
+		{
+			fillBuffer();
+		}
+	}
+}
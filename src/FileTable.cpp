@@ -0,0 +1,470 @@
+/**
+ * Copyright ©2021. Brent Weichel. All Rights Reserved.
+ * Permission to use, copy, modify, and/or distribute this software, in whole
+ * or part by any means, without express prior written agreement is prohibited.
+ */
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <xxhash.h>
+
+#include "BloomFilter.hpp"
+#include "Checksum.hpp"
+#include "File.hpp"
+#include "FileTable.hpp"
+#include "FileView.hpp"
+
+#define FILE_TABLE_MAGIC ( "FTABLE1" )
+
+// Largest data block, and largest record, so that a block fits its 32 bit length.
+#define FILE_TABLE_MAX_BLOCK_SIZE  ( 1024 * 1024 * 1024 )
+#define FILE_TABLE_MAX_RECORD_SIZE ( 1024 * 1024 * 1024 )
+
+/*
+ * The last bytes of a table. The index is the first key, as a varint length followed
+ * by its bytes, then the offset and length of each data block, in order. The filter
+ * is the blocks of a blocked Bloom filter of the XXH3 of the keys; it's empty if the
+ * table was written without one.
+ */
+struct FileTableFooter
+{
+	int64_t mIndexOffset;
+	uint64_t mIndexLength;
+	int64_t mFilterOffset;
+	uint64_t mFilterLength;
+	uint64_t mRecordCount;
+	uint32_t mIndexChecksum;
+	uint32_t mFilterChecksum;
+	char mMagic[ 8 ];
+};
+
+/*
+ * Append an unsigned LEB128 varint to the buffer.
+ */
+static void __append_varint(
+	std::vector< uint8_t >& buffer,
+	uint64_t value )
+{
+	while ( 0x80 <= value )
+	{
+		buffer.push_back( static_cast< uint8_t >( value ) | 0x80 );
+		value >>= 7;
+	}
+
+	buffer.push_back( static_cast< uint8_t >( value ) );
+}
+
+/*
+ * Decode an unsigned LEB128 varint, advancing the cursor past it.
+ * @return False is returned if the varint runs past {@param end}, else true.
+ */
+static bool __read_varint(
+	const uint8_t*& cursor,
+	const uint8_t* end,
+	uint64_t& value )
+{
+	value = 0;
+
+	for ( uint32_t shift = 0; ( cursor < end ) and ( 64 > shift ); shift += 7 )
+	{
+		uint8_t byte = *cursor++;
+		value |= static_cast< uint64_t >( byte & 0x7F ) << shift;
+
+		if ( 0 == ( 0x80 & byte ) )
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/*
+ * Decode a length prefixed string, advancing the cursor past it.
+ * @return False is returned if the string runs past {@param end}, else true.
+ */
+static bool __read_string(
+	const uint8_t*& cursor,
+	const uint8_t* end,
+	std::string_view& string )
+{
+	uint64_t length;
+
+	if ( not __read_varint( cursor, end, length )
+		or ( static_cast< uint64_t >( end - cursor ) < length ) )
+	{
+		return false;
+	}
+
+	string = std::string_view( reinterpret_cast< const char* >( cursor ), length );
+	cursor += length;
+	return true;
+}
+
+FileTableWriter::FileTableWriter(
+	File& file,
+	size_t blockSize,
+	size_t filterBitsPerKey ) :
+	mFile( &file ),
+	mBlockSize( std::clamp< size_t >( blockSize, 1, FILE_TABLE_MAX_BLOCK_SIZE ) ),
+	mErrorCode( 0 ),
+	mRecordCount( 0 ),
+	mFinished( false ),
+	mFilterBitsPerKey( filterBitsPerKey )
+{
+}
+
+bool FileTableWriter::add(
+	std::string_view key,
+	std::string_view value )
+{
+	if ( mFinished )
+	{
+		mErrorCode = ( 0 != mErrorCode ) ? mErrorCode : EINVAL;
+		return false;
+	}
+
+	if ( ( 0 < mRecordCount ) and ( key <= mLastKey ) )
+	{
+		mErrorCode = EINVAL;
+		return false;
+	}
+
+	if ( FILE_TABLE_MAX_RECORD_SIZE < key.size() + value.size() )
+	{
+		mErrorCode = EFBIG;
+		return false;
+	}
+
+	if ( mBlock.empty() )
+	{
+		mBlockFirstKey = key;
+	}
+
+	__append_varint( mBlock, key.size() );
+	__append_varint( mBlock, value.size() );
+	mBlock.insert( mBlock.end(), key.begin(), key.end() );
+	mBlock.insert( mBlock.end(), value.begin(), value.end() );
+	mLastKey = key;
+	++mRecordCount;
+
+	if ( 0 < mFilterBitsPerKey )
+	{
+		mKeyHashes.push_back( XXH3_64bits( key.data(), key.size() ) );
+	}
+
+	return ( mBlockSize > mBlock.size() ) or writeBlock();
+}
+
+std::string FileTableWriter::errorMessage() const
+{
+	return ( 0 == mErrorCode ) ? std::string() : std::string( strerror( mErrorCode ) );
+}
+
+bool FileTableWriter::finish()
+{
+	if ( mFinished )
+	{
+		mErrorCode = ( 0 != mErrorCode ) ? mErrorCode : EINVAL;
+		return false;
+	}
+
+	if ( not writeBlock() )
+	{
+		return false;
+	}
+
+	mFinished = true;
+
+	std::vector< uint8_t > filter;
+
+	if ( not mKeyHashes.empty() )
+	{
+		size_t filterBlockCount = _bloom_filter_block_count( mKeyHashes.size(), mFilterBitsPerKey );
+		filter.resize( filterBlockCount * BLOOM_FILTER_BLOCK_SIZE );
+
+		for ( uint64_t keyHash : mKeyHashes )
+		{
+			_bloom_filter_add( filter.data(), filterBlockCount, keyHash );
+		}
+
+		mKeyHashes = std::vector< uint64_t >();
+	}
+
+	struct FileTableFooter footer = {};
+	footer.mIndexLength = mIndex.size();
+	footer.mFilterLength = filter.size();
+	footer.mRecordCount = mRecordCount;
+	footer.mIndexChecksum = _crc32c( 0, mIndex.data(), mIndex.size() );
+	footer.mFilterChecksum = _crc32c( 0, filter.data(), filter.size() );
+	memcpy( footer.mMagic, FILE_TABLE_MAGIC, sizeof( FILE_TABLE_MAGIC ) );
+
+	if ( not mIndex.empty()
+		and ( static_cast< int64_t >( mIndex.size() ) != mFile->append( mIndex.data(), mIndex.size(), footer.mIndexOffset ) ) )
+	{
+		mErrorCode = ( 0 != mFile->mErrorCode ) ? mFile->mErrorCode : EIO;
+		return false;
+	}
+
+	if ( not filter.empty()
+		and ( static_cast< int64_t >( filter.size() ) != mFile->append( filter.data(), filter.size(), footer.mFilterOffset ) ) )
+	{
+		mErrorCode = ( 0 != mFile->mErrorCode ) ? mFile->mErrorCode : EIO;
+		return false;
+	}
+
+	if ( sizeof( footer ) != mFile->append( reinterpret_cast< const uint8_t* >( &footer ), sizeof( footer ) ) )
+	{
+		mErrorCode = ( 0 != mFile->mErrorCode ) ? mFile->mErrorCode : EIO;
+		return false;
+	}
+
+	mIndex = std::vector< uint8_t >();
+	return true;
+}
+
+bool FileTableWriter::writeBlock()
+{
+	if ( mBlock.empty() )
+	{
+		return true;
+	}
+
+	uint32_t blockLength = mBlock.size();
+	uint32_t blockChecksum = _crc32c( 0, mBlock.data(), mBlock.size() );
+	int64_t blockOffset;
+
+	mBlock.insert( mBlock.end(), reinterpret_cast< const uint8_t* >( &blockChecksum ),
+		reinterpret_cast< const uint8_t* >( &blockChecksum ) + sizeof( blockChecksum ) );
+
+	// Nothing more can be added once a block is lost, as the table would be missing its records.
+	if ( static_cast< int64_t >( mBlock.size() ) != mFile->append( mBlock.data(), mBlock.size(), blockOffset ) )
+	{
+		mErrorCode = ( 0 != mFile->mErrorCode ) ? mFile->mErrorCode : EIO;
+		mFinished = true;
+		return false;
+	}
+
+	__append_varint( mIndex, mBlockFirstKey.size() );
+	mIndex.insert( mIndex.end(), mBlockFirstKey.begin(), mBlockFirstKey.end() );
+	mIndex.insert( mIndex.end(), reinterpret_cast< const uint8_t* >( &blockOffset ),
+		reinterpret_cast< const uint8_t* >( &blockOffset ) + sizeof( blockOffset ) );
+	mIndex.insert( mIndex.end(), reinterpret_cast< const uint8_t* >( &blockLength ),
+		reinterpret_cast< const uint8_t* >( &blockLength ) + sizeof( blockLength ) );
+	mBlock.clear();
+	return true;
+}
+
+FileTableReader::FileTableReader(
+	File& file ) :
+	mFile( &file ),
+	mErrorCode( 0 ),
+	mFilterBlockCount( 0 ),
+	mRecordCount( 0 ),
+	mLoaded( false )
+{
+	int64_t fileSize = mFile->size();
+	struct FileTableFooter footer;
+
+	if ( static_cast< int64_t >( sizeof( footer ) ) > fileSize )
+	{
+		mErrorCode = ( 0 > fileSize ) ? ESPIPE : EBADMSG;
+		return;
+	}
+
+	int64_t bytesRead = mFile->pread( reinterpret_cast< uint8_t* >( &footer ), sizeof( footer ), fileSize - sizeof( footer ) );
+
+	if ( sizeof( footer ) != bytesRead )
+	{
+		mErrorCode = ( ( 0 > bytesRead ) and ( 0 != mFile->mErrorCode ) ) ? mFile->mErrorCode : EBADMSG;
+		return;
+	}
+
+	if ( ( 0 != memcmp( footer.mMagic, FILE_TABLE_MAGIC, sizeof( FILE_TABLE_MAGIC ) ) )
+		or ( 0 != footer.mFilterLength % BLOOM_FILTER_BLOCK_SIZE ) )
+	{
+		mErrorCode = EBADMSG;
+		return;
+	}
+
+	if ( not readSection( footer.mIndexOffset, footer.mIndexLength, footer.mIndexChecksum, mIndex )
+		or not readSection( footer.mFilterOffset, footer.mFilterLength, footer.mFilterChecksum, mFilter ) )
+	{
+		mIndex = FileView();
+		return;
+	}
+
+	mFilterBlockCount = mFilter.size() / BLOOM_FILTER_BLOCK_SIZE;
+
+	const uint8_t* cursor = mIndex.begin();
+
+	while ( cursor < mIndex.end() )
+	{
+		struct BlockHandle block;
+
+		if ( not __read_string( cursor, mIndex.end(), block.mFirstKey )
+			or ( static_cast< size_t >( mIndex.end() - cursor ) < sizeof( block.mOffset ) + sizeof( block.mLength ) ) )
+		{
+			mErrorCode = EBADMSG;
+			mBlocks.clear();
+			mIndex = FileView();
+			mFilter = FileView();
+			mFilterBlockCount = 0;
+			return;
+		}
+
+		memcpy( &block.mOffset, cursor, sizeof( block.mOffset ) );
+		memcpy( &block.mLength, cursor + sizeof( block.mOffset ), sizeof( block.mLength ) );
+		cursor += sizeof( block.mOffset ) + sizeof( block.mLength );
+		mBlocks.push_back( block );
+	}
+
+	mRecordCount = footer.mRecordCount;
+	mLoaded = true;
+}
+
+std::string FileTableReader::errorMessage() const
+{
+	return ( 0 == mErrorCode ) ? std::string() : std::string( strerror( mErrorCode ) );
+}
+
+bool FileTableReader::get(
+	std::string_view key,
+	std::string& value )
+{
+	// Failing to read the table is reported by every lookup.
+	if ( not mLoaded )
+	{
+		return false;
+	}
+
+	mErrorCode = 0;
+
+	if ( not mayContain( key ) )
+	{
+		return false;
+	}
+
+	// The block that can hold the key is the last to begin at or before it.
+	auto block = std::upper_bound( mBlocks.begin(), mBlocks.end(), key,
+		[]( std::string_view key, const struct BlockHandle& block )
+		{
+			return key < block.mFirstKey;
+		} );
+
+	if ( mBlocks.begin() == block )
+	{
+		return false;
+	}
+
+	--block;
+
+	uint32_t blockChecksum;
+	mBlock.resize( block->mLength + sizeof( blockChecksum ) );
+	int64_t bytesRead = mFile->pread( mBlock.data(), mBlock.size(), block->mOffset );
+
+	if ( static_cast< int64_t >( mBlock.size() ) != bytesRead )
+	{
+		mErrorCode = ( ( 0 > bytesRead ) and ( 0 != mFile->mErrorCode ) ) ? mFile->mErrorCode : EBADMSG;
+		return false;
+	}
+
+	memcpy( &blockChecksum, mBlock.data() + block->mLength, sizeof( blockChecksum ) );
+
+	if ( blockChecksum != _crc32c( 0, mBlock.data(), block->mLength ) )
+	{
+		mErrorCode = EBADMSG;
+		return false;
+	}
+
+	const uint8_t* cursor = mBlock.data();
+	const uint8_t* blockEnd = mBlock.data() + block->mLength;
+
+	while ( cursor < blockEnd )
+	{
+		uint64_t keyLength, valueLength;
+
+		if ( not __read_varint( cursor, blockEnd, keyLength )
+			or not __read_varint( cursor, blockEnd, valueLength )
+			or ( static_cast< uint64_t >( blockEnd - cursor ) < keyLength )
+			or ( static_cast< uint64_t >( blockEnd - cursor ) - keyLength < valueLength ) )
+		{
+			mErrorCode = EBADMSG;
+			return false;
+		}
+
+		std::string_view recordKey( reinterpret_cast< const char* >( cursor ), keyLength );
+
+		// The records of a block are sorted, so the key isn't in it once passed.
+		if ( recordKey >= key )
+		{
+			if ( recordKey == key )
+			{
+				value.assign( reinterpret_cast< const char* >( cursor + keyLength ), valueLength );
+				return true;
+			}
+
+			break;
+		}
+
+		cursor += keyLength + valueLength;
+	}
+
+	return false;
+}
+
+bool FileTableReader::mayContain(
+	std::string_view key ) const
+{
+	return ( 0 == mFilterBlockCount )
+		or _bloom_filter_may_contain( mFilter.data(), mFilterBlockCount, XXH3_64bits( key.data(), key.size() ) );
+}
+
+bool FileTableReader::readSection(
+	int64_t offset,
+	uint64_t length,
+	uint32_t checksum,
+	FileView& section )
+{
+	if ( 0 == length )
+	{
+		return true;
+	}
+
+	// Sections lie between the data blocks and the footer.
+	int64_t sectionsEnd = mFile->size() - sizeof( struct FileTableFooter );
+
+	if ( ( 0 > offset ) or ( static_cast< uint64_t >( sectionsEnd ) < length )
+		or ( static_cast< int64_t >( sectionsEnd - length ) < offset ) )
+	{
+		mErrorCode = EBADMSG;
+		return false;
+	}
+
+	section = mFile->view( offset, length );
+
+	if ( length != section.size() )
+	{
+		mErrorCode = ( section.empty() and ( 0 != mFile->mErrorCode ) ) ? mFile->mErrorCode : EBADMSG;
+		section = FileView();
+		return false;
+	}
+
+	if ( checksum != _crc32c( 0, section.data(), section.size() ) )
+	{
+		mErrorCode = EBADMSG;
+		section = FileView();
+		return false;
+	}
+
+	return true;
+}
+
+uint64_t FileTableReader::size() const
+{
+	return mRecordCount;
+}
@@ -0,0 +1,322 @@
+/**
+ * Copyright ©2021. Brent Weichel. All Rights Reserved.
+ * Permission to use, copy, modify, and/or distribute this software, in whole
+ * or part by any means, without express prior written agreement is prohibited.
+ */
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "File.hpp"
+#include "FileContext.hpp"
+#include "IOScheduler.hpp"
+#include "Util.hpp"
+
+#define IO_PRIORITY_COUNT ( 3 )
+
+// Operations of a class are admitted once they have waited this long, whatever
+// is in flight above them, so that no class starves. Foreground never waits.
+#define IO_SCHEDULER_NORMAL_DEADLINE_MICROSECONDS     ( 50 * 1000 )
+#define IO_SCHEDULER_BACKGROUND_DEADLINE_MICROSECONDS ( 1000 * 1000 )
+
+// While a higher class is busy, a class keeps no more than this many operations in flight.
+#define IO_SCHEDULER_YIELD_DEPTH ( 1 )
+
+// A higher class remains busy for this long after its last operation ends, as
+// another often follows; yielding only while operations are in flight would let
+// the lower classes fill the device in the gap between them.
+#define IO_SCHEDULER_ANTICIPATION_MICROSECONDS ( 2000 )
+
+static const std::map< std::string, File::IOPriority > SUPPORTED_IO_PRIORITY_MAP {
+	{ "foreground", File::IOPriority::FOREGROUND },
+	{ "normal", File::IOPriority::NORMAL },
+	{ "background", File::IOPriority::BACKGROUND }
+};
+
+/*
+ * A token bucket limiting the bandwidth of a tag. Operations larger than the
+ * tokens available run the bucket into debt, which later operations wait out.
+ */
+struct IOTokenBucket
+{
+	double mRate; // Bytes per second, zero if unlimited
+	double mBurst;
+	double mTokens;
+	std::chrono::steady_clock::time_point mRefilled;
+};
+
+// An operation waiting to be admitted. It lives on the stack of the waiting thread.
+struct IOWaiter
+{
+	File::IOPriority mPriority;
+	std::chrono::steady_clock::time_point mDeadline;
+};
+
+static std::mutex _G_IOSchedulerMutex;
+static std::condition_variable _G_IOSchedulerChanged;
+static std::vector< struct IOWaiter* > _G_IOWaiters;
+static std::atomic_int64_t _G_IOWaiterCount( 0 );
+static std::atomic_int64_t _G_IOInFlight[ IO_PRIORITY_COUNT ];
+static std::atomic_int64_t _G_IOLastEnded[ IO_PRIORITY_COUNT ]; // Steady clock ticks
+
+// Tags are identified by their index into the buckets, which never move.
+static std::unordered_map< std::string, uint32_t > _G_IOTagIdentifiers;
+static std::deque< struct IOTokenBucket > _G_IOTokenBuckets;
+static std::atomic_bool _G_IOBandwidthLimited( false );
+
+static uint32_t __get_io_tag(
+	const std::string& tag )
+{
+	auto tagIterator = _G_IOTagIdentifiers.find( tag );
+
+	if ( _G_IOTagIdentifiers.end() != tagIterator )
+	{
+		return tagIterator->second;
+	}
+
+	uint32_t tagIdentifier = _G_IOTokenBuckets.size();
+	_G_IOTokenBuckets.push_back( { 0, 0, 0, std::chrono::steady_clock::now() } );
+	_G_IOTagIdentifiers.emplace( tag, tagIdentifier );
+	return tagIdentifier;
+}
+
+/*
+ * Take tokens for the operation from the bucket of its tag.
+ * @return The time it takes to pay off the debt the bucket is left in, which is waited out first.
+ */
+static std::chrono::duration< double > __take_io_tokens(
+	uint32_t tag,
+	int64_t bytes )
+{
+	std::lock_guard schedulerLock( _G_IOSchedulerMutex );
+
+	if ( tag >= _G_IOTokenBuckets.size() )
+	{
+		return std::chrono::duration< double >( 0 );
+	}
+
+	struct IOTokenBucket& bucket = _G_IOTokenBuckets[ tag ];
+
+	if ( 0 >= bucket.mRate )
+	{
+		return std::chrono::duration< double >( 0 );
+	}
+
+	auto now = std::chrono::steady_clock::now();
+	bucket.mTokens = std::min( bucket.mBurst,
+		bucket.mTokens + bucket.mRate * std::chrono::duration< double >( now - bucket.mRefilled ).count() );
+	bucket.mRefilled = now;
+	bucket.mTokens -= bytes;
+
+	return std::chrono::duration< double >( ( 0 > bucket.mTokens ) ? ( -bucket.mTokens / bucket.mRate ) : 0 );
+}
+
+/*
+ * Get the time until which a class is held back by the classes above it, which
+ * is {@param now} if it isn't, and the maximum time point while they're in flight.
+ */
+static std::chrono::steady_clock::time_point __held_until(
+	File::IOPriority priority,
+	std::chrono::steady_clock::time_point now )
+{
+	if ( IO_SCHEDULER_YIELD_DEPTH > _G_IOInFlight[ priority ].load() )
+	{
+		return now;
+	}
+
+	std::chrono::steady_clock::time_point heldUntil = now;
+
+	for ( int higherPriority = 0; higherPriority < priority; ++higherPriority )
+	{
+		if ( 0 < _G_IOInFlight[ higherPriority ].load() )
+		{
+			return std::chrono::steady_clock::time_point::max();
+		}
+
+		heldUntil = std::max( heldUntil, std::chrono::steady_clock::time_point(
+			std::chrono::steady_clock::duration( _G_IOLastEnded[ higherPriority ].load() ) )
+			+ std::chrono::microseconds( IO_SCHEDULER_ANTICIPATION_MICROSECONDS ) );
+	}
+
+	return heldUntil;
+}
+
+bool _select_io_schedule(
+	std::string& uri,
+	const std::string& scheme,
+	File::IOPriority& priority,
+	uint32_t& tag )
+{
+	std::string priorityName, tagName( scheme );
+	priority = File::IOPriority::NORMAL;
+
+	if ( _extract_uri_parameter( uri, "priority", priorityName ) )
+	{
+		auto priorityIterator = SUPPORTED_IO_PRIORITY_MAP.find( priorityName );
+
+		if ( SUPPORTED_IO_PRIORITY_MAP.end() == priorityIterator )
+		{
+			return false;
+		}
+
+		priority = priorityIterator->second;
+	}
+
+	_extract_uri_parameter( uri, "iotag", tagName );
+	tag = _get_io_tag( tagName );
+	return true;
+}
+
+uint32_t _get_io_tag(
+	const std::string& tag )
+{
+	std::lock_guard schedulerLock( _G_IOSchedulerMutex );
+	return __get_io_tag( tag );
+}
+
+void _set_bandwidth_limit(
+	const std::string& tag,
+	double bytesPerSecond,
+	double burstBytes )
+{
+	std::lock_guard schedulerLock( _G_IOSchedulerMutex );
+	struct IOTokenBucket& bucket = _G_IOTokenBuckets[ __get_io_tag( tag ) ];
+
+	bucket.mRate = std::max( bytesPerSecond, 0.0 );
+	bucket.mBurst = ( 0 < burstBytes ) ? burstBytes : bucket.mRate;
+	bucket.mTokens = bucket.mBurst;
+	bucket.mRefilled = std::chrono::steady_clock::now();
+
+	_G_IOBandwidthLimited = std::any_of( _G_IOTokenBuckets.begin(), _G_IOTokenBuckets.end(),
+		[]( const struct IOTokenBucket& other )
+		{
+			return 0 < other.mRate;
+		} );
+}
+
+/*
+ * Wait until {@param waiter} is the earliest of its class, and either its
+ * deadline has passed or the classes above it no longer hold it back.
+ */
+static void __wait_for_admission(
+	struct IOWaiter& waiter )
+{
+	std::unique_lock< std::mutex > schedulerLock( _G_IOSchedulerMutex );
+	_G_IOWaiters.push_back( &waiter );
+	++_G_IOWaiterCount;
+
+	while ( true )
+	{
+		auto now = std::chrono::steady_clock::now();
+		auto heldUntil = __held_until( waiter.mPriority, now );
+
+		// Within a class, the operation with the earliest deadline goes first.
+		bool earliest = std::none_of( _G_IOWaiters.begin(), _G_IOWaiters.end(),
+			[ &waiter ]( const struct IOWaiter* other )
+			{
+				return ( waiter.mPriority == other->mPriority ) and ( waiter.mDeadline > other->mDeadline );
+			} );
+
+		if ( earliest and ( ( now >= waiter.mDeadline ) or ( now >= heldUntil ) ) )
+		{
+			break;
+		}
+
+		_G_IOSchedulerChanged.wait_until( schedulerLock, earliest ? std::min( waiter.mDeadline, heldUntil ) : waiter.mDeadline );
+	}
+
+	_G_IOWaiters.erase( std::find( _G_IOWaiters.begin(), _G_IOWaiters.end(), &waiter ) );
+	--_G_IOWaiterCount;
+	++_G_IOInFlight[ waiter.mPriority ];
+
+	// The next operation of the class may now be the earliest.
+	_G_IOSchedulerChanged.notify_all();
+}
+
+File::IOPriority _begin_io(
+	struct FileContext* context,
+	std::unique_lock< std::mutex >& contextLock,
+	uint32_t ioStat,
+	int64_t bytes )
+{
+	File::IOPriority priority = context->_M_IOPriority;
+	std::chrono::duration< double > delay( 0 );
+
+	if ( _G_IOBandwidthLimited.load() and ( 0 < bytes ) )
+	{
+		delay = __take_io_tokens( context->_M_IOTag, bytes );
+	}
+
+	auto now = std::chrono::steady_clock::now();
+	bool admitted = ( File::IOPriority::FOREGROUND == priority )
+		or ( ( 0 == _G_IOWaiterCount.load() ) and ( now >= __held_until( priority, now ) ) );
+
+	// Without a debt to wait out, or anything waiting or in flight above it, an operation is admitted straight away.
+	if ( ( 0 >= delay.count() ) and admitted )
+	{
+		++_G_IOInFlight[ priority ];
+		return priority;
+	}
+
+	// An operation must start before its deadline, less the time it's expected
+	// to take at the rate the file has been read or written at so far.
+	struct IOWaiter waiter = { priority, now + std::chrono::microseconds(
+		( File::IOPriority::NORMAL == priority )
+			? IO_SCHEDULER_NORMAL_DEADLINE_MICROSECONDS
+			: IO_SCHEDULER_BACKGROUND_DEADLINE_MICROSECONDS ) };
+
+	if ( 0 < context->_M_NumberObservations[ ioStat ] )
+	{
+		waiter.mDeadline -= std::chrono::microseconds( static_cast< int64_t >( MICROSECONDS_IN_SECOND * bytes
+			* context->_M_SumInverseRates[ ioStat ] / context->_M_NumberObservations[ ioStat ] ) );
+	}
+
+	// Waiting with the context locked would hold up every other operation on the
+	// file, foreground ones included, so the lock is released for the wait.
+	bool locked = contextLock.owns_lock();
+
+	if ( locked )
+	{
+		contextLock.unlock();
+	}
+
+	std::this_thread::sleep_for( delay );
+
+	if ( File::IOPriority::FOREGROUND == priority )
+	{
+		++_G_IOInFlight[ priority ];
+	}
+	else
+	{
+		__wait_for_admission( waiter );
+	}
+
+	if ( locked )
+	{
+		contextLock.lock();
+	}
+
+	return priority;
+}
+
+void _end_io(
+	File::IOPriority priority )
+{
+	_G_IOLastEnded[ priority ] = std::chrono::steady_clock::now().time_since_epoch().count();
+	--_G_IOInFlight[ priority ];
+
+	if ( 0 < _G_IOWaiterCount.load() )
+	{
+		std::lock_guard schedulerLock( _G_IOSchedulerMutex );
+		_G_IOSchedulerChanged.notify_all();
+	}
+}
@@ -0,0 +1,73 @@
+/**
+ * Copyright ©2021. Brent Weichel. All Rights Reserved.
+ * Permission to use, copy, modify, and/or distribute this software, in whole
+ * or part by any means, without express prior written agreement is prohibited.
+ */
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+#include "File.hpp"
+#include "FileContext.hpp"
+
+/*
+ * Remove the "priority" and "iotag" query parameters from the URI, which select the
+ * priority class of the file, e.g. "?priority=background", and the tag its bandwidth
+ * is accounted against, e.g. "?iotag=compaction". The tag defaults to the scheme.
+ * @param uri The URI to remove the parameters from.
+ * @param scheme The scheme of the URI.
+ * @param priority Reference to store the priority class, NORMAL if not given.
+ * @param tag Reference to store the identifier of the tag.
+ * @return True is returned on success, false if the priority class is not recognized.
+ */
+bool _select_io_schedule(
+	std::string& uri,
+	const std::string& scheme,
+	File::IOPriority& priority,
+	uint32_t& tag );
+
+/*
+ * Get the identifier of a tag, for many files to share a bandwidth limit.
+ * @param tag The name of the tag.
+ * @return The identifier of the tag is returned.
+ */
+uint32_t _get_io_tag(
+	const std::string& tag );
+
+/*
+ * Limit the bandwidth of the files with a tag, with a token bucket.
+ * @param tag The name of the tag, or of a scheme.
+ * @param bytesPerSecond The rate at which the bucket fills. Zero removes the limit.
+ * @param burstBytes The capacity of the bucket. Zero selects a second at the full rate.
+ */
+void _set_bandwidth_limit(
+	const std::string& tag,
+	double bytesPerSecond,
+	double burstBytes );
+
+/*
+ * Wait for the scheduler to admit an operation on the file, which must then be ended
+ * with _end_io(). Foreground operations are only held back by bandwidth limits.
+ * Called with the context lock held, or from the thread the file is pinned to. Should
+ * the operation have to wait, the lock is released for the wait and then retaken, so
+ * the context is to be read for the operation only once this returns.
+ * @param context Pointer to the context of the file.
+ * @param contextLock Reference to the lock held on the context, if any.
+ * @param ioStat FILE_IO_STATS_READ or FILE_IO_STATS_WRITE, whose rate estimates how long the operation takes.
+ * @param bytes The number of bytes to be read or written.
+ * @return The priority class the operation was admitted in is returned.
+ */
+File::IOPriority _begin_io(
+	struct FileContext* context,
+	std::unique_lock< std::mutex >& contextLock,
+	uint32_t ioStat,
+	int64_t bytes );
+
+/*
+ * End an operation admitted by _begin_io(), letting the operations it held back proceed.
+ * @param priority The priority class returned by _begin_io().
+ */
+void _end_io(
+	File::IOPriority priority );
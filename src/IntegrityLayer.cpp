@@ -0,0 +1,782 @@
+/**
+ * Copyright ©2021. Brent Weichel. All Rights Reserved.
+ * Permission to use, copy, modify, and/or distribute this software, in whole
+ * or part by any means, without express prior written agreement is prohibited.
+ */
+#include <algorithm>
+#include <cerrno>
+#include <cinttypes>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include <vector>
+#include <xxhash.h>
+
+#include "Checksum.hpp"
+#include "File.hpp"
+#include "FileContext.hpp"
+#include "IntegrityLayer.hpp"
+#include "Util.hpp"
+
+#define INTEGRITY_SIDECAR_MAGIC       ( "FCRC32C" )
+#define INTEGRITY_SIDECAR_HEADER_SIZE ( 16 )
+
+enum IntegrityDigest
+{
+	INTEGRITY_DIGEST_NONE,
+	INTEGRITY_DIGEST_CRC32C,
+	INTEGRITY_DIGEST_XXH3
+};
+
+struct IntegrityContext
+{
+	struct FileContext* mInnerContext;
+
+	// The digest covers the bytes [ 0, mDigestPosition ) of the file.
+	// Overwriting any of those bytes invalidates the digest.
+	enum IntegrityDigest mAlgorithm;
+	uint32_t mCRC32C;
+	XXH3_state_t* mXXH3State;
+	int64_t mDigestPosition;
+	bool mDigestValid;
+
+	// CRC32C of each mBlockSize bytes of the file, the last block possibly short.
+	// Blocks [ mDirtyBegin, mDirtyEnd ) are yet to be written to the sidecar.
+	struct FileContext* mSidecarContext;
+	uint32_t mBlockSize;
+	std::vector< uint32_t > mBlockChecksums;
+	size_t mDirtyBegin;
+	size_t mDirtyEnd;
+	bool mSidecarTruncated;
+
+	int mErrorCode;
+};
+
+static void __free_integrity_context(
+	struct IntegrityContext* integrityContext )
+{
+	if ( nullptr != integrityContext->mSidecarContext )
+	{
+		integrityContext->mSidecarContext->_F_close( integrityContext->mSidecarContext );
+		_free_context( integrityContext->mSidecarContext );
+	}
+
+	if ( nullptr != integrityContext->mXXH3State )
+	{
+		XXH3_freeState( integrityContext->mXXH3State );
+	}
+
+	delete integrityContext;
+}
+
+/*
+ * Read {@param bytes} from the inner context at {@param offset}
+ * without disturbing the inner context's file position.
+ */
+static int64_t __integrity_read_at(
+	struct FileContext* innerContext,
+	int64_t offset,
+	uint8_t* buffer,
+	size_t bytes )
+{
+	int64_t position = innerContext->_M_FilePosition;
+
+	if ( -1 == innerContext->_F_seek( innerContext, offset, false ) )
+	{
+		return -1;
+	}
+
+	int64_t bytesRead = innerContext->_F_read( innerContext, buffer, bytes, false );
+	innerContext->_F_seek( innerContext, position, false );
+	return bytesRead;
+}
+
+/*
+ * Compute the CRC32C of block {@param blockIndex} as it currently is in the inner context.
+ */
+static bool __integrity_checksum_block(
+	struct IntegrityContext* integrityContext,
+	size_t blockIndex,
+	uint32_t& checksum )
+{
+	struct FileContext* innerContext = integrityContext->mInnerContext;
+	int64_t blockStart = static_cast< int64_t >( blockIndex ) * integrityContext->mBlockSize;
+	int64_t blockLength = std::min< int64_t >( integrityContext->mBlockSize, innerContext->_M_FileSize - blockStart );
+	std::vector< uint8_t > blockBuffer( std::max< int64_t >( 0, blockLength ) );
+
+	if ( blockLength != __integrity_read_at( innerContext, blockStart, blockBuffer.data(), blockBuffer.size() ) )
+	{
+		integrityContext->mErrorCode = EIO;
+		return false;
+	}
+
+	checksum = _crc32c( 0, blockBuffer.data(), blockBuffer.size() );
+	return true;
+}
+
+static void __integrity_mark_dirty(
+	struct IntegrityContext* integrityContext,
+	size_t blockBegin,
+	size_t blockEnd )
+{
+	if ( integrityContext->mDirtyBegin == integrityContext->mDirtyEnd )
+	{
+		integrityContext->mDirtyBegin = blockBegin;
+		integrityContext->mDirtyEnd = blockEnd;
+		return;
+	}
+
+	integrityContext->mDirtyBegin = std::min( integrityContext->mDirtyBegin, blockBegin );
+	integrityContext->mDirtyEnd = std::max( integrityContext->mDirtyEnd, blockEnd );
+}
+
+/*
+ * Update the block checksums after {@param bytes} of {@param buffer} were written at
+ * {@param offset}. Blocks covered by the write are summed straight from the buffer, and
+ * a write continuing the last block extends its CRC; only a block partially overwritten
+ * in the middle of the file has to be read back.
+ * @param previousSize The size of the file before the write.
+ */
+static bool __integrity_update_blocks(
+	struct IntegrityContext* integrityContext,
+	int64_t offset,
+	const uint8_t* buffer,
+	int64_t bytes,
+	int64_t previousSize )
+{
+	if ( ( nullptr == integrityContext->mSidecarContext ) or ( 0 >= bytes ) )
+	{
+		return true;
+	}
+
+	int64_t fileSize = integrityContext->mInnerContext->_M_FileSize;
+	int64_t blockSize = integrityContext->mBlockSize;
+	size_t previousBlockCount = integrityContext->mBlockChecksums.size();
+	size_t blockBegin = offset / blockSize;
+	size_t blockEnd = ( offset + bytes - 1 ) / blockSize + 1;
+
+	integrityContext->mBlockChecksums.resize( ( fileSize + blockSize - 1 ) / blockSize, 0 );
+
+	for ( size_t blockIndex = blockBegin; blockIndex < blockEnd; ++blockIndex )
+	{
+		int64_t blockStart = blockIndex * blockSize;
+		int64_t blockFinish = std::min( blockStart + blockSize, fileSize );
+		int64_t sliceStart = std::max( blockStart, offset );
+		int64_t sliceFinish = std::min( blockFinish, offset + bytes );
+		uint32_t& checksum = integrityContext->mBlockChecksums[ blockIndex ];
+
+		if ( ( sliceStart == blockStart ) and ( sliceFinish == blockFinish ) )
+		{
+			checksum = _crc32c( 0, buffer + ( sliceStart - offset ), sliceFinish - sliceStart );
+		}
+		else if ( ( sliceStart == previousSize )
+			and ( sliceFinish == blockFinish )
+			and ( blockIndex + 1 == previousBlockCount ) )
+		{
+			checksum = _crc32c( checksum, buffer + ( sliceStart - offset ), sliceFinish - sliceStart );
+		}
+		else if ( not __integrity_checksum_block( integrityContext, blockIndex, checksum ) )
+		{
+			return false;
+		}
+	}
+
+	__integrity_mark_dirty( integrityContext, blockBegin, blockEnd );
+	return true;
+}
+
+/*
+ * Verify the blocks touched by {@param bytes} of {@param buffer} read from {@param offset}.
+ * Blocks entirely within the buffer are checked from it, and at most the first
+ * and last block need to be read back in full.
+ */
+static bool __integrity_verify_blocks(
+	struct IntegrityContext* integrityContext,
+	int64_t offset,
+	const uint8_t* buffer,
+	int64_t bytes )
+{
+	if ( ( nullptr == integrityContext->mSidecarContext ) or ( 0 >= bytes ) )
+	{
+		return true;
+	}
+
+	int64_t fileSize = integrityContext->mInnerContext->_M_FileSize;
+	int64_t blockSize = integrityContext->mBlockSize;
+	size_t blockBegin = offset / blockSize;
+	size_t blockEnd = std::min< size_t >( ( offset + bytes - 1 ) / blockSize + 1, integrityContext->mBlockChecksums.size() );
+
+	for ( size_t blockIndex = blockBegin; blockIndex < blockEnd; ++blockIndex )
+	{
+		int64_t blockStart = blockIndex * blockSize;
+		int64_t blockFinish = std::min( blockStart + blockSize, fileSize );
+		uint32_t checksum;
+
+		if ( ( blockStart >= offset ) and ( blockFinish <= offset + bytes ) )
+		{
+			checksum = _crc32c( 0, buffer + ( blockStart - offset ), blockFinish - blockStart );
+		}
+		else if ( not __integrity_checksum_block( integrityContext, blockIndex, checksum ) )
+		{
+			return false;
+		}
+
+		if ( checksum != integrityContext->mBlockChecksums[ blockIndex ] )
+		{
+			integrityContext->mErrorCode = EBADMSG;
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/*
+ * Fold the part of [ offset, offset + bytes ) that extends the digested prefix into the digest.
+ */
+static void __integrity_update_digest(
+	struct IntegrityContext* integrityContext,
+	int64_t offset,
+	const uint8_t* buffer,
+	int64_t bytes )
+{
+	if ( ( INTEGRITY_DIGEST_NONE == integrityContext->mAlgorithm )
+		or ( offset > integrityContext->mDigestPosition )
+		or ( offset + bytes <= integrityContext->mDigestPosition ) )
+	{
+		return;
+	}
+
+	const uint8_t* extension = buffer + ( integrityContext->mDigestPosition - offset );
+	size_t extensionLength = offset + bytes - integrityContext->mDigestPosition;
+
+	if ( INTEGRITY_DIGEST_CRC32C == integrityContext->mAlgorithm )
+	{
+		integrityContext->mCRC32C = _crc32c( integrityContext->mCRC32C, extension, extensionLength );
+	}
+	else
+	{
+		XXH3_64bits_update( integrityContext->mXXH3State, extension, extensionLength );
+	}
+
+	integrityContext->mDigestPosition += extensionLength;
+}
+
+/*
+ * Write the dirty block checksums out to the sidecar.
+ */
+static bool __integrity_flush_sidecar(
+	struct IntegrityContext* integrityContext )
+{
+	struct FileContext* sidecarContext = integrityContext->mSidecarContext;
+
+	if ( nullptr == sidecarContext )
+	{
+		return true;
+	}
+
+	if ( integrityContext->mSidecarTruncated )
+	{
+		int64_t sidecarSize = INTEGRITY_SIDECAR_HEADER_SIZE
+			+ integrityContext->mBlockChecksums.size() * sizeof( uint32_t );
+
+		if ( sidecarSize != sidecarContext->_F_resize( sidecarContext, sidecarSize, '\0', true, false ) )
+		{
+			return false;
+		}
+
+		integrityContext->mSidecarTruncated = false;
+	}
+
+	if ( integrityContext->mDirtyBegin == integrityContext->mDirtyEnd )
+	{
+		return true;
+	}
+
+	if ( 0 == sidecarContext->_M_FileSize )
+	{
+		uint8_t header[ INTEGRITY_SIDECAR_HEADER_SIZE ] = { 0 };
+		memcpy( header, INTEGRITY_SIDECAR_MAGIC, sizeof( INTEGRITY_SIDECAR_MAGIC ) );
+		memcpy( header + 8, &integrityContext->mBlockSize, sizeof( uint32_t ) );
+
+		if ( sizeof( header ) != sidecarContext->_F_write( sidecarContext, header, sizeof( header ), true ) )
+		{
+			return false;
+		}
+	}
+
+	size_t dirtyEnd = std::min( integrityContext->mDirtyEnd, integrityContext->mBlockChecksums.size() );
+	int64_t dirtyOffset = INTEGRITY_SIDECAR_HEADER_SIZE + integrityContext->mDirtyBegin * sizeof( uint32_t );
+	size_t dirtyLength = ( dirtyEnd - integrityContext->mDirtyBegin ) * sizeof( uint32_t );
+
+	if ( ( -1 == sidecarContext->_F_seek( sidecarContext, dirtyOffset, false ) )
+		or ( static_cast< int64_t >( dirtyLength ) != sidecarContext->_F_write( sidecarContext,
+			reinterpret_cast< const uint8_t* >( integrityContext->mBlockChecksums.data() + integrityContext->mDirtyBegin ),
+			dirtyLength, false ) ) )
+	{
+		return false;
+	}
+
+	integrityContext->mDirtyBegin = integrityContext->mDirtyEnd = 0;
+	return sidecarContext->_F_sync( sidecarContext );
+}
+
+/*
+ * Load the block checksums from the sidecar, adopting its block size if it has one.
+ */
+static bool __integrity_load_sidecar(
+	struct IntegrityContext* integrityContext )
+{
+	struct FileContext* sidecarContext = integrityContext->mSidecarContext;
+	uint8_t header[ INTEGRITY_SIDECAR_HEADER_SIZE ];
+
+	if ( 0 == sidecarContext->_M_FileSize )
+	{
+		return true;
+	}
+
+	if ( ( sizeof( header ) != __integrity_read_at( sidecarContext, 0, header, sizeof( header ) ) )
+		or ( 0 != memcmp( header, INTEGRITY_SIDECAR_MAGIC, sizeof( INTEGRITY_SIDECAR_MAGIC ) ) ) )
+	{
+		return false;
+	}
+
+	memcpy( &integrityContext->mBlockSize, header + 8, sizeof( uint32_t ) );
+	integrityContext->mBlockChecksums.resize(
+		( sidecarContext->_M_FileSize - INTEGRITY_SIDECAR_HEADER_SIZE ) / sizeof( uint32_t ) );
+
+	uint32_t checksumsLength = integrityContext->mBlockChecksums.size() * sizeof( uint32_t );
+	return ( 0 != integrityContext->mBlockSize )
+		and ( checksumsLength == __integrity_read_at( sidecarContext, INTEGRITY_SIDECAR_HEADER_SIZE,
+			reinterpret_cast< uint8_t* >( integrityContext->mBlockChecksums.data() ), checksumsLength ) );
+}
+
+static std::string __integrity_digest(
+	struct FileContext* context )
+{
+	if ( ( nullptr == context )
+		or ( nullptr == context->_M_SchemeContext ) )
+	{
+		return std::string();
+	}
+
+	struct IntegrityContext* integrityContext = static_cast< struct IntegrityContext* >( context->_M_SchemeContext );
+	char digestString[ 17 ];
+
+	if ( ( INTEGRITY_DIGEST_NONE == integrityContext->mAlgorithm )
+		or not integrityContext->mDigestValid )
+	{
+		integrityContext->mErrorCode = ENODATA;
+		return std::string();
+	}
+
+	if ( INTEGRITY_DIGEST_CRC32C == integrityContext->mAlgorithm )
+	{
+		snprintf( digestString, sizeof( digestString ), "%08" PRIx32, integrityContext->mCRC32C );
+	}
+	else
+	{
+		snprintf( digestString, sizeof( digestString ), "%016" PRIx64,
+			static_cast< uint64_t >( XXH3_64bits_digest( integrityContext->mXXH3State ) ) );
+	}
+
+	return std::string( digestString );
+}
+
+static std::string __integrity_error_string(
+	struct FileContext* context )
+{
+	if ( nullptr == context )
+	{
+		return std::string( strerror( EBADF ) );
+	}
+
+	if ( nullptr == context->_M_SchemeContext )
+	{
+		return std::string( strerror( EIDRM ) );
+	}
+
+	struct IntegrityContext* integrityContext = static_cast< struct IntegrityContext* >( context->_M_SchemeContext );
+
+	if ( 0 != integrityContext->mErrorCode )
+	{
+		return std::string( strerror( integrityContext->mErrorCode ) );
+	}
+
+	return integrityContext->mInnerContext->_F_error_string( integrityContext->mInnerContext );
+}
+
+static void __integrity_close(
+	struct FileContext* context )
+{
+	if ( ( nullptr == context )
+		or ( nullptr == context->_M_SchemeContext ) )
+	{
+		return;
+	}
+
+	struct IntegrityContext* integrityContext = static_cast< struct IntegrityContext* >( context->_M_SchemeContext );
+	struct FileContext* innerContext = integrityContext->mInnerContext;
+
+	__integrity_flush_sidecar( integrityContext );
+	innerContext->_F_close( innerContext );
+	_free_context( innerContext );
+	__free_integrity_context( integrityContext );
+	context->_M_SchemeContext = nullptr;
+}
+
+static int64_t __integrity_seek(
+	struct FileContext* context,
+	int64_t offset,
+	bool relative )
+{
+	if ( nullptr == context )
+	{
+		return -1;
+	}
+
+	if ( nullptr == context->_M_SchemeContext )
+	{
+		context->_M_ErrorCode = EIDRM;
+		return -1;
+	}
+
+	struct IntegrityContext* integrityContext = static_cast< struct IntegrityContext* >( context->_M_SchemeContext );
+	struct FileContext* innerContext = integrityContext->mInnerContext;
+
+	int64_t difference = innerContext->_F_seek( innerContext, offset, relative );
+	context->_M_FilePosition = innerContext->_M_FilePosition;
+	context->_M_FileSize = innerContext->_M_FileSize;
+	return difference;
+}
+
+static int64_t __integrity_read(
+	struct FileContext* context,
+	uint8_t* buffer,
+	size_t bytes,
+	bool updatePosition )
+{
+	if ( nullptr == context )
+	{
+		return -1;
+	}
+
+	if ( nullptr == context->_M_SchemeContext )
+	{
+		context->_M_ErrorCode = EIDRM;
+		return -1;
+	}
+
+	struct IntegrityContext* integrityContext = static_cast< struct IntegrityContext* >( context->_M_SchemeContext );
+	struct FileContext* innerContext = integrityContext->mInnerContext;
+	int64_t offset = innerContext->_M_FilePosition;
+
+	int64_t bytesRead = innerContext->_F_read( innerContext, buffer, bytes, updatePosition );
+	context->_M_FilePosition = innerContext->_M_FilePosition;
+	context->_M_FileSize = innerContext->_M_FileSize;
+
+	if ( not __integrity_verify_blocks( integrityContext, offset, buffer, bytesRead ) )
+	{
+		return -1;
+	}
+
+	__integrity_update_digest( integrityContext, offset, buffer, bytesRead );
+	return bytesRead;
+}
+
+static int64_t __integrity_resize(
+	struct FileContext* context,
+	int64_t size,
+	uint8_t fill,
+	bool shrink,
+	bool grow )
+{
+	if ( nullptr == context )
+	{
+		return -1;
+	}
+
+	if ( nullptr == context->_M_SchemeContext )
+	{
+		context->_M_ErrorCode = EIDRM;
+		return -1;
+	}
+
+	struct IntegrityContext* integrityContext = static_cast< struct IntegrityContext* >( context->_M_SchemeContext );
+	struct FileContext* innerContext = integrityContext->mInnerContext;
+	int64_t previousSize = innerContext->_M_FileSize;
+
+	int64_t newSize = innerContext->_F_resize( innerContext, size, fill, shrink, grow );
+	context->_M_FilePosition = innerContext->_M_FilePosition;
+	context->_M_FileSize = innerContext->_M_FileSize = newSize;
+
+	if ( newSize < integrityContext->mDigestPosition )
+	{
+		integrityContext->mDigestValid = false;
+	}
+
+	if ( ( nullptr == integrityContext->mSidecarContext ) or ( newSize == previousSize ) )
+	{
+		return newSize;
+	}
+
+	int64_t blockSize = integrityContext->mBlockSize;
+	size_t blockCount = ( newSize + blockSize - 1 ) / blockSize;
+	size_t firstChangedBlock = std::min( previousSize, newSize ) / blockSize;
+
+	integrityContext->mSidecarTruncated = ( blockCount < integrityContext->mBlockChecksums.size() );
+	integrityContext->mBlockChecksums.resize( blockCount, 0 );
+
+	if ( firstChangedBlock >= blockCount )
+	{
+		return newSize;
+	}
+
+	// Blocks made up entirely of new fill bytes all share the same checksum.
+	std::vector< uint8_t > fillBlock( blockSize, fill );
+	uint32_t fillChecksum = _crc32c( 0, fillBlock.data(), fillBlock.size() );
+
+	for ( size_t blockIndex = firstChangedBlock; blockIndex < blockCount; ++blockIndex )
+	{
+		int64_t blockStart = blockIndex * blockSize;
+
+		if ( ( blockStart >= previousSize ) and ( blockStart + blockSize <= newSize ) )
+		{
+			integrityContext->mBlockChecksums[ blockIndex ] = fillChecksum;
+		}
+		else if ( not __integrity_checksum_block( integrityContext, blockIndex, integrityContext->mBlockChecksums[ blockIndex ] ) )
+		{
+			break;
+		}
+	}
+
+	__integrity_mark_dirty( integrityContext, firstChangedBlock, blockCount );
+	return newSize;
+}
+
+static bool __integrity_sync(
+	struct FileContext* context )
+{
+	if ( nullptr == context )
+	{
+		return false;
+	}
+
+	if ( nullptr == context->_M_SchemeContext )
+	{
+		context->_M_ErrorCode = EIDRM;
+		return false;
+	}
+
+	struct IntegrityContext* integrityContext = static_cast< struct IntegrityContext* >( context->_M_SchemeContext );
+	struct FileContext* innerContext = integrityContext->mInnerContext;
+
+	// The data must be durable before the checksums describing it.
+	return innerContext->_F_sync( innerContext )
+		and __integrity_flush_sidecar( integrityContext );
+}
+
+static int64_t __integrity_write(
+	struct FileContext* context,
+	const uint8_t* buffer,
+	size_t bytes,
+	bool append )
+{
+	if ( nullptr == context )
+	{
+		return -1;
+	}
+
+	if ( nullptr == context->_M_SchemeContext )
+	{
+		context->_M_ErrorCode = EIDRM;
+		return -1;
+	}
+
+	struct IntegrityContext* integrityContext = static_cast< struct IntegrityContext* >( context->_M_SchemeContext );
+	struct FileContext* innerContext = integrityContext->mInnerContext;
+	int64_t previousSize = innerContext->_M_FileSize;
+	int64_t offset = append ? previousSize : innerContext->_M_FilePosition;
+
+	int64_t bytesWritten = innerContext->_F_write( innerContext, buffer, bytes, append );
+	context->_M_FilePosition = innerContext->_M_FilePosition;
+	context->_M_FileSize = innerContext->_M_FileSize;
+
+	if ( 0 >= bytesWritten )
+	{
+		return bytesWritten;
+	}
+
+	if ( offset < integrityContext->mDigestPosition )
+	{
+		integrityContext->mDigestValid = false;
+	}
+
+	__integrity_update_digest( integrityContext, offset, buffer, bytesWritten );
+
+	if ( not __integrity_update_blocks( integrityContext, offset, buffer, bytesWritten, previousSize ) )
+	{
+		return -1;
+	}
+
+	return bytesWritten;
+}
+
+bool _select_integrity(
+	std::string& uri,
+	std::string& algorithm,
+	uint32_t& blockSize )
+{
+	std::string blockChecksums;
+	algorithm.clear();
+	blockSize = 0;
+
+	if ( _extract_uri_parameter( uri, "digest", algorithm )
+		and ( "crc32c" != algorithm )
+		and ( "xxh3" != algorithm ) )
+	{
+		return false;
+	}
+
+	if ( _extract_uri_parameter( uri, "block_checksums", blockChecksums ) )
+	{
+		char* blockChecksumsEnd = nullptr;
+		unsigned long requestedBlockSize = strtoul( blockChecksums.c_str(), &blockChecksumsEnd, 10 );
+
+		if ( blockChecksums.empty()
+			or ( '\0' != *blockChecksumsEnd )
+			or ( 0 == requestedBlockSize )
+			or ( UINT32_MAX < requestedBlockSize ) )
+		{
+			return false;
+		}
+
+		blockSize = static_cast< uint32_t >( requestedBlockSize );
+	}
+
+	return true;
+}
+
+bool _push_integrity_layer(
+	struct FileContext* context,
+	const std::string& uri,
+	const std::string& algorithm,
+	uint32_t blockSize,
+	File::IOFlag mode,
+	int& errorCode )
+{
+	struct IntegrityContext* integrityContext = new ( std::nothrow ) IntegrityContext();
+
+	if ( nullptr == integrityContext )
+	{
+		errorCode = ENOMEM;
+		return false;
+	}
+
+	integrityContext->mAlgorithm = algorithm.empty() ? INTEGRITY_DIGEST_NONE
+		: ( ( "xxh3" == algorithm ) ? INTEGRITY_DIGEST_XXH3 : INTEGRITY_DIGEST_CRC32C );
+	integrityContext->mDigestValid = true;
+	integrityContext->mBlockSize = blockSize;
+
+	if ( INTEGRITY_DIGEST_XXH3 == integrityContext->mAlgorithm )
+	{
+		integrityContext->mXXH3State = XXH3_createState();
+
+		if ( ( nullptr == integrityContext->mXXH3State )
+			or ( XXH_OK != XXH3_64bits_reset( integrityContext->mXXH3State ) ) )
+		{
+			__free_integrity_context( integrityContext );
+			errorCode = ENOMEM;
+			return false;
+		}
+	}
+
+	if ( 0 != blockSize )
+	{
+		std::string sidecarURI( uri );
+		sidecarURI.insert( std::min( sidecarURI.find( '?' ), sidecarURI.size() ), INTEGRITY_SIDECAR_SUFFIX );
+
+		File::IOFlag sidecarMode = static_cast< File::IOFlag >( File::IOFlag::READ | ( File::IOFlag::WRITE & mode ) );
+		integrityContext->mSidecarContext = _allocate_context();
+
+		if ( ( nullptr == integrityContext->mSidecarContext )
+			or not _open_uri( integrityContext->mSidecarContext, sidecarURI, sidecarMode, errorCode ) )
+		{
+			_free_context( integrityContext->mSidecarContext );
+			integrityContext->mSidecarContext = nullptr;
+
+			// Without a sidecar a reader simply has nothing to verify against.
+			if ( File::IOFlag::WRITE & mode )
+			{
+				__free_integrity_context( integrityContext );
+				return false;
+			}
+		}
+		else if ( not __integrity_load_sidecar( integrityContext ) )
+		{
+			__free_integrity_context( integrityContext );
+			errorCode = EBADMSG;
+			return false;
+		}
+	}
+
+	integrityContext->mInnerContext = _push_context_layer( context );
+
+	if ( nullptr == integrityContext->mInnerContext )
+	{
+		__free_integrity_context( integrityContext );
+		errorCode = ENOMEM;
+		return false;
+	}
+
+	// A sidecar created for an existing file starts out describing all of it.
+	if ( ( nullptr != integrityContext->mSidecarContext )
+		and ( File::IOFlag::WRITE & mode )
+		and integrityContext->mBlockChecksums.empty()
+		and ( 0 < context->_M_FileSize ) )
+	{
+		size_t blockCount = ( context->_M_FileSize + blockSize - 1 ) / blockSize;
+		integrityContext->mBlockChecksums.resize( blockCount );
+
+		for ( size_t blockIndex = 0; blockIndex < blockCount; ++blockIndex )
+		{
+			if ( not __integrity_checksum_block( integrityContext, blockIndex, integrityContext->mBlockChecksums[ blockIndex ] ) )
+			{
+				errorCode = integrityContext->mErrorCode;
+				context->_M_SchemeContext = integrityContext->mInnerContext->_M_SchemeContext;
+				_free_context( integrityContext->mInnerContext );
+				integrityContext->mInnerContext = nullptr;
+				__free_integrity_context( integrityContext );
+				return false;
+			}
+		}
+
+		__integrity_mark_dirty( integrityContext, 0, blockCount );
+	}
+
+	context->_M_SchemeContext = static_cast< void* >( integrityContext );
+	context->_F_error_string = __integrity_error_string;
+	context->_F_close = __integrity_close;
+	context->_F_seek = __integrity_seek;
+	context->_F_read = __integrity_read;
+	context->_F_pread = nullptr;
+	context->_F_group_append = nullptr;
+	context->_F_punch_hole = nullptr;
+	context->_F_data_regions = nullptr;
+	context->_F_publish = nullptr;
+	context->_F_snapshot = nullptr;
+	context->_F_dup = nullptr;
+	context->_F_refresh = nullptr;
+	context->_F_watch = nullptr;
+	context->_F_splice = nullptr;
+	context->_F_poll_handle = nullptr;
+	context->_F_view = nullptr;
+	context->_F_write = __integrity_write;
+	context->_F_resize = __integrity_resize;
+	context->_F_sync = __integrity_sync;
+	context->_F_digest = __integrity_digest;
+	return true;
+}
@@ -0,0 +1,51 @@
+/**
+ * Copyright ©2021. Brent Weichel. All Rights Reserved.
+ * Permission to use, copy, modify, and/or distribute this software, in whole
+ * or part by any means, without express prior written agreement is prohibited.
+ */
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "File.hpp"
+#include "FileContext.hpp"
+
+#define INTEGRITY_SIDECAR_SUFFIX ( ".crc32c" )
+
+/*
+ * Select the integrity options for the given URI. The "digest" query parameter
+ * names the whole stream digest ("crc32c" or "xxh3"), and the "block_checksums"
+ * query parameter the block size of the per-block CRC32C sidecar. Both are
+ * removed from {@param uri}.
+ * @param uri Reference to the URI of the resource.
+ * @param algorithm Reference to store the digest algorithm, empty if none was requested.
+ * @param blockSize Reference to store the sidecar block size, zero if none was requested.
+ * @return False is returned if an option is not supported.
+ */
+bool _select_integrity(
+	std::string& uri,
+	std::string& algorithm,
+	uint32_t& blockSize );
+
+/*
+ * Stack the integrity layer on top of the opened resource in {@param context}.
+ * The digest is computed over the bytes read or written contiguously from the
+ * beginning of the file. Per-block checksums are kept in a sidecar next to the
+ * resource ({@param uri} with INTEGRITY_SIDECAR_SUFFIX appended to its path), are
+ * updated by writes, and are used to verify every block a read touches.
+ * @param context A pointer to an opened context.
+ * @param uri The URI the resource was opened with, used to locate the sidecar.
+ * @param algorithm The digest algorithm, or empty for none.
+ * @param blockSize The sidecar block size, or zero for no sidecar.
+ * @param mode The mode the resource was opened with.
+ * @param errorCode A reference to an integer in which to store error codes.
+ * @return True is returned on success, false on error and {@param errorCode} is set.
+ */
+bool _push_integrity_layer(
+	struct FileContext* context,
+	const std::string& uri,
+	const std::string& algorithm,
+	uint32_t blockSize,
+	File::IOFlag mode,
+	int& errorCode );
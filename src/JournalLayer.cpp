@@ -0,0 +1,732 @@
+/**
+ * Copyright ©2021. Brent Weichel. All Rights Reserved.
+ * Permission to use, copy, modify, and/or distribute this software, in whole
+ * or part by any means, without express prior written agreement is prohibited.
+ */
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "Checksum.hpp"
+#include "File.hpp"
+#include "FileContext.hpp"
+#include "JournalLayer.hpp"
+#include "Util.hpp"
+
+#define JOURNAL_MAGIC       ( "FJOURNL" )
+#define JOURNAL_HEADER_SIZE ( 16 )
+
+// Once the journal grows past this size, the next commit is followed by a checkpoint.
+#define JOURNAL_CHECKPOINT_SIZE ( 16 * 1024 * 1024 )
+
+// Largest write held by a single journal record, whose length is 32 bits.
+#define JOURNAL_WRITE_SIZE ( 1024 * 1024 * 1024 )
+
+enum JournalRecordType
+{
+	JOURNAL_RECORD_WRITE = 1,
+	JOURNAL_RECORD_COMMIT = 2
+};
+
+/*
+ * Every record is this header followed by mLength bytes of data. The checksum is the
+ * CRC32C of the header, with mChecksum zeroed, followed by the data. A batch is made up
+ * of its write records followed by a commit record, all sharing the same sequence number.
+ */
+struct JournalRecordHeader
+{
+	uint32_t mType;
+	uint32_t mLength;
+	int64_t mOffset;
+	uint64_t mSequence;
+	uint32_t mChecksum;
+	uint32_t mReserved;
+};
+
+struct JournalWrite
+{
+	int64_t mOffset;
+	std::vector< uint8_t > mData;
+};
+
+struct JournalContext
+{
+	struct FileContext* mInnerContext;
+	struct FileContext* mJournalContext;
+
+	// The records of the batch, encoded as they are to be appended to the journal,
+	// and its writes, which are applied in place once the records are durable.
+	std::vector< uint8_t > mBatchRecords;
+	std::vector< struct JournalWrite > mBatchWrites;
+	uint64_t mSequence;
+	bool mBatchOpen;
+
+	int mErrorCode;
+};
+
+static void __free_journal_context(
+	struct JournalContext* journalContext )
+{
+	if ( nullptr != journalContext->mJournalContext )
+	{
+		journalContext->mJournalContext->_F_close( journalContext->mJournalContext );
+		_free_context( journalContext->mJournalContext );
+	}
+
+	delete journalContext;
+}
+
+static int64_t __journal_read_at(
+	struct FileContext* innerContext,
+	int64_t offset,
+	uint8_t* buffer,
+	size_t bytes )
+{
+	if ( -1 == innerContext->_F_seek( innerContext, offset, false ) )
+	{
+		return -1;
+	}
+
+	return innerContext->_F_read( innerContext, buffer, bytes, false );
+}
+
+static bool __journal_write_at(
+	struct FileContext* innerContext,
+	int64_t offset,
+	const uint8_t* buffer,
+	size_t bytes )
+{
+	size_t bytesWritten = 0;
+
+	if ( -1 == innerContext->_F_seek( innerContext, offset, false ) )
+	{
+		return false;
+	}
+
+	while ( bytesWritten < bytes )
+	{
+		int64_t writeResult = innerContext->_F_write( innerContext, buffer + bytesWritten, bytes - bytesWritten, false );
+
+		if ( 0 >= writeResult )
+		{
+			return false;
+		}
+
+		bytesWritten += writeResult;
+	}
+
+	return true;
+}
+
+static bool __journal_append(
+	struct FileContext* sidecarContext,
+	const uint8_t* buffer,
+	size_t bytes )
+{
+	size_t bytesWritten = 0;
+
+	while ( bytesWritten < bytes )
+	{
+		int64_t writeResult = sidecarContext->_F_write( sidecarContext, buffer + bytesWritten, bytes - bytesWritten, true );
+
+		if ( 0 >= writeResult )
+		{
+			return false;
+		}
+
+		bytesWritten += writeResult;
+	}
+
+	return true;
+}
+
+static bool __journal_apply(
+	struct FileContext* innerContext,
+	const std::vector< struct JournalWrite >& writes )
+{
+	for ( const struct JournalWrite& write : writes )
+	{
+		if ( not __journal_write_at( innerContext, write.mOffset, write.mData.data(), write.mData.size() ) )
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static uint32_t __journal_checksum(
+	struct JournalRecordHeader header,
+	const uint8_t* data )
+{
+	header.mChecksum = 0;
+	return _crc32c( _crc32c( 0, reinterpret_cast< const uint8_t* >( &header ), sizeof( header ) ), data, header.mLength );
+}
+
+static void __journal_record(
+	struct JournalContext* journalContext,
+	uint32_t type,
+	int64_t offset,
+	const uint8_t* data,
+	uint32_t length )
+{
+	struct JournalRecordHeader header = { type, length, offset, journalContext->mSequence, 0, 0 };
+	header.mChecksum = __journal_checksum( header, data );
+
+	const uint8_t* headerBytes = reinterpret_cast< const uint8_t* >( &header );
+	journalContext->mBatchRecords.insert( journalContext->mBatchRecords.end(), headerBytes, headerBytes + sizeof( header ) );
+	journalContext->mBatchRecords.insert( journalContext->mBatchRecords.end(), data, data + length );
+}
+
+/*
+ * Flush the resource, then empty the journal, as every batch in it has now been durably applied.
+ */
+static bool __journal_checkpoint(
+	struct JournalContext* journalContext )
+{
+	struct FileContext* innerContext = journalContext->mInnerContext;
+	struct FileContext* sidecarContext = journalContext->mJournalContext;
+
+	if ( JOURNAL_HEADER_SIZE >= sidecarContext->_M_FileSize )
+	{
+		return true;
+	}
+
+	if ( not innerContext->_F_sync( innerContext ) )
+	{
+		return false;
+	}
+
+	sidecarContext->_M_FileSize = sidecarContext->_F_resize( sidecarContext, JOURNAL_HEADER_SIZE, '\0', true, false );
+
+	if ( JOURNAL_HEADER_SIZE != sidecarContext->_M_FileSize )
+	{
+		journalContext->mErrorCode = EIO;
+		return false;
+	}
+
+	return sidecarContext->_F_sync( sidecarContext );
+}
+
+static void __journal_discard_batch(
+	struct FileContext* context,
+	struct JournalContext* journalContext )
+{
+	journalContext->mBatchRecords.clear();
+	journalContext->mBatchWrites.clear();
+	journalContext->mBatchOpen = false;
+	context->_M_FileSize = journalContext->mInnerContext->_M_FileSize;
+	context->_M_FilePosition = std::min( context->_M_FilePosition, context->_M_FileSize );
+}
+
+/*
+ * Make the batch durable with a single write and flush of the journal, then apply it in place.
+ */
+static bool __journal_commit_batch(
+	struct FileContext* context,
+	struct JournalContext* journalContext )
+{
+	struct FileContext* sidecarContext = journalContext->mJournalContext;
+
+	if ( journalContext->mBatchWrites.empty() )
+	{
+		journalContext->mBatchOpen = false;
+		return true;
+	}
+
+	__journal_record( journalContext, JOURNAL_RECORD_COMMIT, 0, nullptr, 0 );
+
+	if ( not __journal_append( sidecarContext, journalContext->mBatchRecords.data(), journalContext->mBatchRecords.size() )
+		or not sidecarContext->_F_sync( sidecarContext ) )
+	{
+		// The journal may end in a partial batch, which recovery disregards.
+		__journal_discard_batch( context, journalContext );
+		return false;
+	}
+
+	++journalContext->mSequence;
+
+	// Were the batch to be applied only in part, the journal would complete it when next opened.
+	bool applied = __journal_apply( journalContext->mInnerContext, journalContext->mBatchWrites );
+	__journal_discard_batch( context, journalContext );
+
+	if ( not applied )
+	{
+		return false;
+	}
+
+	return ( JOURNAL_CHECKPOINT_SIZE > sidecarContext->_M_FileSize )
+		or __journal_checkpoint( journalContext );
+}
+
+/*
+ * Apply every complete batch in the journal, and discard a trailing incomplete one.
+ */
+static bool __journal_recover(
+	struct JournalContext* journalContext )
+{
+	struct FileContext* sidecarContext = journalContext->mJournalContext;
+	uint8_t header[ JOURNAL_HEADER_SIZE ] = { 0 };
+
+	if ( 0 == sidecarContext->_M_FileSize )
+	{
+		memcpy( header, JOURNAL_MAGIC, sizeof( JOURNAL_MAGIC ) );
+		return __journal_append( sidecarContext, header, sizeof( header ) )
+			and sidecarContext->_F_sync( sidecarContext );
+	}
+
+	if ( ( sizeof( header ) != __journal_read_at( sidecarContext, 0, header, sizeof( header ) ) )
+		or ( 0 != memcmp( header, JOURNAL_MAGIC, sizeof( JOURNAL_MAGIC ) ) ) )
+	{
+		journalContext->mErrorCode = EBADMSG;
+		return false;
+	}
+
+	std::vector< struct JournalWrite > batchWrites;
+	int64_t recordOffset = JOURNAL_HEADER_SIZE;
+
+	while ( recordOffset + static_cast< int64_t >( sizeof( struct JournalRecordHeader ) ) <= sidecarContext->_M_FileSize )
+	{
+		struct JournalRecordHeader record;
+		std::vector< uint8_t > data;
+
+		if ( sizeof( record ) != __journal_read_at( sidecarContext, recordOffset,
+			reinterpret_cast< uint8_t* >( &record ), sizeof( record ) ) )
+		{
+			break;
+		}
+
+		int64_t recordEnd = recordOffset + sizeof( record ) + record.mLength;
+
+		// A record running past the end of the journal was torn while being appended.
+		if ( ( ( JOURNAL_RECORD_WRITE != record.mType ) and ( JOURNAL_RECORD_COMMIT != record.mType ) )
+			or ( recordEnd > sidecarContext->_M_FileSize )
+			or ( batchWrites.empty() and ( JOURNAL_RECORD_COMMIT == record.mType ) ) )
+		{
+			break;
+		}
+
+		data.resize( record.mLength );
+
+		if ( ( record.mLength != __journal_read_at( sidecarContext, recordOffset + sizeof( record ), data.data(), record.mLength ) )
+			or ( record.mChecksum != __journal_checksum( record, data.data() ) ) )
+		{
+			break;
+		}
+
+		recordOffset = recordEnd;
+
+		if ( JOURNAL_RECORD_WRITE == record.mType )
+		{
+			batchWrites.push_back( { record.mOffset, std::move( data ) } );
+			continue;
+		}
+
+		if ( not __journal_apply( journalContext->mInnerContext, batchWrites ) )
+		{
+			journalContext->mErrorCode = EIO;
+			return false;
+		}
+
+		batchWrites.clear();
+		journalContext->mSequence = record.mSequence + 1;
+	}
+
+	return __journal_checkpoint( journalContext );
+}
+
+static bool __journal_begin_batch(
+	struct FileContext* context )
+{
+	if ( nullptr == context )
+	{
+		return false;
+	}
+
+	if ( nullptr == context->_M_SchemeContext )
+	{
+		context->_M_ErrorCode = EIDRM;
+		return false;
+	}
+
+	struct JournalContext* journalContext = static_cast< struct JournalContext* >( context->_M_SchemeContext );
+
+	if ( journalContext->mBatchOpen )
+	{
+		journalContext->mErrorCode = EBUSY;
+		return false;
+	}
+
+	journalContext->mBatchOpen = true;
+	return true;
+}
+
+static bool __journal_commit(
+	struct FileContext* context )
+{
+	if ( nullptr == context )
+	{
+		return false;
+	}
+
+	if ( nullptr == context->_M_SchemeContext )
+	{
+		context->_M_ErrorCode = EIDRM;
+		return false;
+	}
+
+	struct JournalContext* journalContext = static_cast< struct JournalContext* >( context->_M_SchemeContext );
+	return __journal_commit_batch( context, journalContext );
+}
+
+static std::string __journal_digest(
+	struct FileContext* context )
+{
+	if ( ( nullptr == context )
+		or ( nullptr == context->_M_SchemeContext ) )
+	{
+		return std::string();
+	}
+
+	struct JournalContext* journalContext = static_cast< struct JournalContext* >( context->_M_SchemeContext );
+	return journalContext->mInnerContext->_F_digest( journalContext->mInnerContext );
+}
+
+static std::string __journal_error_string(
+	struct FileContext* context )
+{
+	if ( nullptr == context )
+	{
+		return std::string( strerror( EBADF ) );
+	}
+
+	if ( nullptr == context->_M_SchemeContext )
+	{
+		return std::string( strerror( EIDRM ) );
+	}
+
+	struct JournalContext* journalContext = static_cast< struct JournalContext* >( context->_M_SchemeContext );
+
+	if ( 0 != journalContext->mErrorCode )
+	{
+		return std::string( strerror( journalContext->mErrorCode ) );
+	}
+
+	std::string errorString = journalContext->mJournalContext->_F_error_string( journalContext->mJournalContext );
+
+	if ( not errorString.empty() )
+	{
+		return errorString;
+	}
+
+	return journalContext->mInnerContext->_F_error_string( journalContext->mInnerContext );
+}
+
+static void __journal_close(
+	struct FileContext* context )
+{
+	if ( ( nullptr == context )
+		or ( nullptr == context->_M_SchemeContext ) )
+	{
+		return;
+	}
+
+	struct JournalContext* journalContext = static_cast< struct JournalContext* >( context->_M_SchemeContext );
+	struct FileContext* innerContext = journalContext->mInnerContext;
+
+	// A batch left open is rolled back; none of its writes have reached the resource.
+	__journal_discard_batch( context, journalContext );
+	__journal_checkpoint( journalContext );
+	innerContext->_F_close( innerContext );
+	_free_context( innerContext );
+	__free_journal_context( journalContext );
+	context->_M_SchemeContext = nullptr;
+}
+
+static int64_t __journal_seek(
+	struct FileContext* context,
+	int64_t offset,
+	bool relative )
+{
+	if ( nullptr == context )
+	{
+		return -1;
+	}
+
+	if ( nullptr == context->_M_SchemeContext )
+	{
+		context->_M_ErrorCode = EIDRM;
+		return -1;
+	}
+
+	int64_t requestedPosition = relative
+		? ( context->_M_FilePosition + offset )
+		: ( ( 0 > offset ) ? ( context->_M_FileSize + offset ) : offset );
+	context->_M_FilePosition = std::clamp< int64_t >( requestedPosition, 0, context->_M_FileSize );
+
+	return requestedPosition - context->_M_FilePosition;
+}
+
+static int64_t __journal_read(
+	struct FileContext* context,
+	uint8_t* buffer,
+	size_t bytes,
+	bool updatePosition )
+{
+	if ( nullptr == context )
+	{
+		return -1;
+	}
+
+	if ( nullptr == context->_M_SchemeContext )
+	{
+		context->_M_ErrorCode = EIDRM;
+		return -1;
+	}
+
+	struct JournalContext* journalContext = static_cast< struct JournalContext* >( context->_M_SchemeContext );
+	int64_t offset = context->_M_FilePosition;
+	size_t readCount = std::clamp< int64_t >( context->_M_FileSize - offset, 0, bytes );
+
+	if ( 0 == readCount )
+	{
+		return 0;
+	}
+
+	int64_t bytesRead = __journal_read_at( journalContext->mInnerContext, offset, buffer, readCount );
+
+	if ( -1 == bytesRead )
+	{
+		return -1;
+	}
+
+	// The writes of an open batch have yet to reach the resource, and may extend past
+	// its end, so they are laid over what was read, in the order they were made.
+	memset( buffer + bytesRead, 0, readCount - bytesRead );
+
+	for ( const struct JournalWrite& write : journalContext->mBatchWrites )
+	{
+		int64_t overlapBegin = std::max( offset, write.mOffset );
+		int64_t overlapEnd = std::min< int64_t >( offset + readCount, write.mOffset + write.mData.size() );
+
+		if ( overlapBegin < overlapEnd )
+		{
+			memcpy( buffer + ( overlapBegin - offset ), write.mData.data() + ( overlapBegin - write.mOffset ), overlapEnd - overlapBegin );
+		}
+	}
+
+	if ( updatePosition )
+	{
+		context->_M_FilePosition += readCount;
+	}
+
+	return readCount;
+}
+
+static int64_t __journal_resize(
+	struct FileContext* context,
+	int64_t size,
+	uint8_t fill,
+	bool shrink,
+	bool grow )
+{
+	if ( nullptr == context )
+	{
+		return -1;
+	}
+
+	if ( nullptr == context->_M_SchemeContext )
+	{
+		context->_M_ErrorCode = EIDRM;
+		return -1;
+	}
+
+	struct JournalContext* journalContext = static_cast< struct JournalContext* >( context->_M_SchemeContext );
+	struct FileContext* innerContext = journalContext->mInnerContext;
+
+	// Resizing isn't journaled, so the journal is emptied first, lest recovery
+	// replay writes past a new end of the file. That can't happen within a batch.
+	if ( journalContext->mBatchOpen )
+	{
+		journalContext->mErrorCode = EBUSY;
+		return context->_M_FileSize;
+	}
+
+	if ( not __journal_checkpoint( journalContext ) )
+	{
+		return context->_M_FileSize;
+	}
+
+	context->_M_FileSize = innerContext->_M_FileSize = innerContext->_F_resize( innerContext, size, fill, shrink, grow );
+	context->_M_FilePosition = std::min( context->_M_FilePosition, context->_M_FileSize );
+	return context->_M_FileSize;
+}
+
+static bool __journal_sync(
+	struct FileContext* context )
+{
+	if ( nullptr == context )
+	{
+		return false;
+	}
+
+	if ( nullptr == context->_M_SchemeContext )
+	{
+		context->_M_ErrorCode = EIDRM;
+		return false;
+	}
+
+	// Committed batches are already durable in the journal; syncing checkpoints them.
+	struct JournalContext* journalContext = static_cast< struct JournalContext* >( context->_M_SchemeContext );
+	return __journal_checkpoint( journalContext );
+}
+
+static int64_t __journal_write(
+	struct FileContext* context,
+	const uint8_t* buffer,
+	size_t bytes,
+	bool append )
+{
+	if ( nullptr == context )
+	{
+		return -1;
+	}
+
+	if ( nullptr == context->_M_SchemeContext )
+	{
+		context->_M_ErrorCode = EIDRM;
+		return -1;
+	}
+
+	struct JournalContext* journalContext = static_cast< struct JournalContext* >( context->_M_SchemeContext );
+	int64_t offset = append ? context->_M_FileSize : context->_M_FilePosition;
+
+	// Larger writes are journalled as several records, replayed in order.
+	for ( size_t recordOffset = 0; recordOffset < bytes; recordOffset += JOURNAL_WRITE_SIZE )
+	{
+		__journal_record( journalContext, JOURNAL_RECORD_WRITE, offset + recordOffset, buffer + recordOffset,
+			std::min< size_t >( bytes - recordOffset, JOURNAL_WRITE_SIZE ) );
+	}
+
+	journalContext->mBatchWrites.push_back( { offset, std::vector< uint8_t >( buffer, buffer + bytes ) } );
+	context->_M_FileSize = std::max< int64_t >( context->_M_FileSize, offset + bytes );
+
+	if ( not append )
+	{
+		context->_M_FilePosition += bytes;
+	}
+
+	// Outside of a batch, every write is a batch of its own.
+	if ( not journalContext->mBatchOpen
+		and not __journal_commit_batch( context, journalContext ) )
+	{
+		return -1;
+	}
+
+	return bytes;
+}
+
+bool _select_journal(
+	std::string& uri,
+	bool& journal )
+{
+	std::string journalValue;
+	journal = false;
+
+	if ( _extract_uri_parameter( uri, "journal", journalValue ) )
+	{
+		if ( ( "0" != journalValue ) and ( "1" != journalValue ) )
+		{
+			return false;
+		}
+
+		journal = ( "1" == journalValue );
+	}
+
+	return true;
+}
+
+bool _push_journal_layer(
+	struct FileContext* context,
+	const std::string& uri,
+	File::IOFlag mode,
+	int& errorCode )
+{
+	if ( not ( File::IOFlag::WRITE & mode ) )
+	{
+		errorCode = EINVAL;
+		return false;
+	}
+
+	struct JournalContext* journalContext = new ( std::nothrow ) JournalContext();
+
+	if ( nullptr == journalContext )
+	{
+		errorCode = ENOMEM;
+		return false;
+	}
+
+	std::string sidecarURI( uri );
+	sidecarURI.insert( std::min( sidecarURI.find( '?' ), sidecarURI.size() ), JOURNAL_SIDECAR_SUFFIX );
+
+	journalContext->mJournalContext = _allocate_context();
+
+	if ( ( nullptr == journalContext->mJournalContext )
+		or not _open_uri( journalContext->mJournalContext, sidecarURI,
+			static_cast< File::IOFlag >( File::IOFlag::READ | File::IOFlag::WRITE ), errorCode ) )
+	{
+		_free_context( journalContext->mJournalContext );
+		journalContext->mJournalContext = nullptr;
+		__free_journal_context( journalContext );
+		return false;
+	}
+
+	journalContext->mInnerContext = _push_context_layer( context );
+
+	if ( nullptr == journalContext->mInnerContext )
+	{
+		__free_journal_context( journalContext );
+		errorCode = ENOMEM;
+		return false;
+	}
+
+	if ( not __journal_recover( journalContext ) )
+	{
+		errorCode = ( 0 != journalContext->mErrorCode ) ? journalContext->mErrorCode : EIO;
+		context->_M_SchemeContext = journalContext->mInnerContext->_M_SchemeContext;
+		_free_context( journalContext->mInnerContext );
+		journalContext->mInnerContext = nullptr;
+		__free_journal_context( journalContext );
+		return false;
+	}
+
+	context->_M_FileSize = journalContext->mInnerContext->_M_FileSize;
+	context->_M_SchemeContext = static_cast< void* >( journalContext );
+	context->_F_error_string = __journal_error_string;
+	context->_F_close = __journal_close;
+	context->_F_seek = __journal_seek;
+	context->_F_read = __journal_read;
+	context->_F_pread = nullptr;
+	context->_F_write = __journal_write;
+	context->_F_group_append = nullptr;
+	context->_F_resize = __journal_resize;
+	context->_F_punch_hole = nullptr;
+	context->_F_data_regions = nullptr;
+	context->_F_publish = nullptr;
+	context->_F_snapshot = nullptr;
+	context->_F_dup = nullptr;
+	context->_F_refresh = nullptr;
+	context->_F_watch = nullptr;
+	context->_F_splice = nullptr;
+	context->_F_poll_handle = nullptr;
+	context->_F_view = nullptr;
+	context->_F_sync = __journal_sync;
+	context->_F_digest = ( nullptr != journalContext->mInnerContext->_F_digest ) ? __journal_digest : nullptr;
+	context->_F_begin_batch = __journal_begin_batch;
+	context->_F_commit = __journal_commit;
+	return true;
+}
@@ -0,0 +1,44 @@
+/**
+ * Copyright ©2021. Brent Weichel. All Rights Reserved.
+ * Permission to use, copy, modify, and/or distribute this software, in whole
+ * or part by any means, without express prior written agreement is prohibited.
+ */
+#pragma once
+
+#include <string>
+
+#include "File.hpp"
+#include "FileContext.hpp"
+
+#define JOURNAL_SIDECAR_SUFFIX ( ".journal" )
+
+/*
+ * Select the journal mode for the given URI. The "journal" query parameter
+ * ("0" or "1") enables the write-ahead journal, and is removed from {@param uri}.
+ * @param uri Reference to the URI of the resource.
+ * @param journal Reference to store whether the journal was requested.
+ * @return False is returned if the parameter has an unsupported value.
+ */
+bool _select_journal(
+	std::string& uri,
+	bool& journal );
+
+/*
+ * Stack a write-ahead journal on top of the opened resource in {@param context}.
+ * Writes are appended, with checksums, to a journal next to the resource ({@param uri}
+ * with JOURNAL_SIDECAR_SUFFIX appended to its path) and made durable by a single flush
+ * per batch, before being applied in place. The resource itself is only flushed at a
+ * checkpoint, which then empties the journal. Batches found complete in the journal
+ * when opening are applied again, so a write torn by a crash is always either
+ * completed or never happened.
+ * @param context A pointer to an opened context.
+ * @param uri The URI the resource was opened with, used to locate the journal.
+ * @param mode The mode the resource was opened with, which must include WRITE.
+ * @param errorCode A reference to an integer in which to store error codes.
+ * @return True is returned on success, false on error and {@param errorCode} is set.
+ */
+bool _push_journal_layer(
+	struct FileContext* context,
+	const std::string& uri,
+	File::IOFlag mode,
+	int& errorCode );
@@ -0,0 +1,25 @@
+/**
+ * Copyright ©2021. Brent Weichel. All Rights Reserved.
+ * Permission to use, copy, modify, and/or distribute this software, in whole
+ * or part by any means, without express prior written agreement is prohibited.
+ */
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+/*
+ * Find the first occurrence of {@param value} in [ {@param begin}, {@param end} ).
+ * The C library's memchr() is vectorized for the processor it runs on, and beat
+ * hand-written AVX2, SSE2, and NEON loops over records of a hundred bytes or so.
+ * It's inline, as a call per record is a measurable share of the scan.
+ * @return A pointer to the first occurrence is returned, or {@param end} if there is none.
+ */
+inline const uint8_t* _find_byte(
+	const uint8_t* begin,
+	const uint8_t* end,
+	uint8_t value )
+{
+	const void* match = memchr( begin, value, end - begin );
+	return ( nullptr == match ) ? end : static_cast< const uint8_t* >( match );
+}
@@ -6,7 +6,10 @@
 #pragma once
 
 #include <cstdint>
+#include <memory>
+#include <span>
 #include <string>
+#include <vector>
 
 #include "FileContext.hpp"
 
@@ -55,7 +58,21 @@ struct SchemeAPI
 	 * @param updatePosition Should the file position be updated by the number of bytes read.
 	 * @return The number of bytes read from the resource.
 	 */
-	int64_t ( *_F_read )( struct FileContext*, uint8_t*, uint32_t, bool );
+	int64_t ( *_F_read )( struct FileContext*, uint8_t*, size_t, bool );
+
+	/**
+	 * Read the requested number of bytes from the given offset, leaving the file position
+	 * untouched. This may be called concurrently, without the context lock being held,
+	 * so it must not modify the context beyond recording an error code. Schemes unable
+	 * to meet that leave this as nullptr, and positional reads are then emulated with
+	 * _F_seek and _F_read under the lock.
+	 * @param context Pointer to a FileContext struct.
+	 * @param buffer Pointer to a buffer to store bytes read.
+	 * @param bytes The number of bytes to read into the given buffer.
+	 * @param offset The offset from the beginning of the file to read from.
+	 * @return The number of bytes read from the resource.
+	 */
+	int64_t ( *_F_pread )( struct FileContext*, uint8_t*, size_t, int64_t );
 
 	/**
 	 * Write the requested number of bytes to the file either from the current position or the end of the file.
@@ -65,7 +82,22 @@ struct SchemeAPI
 	 * @param append Should the requested bytes be appended or written from the current file position.
 	 * @return The number of bytes written out to the resource is returned.
 	 */
-	int64_t ( *_F_write )( struct FileContext*, const uint8_t*, uint32_t, bool );
+	int64_t ( *_F_write )( struct FileContext*, const uint8_t*, size_t, bool );
+
+	/**
+	 * Durably write the requested number of bytes at an offset already reserved by
+	 * advancing the file size. This is called without the context lock being held,
+	 * so that concurrent appends can be committed together; as with _F_pread, it must
+	 * not modify the context beyond recording an error code. Schemes that don't commit
+	 * appends in groups leave this as nullptr, and _F_open clears it from the context
+	 * when the resource wasn't opened for group commits.
+	 * @param context Pointer to a FileContext struct.
+	 * @param buffer Pointer to a buffer to write from.
+	 * @param bytes The number of bytes to write from the buffer out to the resource.
+	 * @param offset The reserved offset from the beginning of the file to write at.
+	 * @return The number of bytes written out to the resource is returned.
+	 */
+	int64_t ( *_F_group_append )( struct FileContext*, const uint8_t*, size_t, int64_t );
 
 	/**
 	 * Resize the file to the requested number of bytes. There are 2 control flags
@@ -80,10 +112,163 @@ struct SchemeAPI
 	 */
 	int64_t ( *_F_resize )( struct FileContext*, int64_t, uint8_t, bool, bool );
 
+	/**
+	 * Deallocate the storage of a byte range, which then reads back as zeros.
+	 * The file size is left unchanged. Schemes without sparse files leave this as nullptr.
+	 * @param context Pointer to a FileContext struct.
+	 * @param offset The offset from the beginning of the file of the range.
+	 * @param length The length of the range in bytes.
+	 * @return False is returned on error, True is returned on success.
+	 */
+	bool ( *_F_punch_hole )( struct FileContext*, int64_t, int64_t );
+
+	/**
+	 * List the byte ranges of the file backed by data, skipping over holes.
+	 * Schemes without sparse files leave this as nullptr.
+	 * @param context Pointer to a FileContext struct.
+	 * @param regions Reference to the vector to store the ranges, in order, in.
+	 * @return False is returned on error, True is returned on success.
+	 */
+	bool ( *_F_data_regions )( struct FileContext*, std::vector< struct FileChunk >& );
+
 	/**
 	 * Synchronize the contents of the memory buffer with the resource.
 	 * @param context Pointer to a FileContext struct.
 	 * @return False is returned on error, True is returned on success or no-op.
 	 */
 	bool ( *_F_sync )( struct FileContext* );
+
+	/**
+	 * Atomically replace the target of a resource opened with File::IOFlag::ATOMIC
+	 * with what was written, after making it durable. Readers of the target see either
+	 * the whole of the old content or the whole of the new. Publishing twice only
+	 * repeats the directory sync. _F_open clears this when the resource isn't atomic.
+	 * @param context Pointer to a FileContext struct.
+	 * @param syncDirectory Should the replacement itself be made durable. Publishing many
+	 *                      files without, then again with, syncs each directory only once.
+	 * @return False is returned on error, True is returned on success.
+	 */
+	bool ( *_F_publish )( struct FileContext*, bool );
+
+	/**
+	 * Open a read-only copy of the resource as it is now into another context, installing
+	 * the functions to access it. The copy is unaffected by later writes to the resource,
+	 * and ought to be cheap where the storage can share unchanged data between the two.
+	 * @param context Pointer to the FileContext struct of the resource.
+	 * @param snapshotContext Pointer to a newly allocated FileContext struct to open the copy into.
+	 * @param errorCode Reference to the int to store error codes.
+	 * @return True is returned upon successfully opening the copy, false on error.
+	 */
+	bool ( *_F_snapshot )( struct FileContext*, struct FileContext*, int& );
+
+	/**
+	 * Open another handle on the resource into another context, installing the functions
+	 * to access it, which shares what was opened (e.g. the file descriptor) rather than
+	 * opening the resource again. The handle is read only, and has a file position of its
+	 * own, starting at that of {@param context}. The two contexts may then be used
+	 * concurrently, and the resource is closed once both are.
+	 * @param context Pointer to the FileContext struct of the resource.
+	 * @param dupContext Pointer to a newly allocated FileContext struct to open the handle into.
+	 * @param errorCode Reference to the int to store error codes.
+	 * @return True is returned upon successfully opening the handle, false on error.
+	 */
+	bool ( *_F_dup )( struct FileContext*, struct FileContext*, int& );
+
+	/**
+	 * Update the file size from the resource, for following a file as others append to it.
+	 * A file truncated below the file position is read again from the beginning. Once the
+	 * file has been read to the end, and another has since taken its place at its path,
+	 * as when a log is rotated, the other is opened in its place and read from the beginning.
+	 * @param context Pointer to a FileContext struct.
+	 * @param replaced Reference to store whether the resource was reopened.
+	 * @return False is returned on error, True is returned on success.
+	 */
+	bool ( *_F_refresh )( struct FileContext*, bool& );
+
+	/**
+	 * Add watches for the resource changing to an inotify instance: one on the resource
+	 * itself, and one on its directory for another taking its place. The watches on a
+	 * replaced resource are added anew once _F_refresh has reopened it. Schemes without
+	 * notifications leave this as nullptr, and their resources are polled with _F_refresh.
+	 * @param context Pointer to a FileContext struct.
+	 * @param notifyHandle The inotify instance to add the watches to.
+	 * @param fileWatch Reference to store the watch descriptor of the resource.
+	 * @param directoryWatch Reference to store the watch descriptor of the directory, -1 for none.
+	 * @return False is returned on error, True is returned on success.
+	 */
+	bool ( *_F_watch )( struct FileContext*, int, int&, int& );
+
+	/**
+	 * Move bytes from the current file position of the resource to the current file
+	 * position of another resource of the same scheme, without copying them through
+	 * user space, and advance both file positions. Only called with two contexts whose
+	 * _F_splice is the same, and with both context locks held.
+	 * @param context Pointer to the FileContext struct of the resource to move bytes from.
+	 * @param destinationContext Pointer to the FileContext struct of the resource to move bytes to.
+	 * @param bytes The number of bytes to move.
+	 * @return The number of bytes moved is returned, which may be fewer than requested,
+	 *         and zero at the end of the resource. On error, -1 is returned.
+	 */
+	int64_t ( *_F_splice )( struct FileContext*, struct FileContext*, int64_t );
+
+	/**
+	 * Get the file descriptor to wait on, with epoll, for the resource to be ready
+	 * to be read from or written to. Schemes without one leave this as nullptr.
+	 * @param context Pointer to a FileContext struct.
+	 * @return The file descriptor is returned, or -1 on error.
+	 */
+	int ( *_F_poll_handle )( struct FileContext* );
+
+	/**
+	 * Lend a read-only view of bytes of the resource in place, without copying them,
+	 * e.g. by mapping them into memory. The view must remain valid for as long as the
+	 * pointer returned is held, even after the context is closed. Schemes that can't
+	 * lend views leave this as nullptr, and the bytes are copied with _F_pread instead.
+	 * @param context Pointer to a FileContext struct.
+	 * @param offset The offset of the first byte to view.
+	 * @param length The number of bytes to view, all of which are within the resource.
+	 * @return A shared pointer to the first byte, owning the view, is returned.
+	 *         On error, nullptr is returned.
+	 */
+	std::shared_ptr< const uint8_t > ( *_F_view )( struct FileContext*, int64_t, int64_t );
+
+	/**
+	 * Open the directory at the URI for listing into the provided context.
+	 * Schemes that can't list directories leave this and the following as nullptr.
+	 * @param context Pointer to a DirectoryContext struct.
+	 * @param uri Const string reference to the URI of the directory.
+	 * @param errorCode Reference to the int to store error codes.
+	 * @return True is returned upon successfully opening the directory, false on error.
+	 */
+	bool ( *_F_open_directory )( struct DirectoryContext*, const std::string&, int& );
+
+	/**
+	 * Append the next batch of entries of the directory, other than "." and "..", to
+	 * the vector. Listings are read a batch at a time, so that none has to be held in
+	 * memory as a whole. An entry is left as FileEntry::UNKNOWN where the listing doesn't
+	 * carry its type, and its metadata is only filled in where the listing carries it.
+	 * @param context Pointer to a DirectoryContext struct.
+	 * @param entries Reference to the vector to append the entries to.
+	 * @return The number of entries appended is returned, zero at the end of the
+	 *         listing. On error, -1 is returned and the context error code is set.
+	 */
+	int64_t ( *_F_read_directory )( struct DirectoryContext*, std::vector< struct FileEntry >& );
+
+	/**
+	 * Stat the entries of the last batch whose type is unknown, or, if {@param metadata}
+	 * is set, those lacking metadata. The entries may be stat'd concurrently. Schemes whose
+	 * listings already carry all they can provide leave this as nullptr.
+	 * @param context Pointer to a DirectoryContext struct.
+	 * @param entries The entries to fill in.
+	 * @param metadata Should the metadata be filled in, as well as the type.
+	 * @return False is returned on error, True is returned on success. An entry
+	 *         that vanished since it was listed is not an error, and is left as is.
+	 */
+	bool ( *_F_stat_entries )( struct DirectoryContext*, std::span< struct FileEntry >, bool );
+
+	/**
+	 * Stop listing the directory and release the resources of the context.
+	 * @param context Pointer to a DirectoryContext struct.
+	 */
+	void ( *_F_close_directory )( struct DirectoryContext* );
 };
@@ -39,12 +39,10 @@ bool _normalize_filepath(
 
 			if ( nullptr == absolutePath )
 			{
-				// Set the error code and return false.
-				errorCode = errno;
 				return false;
 			}
 
-			normalizedPath = std::string( "file://" ) + std::string( absolutePath );
+			normalizedFilepath = std::string( "file://" ) + std::string( absolutePath );
 			free( absolutePath );
 			return true;
 		}
@@ -56,11 +54,55 @@ bool _normalize_filepath(
 std::string _get_scheme(
 	const std::string uri )
 {
-	std::string canonicalizedScheme;
 	std::string scheme = uri.substr( 0, uri.find( ':' ) );
 	// The canonical form of any URI scheme is lowercase,
 	// so transform to lowercase before returning the scheme.
-	std::transform( scheme.begin(), scheme.end(), canonicalizedScheme.begin(),
+	std::transform( scheme.begin(), scheme.end(), scheme.begin(),
 		[]( unsigned char character ) -> unsigned char { return std::tolower( character ); } );
-	return canonicalizedScheme;
+	return scheme;
+}
+
+bool _extract_uri_parameter(
+	std::string& uri,
+	const std::string& name,
+	std::string& value )
+{
+	size_t queryStart = uri.find( '?' );
+
+	if ( std::string::npos == queryStart )
+	{
+		return false;
+	}
+
+	size_t parameterStart = queryStart + 1;
+
+	while ( parameterStart < uri.size() )
+	{
+		size_t parameterEnd = uri.find( '&', parameterStart );
+		parameterEnd = ( std::string::npos == parameterEnd ) ? uri.size() : parameterEnd;
+		std::string parameter = uri.substr( parameterStart, parameterEnd - parameterStart );
+		size_t separator = parameter.find( '=' );
+
+		if ( parameter.substr( 0, separator ) == name )
+		{
+			value = ( std::string::npos == separator ) ? std::string() : parameter.substr( separator + 1 );
+
+			// Remove the parameter along with one of its delimiters,
+			// dropping the '?' entirely if it was the only parameter.
+			if ( parameterEnd < uri.size() )
+			{
+				uri.erase( parameterStart, parameterEnd + 1 - parameterStart );
+			}
+			else
+			{
+				uri.erase( parameterStart - 1 );
+			}
+
+			return true;
+		}
+
+		parameterStart = parameterEnd + 1;
+	}
+
+	return false;
 }
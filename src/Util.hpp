@@ -5,6 +5,8 @@
  */
 #pragma once
 
+#include <string>
+
 #define MICROSECONDS_IN_SECOND ( 1000000.0L )
 
 /*
@@ -24,3 +26,15 @@ bool _normalize_filepath(
  */
 std::string _get_scheme(
 	const std::string uri );
+
+/*
+ * Remove the query parameter {@param name} from {@param uri}.
+ * If the parameter is present, its value is stored in {@param value}
+ * and true is returned, else false is returned and {@param uri} is left untouched.
+ * Layers above the scheme are configured through query parameters, which
+ * must be removed before the URI is handed down to the scheme.
+ */
+bool _extract_uri_parameter(
+	std::string& uri,
+	const std::string& name,
+	std::string& value );
@@ -0,0 +1,199 @@
+/**
+ * Copyright ©2021. Brent Weichel. All Rights Reserved.
+ * Permission to use, copy, modify, and/or distribute this software, in whole
+ * or part by any means, without express prior written agreement is prohibited.
+ */
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "WorkerPool.hpp"
+
+struct WorkerPool
+{
+	std::mutex mMutex;
+	std::condition_variable mWorkAvailable;
+	std::deque< std::function< void() > > mQueue;
+	std::vector< std::thread > mThreads;
+	bool mStopping;
+};
+
+// A call of _run_parallel(), shared with the work it queues, which may
+// only be started by a worker once every run has been taken and returned.
+struct ParallelRun
+{
+	std::mutex mMutex;
+	std::condition_variable mRunsCompleted;
+	const std::function< void( unsigned int ) >* mWork;
+	unsigned int mRunCount;
+	unsigned int mNextRun;
+	unsigned int mCompletedRuns;
+};
+
+static void __worker_main(
+	struct WorkerPool* pool )
+{
+	std::unique_lock< std::mutex > queueLock( pool->mMutex );
+
+	while ( true )
+	{
+		pool->mWorkAvailable.wait( queueLock,
+			[ pool ]() { return pool->mStopping or not pool->mQueue.empty(); } );
+
+		if ( pool->mQueue.empty() )
+		{
+			// Stopping, and the queue has been drained.
+			return;
+		}
+
+		std::function< void() > work = std::move( pool->mQueue.front() );
+		pool->mQueue.pop_front();
+
+		queueLock.unlock();
+		work();
+		queueLock.lock();
+	}
+}
+
+struct WorkerPool* _create_worker_pool(
+	unsigned int threadCount )
+{
+	if ( 0 == threadCount )
+	{
+		threadCount = std::max( 1U, std::thread::hardware_concurrency() );
+	}
+
+	struct WorkerPool* pool = new ( std::nothrow ) WorkerPool();
+
+	if ( nullptr == pool )
+	{
+		return nullptr;
+	}
+
+	pool->mStopping = false;
+
+	try
+	{
+		for ( unsigned int threadIndex = 0; threadIndex < threadCount; ++threadIndex )
+		{
+			pool->mThreads.emplace_back( __worker_main, pool );
+		}
+	}
+	catch ( const std::system_error& )
+	{
+		_free_worker_pool( pool );
+		return nullptr;
+	}
+
+	return pool;
+}
+
+struct WorkerPool* _shared_worker_pool()
+{
+	static struct WorkerPool* pool = _create_worker_pool( 0 );
+	return pool;
+}
+
+/*
+ * Take and run the runs of {@param run} until none remain to be taken.
+ */
+static void __take_parallel_runs(
+	const std::shared_ptr< struct ParallelRun >& run )
+{
+	std::unique_lock< std::mutex > runLock( run->mMutex );
+
+	while ( run->mNextRun < run->mRunCount )
+	{
+		unsigned int workerIndex = run->mNextRun++;
+
+		runLock.unlock();
+		( *run->mWork )( workerIndex );
+		runLock.lock();
+
+		if ( ++run->mCompletedRuns == run->mRunCount )
+		{
+			run->mRunsCompleted.notify_all();
+		}
+	}
+}
+
+void _run_parallel(
+	struct WorkerPool* pool,
+	unsigned int workerCount,
+	const std::function< void( unsigned int ) >& work )
+{
+	if ( ( nullptr == pool ) or ( 1 >= workerCount ) )
+	{
+		for ( unsigned int workerIndex = 0; workerIndex < workerCount; ++workerIndex )
+		{
+			work( workerIndex );
+		}
+
+		return;
+	}
+
+	std::shared_ptr< struct ParallelRun > run = std::make_shared< struct ParallelRun >();
+	run->mWork = &work;
+	run->mRunCount = workerCount;
+	run->mNextRun = 0;
+	run->mCompletedRuns = 0;
+
+	for ( unsigned int workerIndex = 1; workerIndex < workerCount; ++workerIndex )
+	{
+		_submit_work( pool, [ run ]() { __take_parallel_runs( run ); } );
+	}
+
+	__take_parallel_runs( run );
+
+	std::unique_lock< std::mutex > runLock( run->mMutex );
+	run->mRunsCompleted.wait( runLock, [ &run ]() { return run->mCompletedRuns == run->mRunCount; } );
+}
+
+void _submit_work(
+	struct WorkerPool* pool,
+	std::function< void() > work )
+{
+	{
+		std::lock_guard queueLock( pool->mMutex );
+		pool->mQueue.emplace_back( std::move( work ) );
+	}
+
+	pool->mWorkAvailable.notify_one();
+}
+
+unsigned int _worker_count(
+	const struct WorkerPool* pool )
+{
+	return static_cast< unsigned int >( pool->mThreads.size() );
+}
+
+void _free_worker_pool(
+	struct WorkerPool* pool )
+{
+	if ( nullptr == pool )
+	{
+		return;
+	}
+
+	{
+		std::lock_guard queueLock( pool->mMutex );
+		pool->mStopping = true;
+	}
+
+	pool->mWorkAvailable.notify_all();
+
+	for ( std::thread& thread : pool->mThreads )
+	{
+		thread.join();
+	}
+
+	delete pool;
+}
@@ -0,0 +1,64 @@
+/**
+ * Copyright ©2021. Brent Weichel. All Rights Reserved.
+ * Permission to use, copy, modify, and/or distribute this software, in whole
+ * or part by any means, without express prior written agreement is prohibited.
+ */
+#pragma once
+
+#include <functional>
+
+struct WorkerPool;
+
+/*
+ * Start a pool of worker threads.
+ * @param threadCount The number of worker threads. Zero selects the number of hardware threads.
+ * @return A pointer to the pool is returned, or nullptr if the threads could not be started.
+ */
+struct WorkerPool* _create_worker_pool(
+	unsigned int threadCount );
+
+/*
+ * Get the process-wide pool, which has a worker thread per hardware thread and
+ * is started on first use. Work is run in parallel on it, rather than on pools
+ * of its own, so that the process doesn't run more threads than the hardware.
+ * @return A pointer to the pool is returned, or nullptr if the threads could not be started.
+ */
+struct WorkerPool* _shared_worker_pool();
+
+/*
+ * Queue work to be run on one of the worker threads.
+ * @param pool A pointer to the pool.
+ * @param work The work to be run.
+ */
+void _submit_work(
+	struct WorkerPool* pool,
+	std::function< void() > work );
+
+/*
+ * Run {@param work} once for each worker index in [ 0, {@param workerCount} ), in
+ * parallel on the pool and the calling thread, and wait for every run to return.
+ * The calling thread runs whatever the workers have yet to start, so this may be
+ * called from a worker thread, and completes even if every worker is busy.
+ * @param pool A pointer to the pool, or nullptr to run everything on the calling thread.
+ * @param workerCount The number of times to run {@param work}.
+ * @param work The work to be run, passed the worker index.
+ */
+void _run_parallel(
+	struct WorkerPool* pool,
+	unsigned int workerCount,
+	const std::function< void( unsigned int ) >& work );
+
+/*
+ * Get the number of worker threads in the pool.
+ * @param pool A pointer to the pool.
+ * @return The number of worker threads.
+ */
+unsigned int _worker_count(
+	const struct WorkerPool* pool );
+
+/*
+ * Run the work remaining in the queue, then join and release the worker threads.
+ * @param pool A pointer to the pool.
+ */
+void _free_worker_pool(
+	struct WorkerPool* pool );
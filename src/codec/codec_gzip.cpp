@@ -0,0 +1,139 @@
+/**
+ * Copyright ©2021. Brent Weichel. All Rights Reserved.
+ * Permission to use, copy, modify, and/or distribute this software, in whole
+ * or part by any means, without express prior written agreement is prohibited.
+ */
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <zlib.h>
+
+#include "codec_gzip.hpp"
+
+// Window bits of 15 plus 16 selects the gzip wrapper rather than raw zlib.
+#define CODEC_GZIP_WINDOW_BITS ( 15 + 16 )
+
+void* __codec_gzip_create_decoder()
+{
+	z_stream* stream = static_cast< z_stream* >( calloc( 1, sizeof( z_stream ) ) );
+
+	if ( ( nullptr != stream )
+		and ( Z_OK != inflateInit2( stream, CODEC_GZIP_WINDOW_BITS ) ) )
+	{
+		free( stream );
+		return nullptr;
+	}
+
+	return stream;
+}
+
+void* __codec_gzip_create_encoder()
+{
+	z_stream* stream = static_cast< z_stream* >( calloc( 1, sizeof( z_stream ) ) );
+
+	if ( ( nullptr != stream )
+		and ( Z_OK != deflateInit2( stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+			CODEC_GZIP_WINDOW_BITS, 8, Z_DEFAULT_STRATEGY ) ) )
+	{
+		free( stream );
+		return nullptr;
+	}
+
+	return stream;
+}
+
+int __codec_gzip_decode(
+	void* decoder,
+	const uint8_t* input,
+	size_t inputSize,
+	size_t& inputConsumed,
+	uint8_t* output,
+	size_t outputSize,
+	size_t& outputProduced,
+	bool& frameEnd )
+{
+	z_stream* stream = static_cast< z_stream* >( decoder );
+
+	stream->next_in = const_cast< Bytef* >( input );
+	stream->avail_in = static_cast< uInt >( inputSize );
+	stream->next_out = output;
+	stream->avail_out = static_cast< uInt >( outputSize );
+
+	int status = inflate( stream, Z_NO_FLUSH );
+
+	inputConsumed = inputSize - stream->avail_in;
+	outputProduced = outputSize - stream->avail_out;
+	frameEnd = false;
+
+	// Each gzip member is a frame; concatenated members form a valid stream.
+	if ( Z_STREAM_END == status )
+	{
+		frameEnd = true;
+		return ( Z_OK == inflateReset( stream ) ) ? CODEC_STATUS_DONE : CODEC_STATUS_ERROR;
+	}
+
+	return ( ( Z_OK == status ) or ( Z_BUF_ERROR == status ) ) ? CODEC_STATUS_DONE : CODEC_STATUS_ERROR;
+}
+
+int __codec_gzip_encode(
+	void* encoder,
+	const uint8_t* input,
+	size_t inputSize,
+	size_t& inputConsumed,
+	uint8_t* output,
+	size_t outputSize,
+	size_t& outputProduced,
+	bool endFrame )
+{
+	z_stream* stream = static_cast< z_stream* >( encoder );
+
+	stream->next_in = const_cast< Bytef* >( input );
+	stream->avail_in = static_cast< uInt >( inputSize );
+	stream->next_out = output;
+	stream->avail_out = static_cast< uInt >( outputSize );
+
+	int status = deflate( stream, endFrame ? Z_FINISH : Z_NO_FLUSH );
+
+	inputConsumed = inputSize - stream->avail_in;
+	outputProduced = outputSize - stream->avail_out;
+
+	if ( Z_STREAM_END == status )
+	{
+		return ( Z_OK == deflateReset( stream ) ) ? CODEC_STATUS_DONE : CODEC_STATUS_ERROR;
+	}
+
+	if ( ( Z_OK != status ) and ( Z_BUF_ERROR != status ) )
+	{
+		return CODEC_STATUS_ERROR;
+	}
+
+	return ( endFrame or ( 0 != stream->avail_in ) or ( 0 == stream->avail_out ) )
+		? CODEC_STATUS_PENDING
+		: CODEC_STATUS_DONE;
+}
+
+void __codec_gzip_free_decoder(
+	void* decoder )
+{
+	if ( nullptr != decoder )
+	{
+		inflateEnd( static_cast< z_stream* >( decoder ) );
+		free( decoder );
+	}
+}
+
+void __codec_gzip_free_encoder(
+	void* encoder )
+{
+	if ( nullptr != encoder )
+	{
+		deflateEnd( static_cast< z_stream* >( encoder ) );
+		free( encoder );
+	}
+}
+
+bool __codec_gzip_reset_decoder(
+	void* decoder )
+{
+	return Z_OK == inflateReset( static_cast< z_stream* >( decoder ) );
+}
@@ -0,0 +1,61 @@
+/**
+ * Copyright ©2021. Brent Weichel. All Rights Reserved.
+ * Permission to use, copy, modify, and/or distribute this software, in whole
+ * or part by any means, without express prior written agreement is prohibited.
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "Codec.hpp"
+
+// API Implementing Function Prototypes
+void* __codec_gzip_create_decoder();
+
+void* __codec_gzip_create_encoder();
+
+int __codec_gzip_decode(
+	void* decoder,
+	const uint8_t* input,
+	size_t inputSize,
+	size_t& inputConsumed,
+	uint8_t* output,
+	size_t outputSize,
+	size_t& outputProduced,
+	bool& frameEnd );
+
+int __codec_gzip_encode(
+	void* encoder,
+	const uint8_t* input,
+	size_t inputSize,
+	size_t& inputConsumed,
+	uint8_t* output,
+	size_t outputSize,
+	size_t& outputProduced,
+	bool endFrame );
+
+void __codec_gzip_free_decoder(
+	void* decoder );
+
+void __codec_gzip_free_encoder(
+	void* encoder );
+
+bool __codec_gzip_reset_decoder(
+	void* decoder );
+
+// Codec API Constants
+const std::string CODEC_GZIP_CANONICAL_NAME( "gzip" );
+const std::string CODEC_GZIP_SUFFIX( ".gz" );
+
+const struct CodecAPI CODEC_GZIP_API =
+{
+	._F_create_decoder = __codec_gzip_create_decoder,
+	._F_free_decoder = __codec_gzip_free_decoder,
+	._F_reset_decoder = __codec_gzip_reset_decoder,
+	._F_decode = __codec_gzip_decode,
+	._F_create_encoder = __codec_gzip_create_encoder,
+	._F_free_encoder = __codec_gzip_free_encoder,
+	._F_encode = __codec_gzip_encode
+};
@@ -0,0 +1,185 @@
+/**
+ * Copyright ©2021. Brent Weichel. All Rights Reserved.
+ * Permission to use, copy, modify, and/or distribute this software, in whole
+ * or part by any means, without express prior written agreement is prohibited.
+ */
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <lz4frame.h>
+
+#include "codec_lz4.hpp"
+
+// Largest slice of input handed to LZ4F_compressUpdate() in one call,
+// which keeps the required output capacity (LZ4F_compressBound) small.
+#define CODEC_LZ4_UPDATE_SIZE ( 64 * 1024 )
+
+struct CodecLZ4Encoder
+{
+	LZ4F_cctx* mContext;
+	LZ4F_preferences_t mPreferences;
+	bool mFrameOpen;
+};
+
+void* __codec_lz4_create_decoder()
+{
+	LZ4F_dctx* decoderContext = nullptr;
+
+	if ( LZ4F_isError( LZ4F_createDecompressionContext( &decoderContext, LZ4F_VERSION ) ) )
+	{
+		return nullptr;
+	}
+
+	return decoderContext;
+}
+
+void* __codec_lz4_create_encoder()
+{
+	struct CodecLZ4Encoder* encoder = static_cast< struct CodecLZ4Encoder* >(
+		calloc( 1, sizeof( struct CodecLZ4Encoder ) ) );
+
+	if ( nullptr == encoder )
+	{
+		return nullptr;
+	}
+
+	if ( LZ4F_isError( LZ4F_createCompressionContext( &encoder->mContext, LZ4F_VERSION ) ) )
+	{
+		free( encoder );
+		return nullptr;
+	}
+
+	encoder->mPreferences.frameInfo.contentChecksumFlag = LZ4F_contentChecksumEnabled;
+	return encoder;
+}
+
+int __codec_lz4_decode(
+	void* decoder,
+	const uint8_t* input,
+	size_t inputSize,
+	size_t& inputConsumed,
+	uint8_t* output,
+	size_t outputSize,
+	size_t& outputProduced,
+	bool& frameEnd )
+{
+	inputConsumed = inputSize;
+	outputProduced = outputSize;
+
+	// LZ4F_decompress() stops at the end of a frame and returns zero there.
+	size_t hint = LZ4F_decompress( static_cast< LZ4F_dctx* >( decoder ),
+		output, &outputProduced, input, &inputConsumed, nullptr );
+
+	frameEnd = false;
+
+	if ( LZ4F_isError( hint ) )
+	{
+		return CODEC_STATUS_ERROR;
+	}
+
+	frameEnd = ( 0 == hint );
+	return CODEC_STATUS_DONE;
+}
+
+int __codec_lz4_encode(
+	void* encoder,
+	const uint8_t* input,
+	size_t inputSize,
+	size_t& inputConsumed,
+	uint8_t* output,
+	size_t outputSize,
+	size_t& outputProduced,
+	bool endFrame )
+{
+	struct CodecLZ4Encoder* lz4Encoder = static_cast< struct CodecLZ4Encoder* >( encoder );
+	size_t status;
+
+	inputConsumed = 0;
+	outputProduced = 0;
+
+	if ( not lz4Encoder->mFrameOpen )
+	{
+		if ( LZ4F_HEADER_SIZE_MAX > outputSize )
+		{
+			return CODEC_STATUS_PENDING;
+		}
+
+		status = LZ4F_compressBegin( lz4Encoder->mContext, output, outputSize, &lz4Encoder->mPreferences );
+
+		if ( LZ4F_isError( status ) )
+		{
+			return CODEC_STATUS_ERROR;
+		}
+
+		outputProduced += status;
+		lz4Encoder->mFrameOpen = true;
+	}
+
+	while ( inputConsumed < inputSize )
+	{
+		size_t updateSize = std::min< size_t >( inputSize - inputConsumed, CODEC_LZ4_UPDATE_SIZE );
+
+		if ( LZ4F_compressBound( updateSize, &lz4Encoder->mPreferences ) > ( outputSize - outputProduced ) )
+		{
+			return CODEC_STATUS_PENDING;
+		}
+
+		status = LZ4F_compressUpdate( lz4Encoder->mContext, output + outputProduced,
+			outputSize - outputProduced, input + inputConsumed, updateSize, nullptr );
+
+		if ( LZ4F_isError( status ) )
+		{
+			return CODEC_STATUS_ERROR;
+		}
+
+		outputProduced += status;
+		inputConsumed += updateSize;
+	}
+
+	if ( endFrame )
+	{
+		if ( LZ4F_compressBound( 0, &lz4Encoder->mPreferences ) > ( outputSize - outputProduced ) )
+		{
+			return CODEC_STATUS_PENDING;
+		}
+
+		status = LZ4F_compressEnd( lz4Encoder->mContext, output + outputProduced,
+			outputSize - outputProduced, nullptr );
+
+		if ( LZ4F_isError( status ) )
+		{
+			return CODEC_STATUS_ERROR;
+		}
+
+		outputProduced += status;
+		lz4Encoder->mFrameOpen = false;
+	}
+
+	return CODEC_STATUS_DONE;
+}
+
+void __codec_lz4_free_decoder(
+	void* decoder )
+{
+	LZ4F_freeDecompressionContext( static_cast< LZ4F_dctx* >( decoder ) );
+}
+
+void __codec_lz4_free_encoder(
+	void* encoder )
+{
+	struct CodecLZ4Encoder* lz4Encoder = static_cast< struct CodecLZ4Encoder* >( encoder );
+
+	if ( nullptr != lz4Encoder )
+	{
+		LZ4F_freeCompressionContext( lz4Encoder->mContext );
+		free( lz4Encoder );
+	}
+}
+
+bool __codec_lz4_reset_decoder(
+	void* decoder )
+{
+	LZ4F_resetDecompressionContext( static_cast< LZ4F_dctx* >( decoder ) );
+	return true;
+}
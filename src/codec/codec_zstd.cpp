@@ -0,0 +1,111 @@
+/**
+ * Copyright ©2021. Brent Weichel. All Rights Reserved.
+ * Permission to use, copy, modify, and/or distribute this software, in whole
+ * or part by any means, without express prior written agreement is prohibited.
+ */
+#include <cstddef>
+#include <cstdint>
+#include <zstd.h>
+
+#include "codec_zstd.hpp"
+
+void* __codec_zstd_create_decoder()
+{
+	return ZSTD_createDCtx();
+}
+
+void* __codec_zstd_create_encoder()
+{
+	ZSTD_CCtx* encoderContext = ZSTD_createCCtx();
+
+	if ( ( nullptr != encoderContext )
+		and ZSTD_isError( ZSTD_CCtx_setParameter( encoderContext, ZSTD_c_checksumFlag, 1 ) ) )
+	{
+		ZSTD_freeCCtx( encoderContext );
+		return nullptr;
+	}
+
+	return encoderContext;
+}
+
+int __codec_zstd_decode(
+	void* decoder,
+	const uint8_t* input,
+	size_t inputSize,
+	size_t& inputConsumed,
+	uint8_t* output,
+	size_t outputSize,
+	size_t& outputProduced,
+	bool& frameEnd )
+{
+	ZSTD_inBuffer inputBuffer = { input, inputSize, 0 };
+	ZSTD_outBuffer outputBuffer = { output, outputSize, 0 };
+
+	// ZSTD_decompressStream() never decodes past the end of a frame,
+	// and returns zero once the frame has been completely flushed.
+	size_t status = ZSTD_decompressStream( static_cast< ZSTD_DCtx* >( decoder ), &outputBuffer, &inputBuffer );
+
+	inputConsumed = inputBuffer.pos;
+	outputProduced = outputBuffer.pos;
+	frameEnd = false;
+
+	if ( ZSTD_isError( status ) )
+	{
+		return CODEC_STATUS_ERROR;
+	}
+
+	frameEnd = ( 0 == status );
+	return CODEC_STATUS_DONE;
+}
+
+int __codec_zstd_encode(
+	void* encoder,
+	const uint8_t* input,
+	size_t inputSize,
+	size_t& inputConsumed,
+	uint8_t* output,
+	size_t outputSize,
+	size_t& outputProduced,
+	bool endFrame )
+{
+	ZSTD_inBuffer inputBuffer = { input, inputSize, 0 };
+	ZSTD_outBuffer outputBuffer = { output, outputSize, 0 };
+
+	size_t remaining = ZSTD_compressStream2( static_cast< ZSTD_CCtx* >( encoder ),
+		&outputBuffer, &inputBuffer, endFrame ? ZSTD_e_end : ZSTD_e_continue );
+
+	inputConsumed = inputBuffer.pos;
+	outputProduced = outputBuffer.pos;
+
+	if ( ZSTD_isError( remaining ) )
+	{
+		return CODEC_STATUS_ERROR;
+	}
+
+	if ( endFrame )
+	{
+		return ( 0 == remaining ) ? CODEC_STATUS_DONE : CODEC_STATUS_PENDING;
+	}
+
+	return ( ( inputBuffer.pos < inputBuffer.size ) or ( outputBuffer.pos == outputBuffer.size ) )
+		? CODEC_STATUS_PENDING
+		: CODEC_STATUS_DONE;
+}
+
+void __codec_zstd_free_decoder(
+	void* decoder )
+{
+	ZSTD_freeDCtx( static_cast< ZSTD_DCtx* >( decoder ) );
+}
+
+void __codec_zstd_free_encoder(
+	void* encoder )
+{
+	ZSTD_freeCCtx( static_cast< ZSTD_CCtx* >( encoder ) );
+}
+
+bool __codec_zstd_reset_decoder(
+	void* decoder )
+{
+	return not ZSTD_isError( ZSTD_DCtx_reset( static_cast< ZSTD_DCtx* >( decoder ), ZSTD_reset_session_only ) );
+}
@@ -0,0 +1,61 @@
+/**
+ * Copyright ©2021. Brent Weichel. All Rights Reserved.
+ * Permission to use, copy, modify, and/or distribute this software, in whole
+ * or part by any means, without express prior written agreement is prohibited.
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "Codec.hpp"
+
+// API Implementing Function Prototypes
+void* __codec_zstd_create_decoder();
+
+void* __codec_zstd_create_encoder();
+
+int __codec_zstd_decode(
+	void* decoder,
+	const uint8_t* input,
+	size_t inputSize,
+	size_t& inputConsumed,
+	uint8_t* output,
+	size_t outputSize,
+	size_t& outputProduced,
+	bool& frameEnd );
+
+int __codec_zstd_encode(
+	void* encoder,
+	const uint8_t* input,
+	size_t inputSize,
+	size_t& inputConsumed,
+	uint8_t* output,
+	size_t outputSize,
+	size_t& outputProduced,
+	bool endFrame );
+
+void __codec_zstd_free_decoder(
+	void* decoder );
+
+void __codec_zstd_free_encoder(
+	void* encoder );
+
+bool __codec_zstd_reset_decoder(
+	void* decoder );
+
+// Codec API Constants
+const std::string CODEC_ZSTD_CANONICAL_NAME( "zstd" );
+const std::string CODEC_ZSTD_SUFFIX( ".zst" );
+
+const struct CodecAPI CODEC_ZSTD_API =
+{
+	._F_create_decoder = __codec_zstd_create_decoder,
+	._F_free_decoder = __codec_zstd_free_decoder,
+	._F_reset_decoder = __codec_zstd_reset_decoder,
+	._F_decode = __codec_zstd_decode,
+	._F_create_encoder = __codec_zstd_create_encoder,
+	._F_free_encoder = __codec_zstd_free_encoder,
+	._F_encode = __codec_zstd_encode
+};
@@ -4,178 +4,2154 @@
  * or part by any means, without express prior written agreement is prohibited.
  */
 #include <algorithm>
+#include <atomic>
 #include <cerrno>
+#include <condition_variable>
 #include <cstdint>
+#include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <linux/falloc.h>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <new>
 #include <string>
+#include <thread>
+#include <linux/fs.h>
+#include <sys/inotify.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/sendfile.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/uio.h>
 #include <unistd.h>
+#include <vector>
 
 #include "File.hpp"
+#include "FileChunks.hpp"
 #include "FileContext.hpp"
+#include "FileDirectory.hpp"
+#include "Util.hpp"
+#include "WorkerPool.hpp"
 #include "scheme_file.hpp"
 
+// Non-zero fills are written from a pattern buffer of this size,
+// repeated this many times over in each vectored write.
+#define SCHEME_FILE_FILL_BUFFER_SIZE  ( 1024 * 1024 )
+#define SCHEME_FILE_FILL_VECTOR_COUNT ( 16 )
+
+// Most appends a group commit hands to a single pwritev() call.
+#define SCHEME_FILE_APPEND_VECTOR_COUNT ( 1024 )
+
+// Directories are listed with getdents64() into a buffer of this size, so that even
+// large directories take few system calls. Entries are stat'd on up to this many
+// threads, which claim this many entries at a time.
+#define SCHEME_FILE_DIRECTORY_BUFFER_SIZE ( 1024 * 1024 )
+#define SCHEME_FILE_STAT_THREAD_COUNT     ( 16 )
+#define SCHEME_FILE_STAT_BATCH_SIZE       ( 64 )
+
+// Linux moves at most 2 GiB less a page per read() or write() call, so larger
+// requests are split into calls of this many bytes.
+#define SCHEME_FILE_IO_SIZE ( 1024 * 1024 * 1024 )
+
+// Most bytes moved by a single splice(), copy_file_range() or sendfile() call, and
+// the buffer that bytes are copied through where the kernel can't move them itself.
+#define SCHEME_FILE_SPLICE_SIZE       ( 1024 * 1024 * 1024 )
+#define SCHEME_FILE_COPY_BUFFER_SIZE  ( 64 * 1024 )
+
+// The handles of regular files are closed while idle to keep the process within a
+// budget, and reopened by path on next use; see __scheme_file_acquire_handle(). The
+// budget defaults to the RLIMIT_NOFILE soft limit, less this many for everything else.
+#define SCHEME_FILE_HANDLE_RESERVE ( 64 )
+
+// Set in mHandleUsers while the handle of a file is closed.
+#define SCHEME_FILE_HANDLE_CLOSED ( 0x80000000U )
+
+/*
+ * An append waiting on a group commit. It lives on the stack of the appending thread.
+ */
+struct SchemeFileAppend
+{
+	const uint8_t* mBuffer;
+	size_t mBytes;
+	int64_t mOffset;
+	int64_t mBytesWritten;
+	bool mDone;
+};
+
+/*
+ * Appends arriving while a commit is in progress queue up in mPending, and the first
+ * of them to find no commit in progress becomes the leader that commits them all.
+ */
+struct SchemeFileGroupCommit
+{
+	std::mutex mMutex;
+	std::condition_variable mCommitted;
+	std::vector< struct SchemeFileAppend* > mPending;
+	bool mCommitting;
+};
+
 struct SchemeFileContext
 {
-	int mFileHandle;
-	int mErrorCode;
-};
+	int mFileHandle;
+	int mErrorCode;
+
+	// The contexts sharing the file, which is closed with the last of them; see __scheme_file_dup().
+	// Files are read and written at the file position of each context, never that of mFileHandle.
+	std::atomic_uint32_t mReferenceCount;
+	struct SchemeFileGroupCommit* mGroupCommit;
+
+	// Opened with "sync=0", writes are only made durable by sync().
+	bool mDeferSync;
+
+	// The directory of the file, where its replacements and snapshots are created.
+	char* mDirectoryPath;
+
+	// The path and flags the file was opened with, for reopening the path once
+	// another file takes its place. These are left unset for atomic writes.
+	char* mFilePath;
+	int mOpenFlags;
+
+	// The S_IFMT bits of the file; pipes, devices, and sockets are streamed.
+	mode_t mFileType;
+
+	// Set for regular files opened by path, whose handle is closed while idle should the
+	// process need more files than the handle budget allows. mHandleUsers counts the
+	// operations using the handle, with SCHEME_FILE_HANDLE_CLOSED set while it's closed.
+	// The handle is only reopened if the path still leads to mDevice and mInode.
+	std::atomic_bool mHandleBudgeted;
+	std::atomic_uint32_t mHandleUsers;
+	std::atomic_bool mHandleReferenced; // Used since the clock hand last passed
+	size_t mHandleSlot; // Index into _G_BudgetedHandles while open
+	dev_t mDevice;
+	ino_t mInode;
+
+	// Opened with File::IOFlag::ATOMIC, the file is written anonymously (or under
+	// mTemporaryPath where O_TMPFILE is unsupported) until published over mTargetPath.
+	// Both paths are released once published, and mPublishSequence is then set.
+	char* mTargetPath;
+	char* mTemporaryPath;
+	uint64_t mPublishSequence;
+};
+
+struct SchemeFileDirectoryContext
+{
+	int mDirectoryHandle;
+	std::vector< uint8_t > mBuffer;
+};
+
+// Publishes are numbered in the order their renames complete. A directory synced after
+// publish N had completed makes publishes 1 through N durable, for the files in it.
+static std::atomic_uint64_t _G_PublishSequence( 0 );
+static std::atomic_uint64_t _G_TemporaryCounter( 0 );
+static std::mutex _G_DirectorySyncMutex;
+static std::map< std::string, uint64_t > _G_DirectorySyncSequence;
+
+// The open handles within the budget, swept by the clock hand, and the counters of the budget.
+static std::mutex _G_HandleBudgetMutex;
+static std::vector< struct SchemeFileContext* > _G_BudgetedHandles;
+static size_t _G_HandleClockHand = 0;
+static size_t _G_HandleBudget = 0; // Zero until set, or defaulted on first use
+static uint64_t _G_BudgetedFileCount = 0;
+static uint64_t _G_HandleEvictionCount = 0;
+static uint64_t _G_HandleReopenCount = 0;
+
+struct SchemeFileContext* __allocate_scheme_file_context()
+{
+	// Value-initialized, as the atomics rule out calloc().
+	struct SchemeFileContext* schemeContext = new ( std::nothrow ) SchemeFileContext();
+
+	if ( nullptr != schemeContext )
+	{
+		schemeContext->mFileHandle = -1;
+		schemeContext->mReferenceCount = 1;
+	}
+
+	return schemeContext;
+}
+
+void __free_scheme_file_context(
+	struct SchemeFileContext* context )
+{
+	delete context->mGroupCommit;
+	free( context->mTargetPath );
+	free( context->mTemporaryPath );
+	free( context->mDirectoryPath );
+	free( context->mFilePath );
+	delete context;
+}
+
+/*
+ * Get the handle budget, defaulting it from the RLIMIT_NOFILE soft limit. Called with the budget lock held.
+ */
+size_t __scheme_file_handle_budget()
+{
+	struct rlimit handleLimit;
+
+	if ( 0 != _G_HandleBudget )
+	{
+		return _G_HandleBudget;
+	}
+
+	if ( ( 0 != getrlimit( RLIMIT_NOFILE, &handleLimit ) ) or ( RLIM_INFINITY == handleLimit.rlim_cur ) )
+	{
+		_G_HandleBudget = SIZE_MAX;
+	}
+	else
+	{
+		size_t handleCount = handleLimit.rlim_cur;
+		_G_HandleBudget = std::max< size_t >( { handleCount - std::min< size_t >( handleCount, SCHEME_FILE_HANDLE_RESERVE ), handleCount / 2, 1 } );
+	}
+
+	return _G_HandleBudget;
+}
+
+/*
+ * Add an open handle to, or remove one from, those swept by the clock hand. Called with the budget lock held.
+ */
+void __scheme_file_list_handle(
+	struct SchemeFileContext* schemeContext )
+{
+	schemeContext->mHandleSlot = _G_BudgetedHandles.size();
+	_G_BudgetedHandles.push_back( schemeContext );
+}
+
+void __scheme_file_unlist_handle(
+	struct SchemeFileContext* schemeContext )
+{
+	size_t slot = schemeContext->mHandleSlot;
+
+	_G_BudgetedHandles[ slot ] = _G_BudgetedHandles.back();
+	_G_BudgetedHandles[ slot ]->mHandleSlot = slot;
+	_G_BudgetedHandles.pop_back();
+}
+
+/*
+ * Close the handle of an idle file within the budget, picked by a clock sweep as an
+ * approximation of the least recently used. Called with the budget lock held.
+ * @return False is returned if every handle within the budget is in use.
+ */
+bool __scheme_file_evict_handle()
+{
+	// A file used since the hand last passed is spared once, so two sweeps reach every idle file.
+	for ( size_t step = 0; step < 2 * _G_BudgetedHandles.size(); ++step )
+	{
+		_G_HandleClockHand = ( _G_HandleClockHand + 1 ) % _G_BudgetedHandles.size();
+
+		struct SchemeFileContext* candidate = _G_BudgetedHandles[ _G_HandleClockHand ];
+		uint32_t idleUsers = 0;
+
+		if ( candidate->mHandleReferenced.exchange( false )
+			or not candidate->mHandleUsers.compare_exchange_strong( idleUsers, SCHEME_FILE_HANDLE_CLOSED ) )
+		{
+			continue;
+		}
+
+		close( candidate->mFileHandle );
+		candidate->mFileHandle = -1;
+		__scheme_file_unlist_handle( candidate );
+		++_G_HandleEvictionCount;
+		return true;
+	}
+
+	return false;
+}
+
+/*
+ * open() a path, closing idle handles within the budget to make room should the process
+ * have run out of them. Called with the budget lock held if {@param locked}.
+ * @return The handle is returned. On error, -1 is returned, and errno is set.
+ */
+int __scheme_file_open_path(
+	const char* filePath,
+	int openFlags,
+	mode_t fileMode,
+	bool locked )
+{
+	int fileHandle = open( filePath, openFlags, fileMode );
+
+	while ( ( -1 == fileHandle ) and ( ( EMFILE == errno ) or ( ENFILE == errno ) ) )
+	{
+		int errorCode = errno;
+		bool evicted = false;
+
+		if ( locked )
+		{
+			evicted = __scheme_file_evict_handle();
+		}
+		else
+		{
+			std::lock_guard< std::mutex > budgetLock( _G_HandleBudgetMutex );
+			evicted = __scheme_file_evict_handle();
+		}
+
+		if ( not evicted )
+		{
+			errno = errorCode;
+			break;
+		}
+
+		fileHandle = open( filePath, openFlags, fileMode );
+	}
+
+	return fileHandle;
+}
+
+/*
+ * Reopen the closed handle of a file within the budget, closing the idle handles of
+ * others should the budget be spent. Called with the budget lock held.
+ * @return False is returned on error, with the error code set; ESTALE if the path no
+ *         longer leads to the file, having been replaced while its handle was closed.
+ */
+bool __scheme_file_reopen_handle(
+	struct SchemeFileContext* schemeContext )
+{
+	struct stat fileStatus;
+	int fileHandle = -1;
+
+	while ( ( _G_BudgetedHandles.size() >= __scheme_file_handle_budget() ) and __scheme_file_evict_handle() )
+	{
+	}
+
+	fileHandle = __scheme_file_open_path( schemeContext->mFilePath, schemeContext->mOpenFlags | O_CLOEXEC, 0, true );
+
+	if ( -1 == fileHandle )
+	{
+		schemeContext->mErrorCode = errno;
+		return false;
+	}
+
+	if ( ( -1 == fstat( fileHandle, &fileStatus ) )
+		or ( fileStatus.st_dev != schemeContext->mDevice )
+		or ( fileStatus.st_ino != schemeContext->mInode ) )
+	{
+		schemeContext->mErrorCode = ESTALE;
+		close( fileHandle );
+		return false;
+	}
+
+	schemeContext->mFileHandle = fileHandle;
+	__scheme_file_list_handle( schemeContext );
+	schemeContext->mHandleUsers &= ~SCHEME_FILE_HANDLE_CLOSED;
+	++_G_HandleReopenCount;
+	return true;
+}
+
+/*
+ * Start using the handle of a file, reopening it should it have been closed to stay
+ * within the budget. It stays open until __scheme_file_release_handle().
+ * @param counted Reference to store whether the use was counted, and must be released.
+ * @return False is returned if the handle couldn't be reopened, with the error code set.
+ */
+bool __scheme_file_acquire_handle(
+	struct SchemeFileContext* schemeContext,
+	bool& counted )
+{
+	counted = false;
+
+	if ( not schemeContext->mHandleBudgeted )
+	{
+		return true;
+	}
+
+	schemeContext->mHandleReferenced.store( true, std::memory_order_relaxed );
+
+	if ( 0 == ( SCHEME_FILE_HANDLE_CLOSED & ++schemeContext->mHandleUsers ) )
+	{
+		counted = true;
+		return true;
+	}
+
+	--schemeContext->mHandleUsers;
+
+	std::lock_guard< std::mutex > budgetLock( _G_HandleBudgetMutex );
+
+	// Another thread may have reopened the handle, or taken the file out of the budget, while this one waited.
+	if ( ( -1 == schemeContext->mFileHandle ) and not __scheme_file_reopen_handle( schemeContext ) )
+	{
+		return false;
+	}
+
+	++schemeContext->mHandleUsers;
+	counted = true;
+	return true;
+}
+
+void __scheme_file_release_handle(
+	struct SchemeFileContext* schemeContext )
+{
+	--schemeContext->mHandleUsers;
+}
+
+/*
+ * Holds the handle of a file open for the duration of an operation, during which
+ * mFileHandle of the scheme context can be used as is.
+ */
+struct SchemeFileHandleUse
+{
+	struct SchemeFileContext* mSchemeContext;
+	bool mCounted;
+	bool mAcquired;
+
+	explicit SchemeFileHandleUse(
+		struct SchemeFileContext* schemeContext ) :
+		mSchemeContext( schemeContext ),
+		mCounted( false ),
+		mAcquired( __scheme_file_acquire_handle( schemeContext, mCounted ) )
+	{
+	}
+
+	~SchemeFileHandleUse()
+	{
+		if ( mCounted )
+		{
+			__scheme_file_release_handle( mSchemeContext );
+		}
+	}
+
+	SchemeFileHandleUse( const SchemeFileHandleUse& other ) = delete;
+	SchemeFileHandleUse& operator=( const SchemeFileHandleUse& other ) = delete;
+};
+
+/*
+ * Bring the handle of a newly opened file within the budget, closing the idle handles
+ * of others should the budget be spent.
+ */
+void __scheme_file_budget_handle(
+	struct SchemeFileContext* schemeContext )
+{
+	std::lock_guard< std::mutex > budgetLock( _G_HandleBudgetMutex );
+
+	while ( ( _G_BudgetedHandles.size() >= __scheme_file_handle_budget() ) and __scheme_file_evict_handle() )
+	{
+	}
+
+	__scheme_file_list_handle( schemeContext );
+	schemeContext->mHandleReferenced = true;
+	schemeContext->mHandleBudgeted = true;
+	++_G_BudgetedFileCount;
+}
+
+/*
+ * Take a file out of the budget for good, reopening its handle should it be closed, for
+ * operations that hold on to the handle beyond a call; e.g. following the file, which
+ * detects its replacement by way of the handle, and polling it.
+ * @return False is returned if the handle couldn't be reopened, with the error code set.
+ */
+bool __scheme_file_keep_handle(
+	struct SchemeFileContext* schemeContext )
+{
+	if ( not schemeContext->mHandleBudgeted )
+	{
+		return true;
+	}
+
+	std::lock_guard< std::mutex > budgetLock( _G_HandleBudgetMutex );
+
+	if ( not schemeContext->mHandleBudgeted )
+	{
+		return true;
+	}
+
+	if ( ( -1 == schemeContext->mFileHandle ) and not __scheme_file_reopen_handle( schemeContext ) )
+	{
+		return false;
+	}
+
+	__scheme_file_unlist_handle( schemeContext );
+	schemeContext->mHandleBudgeted = false;
+	--_G_BudgetedFileCount;
+	return true;
+}
+
+File::HandleStats __scheme_file_handle_stats()
+{
+	File::HandleStats stats;
+	std::lock_guard< std::mutex > budgetLock( _G_HandleBudgetMutex );
+
+	stats.budget = __scheme_file_handle_budget();
+	stats.openHandles = _G_BudgetedHandles.size();
+	stats.files = _G_BudgetedFileCount;
+	stats.evictions = _G_HandleEvictionCount;
+	stats.reopens = _G_HandleReopenCount;
+	return stats;
+}
+
+void __scheme_file_set_handle_budget(
+	size_t handles )
+{
+	std::lock_guard< std::mutex > budgetLock( _G_HandleBudgetMutex );
+
+	// A lower budget closes idle handles at once; those in use are closed once idle, as others open.
+	_G_HandleBudget = handles;
+
+	while ( ( _G_BudgetedHandles.size() > __scheme_file_handle_budget() ) and __scheme_file_evict_handle() )
+	{
+	}
+}
+
+/*
+ * Write {@param length} bytes of {@param fill} at {@param offset}.
+ * @return The number of bytes written is returned.
+ */
+int64_t __scheme_file_fill(
+	struct SchemeFileContext* schemeContext,
+	int64_t offset,
+	int64_t length,
+	uint8_t fill )
+{
+	std::vector< uint8_t > fillBuffer( std::min< int64_t >( length, SCHEME_FILE_FILL_BUFFER_SIZE ), fill );
+	struct iovec fillVectors[ SCHEME_FILE_FILL_VECTOR_COUNT ];
+	int64_t bytesFilled = 0;
+
+	while ( bytesFilled < length )
+	{
+		int vectorCount = 0;
+		int64_t vectorBytes = 0;
+
+		while ( ( SCHEME_FILE_FILL_VECTOR_COUNT > vectorCount ) and ( length > bytesFilled + vectorBytes ) )
+		{
+			size_t vectorLength = std::min< int64_t >( fillBuffer.size(), length - bytesFilled - vectorBytes );
+			fillVectors[ vectorCount++ ] = { fillBuffer.data(), vectorLength };
+			vectorBytes += vectorLength;
+		}
+
+		ssize_t bytesWritten = pwritev( schemeContext->mFileHandle, fillVectors, vectorCount, offset + bytesFilled );
+
+		if ( -1 == bytesWritten )
+		{
+			if ( EINTR == errno )
+			{
+				continue;
+			}
+
+			schemeContext->mErrorCode = errno;
+			break;
+		}
+
+		bytesFilled += bytesWritten;
+	}
+
+	return bytesFilled;
+}
+
+/*
+ * Write out a batch of appends to their reserved offsets, followed by a single fdatasync().
+ * Appends are reserved back to back, so the batch is sorted into runs of adjacent
+ * ranges that are each written with as few pwritev() calls as possible.
+ * Every append of the batch fails if any part of it can't be made durable.
+ */
+void __scheme_file_commit_appends(
+	struct SchemeFileContext* schemeContext,
+	std::vector< struct SchemeFileAppend* >& appends )
+{
+	struct iovec appendVectors[ SCHEME_FILE_APPEND_VECTOR_COUNT ];
+	size_t appendIndex = 0;
+	int errorCode = 0;
+
+	std::sort( appends.begin(), appends.end(),
+		[]( const struct SchemeFileAppend* left, const struct SchemeFileAppend* right )
+		{
+			return left->mOffset < right->mOffset;
+		} );
+
+	for ( struct SchemeFileAppend* append : appends )
+	{
+		append->mBytesWritten = 0;
+	}
+
+	while ( ( appendIndex < appends.size() ) and ( 0 == errorCode ) )
+	{
+		int64_t runOffset = appends[ appendIndex ]->mOffset + appends[ appendIndex ]->mBytesWritten;
+		int64_t runEnd = runOffset;
+		int vectorCount = 0;
+
+		for ( size_t runIndex = appendIndex;
+			( runIndex < appends.size() ) and ( SCHEME_FILE_APPEND_VECTOR_COUNT > vectorCount );
+			++runIndex )
+		{
+			struct SchemeFileAppend* append = appends[ runIndex ];
+
+			if ( append->mOffset + append->mBytesWritten != runEnd )
+			{
+				break;
+			}
+
+			appendVectors[ vectorCount++ ] = {
+				const_cast< uint8_t* >( append->mBuffer ) + append->mBytesWritten,
+				static_cast< size_t >( append->mBytes - append->mBytesWritten ) };
+			runEnd += append->mBytes - append->mBytesWritten;
+		}
+
+		ssize_t bytesWritten = pwritev( schemeContext->mFileHandle, appendVectors, vectorCount, runOffset );
+
+		if ( 0 >= bytesWritten )
+		{
+			if ( ( -1 == bytesWritten ) and ( EINTR == errno ) )
+			{
+				continue;
+			}
+
+			errorCode = ( -1 == bytesWritten ) ? errno : EIO;
+			break;
+		}
+
+		// Credit the bytes written to the appends of the run in order;
+		// a short write leaves the remainder for the next pwritev().
+		while ( 0 < bytesWritten )
+		{
+			struct SchemeFileAppend* append = appends[ appendIndex ];
+			int64_t appendBytes = std::min< int64_t >( bytesWritten, append->mBytes - append->mBytesWritten );
+
+			append->mBytesWritten += appendBytes;
+			bytesWritten -= appendBytes;
+
+			if ( append->mBytesWritten == static_cast< int64_t >( append->mBytes ) )
+			{
+				++appendIndex;
+			}
+		}
+	}
+
+	if ( ( 0 == errorCode ) and ( -1 == fdatasync( schemeContext->mFileHandle ) ) )
+	{
+		errorCode = errno;
+	}
+
+	if ( 0 != errorCode )
+	{
+		schemeContext->mErrorCode = errorCode;
+
+		for ( struct SchemeFileAppend* append : appends )
+		{
+			append->mBytesWritten = -1;
+		}
+	}
+}
+
+/*
+ * The prefix of the hidden names a replacement of {@param targetPath} goes by,
+ * before being renamed over it. They sit in the same directory, so the rename is atomic.
+ */
+std::string __scheme_file_hidden_prefix(
+	const std::string& targetPath )
+{
+	size_t separator = targetPath.rfind( '/' );
+	size_t nameStart = ( std::string::npos == separator ) ? 0 : separator + 1;
+	return targetPath.substr( 0, nameStart ) + "." + targetPath.substr( nameStart ) + ".tmp.";
+}
+
+std::string __scheme_file_directory(
+	const std::string& path )
+{
+	size_t separator = path.rfind( '/' );
+
+	return ( std::string::npos == separator )
+		? std::string( "." )
+		: path.substr( 0, std::max< size_t >( separator, 1 ) );
+}
+
+/*
+ * Create a file without a name in {@param directoryPath}. Where O_TMPFILE is unsupported,
+ * a hidden file starting with {@param hiddenPrefix} is created instead, and its path is
+ * stored in {@param temporaryPath}, which is otherwise left empty.
+ * @return The file handle is returned, or -1 on error and errno is set.
+ */
+int __scheme_file_create_temporary(
+	const char* directoryPath,
+	const std::string& hiddenPrefix,
+	int defaultMode,
+	std::string& temporaryPath )
+{
+	int fileHandle = open( directoryPath, O_TMPFILE | O_RDWR | O_CLOEXEC, defaultMode );
+
+	temporaryPath.clear();
+
+	if ( ( -1 == fileHandle ) and ( ( EOPNOTSUPP == errno ) or ( EISDIR == errno ) or ( EINVAL == errno ) ) )
+	{
+		temporaryPath = hiddenPrefix + "XXXXXX";
+		fileHandle = mkostemp( temporaryPath.data(), O_CLOEXEC );
+
+		if ( -1 == fileHandle )
+		{
+			temporaryPath.clear();
+		}
+	}
+
+	return fileHandle;
+}
+
+/*
+ * Open an anonymous file in the directory of {@param path}, to be published over it.
+ * @return The file handle is returned, or -1 on error and errno is set.
+ */
+int __scheme_file_open_temporary(
+	struct SchemeFileContext* schemeContext,
+	const char* path,
+	int defaultMode )
+{
+	std::string temporaryPath;
+
+	schemeContext->mTargetPath = strdup( path );
+
+	if ( nullptr == schemeContext->mTargetPath )
+	{
+		errno = ENOMEM;
+		return -1;
+	}
+
+	int fileHandle = __scheme_file_create_temporary( schemeContext->mDirectoryPath,
+		__scheme_file_hidden_prefix( path ), defaultMode, temporaryPath );
+
+	if ( not temporaryPath.empty() )
+	{
+		schemeContext->mTemporaryPath = strdup( temporaryPath.c_str() );
+	}
+
+	// A replacement keeps the permissions of the file it replaces.
+	struct stat targetStatus;
+
+	if ( ( -1 != fileHandle ) and ( 0 == stat( path, &targetStatus ) ) )
+	{
+		fchmod( fileHandle, targetStatus.st_mode & 07777 );
+	}
+
+	return fileHandle;
+}
+
+/*
+ * fsync() the directory of a published file, unless a sync begun after the publish
+ * completed already has. Concurrent publishers into one directory thereby share syncs.
+ */
+bool __scheme_file_sync_directory(
+	struct SchemeFileContext* schemeContext )
+{
+	std::string directoryPath( schemeContext->mDirectoryPath );
+
+	{
+		std::lock_guard< std::mutex > syncLock( _G_DirectorySyncMutex );
+		auto syncIterator = _G_DirectorySyncSequence.find( directoryPath );
+
+		if ( ( _G_DirectorySyncSequence.end() != syncIterator )
+			and ( syncIterator->second >= schemeContext->mPublishSequence ) )
+		{
+			return true;
+		}
+	}
+
+	// Every publish numbered up to here has renamed its file before the sync begins.
+	uint64_t syncSequence = _G_PublishSequence.load();
+	int directoryHandle = open( directoryPath.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC );
+
+	if ( ( -1 == directoryHandle ) or ( -1 == fsync( directoryHandle ) ) )
+	{
+		schemeContext->mErrorCode = errno;
+
+		if ( -1 != directoryHandle )
+		{
+			close( directoryHandle );
+		}
+
+		return false;
+	}
+
+	close( directoryHandle );
+
+	std::lock_guard< std::mutex > syncLock( _G_DirectorySyncMutex );
+	uint64_t& directorySequence = _G_DirectorySyncSequence[ directoryPath ];
+	directorySequence = std::max( directorySequence, syncSequence );
+	return true;
+}
+
+// TODO:
+// [x] Handle Regular File
+// [x] Handle Character Device
+// [x] Handle FIFO/Pipe
+// [ ] Perform Memory Mapped IO for Regular Files
+
+bool __scheme_file_open(
+	struct FileContext* context,
+	const std::string& uri,
+	File::IOFlag mode,
+	int& errorCode )
+{
+	static const char SCHEME_FILE_PREFIX[] = "file://";
+
+	if ( nullptr == context )
+	{
+		errorCode = EBADF;
+		return false;
+	}
+
+	if ( nullptr != context->_M_SchemeContext )
+	{
+		errorCode = ESTALE;
+		return false;
+	}
+
+	// Check that the mode is set to READ, WRITE, or both.
+	if ( not ( File::IOFlag::READ & mode )
+		and not ( File::IOFlag::WRITE & mode ) )
+	{
+		errorCode = EINVAL;
+		return false;
+	}
+
+	// Check that the URI starts with "file://"
+	if ( 0 != strncmp( SCHEME_FILE_PREFIX, uri.c_str(), sizeof( SCHEME_FILE_PREFIX ) - 1 ) )
+	{
+		errorCode = EINVAL;
+		return false;
+	}
+
+	// With "group_commit=1", concurrent appends are batched into one write and one
+	// fdatasync(), in place of every write being synchronous by way of O_SYNC.
+	std::string filepath( uri );
+	std::string groupCommitValue;
+	bool groupCommit = _extract_uri_parameter( filepath, "group_commit", groupCommitValue )
+		and ( "0" != groupCommitValue );
+
+	// With "sync=0", no write is made durable until sync(), for callers
+	// that flush at points of their own choosing, e.g. the journal.
+	std::string syncValue;
+	bool deferSync = _extract_uri_parameter( filepath, "sync", syncValue )
+		and ( "0" == syncValue );
+
+	if ( ( File::IOFlag::ATOMIC & mode ) and not ( File::IOFlag::WRITE & mode ) )
+	{
+		errorCode = EINVAL;
+		return false;
+	}
+
+	int flags = O_CREAT | ( ( groupCommit or deferSync ) ? 0 : O_SYNC ) | ( ( File::IOFlag::NONBLOCK & mode ) ? O_NONBLOCK : 0 ) |
+		( ( File::IOFlag::READ & mode )
+			? ( ( File::IOFlag::WRITE & mode ) ? O_RDWR : O_RDONLY )
+			: O_WRONLY );
+	int defaultMode = S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH;
+
+	struct SchemeFileContext* schemeContext = __allocate_scheme_file_context();
+
+	if ( nullptr == schemeContext )
+	{
+		errorCode = ENOMEM;
+		return false;
+	}
+
+	schemeContext->mDeferSync = deferSync;
+
+	// The directory is kept for creating files next to this one.
+	schemeContext->mDirectoryPath = strdup( __scheme_file_directory( filepath.c_str() + sizeof( SCHEME_FILE_PREFIX ) - 1 ).c_str() );
+
+	if ( nullptr == schemeContext->mDirectoryPath )
+	{
+		errorCode = ENOMEM;
+		__free_scheme_file_context( schemeContext );
+		return false;
+	}
+
+	if ( not ( File::IOFlag::ATOMIC & mode ) )
+	{
+		schemeContext->mFilePath = strdup( filepath.c_str() + sizeof( SCHEME_FILE_PREFIX ) - 1 );
+		schemeContext->mOpenFlags = flags & ~O_CREAT;
+
+		if ( nullptr == schemeContext->mFilePath )
+		{
+			errorCode = ENOMEM;
+			__free_scheme_file_context( schemeContext );
+			return false;
+		}
+	}
+
+	// An atomic write goes to a new file, which is flushed once when published.
+	schemeContext->mFileHandle = ( File::IOFlag::ATOMIC & mode )
+		? __scheme_file_open_temporary( schemeContext, filepath.c_str() + sizeof( SCHEME_FILE_PREFIX ) - 1, defaultMode )
+		: __scheme_file_open_path( filepath.c_str() + sizeof( SCHEME_FILE_PREFIX ) - 1, flags, defaultMode, false );
+
+	if ( -1 == schemeContext->mFileHandle )
+	{
+		errorCode = errno;
+		__free_scheme_file_context( schemeContext );
+		return false;
+	}
+
+	// stat the file
+	struct stat fileStatus;
+	if ( -1 == fstat( schemeContext->mFileHandle, &fileStatus ) )
+	{
+		errorCode = errno;
+		__free_scheme_file_context( schemeContext );
+		return false;
+	}
+
+	// Pipes, character devices, and sockets are streams: they have
+	// no size, and can neither be seeked nor read at an offset.
+	context->_M_Capabilities = static_cast< File::IOFlag >( mode & ( File::IOFlag::READ | File::IOFlag::WRITE ) );
+	schemeContext->mFileType = S_IFMT & fileStatus.st_mode;
+
+	switch ( schemeContext->mFileType )
+	{
+	case S_IFREG:
+		context->_M_FileSize = fileStatus.st_size;
+		context->_M_Capabilities = static_cast< File::IOFlag >( context->_M_Capabilities | File::IOFlag::SEEK );
+		break;
+	case S_IFBLK:
+		context->_M_FileSize = lseek( schemeContext->mFileHandle, 0, SEEK_END );
+		lseek( schemeContext->mFileHandle, 0, SEEK_SET );
+		context->_M_Capabilities = static_cast< File::IOFlag >( context->_M_Capabilities | File::IOFlag::SEEK );
+		break;
+	case S_IFDIR:
+		errorCode = EISDIR;
+		close( schemeContext->mFileHandle );
+		__free_scheme_file_context( schemeContext );
+		return false;
+	default:
+		context->_M_FileSize = -1;
+		context->_F_pread = nullptr;
+		context->_F_snapshot = nullptr;
+		context->_F_view = nullptr;
+	}
+
+	// Appends can only be reserved ahead of time at the end of a regular file.
+	if ( groupCommit and ( File::IOFlag::WRITE & mode ) and ( S_IFREG == ( S_IFMT & fileStatus.st_mode ) ) )
+	{
+		schemeContext->mGroupCommit = new ( std::nothrow ) struct SchemeFileGroupCommit();
+
+		if ( nullptr == schemeContext->mGroupCommit )
+		{
+			errorCode = ENOMEM;
+			close( schemeContext->mFileHandle );
+			__free_scheme_file_context( schemeContext );
+			return false;
+		}
+	}
+	else
+	{
+		context->_F_group_append = nullptr;
+	}
+
+	if ( not ( File::IOFlag::ATOMIC & mode ) )
+	{
+		context->_F_publish = nullptr;
+	}
+
+	// A regular file opened by path can be closed while idle, and reopened by it. The
+	// appends of a group commit are written by whichever thread leads it, so stay open.
+	if ( ( S_IFREG == schemeContext->mFileType )
+		and ( nullptr != schemeContext->mFilePath )
+		and ( nullptr == schemeContext->mGroupCommit ) )
+	{
+		schemeContext->mDevice = fileStatus.st_dev;
+		schemeContext->mInode = fileStatus.st_ino;
+		__scheme_file_budget_handle( schemeContext );
+	}
+
+	context->_M_SchemeContext = static_cast< void* >( schemeContext );
+	return true;
+}
+
+int64_t __scheme_file_group_append(
+	struct FileContext* context,
+	const uint8_t* buffer,
+	size_t bytes,
+	int64_t offset )
+{
+	if ( nullptr == context )
+	{
+		return -1;
+	}
+
+	if ( nullptr == context->_M_SchemeContext )
+	{
+		return -1;
+	}
+
+	struct SchemeFileContext* schemeContext = static_cast< struct SchemeFileContext* >( context->_M_SchemeContext );
+	struct SchemeFileGroupCommit* groupCommit = schemeContext->mGroupCommit;
+
+	if ( nullptr == groupCommit )
+	{
+		schemeContext->mErrorCode = ENOTSUP;
+		return -1;
+	}
+
+	struct SchemeFileAppend append = { buffer, bytes, offset, 0, false };
+	std::unique_lock< std::mutex > groupLock( groupCommit->mMutex );
+
+	groupCommit->mPending.push_back( &append );
+
+	while ( not append.mDone )
+	{
+		if ( groupCommit->mCommitting )
+		{
+			groupCommit->mCommitted.wait( groupLock );
+			continue;
+		}
+
+		// Lead the commit of every append pending, this one included. Appends arriving
+		// in the meantime wait, and are committed together by the next leader.
+		std::vector< struct SchemeFileAppend* > appends;
+		appends.swap( groupCommit->mPending );
+		groupCommit->mCommitting = true;
+		groupLock.unlock();
+
+		__scheme_file_commit_appends( schemeContext, appends );
+
+		groupLock.lock();
+
+		for ( struct SchemeFileAppend* committedAppend : appends )
+		{
+			committedAppend->mDone = true;
+		}
+
+		groupCommit->mCommitting = false;
+		groupCommit->mCommitted.notify_all();
+	}
+
+	return append.mBytesWritten;
+}
+
+bool __scheme_file_publish(
+	struct FileContext* context,
+	bool syncDirectory )
+{
+	if ( nullptr == context )
+	{
+		return false;
+	}
+
+	if ( nullptr == context->_M_SchemeContext )
+	{
+		context->_M_ErrorCode = EIDRM;
+		return false;
+	}
+
+	struct SchemeFileContext* schemeContext = static_cast< struct SchemeFileContext* >( context->_M_SchemeContext );
+
+	if ( nullptr != schemeContext->mTargetPath )
+	{
+		if ( -1 == fdatasync( schemeContext->mFileHandle ) )
+		{
+			schemeContext->mErrorCode = errno;
+			return false;
+		}
+
+		// An anonymous file can't be linked over an existing one, so it is
+		// given a hidden name first, which is then renamed over the target.
+		if ( nullptr == schemeContext->mTemporaryPath )
+		{
+			char procPath[ 32 ];
+			std::string hiddenPrefix = __scheme_file_hidden_prefix( schemeContext->mTargetPath );
+			std::string temporaryPath;
+			int linkResult;
+
+			snprintf( procPath, sizeof( procPath ), "/proc/self/fd/%d", schemeContext->mFileHandle );
+
+			do
+			{
+				temporaryPath = hiddenPrefix + std::to_string( getpid() ) + "." + std::to_string( ++_G_TemporaryCounter );
+				linkResult = linkat( AT_FDCWD, procPath, AT_FDCWD, temporaryPath.c_str(), AT_SYMLINK_FOLLOW );
+			}
+			while ( ( -1 == linkResult ) and ( EEXIST == errno ) );
+
+			if ( -1 == linkResult )
+			{
+				schemeContext->mErrorCode = errno;
+				return false;
+			}
+
+			schemeContext->mTemporaryPath = strdup( temporaryPath.c_str() );
+
+			if ( nullptr == schemeContext->mTemporaryPath )
+			{
+				unlink( temporaryPath.c_str() );
+				schemeContext->mErrorCode = ENOMEM;
+				return false;
+			}
+		}
+
+		if ( -1 == rename( schemeContext->mTemporaryPath, schemeContext->mTargetPath ) )
+		{
+			schemeContext->mErrorCode = errno;
+			return false;
+		}
+
+		free( schemeContext->mTemporaryPath );
+		free( schemeContext->mTargetPath );
+		schemeContext->mTemporaryPath = nullptr;
+		schemeContext->mTargetPath = nullptr;
+		schemeContext->mPublishSequence = ++_G_PublishSequence;
+	}
+
+	if ( not syncDirectory )
+	{
+		return true;
+	}
+
+	return __scheme_file_sync_directory( schemeContext );
+}
+
+int64_t __scheme_file_pread(
+	struct FileContext* context,
+	uint8_t* buffer,
+	size_t bytes,
+	int64_t offset )
+{
+	if ( nullptr == context )
+	{
+		return -1;
+	}
+
+	if ( nullptr == context->_M_SchemeContext )
+	{
+		return -1;
+	}
+
+	struct SchemeFileContext* schemeContext = static_cast< struct SchemeFileContext* >( context->_M_SchemeContext );
+	struct SchemeFileHandleUse handleUse( schemeContext );
+	int64_t bytesRead = 0;
+
+	if ( not handleUse.mAcquired )
+	{
+		return -1;
+	}
+
+	while ( bytesRead < static_cast< int64_t >( bytes ) )
+	{
+		size_t readCount = std::min< size_t >( bytes - bytesRead, SCHEME_FILE_IO_SIZE );
+		ssize_t readResult = pread( schemeContext->mFileHandle, buffer + bytesRead, readCount, offset + bytesRead );
+
+		if ( -1 == readResult )
+		{
+			if ( 0 == bytesRead )
+			{
+				schemeContext->mErrorCode = errno;
+				return -1;
+			}
+
+			break;
+		}
+
+		bytesRead += readResult;
+
+		// A short read is the end of the file.
+		if ( static_cast< size_t >( readResult ) < readCount )
+		{
+			break;
+		}
+	}
+
+	return bytesRead;
+}
+
+bool __scheme_file_snapshot(
+	struct FileContext* context,
+	struct FileContext* snapshotContext,
+	int& errorCode )
+{
+	if ( nullptr == context )
+	{
+		errorCode = EBADF;
+		return false;
+	}
+
+	if ( nullptr == context->_M_SchemeContext )
+	{
+		errorCode = EIDRM;
+		return false;
+	}
+
+	struct SchemeFileContext* schemeContext = static_cast< struct SchemeFileContext* >( context->_M_SchemeContext );
+	struct SchemeFileHandleUse handleUse( schemeContext );
+
+	if ( not handleUse.mAcquired )
+	{
+		errorCode = schemeContext->mErrorCode;
+		return false;
+	}
+
+	// Only regular files have contents to be copied.
+	if ( 0 > context->_M_FileSize )
+	{
+		errorCode = ENOTSUP;
+		return false;
+	}
+
+	struct SchemeFileContext* snapshotSchemeContext = __allocate_scheme_file_context();
+
+	if ( nullptr == snapshotSchemeContext )
+	{
+		errorCode = ENOMEM;
+		return false;
+	}
+
+	// The snapshot has no name, so it disappears once closed. It lives in the same
+	// directory as the file, as extents can only be shared within a file system.
+	std::string temporaryPath;
+	snapshotSchemeContext->mDirectoryPath = strdup( schemeContext->mDirectoryPath );
+	snapshotSchemeContext->mFileHandle = ( nullptr == snapshotSchemeContext->mDirectoryPath ) ? -1
+		: __scheme_file_create_temporary( snapshotSchemeContext->mDirectoryPath,
+			std::string( snapshotSchemeContext->mDirectoryPath ) + "/.snapshot.", S_IRUSR | S_IWUSR, temporaryPath );
+
+	if ( -1 == snapshotSchemeContext->mFileHandle )
+	{
+		errorCode = ( nullptr == snapshotSchemeContext->mDirectoryPath ) ? ENOMEM : errno;
+		__free_scheme_file_context( snapshotSchemeContext );
+		return false;
+	}
+
+	if ( not temporaryPath.empty() )
+	{
+		unlink( temporaryPath.c_str() );
+	}
+
+	// A reflink shares every extent of the file, and copies none until either is written.
+	// Otherwise the file is copied, by copy_file_range(), which shares extents itself
+	// where the file system can, and elsewhere copies without leaving the kernel.
+	if ( -1 == ioctl( snapshotSchemeContext->mFileHandle, FICLONE, schemeContext->mFileHandle ) )
+	{
+		loff_t sourceOffset = 0;
+		loff_t snapshotOffset = 0;
+
+		while ( sourceOffset < context->_M_FileSize )
+		{
+			ssize_t bytesCopied = copy_file_range( schemeContext->mFileHandle, &sourceOffset,
+				snapshotSchemeContext->mFileHandle, &snapshotOffset, context->_M_FileSize - sourceOffset, 0 );
+
+			if ( 0 < bytesCopied )
+			{
+				continue;
+			}
+
+			if ( ( -1 == bytesCopied ) and ( EINTR == errno ) )
+			{
+				continue;
+			}
+
+			errorCode = ( -1 == bytesCopied ) ? errno : EIO;
+			close( snapshotSchemeContext->mFileHandle );
+			__free_scheme_file_context( snapshotSchemeContext );
+			return false;
+		}
+	}
+
+	snapshotContext->_M_FileSize = context->_M_FileSize;
+	snapshotContext->_M_FilePosition = 0;
+	snapshotContext->_M_Capabilities = static_cast< File::IOFlag >( File::IOFlag::READ | File::IOFlag::SEEK );
+	snapshotSchemeContext->mFileType = S_IFREG;
+	snapshotContext->_M_SchemeContext = static_cast< void* >( snapshotSchemeContext );
+	snapshotContext->_F_error_string = __scheme_file_error_string;
+	snapshotContext->_F_close = __scheme_file_close;
+	snapshotContext->_F_seek = __scheme_file_seek;
+	snapshotContext->_F_read = __scheme_file_read;
+	snapshotContext->_F_pread = __scheme_file_pread;
+	snapshotContext->_F_write = __scheme_file_write;
+	snapshotContext->_F_resize = __scheme_file_resize;
+	snapshotContext->_F_data_regions = __scheme_file_data_regions;
+	snapshotContext->_F_sync = __scheme_file_sync;
+	snapshotContext->_F_snapshot = __scheme_file_snapshot;
+	snapshotContext->_F_dup = __scheme_file_dup;
+	snapshotContext->_F_splice = __scheme_file_splice;
+	snapshotContext->_F_poll_handle = __scheme_file_poll_handle;
+	snapshotContext->_F_view = __scheme_file_view;
+	return true;
+}
+
+bool __scheme_file_dup(
+	struct FileContext* context,
+	struct FileContext* dupContext,
+	int& errorCode )
+{
+	if ( nullptr == context )
+	{
+		errorCode = EBADF;
+		return false;
+	}
+
+	if ( nullptr == context->_M_SchemeContext )
+	{
+		errorCode = EIDRM;
+		return false;
+	}
+
+	// Streams have a single position, which every handle on them consumes.
+	if ( not FILE_CAN_READ( context ) or not FILE_CAN_SEEK( context ) )
+	{
+		errorCode = ENOTSUP;
+		return false;
+	}
+
+	struct SchemeFileContext* schemeContext = static_cast< struct SchemeFileContext* >( context->_M_SchemeContext );
+	++schemeContext->mReferenceCount;
+
+	dupContext->_M_FileSize = context->_M_FileSize;
+	dupContext->_M_FilePosition = context->_M_FilePosition;
+	dupContext->_M_Capabilities = static_cast< File::IOFlag >( File::IOFlag::READ | File::IOFlag::SEEK );
+	dupContext->_M_SchemeContext = static_cast< void* >( schemeContext );
+	dupContext->_F_error_string = __scheme_file_error_string;
+	dupContext->_F_close = __scheme_file_close;
+	dupContext->_F_seek = __scheme_file_seek;
+	dupContext->_F_read = __scheme_file_read;
+	dupContext->_F_pread = __scheme_file_pread;
+	dupContext->_F_write = __scheme_file_write;
+	dupContext->_F_resize = __scheme_file_resize;
+	dupContext->_F_data_regions = __scheme_file_data_regions;
+	dupContext->_F_sync = __scheme_file_sync;
+	dupContext->_F_snapshot = __scheme_file_snapshot;
+	dupContext->_F_dup = __scheme_file_dup;
+	dupContext->_F_refresh = __scheme_file_refresh;
+	dupContext->_F_watch = __scheme_file_watch;
+	dupContext->_F_splice = __scheme_file_splice;
+	dupContext->_F_poll_handle = __scheme_file_poll_handle;
+	dupContext->_F_view = __scheme_file_view;
+	return true;
+}
+
+bool __scheme_file_refresh(
+	struct FileContext* context,
+	bool& replaced )
+{
+	replaced = false;
+
+	if ( nullptr == context )
+	{
+		return false;
+	}
+
+	if ( nullptr == context->_M_SchemeContext )
+	{
+		context->_M_ErrorCode = EIDRM;
+		return false;
+	}
+
+	struct SchemeFileContext* schemeContext = static_cast< struct SchemeFileContext* >( context->_M_SchemeContext );
+	struct stat fileStatus;
+
+	// A followed file keeps its handle, through which its replacement is detected.
+	if ( not __scheme_file_keep_handle( schemeContext ) )
+	{
+		return false;
+	}
+
+	if ( -1 == fstat( schemeContext->mFileHandle, &fileStatus ) )
+	{
+		schemeContext->mErrorCode = errno;
+		return false;
+	}
+
+	// Pipes and devices have no size to follow; reads on them simply block.
+	if ( S_IFREG != ( S_IFMT & fileStatus.st_mode ) )
+	{
+		return true;
+	}
+
+	// A file truncated in place (e.g. by "copytruncate" rotation) is read again from the beginning.
+	if ( fileStatus.st_size < context->_M_FilePosition )
+	{
+		context->_M_FilePosition = 0;
+	}
+
+	context->_M_FileSize = fileStatus.st_size;
+
+	// The file is only let go of once it's been read to the end, as
+	// whatever was appended ahead of it being replaced is still wanted.
+	// Nor is a file shared with dups let go of, as they'd be left reading the other.
+	if ( ( nullptr == schemeContext->mFilePath )
+		or ( context->_M_FilePosition < context->_M_FileSize )
+		or ( 1 < schemeContext->mReferenceCount ) )
+	{
+		return true;
+	}
+
+	struct stat pathStatus;
+
+	if ( ( 0 != stat( schemeContext->mFilePath, &pathStatus ) )
+		or ( ( pathStatus.st_dev == fileStatus.st_dev ) and ( pathStatus.st_ino == fileStatus.st_ino ) ) )
+	{
+		// Either the file is still in place, or nothing has taken its place yet.
+		return true;
+	}
+
+	int fileHandle = open( schemeContext->mFilePath, schemeContext->mOpenFlags | O_CLOEXEC );
+
+	if ( -1 == fileHandle )
+	{
+		if ( ENOENT == errno )
+		{
+			return true;
+		}
+
+		schemeContext->mErrorCode = errno;
+		return false;
+	}
+
+	if ( -1 == fstat( fileHandle, &fileStatus ) )
+	{
+		schemeContext->mErrorCode = errno;
+		close( fileHandle );
+		return false;
+	}
+
+	close( schemeContext->mFileHandle );
+	schemeContext->mFileHandle = fileHandle;
+	context->_M_FileSize = ( S_IFREG == ( S_IFMT & fileStatus.st_mode ) ) ? fileStatus.st_size : -1;
+	context->_M_FilePosition = 0;
+	replaced = true;
+	return true;
+}
+
+std::shared_ptr< const uint8_t > __scheme_file_view(
+	struct FileContext* context,
+	int64_t offset,
+	int64_t length )
+{
+	if ( nullptr == context )
+	{
+		return nullptr;
+	}
+
+	if ( nullptr == context->_M_SchemeContext )
+	{
+		context->_M_ErrorCode = EIDRM;
+		return nullptr;
+	}
+
+	struct SchemeFileContext* schemeContext = static_cast< struct SchemeFileContext* >( context->_M_SchemeContext );
+	struct SchemeFileHandleUse handleUse( schemeContext );
+
+	if ( not handleUse.mAcquired )
+	{
+		return nullptr;
+	}
+
+	// Mappings start on a page boundary, so the view begins part way into its mapping.
+	static const int64_t pageSize = sysconf( _SC_PAGESIZE );
+	int64_t mappingOffset = offset - ( offset % pageSize );
+	size_t mappingLength = ( offset - mappingOffset ) + std::max< int64_t >( length, 1 );
+	void* mapping = mmap( nullptr, mappingLength, PROT_READ, MAP_SHARED, schemeContext->mFileHandle, mappingOffset );
+
+	if ( MAP_FAILED == mapping )
+	{
+		schemeContext->mErrorCode = errno;
+		return nullptr;
+	}
+
+	// The mapping outlives the file handle, so the view remains valid once the file is closed.
+	const uint8_t* viewData = static_cast< const uint8_t* >( mapping ) + ( offset - mappingOffset );
+
+	return std::shared_ptr< const uint8_t >( viewData,
+		[ mapping, mappingLength ]( const uint8_t* )
+		{
+			munmap( mapping, mappingLength );
+		} );
+}
+
+bool __scheme_file_watch(
+	struct FileContext* context,
+	int notifyHandle,
+	int& fileWatch,
+	int& directoryWatch )
+{
+	if ( nullptr == context )
+	{
+		return false;
+	}
+
+	if ( nullptr == context->_M_SchemeContext )
+	{
+		context->_M_ErrorCode = EIDRM;
+		return false;
+	}
+
+	struct SchemeFileContext* schemeContext = static_cast< struct SchemeFileContext* >( context->_M_SchemeContext );
+
+	if ( not __scheme_file_keep_handle( schemeContext ) )
+	{
+		return false;
+	}
+
+	// Watching through the file descriptor watches the file that was opened, rather than
+	// whichever is at its path. A rename shows up as IN_MOVE_SELF, and an unlink as
+	// IN_ATTRIB; IN_DELETE_SELF only follows once the file is closed.
+	std::string descriptorPath = "/proc/self/fd/" + std::to_string( schemeContext->mFileHandle );
+	fileWatch = inotify_add_watch( notifyHandle, descriptorPath.c_str(),
+		IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB | IN_MOVE_SELF | IN_DELETE_SELF );
+
+	if ( -1 == fileWatch )
+	{
+		schemeContext->mErrorCode = errno;
+		return false;
+	}
+
+	directoryWatch = -1;
+
+	// Another file taking the place of this one is seen in its directory.
+	if ( nullptr != schemeContext->mFilePath )
+	{
+		directoryWatch = inotify_add_watch( notifyHandle, schemeContext->mDirectoryPath,
+			IN_ONLYDIR | IN_CREATE | IN_MOVED_TO );
+
+		if ( -1 == directoryWatch )
+		{
+			schemeContext->mErrorCode = errno;
+			inotify_rm_watch( notifyHandle, fileWatch );
+			return false;
+		}
+	}
+
+	return true;
+}
+
+int64_t __scheme_file_read(
+	struct FileContext* context,
+	uint8_t* buffer,
+	size_t bytes,
+	bool updatePosition )
+{
+	if ( nullptr == context )
+	{
+		return -1;
+	}
+
+	if ( nullptr == context->_M_SchemeContext )
+	{
+		context->_M_ErrorCode = EIDRM;
+		return -1;
+	}
+
+	struct SchemeFileContext* schemeContext = static_cast< struct SchemeFileContext* >( context->_M_SchemeContext );
+	struct SchemeFileHandleUse handleUse( schemeContext );
+	int64_t bytesRead = 0;
+
+	if ( not handleUse.mAcquired )
+	{
+		return -1;
+	}
+
+	while ( bytesRead < static_cast< int64_t >( bytes ) )
+	{
+		size_t readCount = std::min< size_t >( bytes - bytesRead, SCHEME_FILE_IO_SIZE );
+		ssize_t readResult = ( updatePosition and not FILE_CAN_SEEK( context ) )
+			? read( schemeContext->mFileHandle, buffer + bytesRead, readCount )
+			: pread( schemeContext->mFileHandle, buffer + bytesRead, readCount, context->_M_FilePosition + bytesRead );
+
+		if ( -1 == readResult )
+		{
+			if ( 0 == bytesRead )
+			{
+				schemeContext->mErrorCode = errno;
+				return -1;
+			}
+
+			break;
+		}
+
+		bytesRead += readResult;
+
+		// A short read is the end of the file, or of what a stream has ready.
+		if ( static_cast< size_t >( readResult ) < readCount )
+		{
+			break;
+		}
+	}
+
+	// The file position of a stream counts the bytes consumed from it.
+	if ( updatePosition )
+	{
+		context->_M_FilePosition += bytesRead;
+	}
+
+	return bytesRead;
+}
+
+int64_t __scheme_file_write(
+	struct FileContext* context,
+	const uint8_t* buffer,
+	size_t bytes,
+	bool append )
+{
+	if ( nullptr == context )
+	{
+		return -1;
+	}
+
+	if ( nullptr == context->_M_SchemeContext )
+	{
+		context->_M_ErrorCode = EIDRM;
+		return -1;
+	}
+
+	struct SchemeFileContext* schemeContext = static_cast< struct SchemeFileContext* >( context->_M_SchemeContext );
+	struct SchemeFileHandleUse handleUse( schemeContext );
+	int64_t bytesWritten = 0;
+
+	if ( not handleUse.mAcquired )
+	{
+		return -1;
+	}
+
+	while ( bytesWritten < static_cast< int64_t >( bytes ) )
+	{
+		size_t writeCount = std::min< size_t >( bytes - bytesWritten, SCHEME_FILE_IO_SIZE );
+		ssize_t writeResult = append
+			? pwrite( schemeContext->mFileHandle, buffer + bytesWritten, writeCount, context->_M_FileSize )
+			: FILE_CAN_SEEK( context )
+				? pwrite( schemeContext->mFileHandle, buffer + bytesWritten, writeCount, context->_M_FilePosition )
+				: write( schemeContext->mFileHandle, buffer + bytesWritten, writeCount );
+
+		if ( -1 == writeResult )
+		{
+			if ( 0 == bytesWritten )
+			{
+				schemeContext->mErrorCode = errno;
+				return -1;
+			}
+
+			break;
+		}
+
+		bytesWritten += writeResult;
+
+		if ( append )
+		{
+			context->_M_FileSize += writeResult;
+		}
+		else
+		{
+			context->_M_FilePosition += writeResult;
+
+			// Streams have no size to extend.
+			if ( 0 <= context->_M_FileSize )
+			{
+				context->_M_FileSize = std::max( context->_M_FileSize, context->_M_FilePosition );
+			}
+		}
+
+		// A short write is a full disk, or a stream with no more room for now.
+		if ( static_cast< size_t >( writeResult ) < writeCount )
+		{
+			break;
+		}
+	}
+
+	// Without O_SYNC, writes outside of a group commit are made durable one at a time.
+	if ( ( 0 < bytesWritten )
+		and ( nullptr != schemeContext->mGroupCommit )
+		and not schemeContext->mDeferSync
+		and ( -1 == fdatasync( schemeContext->mFileHandle ) ) )
+	{
+		schemeContext->mErrorCode = errno;
+		return -1;
+	}
+
+	return bytesWritten;
+}
+
+int __scheme_file_poll_handle(
+	struct FileContext* context )
+{
+	if ( ( nullptr == context )
+		or ( nullptr == context->_M_SchemeContext ) )
+	{
+		return -1;
+	}
+
+	struct SchemeFileContext* schemeContext = static_cast< struct SchemeFileContext* >( context->_M_SchemeContext );
+
+	// The handle is polled beyond this call, so it can't be closed while idle.
+	if ( not __scheme_file_keep_handle( schemeContext ) )
+	{
+		return -1;
+	}
+
+	return schemeContext->mFileHandle;
+}
+
+int64_t __scheme_file_splice(
+	struct FileContext* context,
+	struct FileContext* destinationContext,
+	int64_t bytes )
+{
+	if ( ( nullptr == context )
+		or ( nullptr == destinationContext ) )
+	{
+		return -1;
+	}
+
+	if ( ( nullptr == context->_M_SchemeContext )
+		or ( nullptr == destinationContext->_M_SchemeContext ) )
+	{
+		context->_M_ErrorCode = EIDRM;
+		return -1;
+	}
+
+	struct SchemeFileContext* schemeContext = static_cast< struct SchemeFileContext* >( context->_M_SchemeContext );
+	struct SchemeFileContext* destinationSchemeContext = static_cast< struct SchemeFileContext* >( destinationContext->_M_SchemeContext );
+	struct SchemeFileHandleUse handleUse( schemeContext );
+	struct SchemeFileHandleUse destinationHandleUse( destinationSchemeContext );
+
+	if ( not handleUse.mAcquired )
+	{
+		return -1;
+	}
+
+	if ( not destinationHandleUse.mAcquired )
+	{
+		schemeContext->mErrorCode = destinationSchemeContext->mErrorCode;
+		return -1;
+	}
+
+	// splice() moves pages in and out of a pipe by reference. Between regular files,
+	// copy_file_range() shares extents where it can; from a regular file to anything
+	// else that can't be seeked, such as a socket, sendfile() copies within the kernel.
+	bool throughPipe = ( S_IFIFO == schemeContext->mFileType ) or ( S_IFIFO == destinationSchemeContext->mFileType );
+	bool betweenFiles = ( S_IFREG == schemeContext->mFileType ) and ( S_IFREG == destinationSchemeContext->mFileType );
+	unsigned int spliceFlags = SPLICE_F_MOVE
+		| ( ( O_NONBLOCK & ( schemeContext->mOpenFlags | destinationSchemeContext->mOpenFlags ) ) ? SPLICE_F_NONBLOCK : 0 );
+	bool copyThroughBuffer = not throughPipe and not betweenFiles
+		and ( ( S_IFREG != schemeContext->mFileType ) or FILE_CAN_SEEK( destinationContext ) );
+	std::vector< uint8_t > copyBuffer;
+	int64_t bytesSpliced = 0;
+
+	while ( bytesSpliced < bytes )
+	{
+		size_t spliceSize = std::min< int64_t >( bytes - bytesSpliced, SCHEME_FILE_SPLICE_SIZE );
+		ssize_t bytesMoved;
+
+		// Files are moved from and to the file positions of the contexts, streams from and to wherever they are.
+		loff_t offset = context->_M_FilePosition;
+		loff_t destinationOffset = destinationContext->_M_FilePosition;
+		loff_t* offsetPointer = FILE_CAN_SEEK( context ) ? &offset : nullptr;
+		loff_t* destinationOffsetPointer = FILE_CAN_SEEK( destinationContext ) ? &destinationOffset : nullptr;
+
+		if ( copyThroughBuffer )
+		{
+			copyBuffer.resize( SCHEME_FILE_COPY_BUFFER_SIZE );
+			bytesMoved = ( nullptr != offsetPointer )
+				? pread( schemeContext->mFileHandle, copyBuffer.data(), std::min( spliceSize, copyBuffer.size() ), offset )
+				: read( schemeContext->mFileHandle, copyBuffer.data(), std::min( spliceSize, copyBuffer.size() ) );
+
+			// Bytes read from a stream are lost should they fail to be written.
+			for ( ssize_t bytesWritten = 0, writeResult; ( 0 < bytesMoved ) and ( bytesWritten < bytesMoved ); )
+			{
+				writeResult = ( nullptr != destinationOffsetPointer )
+					? pwrite( destinationSchemeContext->mFileHandle, copyBuffer.data() + bytesWritten, bytesMoved - bytesWritten, destinationOffset + bytesWritten )
+					: write( destinationSchemeContext->mFileHandle, copyBuffer.data() + bytesWritten, bytesMoved - bytesWritten );
+
+				if ( -1 != writeResult )
+				{
+					bytesWritten += writeResult;
+				}
+				else if ( EINTR != errno )
+				{
+					bytesMoved = -1;
+				}
+			}
+		}
+		else if ( throughPipe )
+		{
+			bytesMoved = splice( schemeContext->mFileHandle, offsetPointer,
+				destinationSchemeContext->mFileHandle, destinationOffsetPointer, spliceSize, spliceFlags );
+		}
+		else if ( betweenFiles )
+		{
+			bytesMoved = copy_file_range( schemeContext->mFileHandle, offsetPointer,
+				destinationSchemeContext->mFileHandle, destinationOffsetPointer, spliceSize, 0 );
+		}
+		else
+		{
+			bytesMoved = sendfile( destinationSchemeContext->mFileHandle, schemeContext->mFileHandle, offsetPointer, spliceSize );
+		}
+
+		if ( -1 == bytesMoved )
+		{
+			if ( EINTR == errno )
+			{
+				continue;
+			}
+
+			// Where the kernel can't move bytes between the two (e.g. across file systems
+			// before Linux 5.3, or into a file opened for appending), they're copied instead.
+			if ( not copyThroughBuffer
+				and ( ( EINVAL == errno ) or ( EXDEV == errno ) or ( ENOSYS == errno ) or ( EOPNOTSUPP == errno ) ) )
+			{
+				copyThroughBuffer = true;
+				continue;
+			}
+
+			if ( 0 == bytesSpliced )
+			{
+				schemeContext->mErrorCode = errno;
+				return -1;
+			}
+
+			break;
+		}
+
+		if ( 0 == bytesMoved )
+		{
+			break;
+		}
+
+		bytesSpliced += bytesMoved;
+		context->_M_FilePosition += bytesMoved;
+		destinationContext->_M_FilePosition += bytesMoved;
+
+		if ( 0 <= destinationContext->_M_FileSize )
+		{
+			destinationContext->_M_FileSize = std::max( destinationContext->_M_FileSize, destinationContext->_M_FilePosition );
+		}
+	}
+
+	// Without O_SYNC, writes outside of a group commit are made durable one at a time.
+	if ( ( 0 < bytesSpliced )
+		and ( nullptr != destinationSchemeContext->mGroupCommit )
+		and not destinationSchemeContext->mDeferSync
+		and ( -1 == fdatasync( destinationSchemeContext->mFileHandle ) ) )
+	{
+		destinationSchemeContext->mErrorCode = errno;
+		return -1;
+	}
+
+	return bytesSpliced;
+}
+
+bool __scheme_file_sync(
+	struct FileContext* context )
+{
+	if ( nullptr == context )
+	{
+		return false;
+	}
+
+	if ( nullptr == context->_M_SchemeContext )
+	{
+		context->_M_ErrorCode = EIDRM;
+		return false;
+	}
+
+	struct SchemeFileContext* schemeContext = static_cast< struct SchemeFileContext* >( context->_M_SchemeContext );
+	struct SchemeFileHandleUse handleUse( schemeContext );
+
+	if ( not handleUse.mAcquired )
+	{
+		return false;
+	}
+
+	if ( -1 == fdatasync( schemeContext->mFileHandle ) )
+	{
+		schemeContext->mErrorCode = errno;
+		return false;
+	}
+
+	return true;
+}
+
+int64_t __scheme_file_seek(
+	struct FileContext* context,
+	int64_t offset,
+	bool relative )
+{
+	if ( nullptr == context )
+	{
+		return -1;
+	}
 
-struct SchemeFileContext* __allocate_scheme_file_context()
-{
-	struct SchemeFileContext* schemeContext = nullptr;
+	if ( nullptr == context->_M_SchemeContext )
+	{
+		context->_M_ErrorCode = EIDRM;
+		return -1;
+	}
 
-	schemeContext = static_cast< struct SchemeFileContext* >( calloc( 1, sizeof( struct SchemeFileContext ) ) );
+	struct SchemeFileContext* schemeContext = static_cast< struct SchemeFileContext* >( context->_M_SchemeContext );
 
-	if ( nullptr != schemeContext )
+	if ( not FILE_CAN_SEEK( context ) )
 	{
-		schemeContext->mFileHandle = -1;
+		schemeContext->mErrorCode = ESPIPE;
+		return -1;
 	}
 
-	return schemeContext;
+	// Seeking past the end of a file is permitted, and writing there leaves a hole.
+	// Only the file position of the context moves, as reads and writes are made at it.
+	int64_t requestedPosition = relative
+		? ( context->_M_FilePosition + offset )
+		: ( ( 0 > offset ) ? ( context->_M_FileSize + offset ) : offset );
+	int64_t filePosition = std::max< int64_t >( requestedPosition, 0 );
+
+	context->_M_FilePosition = filePosition;
+	return requestedPosition - filePosition;
 }
 
-void __free_scheme_file_context(
-	struct SchemeFileContext* context )
+int64_t __scheme_file_resize(
+	struct FileContext* context,
+	int64_t size,
+	uint8_t fill,
+	bool shrink,
+	bool grow )
 {
-	memset( context, 0, sizeof( struct SchemeFileContext ) );
-	free( context );
-}
+	if ( nullptr == context )
+	{
+		return -1;
+	}
 
-// TODO:
-// [ ] Handle Regular File
-// [ ] Handle Character Device
-// [ ] Handle FIFO/Pipe
-// [ ] Perform Memory Mapped IO for Regular Files
+	if ( nullptr == context->_M_SchemeContext )
+	{
+		context->_M_ErrorCode = EIDRM;
+		return -1;
+	}
 
-// For the moment, assume that we're dealing with
-// a regular file in a Unix environment.
-bool __scheme_file_open(
+	struct SchemeFileContext* schemeContext = static_cast< struct SchemeFileContext* >( context->_M_SchemeContext );
+	struct SchemeFileHandleUse handleUse( schemeContext );
+	int64_t fileSize = context->_M_FileSize;
+
+	if ( not handleUse.mAcquired )
+	{
+		return -1;
+	}
+
+	if ( size < fileSize )
+	{
+		if ( not shrink )
+		{
+			return fileSize;
+		}
+
+		if ( -1 == ftruncate( schemeContext->mFileHandle, size ) )
+		{
+			schemeContext->mErrorCode = errno;
+			return fileSize;
+		}
+
+		return size;
+	}
+
+	if ( ( size == fileSize ) or not grow )
+	{
+		return fileSize;
+	}
+
+	int64_t length = size - fileSize;
+
+	if ( 0 == fill )
+	{
+		// Allocated extents read back as zeros, so nothing needs to be written.
+		if ( 0 == fallocate( schemeContext->mFileHandle, 0, fileSize, length ) )
+		{
+			return size;
+		}
+
+		if ( ( EOPNOTSUPP != errno ) and ( ENOSYS != errno ) )
+		{
+			schemeContext->mErrorCode = errno;
+			return fileSize;
+		}
+
+		// Without fallocate, extending the file leaves a hole, which also reads back as zeros.
+		if ( -1 == ftruncate( schemeContext->mFileHandle, size ) )
+		{
+			schemeContext->mErrorCode = errno;
+			return fileSize;
+		}
+
+		return size;
+	}
+	else
+	{
+		// Allocate the extent up front so the fill doesn't allocate it piecemeal.
+		// This is only advisory; the writes allocate whatever this didn't.
+		fallocate( schemeContext->mFileHandle, FALLOC_FL_KEEP_SIZE, fileSize, length );
+	}
+
+	return fileSize + __scheme_file_fill( schemeContext, fileSize, length, fill );
+}
+
+bool __scheme_file_punch_hole(
 	struct FileContext* context,
-	const std::string& uri,
-	File::IOFlag mode,
-	int& errorCode )
+	int64_t offset,
+	int64_t length )
 {
-	static const char SCHEME_FILE_PREFIX[] = "file://";
-
 	if ( nullptr == context )
 	{
-		errorCode = EBADF;
 		return false;
 	}
 
-	if ( nullptr != context->_M_SchemeContext )
+	if ( nullptr == context->_M_SchemeContext )
 	{
-		errorCode = ESTALE;
+		context->_M_ErrorCode = EIDRM;
 		return false;
 	}
 
-	// Check that the mode is set to READ, WRITE, or both.
-	if ( not ( File::IOFlag::READ & mode )
-		and not ( File::IOFlag::WRITE & mode ) )
+	struct SchemeFileContext* schemeContext = static_cast< struct SchemeFileContext* >( context->_M_SchemeContext );
+	struct SchemeFileHandleUse handleUse( schemeContext );
+
+	if ( not handleUse.mAcquired )
 	{
-		errorCode = EINVAL;
 		return false;
 	}
 
-	// Check that the URI starts with "file://"
-	if ( 0 != strncmp( SCHEME_FILE_PREFIX, uri.c_str(), sizeof( SCHEME_FILE_PREFIX ) - 1 ) )
+	if ( 0 == fallocate( schemeContext->mFileHandle, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, offset, length ) )
 	{
-		errorCode = EINVAL;
-		return false;
+		return true;
 	}
 
-	int flags = O_CREAT | O_SYNC |
-		( ( File::IOFlag::READ & mode )
-			? ( ( File::IOFlag::WRITE & mode ) ? O_RDWR : O_RDONLY )
-			: O_WRONLY );
-	int defaultMode = S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH;
+	// A file system unable to deallocate the range may still be able to zero it in place.
+	if ( ( EOPNOTSUPP == errno )
+		and ( 0 == fallocate( schemeContext->mFileHandle, FALLOC_FL_ZERO_RANGE | FALLOC_FL_KEEP_SIZE, offset, length ) ) )
+	{
+		return true;
+	}
 
-	struct SchemeFileContext* schemeContext = __allocate_scheme_file_context();
+	schemeContext->mErrorCode = errno;
+	return false;
+}
 
-	if ( nullptr == schemeContext )
+bool __scheme_file_data_regions(
+	struct FileContext* context,
+	std::vector< struct FileChunk >& regions )
+{
+	if ( nullptr == context )
 	{
-		errorCode = ENOMEM;
 		return false;
 	}
 
-	schemeContext->mFileHandle = open( uri.c_str() + sizeof( SCHEME_FILE_PREFIX ) - 1, flags, defaultMode );
-
-	if ( -1 == schemeContext->mFileHandle )
+	if ( nullptr == context->_M_SchemeContext )
 	{
-		errorCode = errno;
-		__free_scheme_file_context( schemeContext );
+		context->_M_ErrorCode = EIDRM;
 		return false;
 	}
 
-	// stat the file
-	struct stat fileStatus;
-	if ( -1 == fstat( schemeContext->mFileHandle, &fileStatus ) )
+	struct SchemeFileContext* schemeContext = static_cast< struct SchemeFileContext* >( context->_M_SchemeContext );
+	struct SchemeFileHandleUse handleUse( schemeContext );
+	int64_t fileSize = context->_M_FileSize;
+
+	if ( not handleUse.mAcquired )
 	{
-		errorCode = errno;
-		__free_scheme_file_context( schemeContext );
 		return false;
 	}
 
-	// TODO: Update the capabilities
+	regions.clear();
 
-	switch ( S_IFMT & fileStatus.st_mode )
+	if ( 0 >= fileSize )
 	{
-	case S_IFREG:
-		context->_M_FileSize = fileStatus.st_size;
-	case S_IFCHR:
-	case S_IFIFO:
-		context->_M_FileSize = -1;
+		return 0 == fileSize;
 	}
 
-	context->_M_SchemeContext = static_cast< void* >( schemeContext );
+	// SEEK_DATA and SEEK_HOLE move the file offset, which reads and writes depend upon.
+	off_t filePosition = lseek( schemeContext->mFileHandle, 0, SEEK_CUR );
+	int64_t regionEnd = 0;
+
+	while ( regionEnd < fileSize )
+	{
+		off_t regionBegin = lseek( schemeContext->mFileHandle, regionEnd, SEEK_DATA );
+
+		if ( -1 == regionBegin )
+		{
+			// ENXIO: There is no data past regionEnd, only a trailing hole.
+			// EINVAL: The file system can't report holes, so the whole file is data.
+			if ( ( EINVAL == errno ) and regions.empty() )
+			{
+				regions.push_back( { 0, fileSize } );
+			}
+			else if ( ENXIO != errno )
+			{
+				schemeContext->mErrorCode = errno;
+				lseek( schemeContext->mFileHandle, filePosition, SEEK_SET );
+				return false;
+			}
+
+			break;
+		}
+
+		regionEnd = lseek( schemeContext->mFileHandle, regionBegin, SEEK_HOLE );
+
+		if ( -1 == regionEnd )
+		{
+			schemeContext->mErrorCode = errno;
+			lseek( schemeContext->mFileHandle, filePosition, SEEK_SET );
+			return false;
+		}
+
+		regionEnd = std::min( regionEnd, fileSize );
+		regions.push_back( { regionBegin, regionEnd } );
+	}
+
+	lseek( schemeContext->mFileHandle, filePosition, SEEK_SET );
 	return true;
 }
 
-int64_t __scheme_file_read(
-	struct FileContext* context,
-	uint8_t* buffer,
-	uint32_t bytes,
-	bool updatePosition )
+/*
+ * Map the file type bits of {@param mode} to the type of a directory entry.
+ */
+FileEntry::Type __scheme_file_entry_type(
+	mode_t mode )
 {
-	if ( nullptr == context )
+	switch ( mode & S_IFMT )
 	{
-		return -1;
+		case S_IFREG: return FileEntry::REGULAR;
+		case S_IFDIR: return FileEntry::DIRECTORY;
+		case S_IFLNK: return FileEntry::SYMBOLIC_LINK;
+		case S_IFIFO: return FileEntry::FIFO;
+		case S_IFCHR: return FileEntry::CHARACTER_DEVICE;
+		case S_IFBLK: return FileEntry::BLOCK_DEVICE;
+		case S_IFSOCK: return FileEntry::SOCKET;
+		default: return FileEntry::UNKNOWN;
 	}
+}
 
-	if ( nullptr == context->_M_SchemeContext )
+bool __scheme_file_open_directory(
+	struct DirectoryContext* context,
+	const std::string& uri,
+	int& errorCode )
+{
+	static const char SCHEME_FILE_PREFIX[] = "file://";
+
+	if ( nullptr == context )
 	{
-		context->_M_ErrorCode = EIDRM;
-		return -1;
+		errorCode = EBADF;
+		return false;
 	}
 
-	struct SchemeFileContext* schemeContext = static_cast< struct SchemeFileContext* >( context->_M_SchemeContext );
-	ssize_t bytesRead = -1;
+	if ( nullptr != context->_M_SchemeContext )
+	{
+		errorCode = ESTALE;
+		return false;
+	}
 
-	if ( updatePosition )
+	if ( 0 != strncmp( SCHEME_FILE_PREFIX, uri.c_str(), sizeof( SCHEME_FILE_PREFIX ) - 1 ) )
 	{
-		bytesRead = read( schemeContext->mFileHandle, buffer, bytes );
+		errorCode = EINVAL;
+		return false;
 	}
-	else
+
+	struct SchemeFileDirectoryContext* schemeContext = new ( std::nothrow ) SchemeFileDirectoryContext();
+
+	if ( nullptr == schemeContext )
 	{
-		bytesRead = pread( schemeContext->mFileHandle, buffer, bytes, context->_M_FilePosition );
+		errorCode = ENOMEM;
+		return false;
 	}
 
-	if ( -1 == bytesRead )
+	schemeContext->mDirectoryHandle = open( uri.c_str() + sizeof( SCHEME_FILE_PREFIX ) - 1, O_RDONLY | O_DIRECTORY | O_CLOEXEC );
+
+	if ( -1 == schemeContext->mDirectoryHandle )
 	{
-		schemeContext->mErrorCode = errno;
+		errorCode = errno;
+		delete schemeContext;
+		return false;
 	}
 
-	return static_cast< int64_t >( bytesRead );
+	schemeContext->mBuffer.resize( SCHEME_FILE_DIRECTORY_BUFFER_SIZE );
+	context->_M_SchemeContext = static_cast< void* >( schemeContext );
+	return true;
 }
 
-int64_t __scheme_file_write(
-	struct FileContext* context,
-	const uint8_t* buffer,
-	uint32_t bytes,
-	bool append )
+int64_t __scheme_file_read_directory(
+	struct DirectoryContext* context,
+	std::vector< struct FileEntry >& entries )
 {
 	if ( nullptr == context )
 	{
@@ -188,51 +2164,137 @@ int64_t __scheme_file_write(
 		return -1;
 	}
 
-	struct SchemeFileContext* schemeContext = static_cast< struct SchemeFileContext* >( context->_M_SchemeContext );
-	ssize_t bytesWritten = -1;
+	struct SchemeFileDirectoryContext* schemeContext = static_cast< struct SchemeFileDirectoryContext* >( context->_M_SchemeContext );
+	size_t firstEntry = entries.size();
 
-	if ( append )
+	// A batch holding nothing but "." and ".." isn't the end of the listing.
+	while ( firstEntry == entries.size() )
 	{
-		bytesWritten = pwrite( schemeContext->mFileHandle, buffer, bytes, context->_M_FileSize );
+		ssize_t bytesRead = getdents64( schemeContext->mDirectoryHandle,
+			schemeContext->mBuffer.data(), schemeContext->mBuffer.size() );
 
-		if ( -1 != byteWritten )
+		if ( -1 == bytesRead )
 		{
-			context->_M_FileSize += bytesWritten;
+			context->_M_ErrorCode = errno;
+			return -1;
+		}
+
+		if ( 0 == bytesRead )
+		{
+			break;
+		}
+
+		for ( ssize_t offset = 0; offset < bytesRead; )
+		{
+			const struct dirent64* directoryEntry = reinterpret_cast< const struct dirent64* >(
+				schemeContext->mBuffer.data() + offset );
+			offset += directoryEntry->d_reclen;
+
+			if ( ( 0 == strcmp( ".", directoryEntry->d_name ) )
+				or ( 0 == strcmp( "..", directoryEntry->d_name ) ) )
+			{
+				continue;
+			}
+
+			// d_type is DT_UNKNOWN on file systems that don't record it, which maps to
+			// FileEntry::UNKNOWN and leaves the type to be found with a stat.
+			struct FileEntry entry = {};
+			entry.name = directoryEntry->d_name;
+			entry.type = __scheme_file_entry_type( DTTOIF( directoryEntry->d_type ) );
+			entries.push_back( std::move( entry ) );
 		}
 	}
-	else
+
+	return entries.size() - firstEntry;
+}
+
+bool __scheme_file_stat_entries(
+	struct DirectoryContext* context,
+	std::span< struct FileEntry > entries,
+	bool metadata )
+{
+	if ( nullptr == context )
+	{
+		return false;
+	}
+
+	if ( nullptr == context->_M_SchemeContext )
+	{
+		context->_M_ErrorCode = EIDRM;
+		return false;
+	}
+
+	struct SchemeFileDirectoryContext* schemeContext = static_cast< struct SchemeFileDirectoryContext* >( context->_M_SchemeContext );
+
+	// The metadata is filled in whenever an entry is stat'd, as it comes at no extra cost.
+	std::atomic_size_t nextBatch( 0 );
+	std::atomic_int statErrorCode( 0 );
+	auto statBatches = [ & ]()
 	{
-		bytesWritten = write( schemeContext->mFileHandle, buffer, bytes );
+		size_t batchStart;
 
-		if ( -1 != bytesWritten )
+		while ( ( batchStart = nextBatch.fetch_add( SCHEME_FILE_STAT_BATCH_SIZE ) ) < entries.size() )
 		{
-			context->_M_FilePosition += bytesWritten;
-			context->_M_FileSize = std::max( context->_M_FileSize, context->_M_FilePosition );
+			size_t batchEnd = std::min< size_t >( batchStart + SCHEME_FILE_STAT_BATCH_SIZE, entries.size() );
+
+			for ( size_t entryIndex = batchStart; entryIndex < batchEnd; ++entryIndex )
+			{
+				struct FileEntry& entry = entries[ entryIndex ];
+				struct statx status;
+
+				if ( ( FileEntry::UNKNOWN != entry.type ) and ( not metadata or entry.hasMetadata ) )
+				{
+					continue;
+				}
+
+				if ( 0 != statx( schemeContext->mDirectoryHandle, entry.name.c_str(),
+					AT_SYMLINK_NOFOLLOW | AT_NO_AUTOMOUNT, STATX_TYPE | STATX_MODE | STATX_SIZE | STATX_MTIME, &status ) )
+				{
+					// An entry removed since it was listed is left as it is.
+					if ( ENOENT != errno )
+					{
+						statErrorCode.store( errno );
+					}
+
+					continue;
+				}
+
+				entry.type = __scheme_file_entry_type( status.stx_mode );
+				entry.hasMetadata = true;
+				entry.size = status.stx_size;
+				entry.modifiedTime = status.stx_mtime.tv_sec * 1000000000LL + status.stx_mtime.tv_nsec;
+				entry.mode = status.stx_mode & 07777;
+			}
 		}
-	}
+	};
+
+	unsigned int workerCount = std::min< size_t >(
+		std::min( std::max( 1U, std::thread::hardware_concurrency() ), static_cast< unsigned int >( SCHEME_FILE_STAT_THREAD_COUNT ) ),
+		( entries.size() + SCHEME_FILE_STAT_BATCH_SIZE - 1 ) / SCHEME_FILE_STAT_BATCH_SIZE );
+	_run_parallel( _shared_worker_pool(), workerCount, [ &statBatches ]( unsigned int ) { statBatches(); } );
 
-	if ( -1 == bytesWritten )
+	if ( 0 != statErrorCode.load() )
 	{
-		schemeContext->mErrorCode = errno;
+		context->_M_ErrorCode = statErrorCode.load();
+		return false;
 	}
 
-	return static_cast< int64_t >( bytesWritten );
+	return true;
 }
 
-int64_t __scheme_file_seek(
-	struct FileContext* context,
-	int64_t offset,
-	bool relative )
+void __scheme_file_close_directory(
+	struct DirectoryContext* context )
 {
-}
+	if ( ( nullptr == context )
+		or ( nullptr == context->_M_SchemeContext ) )
+	{
+		return;
+	}
 
-bool __scheme_file_resize(
-	struct FileContext* context,
-	int64_t size,
-	uint8_t fill,
-	bool grown,
-	bool shrink )
-{
+	struct SchemeFileDirectoryContext* schemeContext = static_cast< struct SchemeFileDirectoryContext* >( context->_M_SchemeContext );
+	close( schemeContext->mDirectoryHandle );
+	delete schemeContext;
+	context->_M_SchemeContext = nullptr;
 }
 
 std::string __scheme_file_error_string(
@@ -268,8 +2330,42 @@ void __scheme_file_close(
 	}
 
 	struct SchemeFileContext* schemeContext = static_cast< struct SchemeFileContext* >( context->_M_SchemeContext );
+
+	// An atomic write not yet committed is published on close, of the handle that
+	// wrote it rather than its dups. Should that fail, the target is left untouched
+	// and the replacement discarded.
+	if ( FILE_CAN_WRITE( context )
+		and ( nullptr != schemeContext->mTargetPath )
+		and not __scheme_file_publish( context, true )
+		and ( nullptr != schemeContext->mTemporaryPath ) )
+	{
+		unlink( schemeContext->mTemporaryPath );
+	}
+
+	context->_M_SchemeContext = nullptr;
+
+	if ( 1 != schemeContext->mReferenceCount-- )
+	{
+		return;
+	}
+
+	if ( schemeContext->mHandleBudgeted )
+	{
+		std::lock_guard< std::mutex > budgetLock( _G_HandleBudgetMutex );
+
+		if ( -1 != schemeContext->mFileHandle )
+		{
+			__scheme_file_unlist_handle( schemeContext );
+		}
+
+		--_G_BudgetedFileCount;
+	}
+
 	// TODO: Catch the error for close
-	close( schemeContext->mFileHandle );
+	if ( -1 != schemeContext->mFileHandle )
+	{
+		close( schemeContext->mFileHandle );
+	}
+
 	__free_scheme_file_context( schemeContext );
-	context->_M_SchemeContext = nullptr;
 }
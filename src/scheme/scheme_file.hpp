@@ -6,7 +6,9 @@
 #pragma once
 
 #include <cstdint>
+#include <span>
 #include <string>
+#include <vector>
 
 #include "File.hpp"
 #include "FileContext.hpp"
@@ -16,6 +18,18 @@
 void __scheme_file_close(
 	struct FileContext* context );
 
+void __scheme_file_close_directory(
+	struct DirectoryContext* context );
+
+bool __scheme_file_data_regions(
+	struct FileContext* context,
+	std::vector< struct FileChunk >& regions );
+
+bool __scheme_file_dup(
+	struct FileContext* context,
+	struct FileContext* dupContext,
+	int& errorCode );
+
 std::string __scheme_file_error_string(
 	struct FileContext* context );
 
@@ -25,44 +39,129 @@ bool __scheme_file_open(
 	File::IOFlag mode,
 	int& errorCode );
 
+bool __scheme_file_open_directory(
+	struct DirectoryContext* context,
+	const std::string& uri,
+	int& errorCode );
+
+int __scheme_file_poll_handle(
+	struct FileContext* context );
+
+bool __scheme_file_punch_hole(
+	struct FileContext* context,
+	int64_t offset,
+	int64_t length );
+
+int64_t __scheme_file_group_append(
+	struct FileContext* context,
+	const uint8_t* buffer,
+	size_t bytes,
+	int64_t offset );
+
+bool __scheme_file_publish(
+	struct FileContext* context,
+	bool syncDirectory );
+
+int64_t __scheme_file_pread(
+	struct FileContext* context,
+	uint8_t* buffer,
+	size_t bytes,
+	int64_t offset );
+
 int64_t __scheme_file_read(
 	struct FileContext* context,
 	uint8_t* buffer,
-	uint32_t bytes,
+	size_t bytes,
 	bool updatePosition );
 
-bool __scheme_file_resize(
+int64_t __scheme_file_read_directory(
+	struct DirectoryContext* context,
+	std::vector< struct FileEntry >& entries );
+
+bool __scheme_file_refresh(
+	struct FileContext* context,
+	bool& replaced );
+
+int64_t __scheme_file_resize(
 	struct FileContext* context,
 	int64_t size,
 	uint8_t fill,
-	bool grown,
-	bool shrink );
+	bool shrink,
+	bool grow );
+
+bool __scheme_file_snapshot(
+	struct FileContext* context,
+	struct FileContext* snapshotContext,
+	int& errorCode );
 
 int64_t __scheme_file_seek(
 	struct FileContext* context,
 	int64_t offset,
 	bool relative );
 
+int64_t __scheme_file_splice(
+	struct FileContext* context,
+	struct FileContext* destinationContext,
+	int64_t bytes );
+
+bool __scheme_file_stat_entries(
+	struct DirectoryContext* context,
+	std::span< struct FileEntry > entries,
+	bool metadata );
+
 bool __scheme_file_sync(
 	struct FileContext* context );
 
+std::shared_ptr< const uint8_t > __scheme_file_view(
+	struct FileContext* context,
+	int64_t offset,
+	int64_t length );
+
+bool __scheme_file_watch(
+	struct FileContext* context,
+	int notifyHandle,
+	int& fileWatch,
+	int& directoryWatch );
+
 int64_t __scheme_file_write(
 	struct FileContext* context,
 	const uint8_t* buffer,
-	uint32_t bytes,
+	size_t bytes,
 	bool append );
 
+// Handle Budget
+File::HandleStats __scheme_file_handle_stats();
+
+void __scheme_file_set_handle_budget(
+	size_t handles );
+
 // Scheme API Constants
 const std::string SCHEME_FILE_CANONICAL_PREFIX( "file" );
 
 const struct SchemeAPI SCHEME_FILE_API =
 {
-	._F_close = __scheme_file_close,
-	._F_error_string = __scheme_file_error_string,
 	._F_open = __scheme_file_open,
+	._F_error_string = __scheme_file_error_string,
+	._F_close = __scheme_file_close,
+	._F_seek = __scheme_file_seek,
 	._F_read = __scheme_file_read,
+	._F_pread = __scheme_file_pread,
+	._F_write = __scheme_file_write,
+	._F_group_append = __scheme_file_group_append,
 	._F_resize = __scheme_file_resize,
-	._F_seek = __scheme_file_seek,
+	._F_punch_hole = __scheme_file_punch_hole,
+	._F_data_regions = __scheme_file_data_regions,
 	._F_sync = __scheme_file_sync,
-	._F_write = __scheme_file_write
+	._F_publish = __scheme_file_publish,
+	._F_snapshot = __scheme_file_snapshot,
+	._F_dup = __scheme_file_dup,
+	._F_refresh = __scheme_file_refresh,
+	._F_watch = __scheme_file_watch,
+	._F_splice = __scheme_file_splice,
+	._F_poll_handle = __scheme_file_poll_handle,
+	._F_view = __scheme_file_view,
+	._F_open_directory = __scheme_file_open_directory,
+	._F_read_directory = __scheme_file_read_directory,
+	._F_stat_entries = __scheme_file_stat_entries,
+	._F_close_directory = __scheme_file_close_directory
 };
@@ -0,0 +1,1462 @@
+/**
+ * Copyright ©2021. Brent Weichel. All Rights Reserved.
+ * Permission to use, copy, modify, and/or distribute this software, in whole
+ * or part by any means, without express prior written agreement is prohibited.
+ */
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <mutex>
+#include <netdb.h>
+#include <new>
+#include <string>
+#include <strings.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+#include "File.hpp"
+#include "FileContext.hpp"
+#include "FileDirectory.hpp"
+#include "scheme_ftp.hpp"
+
+#define SCHEME_FTP_DEFAULT_PORT          ( "21" )
+#define SCHEME_FTP_READ_AHEAD_SIZE       ( 256 * 1024 )
+#define SCHEME_FTP_MAX_IDLE_CONNECTIONS  ( 8 )
+
+enum SchemeFTPTransfer
+{
+	SCHEME_FTP_TRANSFER_NONE,
+	SCHEME_FTP_TRANSFER_RETRIEVE,
+	SCHEME_FTP_TRANSFER_STORE,
+	SCHEME_FTP_TRANSFER_APPEND,
+	SCHEME_FTP_TRANSFER_LIST
+};
+
+// A logged in control connection. These are pooled between
+// opens to the same server, keyed on user@host:port.
+struct SchemeFTPConnection
+{
+	int mSocket;
+	std::string mPending; // Bytes received past the last reply line
+
+	// The server lists "REST STREAM" in its FEAT reply (RFC 3659), so a STOR
+	// after a REST writes in place from that offset rather than replacing the file.
+	bool mRestartStore;
+};
+
+struct SchemeFTPContext
+{
+	struct SchemeFTPConnection* mConnection;
+	std::string mPoolKey;
+	std::string mPath;
+
+	// The data connection of the transfer in progress, if any.
+	// mTransferPosition is the file offset that the next byte
+	// sent or received on mTransferSocket corresponds to.
+	enum SchemeFTPTransfer mTransfer;
+	int mTransferSocket;
+	int64_t mTransferPosition;
+
+	// Bytes received from a RETR (or MLSD) that have not yet been consumed.
+	// mReadAheadPosition is the file offset of mReadAhead[ mReadAheadOffset ].
+	std::vector< uint8_t > mReadAhead;
+	size_t mReadAheadOffset;
+	int64_t mReadAheadPosition;
+
+	int mErrorCode;
+	int mReplyCode;
+	std::string mReplyMessage;
+};
+
+static std::mutex _G_FTPConnectionPoolMutex;
+static std::unordered_multimap< std::string, struct SchemeFTPConnection* > _G_FTPConnectionPool;
+
+static struct SchemeFTPContext* __allocate_scheme_ftp_context()
+{
+	struct SchemeFTPContext* schemeContext = new ( std::nothrow ) SchemeFTPContext();
+
+	if ( nullptr != schemeContext )
+	{
+		schemeContext->mConnection = nullptr;
+		schemeContext->mTransfer = SCHEME_FTP_TRANSFER_NONE;
+		schemeContext->mTransferSocket = -1;
+		schemeContext->mTransferPosition = 0;
+		schemeContext->mReadAheadOffset = 0;
+		schemeContext->mReadAheadPosition = 0;
+		schemeContext->mErrorCode = 0;
+		schemeContext->mReplyCode = 0;
+	}
+
+	return schemeContext;
+}
+
+static void __free_scheme_ftp_context(
+	struct SchemeFTPContext* schemeContext )
+{
+	delete schemeContext;
+}
+
+static void __free_ftp_connection(
+	struct SchemeFTPConnection* connection )
+{
+	if ( nullptr != connection )
+	{
+		::close( connection->mSocket );
+		delete connection;
+	}
+}
+
+/*
+ * Connect a TCP socket to the given host and service.
+ * @return The connected socket is returned, else -1 and {@param errorCode} is set.
+ */
+static int __ftp_connect(
+	const std::string& host,
+	const std::string& service,
+	int& errorCode )
+{
+	struct addrinfo hints;
+	struct addrinfo* addresses = nullptr;
+
+	memset( &hints, 0, sizeof( hints ) );
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+
+	if ( 0 != getaddrinfo( host.c_str(), service.c_str(), &hints, &addresses ) )
+	{
+		errorCode = EHOSTUNREACH;
+		return -1;
+	}
+
+	int connectedSocket = -1;
+	errorCode = ECONNREFUSED;
+
+	for ( struct addrinfo* address = addresses; nullptr != address; address = address->ai_next )
+	{
+		connectedSocket = socket( address->ai_family, address->ai_socktype | SOCK_CLOEXEC, address->ai_protocol );
+
+		if ( -1 == connectedSocket )
+		{
+			errorCode = errno;
+			continue;
+		}
+
+		if ( 0 == connect( connectedSocket, address->ai_addr, address->ai_addrlen ) )
+		{
+			break;
+		}
+
+		errorCode = errno;
+		::close( connectedSocket );
+		connectedSocket = -1;
+	}
+
+	freeaddrinfo( addresses );
+	return connectedSocket;
+}
+
+static bool __ftp_send_all(
+	int socketHandle,
+	const uint8_t* buffer,
+	size_t bytes,
+	int& errorCode )
+{
+	while ( 0 < bytes )
+	{
+		ssize_t bytesSent = send( socketHandle, buffer, bytes, MSG_NOSIGNAL );
+
+		if ( -1 == bytesSent )
+		{
+			if ( EINTR == errno )
+			{
+				continue;
+			}
+
+			errorCode = errno;
+			return false;
+		}
+
+		buffer += bytesSent;
+		bytes -= bytesSent;
+	}
+
+	return true;
+}
+
+/*
+ * Read a single, possibly multi-line, reply from the control connection.
+ * @return The three digit reply code is returned, or -1 on a connection error.
+ */
+static int __ftp_read_reply(
+	struct SchemeFTPConnection* connection,
+	std::string& message,
+	int& errorCode )
+{
+	std::string multilinePrefix;
+	message.clear();
+
+	while ( true )
+	{
+		size_t lineEnd = connection->mPending.find( "\r\n" );
+
+		if ( std::string::npos == lineEnd )
+		{
+			char receiveBuffer[ 1024 ];
+			ssize_t bytesReceived = recv( connection->mSocket, receiveBuffer, sizeof( receiveBuffer ), 0 );
+
+			if ( 0 >= bytesReceived )
+			{
+				if ( ( -1 == bytesReceived ) and ( EINTR == errno ) )
+				{
+					continue;
+				}
+
+				errorCode = ( 0 == bytesReceived ) ? ECONNRESET : errno;
+				return -1;
+			}
+
+			connection->mPending.append( receiveBuffer, bytesReceived );
+			continue;
+		}
+
+		std::string line = connection->mPending.substr( 0, lineEnd );
+		connection->mPending.erase( 0, lineEnd + 2 );
+		message += line;
+
+		if ( multilinePrefix.empty() )
+		{
+			if ( ( 4 <= line.size() ) and ( '-' == line[ 3 ] ) )
+			{
+				// Multi-line replies are terminated by "ddd " with the same code.
+				multilinePrefix = line.substr( 0, 3 ) + " ";
+				message += "\n";
+				continue;
+			}
+		}
+		else if ( 0 != line.compare( 0, multilinePrefix.size(), multilinePrefix ) )
+		{
+			message += "\n";
+			continue;
+		}
+
+		if ( ( 3 > line.size() ) or not isdigit( line[ 0 ] ) )
+		{
+			errorCode = EPROTO;
+			return -1;
+		}
+
+		return atoi( line.substr( 0, 3 ).c_str() );
+	}
+}
+
+static int __ftp_command(
+	struct SchemeFTPConnection* connection,
+	const std::string& command,
+	std::string& message,
+	int& errorCode )
+{
+	std::string line = command + "\r\n";
+
+	if ( not __ftp_send_all( connection->mSocket, reinterpret_cast< const uint8_t* >( line.data() ), line.size(), errorCode ) )
+	{
+		return -1;
+	}
+
+	return __ftp_read_reply( connection, message, errorCode );
+}
+
+/*
+ * Take a logged in control connection from the pool, or establish a new one.
+ */
+static struct SchemeFTPConnection* __ftp_acquire_connection(
+	const std::string& poolKey,
+	const std::string& host,
+	const std::string& port,
+	const std::string& user,
+	const std::string& password,
+	int& errorCode )
+{
+	std::string message;
+
+	while ( true )
+	{
+		struct SchemeFTPConnection* connection = nullptr;
+
+		{
+			std::lock_guard poolLock( _G_FTPConnectionPoolMutex );
+			auto poolIterator = _G_FTPConnectionPool.find( poolKey );
+
+			if ( _G_FTPConnectionPool.end() != poolIterator )
+			{
+				connection = poolIterator->second;
+				_G_FTPConnectionPool.erase( poolIterator );
+			}
+		}
+
+		if ( nullptr == connection )
+		{
+			break;
+		}
+
+		// The server may have timed out an idle connection.
+		if ( 200 == __ftp_command( connection, "NOOP", message, errorCode ) )
+		{
+			return connection;
+		}
+
+		__free_ftp_connection( connection );
+	}
+
+	int controlSocket = __ftp_connect( host, port, errorCode );
+
+	if ( -1 == controlSocket )
+	{
+		return nullptr;
+	}
+
+	struct SchemeFTPConnection* connection = new ( std::nothrow ) SchemeFTPConnection();
+
+	if ( nullptr == connection )
+	{
+		::close( controlSocket );
+		errorCode = ENOMEM;
+		return nullptr;
+	}
+
+	connection->mSocket = controlSocket;
+
+	if ( 220 != __ftp_read_reply( connection, message, errorCode ) )
+	{
+		__free_ftp_connection( connection );
+		return nullptr;
+	}
+
+	int replyCode = __ftp_command( connection, "USER " + user, message, errorCode );
+
+	if ( 331 == replyCode )
+	{
+		replyCode = __ftp_command( connection, "PASS " + password, message, errorCode );
+	}
+
+	if ( ( 230 != replyCode )
+		or ( 200 != __ftp_command( connection, "TYPE I", message, errorCode ) ) )
+	{
+		if ( 0 <= replyCode )
+		{
+			errorCode = EACCES;
+		}
+
+		__free_ftp_connection( connection );
+		return nullptr;
+	}
+
+	// Servers predating RFC 2389 reject FEAT, and so can't be trusted to restart a STOR.
+	if ( 211 == __ftp_command( connection, "FEAT", message, errorCode ) )
+	{
+		std::transform( message.begin(), message.end(), message.begin(), ::toupper );
+		connection->mRestartStore = ( std::string::npos != message.find( " REST STREAM" ) );
+	}
+
+	return connection;
+}
+
+static void __ftp_release_connection(
+	const std::string& poolKey,
+	struct SchemeFTPConnection* connection )
+{
+	if ( nullptr == connection )
+	{
+		return;
+	}
+
+	{
+		std::lock_guard poolLock( _G_FTPConnectionPoolMutex );
+
+		if ( SCHEME_FTP_MAX_IDLE_CONNECTIONS > _G_FTPConnectionPool.count( poolKey ) )
+		{
+			_G_FTPConnectionPool.emplace( poolKey, connection );
+			return;
+		}
+	}
+
+	int errorCode;
+	std::string message;
+	__ftp_command( connection, "QUIT", message, errorCode );
+	__free_ftp_connection( connection );
+}
+
+/*
+ * Enter passive mode and connect the data connection.
+ * EPSV is preferred as it works over IPv6 and through NAT,
+ * falling back to PASV for older servers.
+ */
+static int __ftp_open_data_connection(
+	struct SchemeFTPContext* schemeContext )
+{
+	struct SchemeFTPConnection* connection = schemeContext->mConnection;
+	std::string& message = schemeContext->mReplyMessage;
+	int& errorCode = schemeContext->mErrorCode;
+
+	struct sockaddr_storage peerAddress;
+	socklen_t peerAddressLength = sizeof( peerAddress );
+	char peerHost[ NI_MAXHOST ];
+
+	if ( ( 0 != getpeername( connection->mSocket, reinterpret_cast< struct sockaddr* >( &peerAddress ), &peerAddressLength ) )
+		or ( 0 != getnameinfo( reinterpret_cast< struct sockaddr* >( &peerAddress ), peerAddressLength,
+			peerHost, sizeof( peerHost ), nullptr, 0, NI_NUMERICHOST ) ) )
+	{
+		errorCode = errno;
+		return -1;
+	}
+
+	std::string host( peerHost );
+	unsigned int port = 0;
+
+	schemeContext->mReplyCode = __ftp_command( connection, "EPSV", message, errorCode );
+
+	if ( 229 == schemeContext->mReplyCode )
+	{
+		// 229 Entering Extended Passive Mode (|||port|)
+		size_t delimiter = message.find( "(|||" );
+
+		if ( ( std::string::npos == delimiter )
+			or ( 1 != sscanf( message.c_str() + delimiter, "(|||%u|)", &port ) ) )
+		{
+			errorCode = EPROTO;
+			return -1;
+		}
+	}
+	else if ( 0 <= schemeContext->mReplyCode )
+	{
+		unsigned int h1, h2, h3, h4, p1, p2;
+		schemeContext->mReplyCode = __ftp_command( connection, "PASV", message, errorCode );
+
+		if ( 227 != schemeContext->mReplyCode )
+		{
+			errorCode = ( 0 <= schemeContext->mReplyCode ) ? EPROTO : errorCode;
+			return -1;
+		}
+
+		// 227 Entering Passive Mode (h1,h2,h3,h4,p1,p2)
+		size_t delimiter = message.find( '(' );
+
+		if ( ( std::string::npos == delimiter )
+			or ( 6 != sscanf( message.c_str() + delimiter, "(%u,%u,%u,%u,%u,%u)", &h1, &h2, &h3, &h4, &p1, &p2 ) ) )
+		{
+			errorCode = EPROTO;
+			return -1;
+		}
+
+		port = ( p1 << 8 ) | p2;
+	}
+	else
+	{
+		return -1;
+	}
+
+	return __ftp_connect( host, std::to_string( port ), errorCode );
+}
+
+/*
+ * Close the data connection of the transfer in progress and collect the
+ * completion reply from the server. An unfinished RETR is aborted.
+ */
+static bool __ftp_finish_transfer(
+	struct SchemeFTPContext* schemeContext )
+{
+	if ( SCHEME_FTP_TRANSFER_NONE == schemeContext->mTransfer )
+	{
+		return true;
+	}
+
+	enum SchemeFTPTransfer transfer = schemeContext->mTransfer;
+	schemeContext->mTransfer = SCHEME_FTP_TRANSFER_NONE;
+
+	// A RETR that reached the end of the file has already had its reply collected.
+	if ( -1 == schemeContext->mTransferSocket )
+	{
+		return true;
+	}
+
+	::close( schemeContext->mTransferSocket );
+	schemeContext->mTransferSocket = -1;
+
+	if ( ( SCHEME_FTP_TRANSFER_RETRIEVE == transfer ) or ( SCHEME_FTP_TRANSFER_LIST == transfer ) )
+	{
+		// Closing the data connection early causes the server to reply
+		// with either 426 (aborted) or 226 (already fully sent).
+		schemeContext->mReplyCode = __ftp_read_reply(
+			schemeContext->mConnection, schemeContext->mReplyMessage, schemeContext->mErrorCode );
+		return ( 0 <= schemeContext->mReplyCode );
+	}
+
+	schemeContext->mReplyCode = __ftp_read_reply(
+		schemeContext->mConnection, schemeContext->mReplyMessage, schemeContext->mErrorCode );
+
+	if ( ( 226 != schemeContext->mReplyCode ) and ( 250 != schemeContext->mReplyCode ) )
+	{
+		if ( 0 <= schemeContext->mReplyCode )
+		{
+			schemeContext->mErrorCode = EIO;
+		}
+
+		return false;
+	}
+
+	return true;
+}
+
+/*
+ * Start a transfer from {@param position}, sending a REST first if {@param restart}
+ * is set. Without one, a RETR starts from the beginning of the file, and a STOR
+ * replaces the file.
+ */
+static bool __ftp_start_transfer(
+	struct SchemeFTPContext* schemeContext,
+	enum SchemeFTPTransfer transfer,
+	int64_t position,
+	bool restart )
+{
+	if ( not __ftp_finish_transfer( schemeContext ) )
+	{
+		return false;
+	}
+
+	int dataSocket = __ftp_open_data_connection( schemeContext );
+
+	if ( -1 == dataSocket )
+	{
+		return false;
+	}
+
+	std::string& message = schemeContext->mReplyMessage;
+	int& errorCode = schemeContext->mErrorCode;
+
+	if ( restart )
+	{
+		schemeContext->mReplyCode = __ftp_command(
+			schemeContext->mConnection, "REST " + std::to_string( position ), message, errorCode );
+
+		if ( 350 != schemeContext->mReplyCode )
+		{
+			errorCode = ( 0 <= schemeContext->mReplyCode ) ? ESPIPE : errorCode;
+			::close( dataSocket );
+			return false;
+		}
+	}
+
+	static const char* TRANSFER_COMMANDS[] = { "", "RETR ", "STOR ", "APPE ", "MLSD " };
+	schemeContext->mReplyCode = __ftp_command(
+		schemeContext->mConnection, TRANSFER_COMMANDS[ transfer ] + schemeContext->mPath, message, errorCode );
+
+	if ( ( 150 != schemeContext->mReplyCode ) and ( 125 != schemeContext->mReplyCode ) )
+	{
+		if ( 0 <= schemeContext->mReplyCode )
+		{
+			errorCode = ( 550 == schemeContext->mReplyCode ) ? ENOENT : EIO;
+		}
+
+		::close( dataSocket );
+		return false;
+	}
+
+	schemeContext->mTransfer = transfer;
+	schemeContext->mTransferSocket = dataSocket;
+	schemeContext->mTransferPosition = position;
+	return true;
+}
+
+/*
+ * Query the size of the file on the server.
+ * @return The size of the file, or -1 if the server could not provide it.
+ */
+static int64_t __ftp_query_size(
+	struct SchemeFTPContext* schemeContext )
+{
+	schemeContext->mReplyCode = __ftp_command( schemeContext->mConnection,
+		"SIZE " + schemeContext->mPath, schemeContext->mReplyMessage, schemeContext->mErrorCode );
+
+	if ( 213 != schemeContext->mReplyCode )
+	{
+		return -1;
+	}
+
+	return strtoll( schemeContext->mReplyMessage.c_str() + 4, nullptr, 10 );
+}
+
+static void __ftp_discard_read_ahead(
+	struct SchemeFTPContext* schemeContext )
+{
+	schemeContext->mReadAhead.clear();
+	schemeContext->mReadAheadOffset = 0;
+}
+
+/*
+ * Refill the read ahead buffer from the RETR stream positioned at
+ * the end of the buffered bytes, reissuing REST + RETR if required.
+ * @return The number of bytes added to the buffer, zero on end of file, -1 on error.
+ */
+static int64_t __ftp_fill_read_ahead(
+	struct SchemeFTPContext* schemeContext,
+	int64_t position )
+{
+	int64_t bufferedEnd = schemeContext->mReadAheadPosition
+		+ static_cast< int64_t >( schemeContext->mReadAhead.size() - schemeContext->mReadAheadOffset );
+
+	if ( ( position < schemeContext->mReadAheadPosition ) or ( position > bufferedEnd ) )
+	{
+		__ftp_discard_read_ahead( schemeContext );
+		schemeContext->mReadAheadPosition = position;
+		bufferedEnd = position;
+	}
+
+	if ( ( SCHEME_FTP_TRANSFER_RETRIEVE != schemeContext->mTransfer )
+		or ( schemeContext->mTransferPosition != bufferedEnd ) )
+	{
+		if ( not __ftp_start_transfer( schemeContext, SCHEME_FTP_TRANSFER_RETRIEVE, bufferedEnd, 0 != bufferedEnd ) )
+		{
+			return -1;
+		}
+	}
+
+	if ( -1 == schemeContext->mTransferSocket )
+	{
+		// The server has already sent the remainder of the file.
+		return 0;
+	}
+
+	// Compact the consumed bytes out of the front of the buffer.
+	if ( 0 != schemeContext->mReadAheadOffset )
+	{
+		schemeContext->mReadAhead.erase(
+			schemeContext->mReadAhead.begin(),
+			schemeContext->mReadAhead.begin() + schemeContext->mReadAheadOffset );
+		schemeContext->mReadAheadOffset = 0;
+	}
+
+	size_t bufferedBytes = schemeContext->mReadAhead.size();
+	schemeContext->mReadAhead.resize( bufferedBytes + SCHEME_FTP_READ_AHEAD_SIZE );
+
+	ssize_t bytesReceived;
+	do
+	{
+		bytesReceived = recv( schemeContext->mTransferSocket,
+			schemeContext->mReadAhead.data() + bufferedBytes, SCHEME_FTP_READ_AHEAD_SIZE, 0 );
+	} while ( ( -1 == bytesReceived ) and ( EINTR == errno ) );
+
+	schemeContext->mReadAhead.resize( bufferedBytes + std::max< ssize_t >( 0, bytesReceived ) );
+
+	if ( -1 == bytesReceived )
+	{
+		schemeContext->mErrorCode = errno;
+		return -1;
+	}
+
+	if ( 0 == bytesReceived )
+	{
+		// End of the file; collect the 226 and leave the transfer marked complete.
+		::close( schemeContext->mTransferSocket );
+		schemeContext->mTransferSocket = -1;
+		schemeContext->mReplyCode = __ftp_read_reply(
+			schemeContext->mConnection, schemeContext->mReplyMessage, schemeContext->mErrorCode );
+		return 0;
+	}
+
+	schemeContext->mTransferPosition += bytesReceived;
+	return bytesReceived;
+}
+
+static bool __parse_ftp_uri(
+	const std::string& uri,
+	std::string& user,
+	std::string& password,
+	std::string& host,
+	std::string& port,
+	std::string& path )
+{
+	static const char SCHEME_FTP_PREFIX[] = "ftp://";
+
+	if ( 0 != strncasecmp( SCHEME_FTP_PREFIX, uri.c_str(), sizeof( SCHEME_FTP_PREFIX ) - 1 ) )
+	{
+		return false;
+	}
+
+	std::string remainder = uri.substr( sizeof( SCHEME_FTP_PREFIX ) - 1 );
+	size_t pathStart = remainder.find( '/' );
+
+	if ( std::string::npos == pathStart )
+	{
+		return false;
+	}
+
+	std::string authority = remainder.substr( 0, pathStart );
+	path = remainder.substr( pathStart );
+
+	size_t userEnd = authority.rfind( '@' );
+	user = "anonymous";
+	password = "anonymous@";
+
+	if ( std::string::npos != userEnd )
+	{
+		std::string userInformation = authority.substr( 0, userEnd );
+		size_t passwordStart = userInformation.find( ':' );
+		user = userInformation.substr( 0, passwordStart );
+		password = ( std::string::npos == passwordStart ) ? "" : userInformation.substr( passwordStart + 1 );
+		authority.erase( 0, userEnd + 1 );
+	}
+
+	size_t portStart = authority.rfind( ':' );
+	port = SCHEME_FTP_DEFAULT_PORT;
+
+	if ( ( std::string::npos != portStart ) and ( std::string::npos == authority.find( ']', portStart ) ) )
+	{
+		port = authority.substr( portStart + 1 );
+		authority.erase( portStart );
+	}
+
+	// Strip the brackets from IPv6 literals.
+	if ( ( 2 < authority.size() ) and ( '[' == authority.front() ) and ( ']' == authority.back() ) )
+	{
+		authority = authority.substr( 1, authority.size() - 2 );
+	}
+
+	host = authority;
+	return not host.empty();
+}
+
+bool __scheme_ftp_open(
+	struct FileContext* context,
+	const std::string& uri,
+	File::IOFlag mode,
+	int& errorCode )
+{
+	if ( nullptr == context )
+	{
+		errorCode = EBADF;
+		return false;
+	}
+
+	if ( nullptr != context->_M_SchemeContext )
+	{
+		errorCode = ESTALE;
+		return false;
+	}
+
+	// Check that the mode is set to READ, WRITE, or both.
+	if ( not ( File::IOFlag::READ & mode )
+		and not ( File::IOFlag::WRITE & mode ) )
+	{
+		errorCode = EINVAL;
+		return false;
+	}
+
+	std::string user, password, host, port, path;
+
+	// The root is a directory, and can only be listed.
+	if ( not __parse_ftp_uri( uri, user, password, host, port, path )
+		or ( "/" == path ) )
+	{
+		errorCode = EINVAL;
+		return false;
+	}
+
+	struct SchemeFTPContext* schemeContext = __allocate_scheme_ftp_context();
+
+	if ( nullptr == schemeContext )
+	{
+		errorCode = ENOMEM;
+		return false;
+	}
+
+	schemeContext->mPath = path;
+	schemeContext->mPoolKey = user + "@" + host + ":" + port;
+	schemeContext->mConnection = __ftp_acquire_connection(
+		schemeContext->mPoolKey, host, port, user, password, errorCode );
+
+	if ( nullptr == schemeContext->mConnection )
+	{
+		__free_scheme_ftp_context( schemeContext );
+		return false;
+	}
+
+	context->_M_FileSize = __ftp_query_size( schemeContext );
+
+	if ( -1 == context->_M_FileSize )
+	{
+		// A missing file is only acceptable if we're going to write it.
+		if ( not ( File::IOFlag::WRITE & mode ) )
+		{
+			errorCode = ( 550 == schemeContext->mReplyCode ) ? ENOENT : EIO;
+			__ftp_release_connection( schemeContext->mPoolKey, schemeContext->mConnection );
+			__free_scheme_ftp_context( schemeContext );
+			return false;
+		}
+
+		context->_M_FileSize = 0;
+	}
+
+	context->_M_FilePosition = 0;
+	context->_M_Capabilities = static_cast< File::IOFlag >(
+		( mode & ( File::IOFlag::READ | File::IOFlag::WRITE ) ) | File::IOFlag::SEEK );
+	context->_M_SchemeContext = static_cast< void* >( schemeContext );
+	return true;
+}
+
+int64_t __scheme_ftp_read(
+	struct FileContext* context,
+	uint8_t* buffer,
+	size_t bytes,
+	bool updatePosition )
+{
+	if ( nullptr == context )
+	{
+		return -1;
+	}
+
+	if ( nullptr == context->_M_SchemeContext )
+	{
+		context->_M_ErrorCode = EIDRM;
+		return -1;
+	}
+
+	struct SchemeFTPContext* schemeContext = static_cast< struct SchemeFTPContext* >( context->_M_SchemeContext );
+	int64_t position = context->_M_FilePosition;
+	int64_t bytesRead = 0;
+
+	if ( ( SCHEME_FTP_TRANSFER_STORE == schemeContext->mTransfer )
+		or ( SCHEME_FTP_TRANSFER_APPEND == schemeContext->mTransfer ) )
+	{
+		if ( not __ftp_finish_transfer( schemeContext ) )
+		{
+			return -1;
+		}
+	}
+
+	// Sequential reads are served from the read ahead buffer, which is
+	// fed by a single RETR stream kept open between calls. Only a
+	// discontiguous read pays for a new REST + RETR round trip.
+	while ( bytesRead < static_cast< int64_t >( bytes ) )
+	{
+		int64_t bufferedEnd = schemeContext->mReadAheadPosition
+			+ static_cast< int64_t >( schemeContext->mReadAhead.size() - schemeContext->mReadAheadOffset );
+
+		if ( ( position >= schemeContext->mReadAheadPosition ) and ( position < bufferedEnd ) )
+		{
+			size_t skip = position - schemeContext->mReadAheadPosition;
+			size_t available = bufferedEnd - position;
+			size_t copyCount = std::min< size_t >( available, bytes - bytesRead );
+
+			memcpy( buffer + bytesRead,
+				schemeContext->mReadAhead.data() + schemeContext->mReadAheadOffset + skip, copyCount );
+			bytesRead += copyCount;
+			position += copyCount;
+
+			if ( updatePosition )
+			{
+				schemeContext->mReadAheadOffset += skip + copyCount;
+				schemeContext->mReadAheadPosition = position;
+			}
+
+			continue;
+		}
+
+		int64_t bytesFilled = __ftp_fill_read_ahead( schemeContext, position );
+
+		if ( 0 >= bytesFilled )
+		{
+			if ( ( -1 == bytesFilled ) and ( 0 == bytesRead ) )
+			{
+				return -1;
+			}
+
+			break;
+		}
+	}
+
+	if ( updatePosition )
+	{
+		context->_M_FilePosition = position;
+	}
+
+	return bytesRead;
+}
+
+int64_t __scheme_ftp_write(
+	struct FileContext* context,
+	const uint8_t* buffer,
+	size_t bytes,
+	bool append )
+{
+	if ( nullptr == context )
+	{
+		return -1;
+	}
+
+	if ( nullptr == context->_M_SchemeContext )
+	{
+		context->_M_ErrorCode = EIDRM;
+		return -1;
+	}
+
+	struct SchemeFTPContext* schemeContext = static_cast< struct SchemeFTPContext* >( context->_M_SchemeContext );
+	enum SchemeFTPTransfer transfer = append ? SCHEME_FTP_TRANSFER_APPEND : SCHEME_FTP_TRANSFER_STORE;
+	int64_t position = append ? context->_M_FileSize : context->_M_FilePosition;
+
+	__ftp_discard_read_ahead( schemeContext );
+
+	// Consecutive writes continue on the open STOR/APPE data connection.
+	if ( ( transfer != schemeContext->mTransfer )
+		or ( position != schemeContext->mTransferPosition ) )
+	{
+		// A bare STOR replaces the file, so it only starts a file that's empty. Writing
+		// anywhere else, even from the beginning, restarts the STOR in place with a REST,
+		// which is only attempted on servers that advertise they honour it.
+		bool restart = not append and ( ( 0 != position ) or ( 0 < context->_M_FileSize ) );
+
+		if ( restart and not schemeContext->mConnection->mRestartStore )
+		{
+			schemeContext->mErrorCode = ENOTSUP;
+			return -1;
+		}
+
+		if ( not __ftp_start_transfer( schemeContext, transfer, position, restart ) )
+		{
+			return -1;
+		}
+	}
+
+	if ( not __ftp_send_all( schemeContext->mTransferSocket, buffer, bytes, schemeContext->mErrorCode ) )
+	{
+		__ftp_finish_transfer( schemeContext );
+		return -1;
+	}
+
+	schemeContext->mTransferPosition += bytes;
+
+	if ( append )
+	{
+		context->_M_FileSize += bytes;
+	}
+	else
+	{
+		context->_M_FilePosition += bytes;
+		context->_M_FileSize = std::max( context->_M_FileSize, context->_M_FilePosition );
+	}
+
+	return static_cast< int64_t >( bytes );
+}
+
+int64_t __scheme_ftp_seek(
+	struct FileContext* context,
+	int64_t offset,
+	bool relative )
+{
+	if ( nullptr == context )
+	{
+		return -1;
+	}
+
+	if ( nullptr == context->_M_SchemeContext )
+	{
+		context->_M_ErrorCode = EIDRM;
+		return -1;
+	}
+
+	// Seeking is lazy; the REST is issued by the next read or write
+	// that doesn't line up with the transfer in progress.
+	int64_t requestedPosition = relative
+		? ( context->_M_FilePosition + offset )
+		: ( ( 0 > offset ) ? ( context->_M_FileSize + offset ) : offset );
+	context->_M_FilePosition = std::clamp< int64_t >( requestedPosition, 0, context->_M_FileSize );
+
+	return requestedPosition - context->_M_FilePosition;
+}
+
+int64_t __scheme_ftp_resize(
+	struct FileContext* context,
+	int64_t size,
+	uint8_t fill,
+	bool shrink,
+	bool grow )
+{
+	if ( nullptr == context )
+	{
+		return -1;
+	}
+
+	if ( nullptr == context->_M_SchemeContext )
+	{
+		context->_M_ErrorCode = EIDRM;
+		return -1;
+	}
+
+	struct SchemeFTPContext* schemeContext = static_cast< struct SchemeFTPContext* >( context->_M_SchemeContext );
+
+	if ( size < context->_M_FileSize )
+	{
+		// FTP has no means of truncating a file in place.
+		if ( shrink )
+		{
+			schemeContext->mErrorCode = ENOTSUP;
+		}
+
+		return context->_M_FileSize;
+	}
+
+	if ( grow )
+	{
+		uint8_t fillBuffer[ 64 * 1024 ];
+		memset( fillBuffer, fill, sizeof( fillBuffer ) );
+
+		while ( context->_M_FileSize < size )
+		{
+			uint32_t fillCount = std::min< int64_t >( sizeof( fillBuffer ), size - context->_M_FileSize );
+
+			if ( -1 == __scheme_ftp_write( context, fillBuffer, fillCount, true ) )
+			{
+				break;
+			}
+		}
+
+		__ftp_finish_transfer( schemeContext );
+	}
+
+	return context->_M_FileSize;
+}
+
+bool __scheme_ftp_refresh(
+	struct FileContext* context,
+	bool& replaced )
+{
+	replaced = false;
+
+	if ( nullptr == context )
+	{
+		return false;
+	}
+
+	if ( nullptr == context->_M_SchemeContext )
+	{
+		context->_M_ErrorCode = EIDRM;
+		return false;
+	}
+
+	struct SchemeFTPContext* schemeContext = static_cast< struct SchemeFTPContext* >( context->_M_SchemeContext );
+
+	// The control connection can't be used while a transfer is under way, and a RETR
+	// under way hasn't reached the end of the file yet, so there's nothing to refresh.
+	if ( -1 != schemeContext->mTransferSocket )
+	{
+		return true;
+	}
+
+	if ( not __ftp_finish_transfer( schemeContext ) )
+	{
+		return false;
+	}
+
+	int64_t fileSize = __ftp_query_size( schemeContext );
+
+	if ( -1 != fileSize )
+	{
+		// A file replaced by a smaller one, or truncated, is read again from the beginning.
+		if ( fileSize < context->_M_FilePosition )
+		{
+			__ftp_discard_read_ahead( schemeContext );
+			context->_M_FilePosition = 0;
+		}
+
+		context->_M_FileSize = fileSize;
+	}
+
+	return true;
+}
+
+bool __scheme_ftp_sync(
+	struct FileContext* context )
+{
+	if ( nullptr == context )
+	{
+		return false;
+	}
+
+	if ( nullptr == context->_M_SchemeContext )
+	{
+		context->_M_ErrorCode = EIDRM;
+		return false;
+	}
+
+	struct SchemeFTPContext* schemeContext = static_cast< struct SchemeFTPContext* >( context->_M_SchemeContext );
+
+	if ( SCHEME_FTP_TRANSFER_RETRIEVE == schemeContext->mTransfer )
+	{
+		return true;
+	}
+
+	// Closing the STOR/APPE data connection commits the bytes on the server.
+	if ( not __ftp_finish_transfer( schemeContext ) )
+	{
+		return false;
+	}
+
+	int64_t fileSize = __ftp_query_size( schemeContext );
+
+	if ( -1 != fileSize )
+	{
+		context->_M_FileSize = fileSize;
+	}
+
+	return true;
+}
+
+/*
+ * Parse a line of an MLSD listing, "fact=value;fact=value; name", into {@param entry}.
+ * The facts are those of RFC 3659, along with the UNIX.mode of common servers.
+ * @return False is returned for the "." and ".." entries, and for malformed lines.
+ */
+static bool __ftp_parse_listing_line(
+	const std::string& line,
+	struct FileEntry& entry )
+{
+	size_t nameStart = line.find( ' ' );
+
+	if ( ( std::string::npos == nameStart ) or ( line.size() == nameStart + 1 ) )
+	{
+		return false;
+	}
+
+	bool hasSize = false;
+	bool hasModifiedTime = false;
+
+	entry = {};
+	entry.name = line.substr( nameStart + 1 );
+
+	for ( size_t factStart = 0; factStart < nameStart; )
+	{
+		size_t factEnd = std::min( line.find( ';', factStart ), nameStart );
+		size_t valueStart = line.find( '=', factStart );
+
+		if ( valueStart < factEnd )
+		{
+			std::string fact = line.substr( factStart, valueStart - factStart );
+			std::string value = line.substr( valueStart + 1, factEnd - valueStart - 1 );
+
+			if ( 0 == strcasecmp( "type", fact.c_str() ) )
+			{
+				if ( ( 0 == strcasecmp( "cdir", value.c_str() ) ) or ( 0 == strcasecmp( "pdir", value.c_str() ) ) )
+				{
+					return false;
+				}
+
+				if ( 0 == strcasecmp( "file", value.c_str() ) )
+				{
+					entry.type = FileEntry::REGULAR;
+				}
+				else if ( 0 == strcasecmp( "dir", value.c_str() ) )
+				{
+					entry.type = FileEntry::DIRECTORY;
+				}
+				else if ( ( 0 == strncasecmp( "OS.unix=slink", value.c_str(), 13 ) )
+					or ( 0 == strncasecmp( "OS.unix=symlink", value.c_str(), 15 ) ) )
+				{
+					entry.type = FileEntry::SYMBOLIC_LINK;
+				}
+			}
+			else if ( ( 0 == strcasecmp( "size", fact.c_str() ) ) or ( 0 == strcasecmp( "sizd", fact.c_str() ) ) )
+			{
+				entry.size = strtoll( value.c_str(), nullptr, 10 );
+				hasSize = true;
+			}
+			else if ( 0 == strcasecmp( "modify", fact.c_str() ) )
+			{
+				// YYYYMMDDHHMMSS[.sss], in UTC
+				struct tm modifiedTime = {};
+				unsigned int fraction = 0;
+				int fractionDigits = 0;
+
+				if ( 6 <= sscanf( value.c_str(), "%4d%2d%2d%2d%2d%2d.%n%u",
+					&modifiedTime.tm_year, &modifiedTime.tm_mon, &modifiedTime.tm_mday,
+					&modifiedTime.tm_hour, &modifiedTime.tm_min, &modifiedTime.tm_sec, &fractionDigits, &fraction ) )
+				{
+					modifiedTime.tm_year -= 1900;
+					modifiedTime.tm_mon -= 1;
+					entry.modifiedTime = timegm( &modifiedTime ) * 1000000000LL;
+
+					if ( 0 != fractionDigits )
+					{
+						fractionDigits = static_cast< int >( value.size() ) - fractionDigits;
+
+						for ( int digit = fractionDigits; digit < 9; ++digit )
+						{
+							fraction *= 10;
+						}
+
+						entry.modifiedTime += fraction;
+					}
+
+					hasModifiedTime = true;
+				}
+			}
+			else if ( 0 == strcasecmp( "UNIX.mode", fact.c_str() ) )
+			{
+				entry.mode = strtoul( value.c_str(), nullptr, 8 ) & 07777;
+			}
+		}
+
+		factStart = factEnd + 1;
+	}
+
+	entry.hasMetadata = hasSize and hasModifiedTime;
+	return true;
+}
+
+bool __scheme_ftp_open_directory(
+	struct DirectoryContext* context,
+	const std::string& uri,
+	int& errorCode )
+{
+	if ( nullptr == context )
+	{
+		errorCode = EBADF;
+		return false;
+	}
+
+	if ( nullptr != context->_M_SchemeContext )
+	{
+		errorCode = ESTALE;
+		return false;
+	}
+
+	std::string user, password, host, port, path;
+
+	if ( not __parse_ftp_uri( uri, user, password, host, port, path ) )
+	{
+		errorCode = EINVAL;
+		return false;
+	}
+
+	struct SchemeFTPContext* schemeContext = __allocate_scheme_ftp_context();
+
+	if ( nullptr == schemeContext )
+	{
+		errorCode = ENOMEM;
+		return false;
+	}
+
+	schemeContext->mPath = path;
+	schemeContext->mPoolKey = user + "@" + host + ":" + port;
+	schemeContext->mConnection = __ftp_acquire_connection(
+		schemeContext->mPoolKey, host, port, user, password, errorCode );
+
+	if ( nullptr == schemeContext->mConnection )
+	{
+		__free_scheme_ftp_context( schemeContext );
+		return false;
+	}
+
+	// The listing is streamed over the data connection, and parsed as it's read.
+	if ( not __ftp_start_transfer( schemeContext, SCHEME_FTP_TRANSFER_LIST, 0, false ) )
+	{
+		errorCode = schemeContext->mErrorCode;
+
+		// Servers predating RFC 3659 reject MLSD as an unknown command.
+		if ( ( 500 <= schemeContext->mReplyCode ) and ( 504 >= schemeContext->mReplyCode ) )
+		{
+			errorCode = ENOTSUP;
+		}
+
+		if ( 0 <= schemeContext->mReplyCode )
+		{
+			__ftp_release_connection( schemeContext->mPoolKey, schemeContext->mConnection );
+		}
+		else
+		{
+			__free_ftp_connection( schemeContext->mConnection );
+		}
+
+		__free_scheme_ftp_context( schemeContext );
+		return false;
+	}
+
+	context->_M_SchemeContext = static_cast< void* >( schemeContext );
+	return true;
+}
+
+int64_t __scheme_ftp_read_directory(
+	struct DirectoryContext* context,
+	std::vector< struct FileEntry >& entries )
+{
+	if ( nullptr == context )
+	{
+		return -1;
+	}
+
+	if ( nullptr == context->_M_SchemeContext )
+	{
+		context->_M_ErrorCode = EIDRM;
+		return -1;
+	}
+
+	struct SchemeFTPContext* schemeContext = static_cast< struct SchemeFTPContext* >( context->_M_SchemeContext );
+	std::vector< uint8_t >& listing = schemeContext->mReadAhead;
+	size_t firstEntry = entries.size();
+
+	while ( ( firstEntry == entries.size() ) and ( -1 != schemeContext->mTransferSocket ) )
+	{
+		size_t bufferedBytes = listing.size();
+		listing.resize( bufferedBytes + SCHEME_FTP_READ_AHEAD_SIZE );
+
+		ssize_t bytesReceived;
+		do
+		{
+			bytesReceived = recv( schemeContext->mTransferSocket,
+				listing.data() + bufferedBytes, SCHEME_FTP_READ_AHEAD_SIZE, 0 );
+		} while ( ( -1 == bytesReceived ) and ( EINTR == errno ) );
+
+		listing.resize( bufferedBytes + std::max< ssize_t >( 0, bytesReceived ) );
+
+		if ( -1 == bytesReceived )
+		{
+			context->_M_ErrorCode = errno;
+			return -1;
+		}
+
+		if ( 0 == bytesReceived )
+		{
+			// End of the listing; collect the 226 and leave the transfer marked complete.
+			::close( schemeContext->mTransferSocket );
+			schemeContext->mTransferSocket = -1;
+			schemeContext->mReplyCode = __ftp_read_reply(
+				schemeContext->mConnection, schemeContext->mReplyMessage, schemeContext->mErrorCode );
+
+			if ( ( 226 != schemeContext->mReplyCode ) and ( 250 != schemeContext->mReplyCode ) )
+			{
+				context->_M_ErrorCode = ( 0 <= schemeContext->mReplyCode ) ? EIO : schemeContext->mErrorCode;
+				return -1;
+			}
+
+			// The last line needn't be terminated.
+			if ( not listing.empty() and ( '\n' != listing.back() ) )
+			{
+				listing.push_back( '\n' );
+			}
+		}
+
+		// Parse every complete line, keeping a partial one for the next batch.
+		size_t lineStart = 0;
+
+		for ( size_t lineEnd = lineStart; lineEnd < listing.size(); ++lineEnd )
+		{
+			if ( '\n' != listing[ lineEnd ] )
+			{
+				continue;
+			}
+
+			std::string line( listing.begin() + lineStart, listing.begin() + lineEnd );
+			struct FileEntry entry;
+			lineStart = lineEnd + 1;
+
+			if ( not line.empty() and ( '\r' == line.back() ) )
+			{
+				line.pop_back();
+			}
+
+			if ( __ftp_parse_listing_line( line, entry ) )
+			{
+				entries.push_back( std::move( entry ) );
+			}
+		}
+
+		listing.erase( listing.begin(), listing.begin() + lineStart );
+	}
+
+	return entries.size() - firstEntry;
+}
+
+void __scheme_ftp_close_directory(
+	struct DirectoryContext* context )
+{
+	if ( ( nullptr == context )
+		or ( nullptr == context->_M_SchemeContext ) )
+	{
+		return;
+	}
+
+	struct SchemeFTPContext* schemeContext = static_cast< struct SchemeFTPContext* >( context->_M_SchemeContext );
+
+	// A listing abandoned part way through is aborted by closing its data connection.
+	if ( __ftp_finish_transfer( schemeContext ) )
+	{
+		__ftp_release_connection( schemeContext->mPoolKey, schemeContext->mConnection );
+	}
+	else
+	{
+		__free_ftp_connection( schemeContext->mConnection );
+	}
+
+	__free_scheme_ftp_context( schemeContext );
+	context->_M_SchemeContext = nullptr;
+}
+
+std::string __scheme_ftp_error_string(
+	struct FileContext* context )
+{
+	if ( nullptr == context )
+	{
+		return std::string( strerror( EBADF ) );
+	}
+
+	if ( nullptr == context->_M_SchemeContext )
+	{
+		return std::string( strerror( EIDRM ) );
+	}
+
+	struct SchemeFTPContext* schemeContext = static_cast< struct SchemeFTPContext* >( context->_M_SchemeContext );
+
+	if ( 0 != schemeContext->mErrorCode )
+	{
+		// Prefer the server's own explanation when it gave one.
+		if ( 400 <= schemeContext->mReplyCode )
+		{
+			return schemeContext->mReplyMessage;
+		}
+
+		return std::string( strerror( schemeContext->mErrorCode ) );
+	}
+
+	return std::string();
+}
+
+void __scheme_ftp_close(
+	struct FileContext* context )
+{
+	if ( ( nullptr == context )
+		or ( nullptr == context->_M_SchemeContext ) )
+	{
+		return;
+	}
+
+	struct SchemeFTPContext* schemeContext = static_cast< struct SchemeFTPContext* >( context->_M_SchemeContext );
+
+	// Only return the control connection to the pool if it
+	// is in a known state, i.e. the last transfer completed.
+	if ( __ftp_finish_transfer( schemeContext ) )
+	{
+		__ftp_release_connection( schemeContext->mPoolKey, schemeContext->mConnection );
+	}
+	else
+	{
+		__free_ftp_connection( schemeContext->mConnection );
+	}
+
+	__free_scheme_ftp_context( schemeContext );
+	context->_M_SchemeContext = nullptr;
+}
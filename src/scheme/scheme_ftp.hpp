@@ -0,0 +1,89 @@
+/**
+ * Copyright ©2021. Brent Weichel. All Rights Reserved.
+ * Permission to use, copy, modify, and/or distribute this software, in whole
+ * or part by any means, without express prior written agreement is prohibited.
+ */
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "File.hpp"
+#include "FileContext.hpp"
+#include "Scheme.hpp"
+
+// API Implementing Function Prototypes
+void __scheme_ftp_close(
+	struct FileContext* context );
+
+void __scheme_ftp_close_directory(
+	struct DirectoryContext* context );
+
+std::string __scheme_ftp_error_string(
+	struct FileContext* context );
+
+bool __scheme_ftp_open(
+	struct FileContext* context,
+	const std::string& uri,
+	File::IOFlag mode,
+	int& errorCode );
+
+bool __scheme_ftp_open_directory(
+	struct DirectoryContext* context,
+	const std::string& uri,
+	int& errorCode );
+
+int64_t __scheme_ftp_read(
+	struct FileContext* context,
+	uint8_t* buffer,
+	size_t bytes,
+	bool updatePosition );
+
+int64_t __scheme_ftp_read_directory(
+	struct DirectoryContext* context,
+	std::vector< struct FileEntry >& entries );
+
+bool __scheme_ftp_refresh(
+	struct FileContext* context,
+	bool& replaced );
+
+int64_t __scheme_ftp_resize(
+	struct FileContext* context,
+	int64_t size,
+	uint8_t fill,
+	bool shrink,
+	bool grow );
+
+int64_t __scheme_ftp_seek(
+	struct FileContext* context,
+	int64_t offset,
+	bool relative );
+
+bool __scheme_ftp_sync(
+	struct FileContext* context );
+
+int64_t __scheme_ftp_write(
+	struct FileContext* context,
+	const uint8_t* buffer,
+	size_t bytes,
+	bool append );
+
+// Scheme API Constants
+const std::string SCHEME_FTP_CANONICAL_PREFIX( "ftp" );
+
+const struct SchemeAPI SCHEME_FTP_API =
+{
+	._F_open = __scheme_ftp_open,
+	._F_error_string = __scheme_ftp_error_string,
+	._F_close = __scheme_ftp_close,
+	._F_seek = __scheme_ftp_seek,
+	._F_read = __scheme_ftp_read,
+	._F_write = __scheme_ftp_write,
+	._F_resize = __scheme_ftp_resize,
+	._F_sync = __scheme_ftp_sync,
+	._F_refresh = __scheme_ftp_refresh,
+	._F_open_directory = __scheme_ftp_open_directory,
+	._F_read_directory = __scheme_ftp_read_directory,
+	._F_close_directory = __scheme_ftp_close_directory
+};
@@ -0,0 +1,30 @@
+/**
+ * Copyright ©2021. Brent Weichel. All Rights Reserved.
+ * Permission to use, copy, modify, and/or distribute this software, in whole
+ * or part by any means, without express prior written agreement is prohibited.
+ */
+#pragma once
+
+#include <cstdio>
+#include <cstdlib>
+
+/*
+ * A failed check is reported and the test carries on, so that a run lists every
+ * failure. Each test is a single translation unit, so the count can live here.
+ */
+static int _G_CheckFailures = 0;
+
+#define CHECK( condition ) \
+	do \
+	{ \
+		if ( not ( condition ) ) \
+		{ \
+			fprintf( stderr, "%s:%d: CHECK( %s ) failed\n", __FILE__, __LINE__, #condition ); \
+			++_G_CheckFailures; \
+		} \
+	} while ( false )
+
+/*
+ * The exit status of a test, for ctest.
+ */
+#define CHECK_RESULT() ( ( 0 == _G_CheckFailures ) ? EXIT_SUCCESS : EXIT_FAILURE )
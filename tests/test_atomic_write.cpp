@@ -0,0 +1,104 @@
+/**
+ * Copyright ©2021. Brent Weichel. All Rights Reserved.
+ * Permission to use, copy, modify, and/or distribute this software, in whole
+ * or part by any means, without express prior written agreement is prohibited.
+ */
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+
+#include "Check.hpp"
+#include "File.hpp"
+
+static const std::filesystem::path _G_Directory( std::filesystem::absolute( "test_atomic_write.d" ) );
+static const std::string _G_Path( ( _G_Directory / "target.txt" ).string() );
+
+static std::string __read_target()
+{
+	std::ifstream stream( _G_Path, std::ios::binary );
+	return std::string( std::istreambuf_iterator< char >( stream ), std::istreambuf_iterator< char >() );
+}
+
+static void __write_target(
+	const std::string& contents )
+{
+	std::ofstream( _G_Path, std::ios::binary | std::ios::trunc ) << contents;
+}
+
+/*
+ * Check that the directory holds only the target, so no replacement was left behind.
+ */
+static bool __only_target()
+{
+	size_t entryCount = 0;
+
+	for ( const auto& entry : std::filesystem::directory_iterator( _G_Directory ) )
+	{
+		entryCount += ( entry.path().string() == _G_Path ) ? 1 : 100;
+	}
+
+	return 1 == entryCount;
+}
+
+static int64_t __write(
+	File& file,
+	const std::string& contents )
+{
+	return file.write( reinterpret_cast< const uint8_t* >( contents.data() ), contents.size() );
+}
+
+int main()
+{
+	std::filesystem::remove_all( _G_Directory );
+	std::filesystem::create_directories( _G_Directory );
+	const File::IOFlag mode = static_cast< File::IOFlag >( File::IOFlag::WRITE | File::IOFlag::ATOMIC );
+
+	// Closing commits what was written, which replaces the target whole.
+	{
+		__write_target( "the original contents" );
+		File file( _G_Path, mode );
+		CHECK( 11 == __write( file, "replacement" ) );
+		CHECK( "the original contents" == __read_target() );
+		file.close();
+		CHECK( "replacement" == __read_target() );
+		CHECK( __only_target() );
+	}
+
+	// So does destroying the File.
+	{
+		File file( _G_Path, mode );
+		CHECK( 6 == __write( file, "second" ) );
+	}
+
+	CHECK( "second" == __read_target() );
+	CHECK( __only_target() );
+
+	// The replacement is committed by the last copy of the File to close, not the first.
+	{
+		File file( _G_Path, mode );
+		File copy( file );
+		CHECK( 5 == __write( file, "third" ) );
+		file.close();
+		CHECK( "second" == __read_target() );
+		copy.close();
+		CHECK( "third" == __read_target() );
+		CHECK( __only_target() );
+	}
+
+	// After commit(), writes go to the target in place, and closing doesn't publish again.
+	{
+		File file( _G_Path, mode );
+		CHECK( 6 == __write( file, "fourth" ) );
+		CHECK( file.commit() );
+		CHECK( "fourth" == __read_target() );
+		CHECK( 1 == __write( file, "!" ) );
+		file.close();
+		CHECK( "fourth!" == __read_target() );
+		CHECK( __only_target() );
+	}
+
+	std::filesystem::remove_all( _G_Directory );
+	return CHECK_RESULT();
+}
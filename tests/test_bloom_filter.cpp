@@ -0,0 +1,81 @@
+/**
+ * Copyright ©2021. Brent Weichel. All Rights Reserved.
+ * Permission to use, copy, modify, and/or distribute this software, in whole
+ * or part by any means, without express prior written agreement is prohibited.
+ */
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "BloomFilter.hpp"
+#include "Check.hpp"
+
+/*
+ * Check a filter at every offset within a cache line, as filters are read in place
+ * from files: every key added is found, the accelerated probe (AVX2, where the
+ * processor has it) agrees with the portable one on every hash, and false positives
+ * stay near the rate of the bits per key.
+ */
+static void __check_filter(
+	uint64_t keyCount,
+	size_t bitsPerKey )
+{
+	std::mt19937_64 random( 48 + keyCount );
+	size_t blockCount = _bloom_filter_block_count( keyCount, bitsPerKey );
+	std::vector< uint64_t > keyHashes( keyCount );
+
+	for ( uint64_t& keyHash : keyHashes )
+	{
+		keyHash = random();
+	}
+
+	for ( size_t alignment = 0; alignment < BLOOM_FILTER_BLOCK_SIZE; alignment += 9 )
+	{
+		std::vector< uint8_t > buffer( alignment + blockCount * BLOOM_FILTER_BLOCK_SIZE, 0 );
+		uint8_t* filter = buffer.data() + alignment;
+		size_t falsePositives = 0;
+		size_t probeCount = 20000;
+
+		for ( uint64_t keyHash : keyHashes )
+		{
+			_bloom_filter_add( filter, blockCount, keyHash );
+		}
+
+		for ( uint64_t keyHash : keyHashes )
+		{
+			CHECK( _bloom_filter_may_contain( filter, blockCount, keyHash ) );
+			CHECK( _bloom_filter_may_contain_portable( filter, blockCount, keyHash ) );
+		}
+
+		for ( size_t probe = 0; probe < probeCount; ++probe )
+		{
+			uint64_t hash = random();
+			bool mayContain = _bloom_filter_may_contain( filter, blockCount, hash );
+
+			CHECK( _bloom_filter_may_contain_portable( filter, blockCount, hash ) == mayContain );
+			falsePositives += mayContain;
+		}
+
+		// About 1% for 10 bits per key; a filter far fuller than that is a broken one.
+		if ( ( 10 <= bitsPerKey ) and ( 1000 <= keyCount ) )
+		{
+			CHECK( falsePositives < probeCount / 25 );
+		}
+	}
+}
+
+int main()
+{
+	CHECK( 1 == _bloom_filter_block_count( 0, 10 ) );
+	CHECK( 1 == _bloom_filter_block_count( 1, 10 ) );
+	CHECK( 20 == _bloom_filter_block_count( 1024, 10 ) );
+	CHECK( UINT32_MAX == _bloom_filter_block_count( UINT64_MAX / 1024, 1024 ) );
+
+	__check_filter( 1, 10 );
+	__check_filter( 100, 4 );
+	__check_filter( 10000, 10 );
+
+	// A saturated filter, in which most bits are set and probes mostly pass.
+	__check_filter( 5000, 1 );
+	return CHECK_RESULT();
+}
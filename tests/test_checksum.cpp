@@ -0,0 +1,97 @@
+/**
+ * Copyright ©2021. Brent Weichel. All Rights Reserved.
+ * Permission to use, copy, modify, and/or distribute this software, in whole
+ * or part by any means, without express prior written agreement is prohibited.
+ */
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "Check.hpp"
+#include "Checksum.hpp"
+
+// The lane size of the accelerated CRC32C, see Checksum.cpp.
+#define LANE_SIZE ( 4096 )
+
+/*
+ * Check the published CRC32C test vectors (RFC 3720, B.4).
+ */
+static void __check_vectors()
+{
+	const uint8_t* digits = reinterpret_cast< const uint8_t* >( "123456789" );
+	std::vector< uint8_t > zeros( 32, 0x00 );
+	std::vector< uint8_t > ones( 32, 0xFF );
+	std::vector< uint8_t > ascending( 32 );
+
+	for ( size_t index = 0; index < ascending.size(); ++index )
+	{
+		ascending[ index ] = static_cast< uint8_t >( index );
+	}
+
+	CHECK( 0xE3069283U == _crc32c( 0, digits, 9 ) );
+	CHECK( 0x8A9136AAU == _crc32c( 0, zeros.data(), zeros.size() ) );
+	CHECK( 0x62A8AB43U == _crc32c( 0, ones.data(), ones.size() ) );
+	CHECK( 0x46DD794EU == _crc32c( 0, ascending.data(), ascending.size() ) );
+	CHECK( 0xE3069283U == _crc32c_portable( 0, digits, 9 ) );
+	CHECK( 0 == _crc32c( 0, nullptr, 0 ) );
+}
+
+/*
+ * Check the accelerated CRC32C against the table driven one, for lengths on either
+ * side of every multiple of the three lanes it merges, and from unaligned starts.
+ */
+static void __check_lane_merge(
+	const std::vector< uint8_t >& buffer )
+{
+	for ( size_t lanes = 0; lanes <= 4; ++lanes )
+	{
+		for ( size_t extra : { 0, 1, 7, 8, 9, LANE_SIZE - 1, LANE_SIZE, 2 * LANE_SIZE + 5 } )
+		{
+			size_t bytes = lanes * 3 * LANE_SIZE + extra;
+
+			for ( size_t start = 0; start < 8; ++start )
+			{
+				const uint8_t* data = buffer.data() + start;
+				CHECK( _crc32c_portable( 0, data, bytes ) == _crc32c( 0, data, bytes ) );
+				CHECK( _crc32c_portable( 0x12345678U, data, bytes ) == _crc32c( 0x12345678U, data, bytes ) );
+			}
+		}
+	}
+}
+
+/*
+ * Check that a CRC32C continued over the second half of a split buffer matches
+ * the one over the whole, for splits within and across the merged lanes.
+ */
+static void __check_continuation(
+	const std::vector< uint8_t >& buffer )
+{
+	size_t bytes = 7 * LANE_SIZE + 3;
+	uint32_t whole = _crc32c( 0, buffer.data(), bytes );
+
+	for ( size_t split : { 0, 1, 8, LANE_SIZE - 3, LANE_SIZE, 3 * LANE_SIZE, 3 * LANE_SIZE + 1, 5 * LANE_SIZE + 11, 7 * LANE_SIZE + 3 } )
+	{
+		uint32_t first = _crc32c( 0, buffer.data(), split );
+		CHECK( whole == _crc32c( first, buffer.data() + split, bytes - split ) );
+
+		first = _crc32c_portable( 0, buffer.data(), split );
+		CHECK( whole == _crc32c_portable( first, buffer.data() + split, bytes - split ) );
+	}
+}
+
+int main()
+{
+	std::mt19937_64 random( 29 );
+	std::vector< uint8_t > buffer( 15 * LANE_SIZE + 16 );
+
+	for ( uint8_t& byte : buffer )
+	{
+		byte = static_cast< uint8_t >( random() );
+	}
+
+	__check_vectors();
+	__check_lane_merge( buffer );
+	__check_continuation( buffer );
+	return CHECK_RESULT();
+}
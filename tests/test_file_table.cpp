@@ -0,0 +1,227 @@
+/**
+ * Copyright ©2021. Brent Weichel. All Rights Reserved.
+ * Permission to use, copy, modify, and/or distribute this software, in whole
+ * or part by any means, without express prior written agreement is prohibited.
+ */
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#include "Check.hpp"
+#include "Checksum.hpp"
+#include "File.hpp"
+#include "FileTable.hpp"
+
+// The footer of a table, as laid out by FileTable.cpp.
+struct FileTableFooter
+{
+	int64_t mIndexOffset;
+	uint64_t mIndexLength;
+	int64_t mFilterOffset;
+	uint64_t mFilterLength;
+	uint64_t mRecordCount;
+	uint32_t mIndexChecksum;
+	uint32_t mFilterChecksum;
+	char mMagic[ 8 ];
+};
+
+// Keys are even numbers, so that the odd ones fall between them.
+#define TEST_KEY_COUNT ( 2000 )
+
+// Bytes ahead of the table in the file, which the table's offsets must account for.
+#define TEST_PREAMBLE_SIZE ( 100 )
+
+static const std::string _G_Path( std::filesystem::absolute( "test_file_table.bin" ).string() );
+
+static std::string __key(
+	uint64_t number )
+{
+	char key[ 16 ];
+	snprintf( key, sizeof( key ), "key%08lu", number );
+	return key;
+}
+
+static std::string __value(
+	uint64_t number )
+{
+	return std::string( number % 50, 'v' ) + std::to_string( number );
+}
+
+static std::vector< uint8_t > __read_file()
+{
+	std::vector< uint8_t > contents( std::filesystem::file_size( _G_Path ) );
+	int fileHandle = open( _G_Path.c_str(), O_RDONLY );
+	bool read = ( -1 != fileHandle )
+		and ( static_cast< ssize_t >( contents.size() ) == pread( fileHandle, contents.data(), contents.size(), 0 ) );
+	close( fileHandle );
+	return read ? contents : std::vector< uint8_t >();
+}
+
+static void __write_file(
+	const std::vector< uint8_t >& contents )
+{
+	int fileHandle = open( _G_Path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644 );
+	CHECK( ( -1 != fileHandle ) and ( static_cast< ssize_t >( contents.size() ) == write( fileHandle, contents.data(), contents.size() ) ) );
+	close( fileHandle );
+}
+
+/*
+ * Write a table after a preamble, in small blocks so that the index has many entries.
+ */
+static void __write_table(
+	uint64_t keyCount )
+{
+	__write_file( std::vector< uint8_t >( TEST_PREAMBLE_SIZE, 'p' ) );
+
+	File file( _G_Path, File::IOFlag::WRITE );
+	FileTableWriter writer( file, 256 );
+
+	for ( uint64_t number = 0; number < keyCount; ++number )
+	{
+		CHECK( writer.add( __key( 2 * number ), __value( 2 * number ) ) );
+	}
+
+	CHECK( ( 0 == keyCount ) or not writer.add( __key( 0 ), "out of order" ) );
+	CHECK( writer.finish() );
+	file.close();
+}
+
+/*
+ * Check that a table reads back whole: every key is found with its value, and keys
+ * between them aren't, without error.
+ */
+static void __check_table(
+	uint64_t keyCount )
+{
+	File file( _G_Path, File::IOFlag::READ );
+	FileTableReader reader( file );
+	std::string value;
+
+	CHECK( reader.errorMessage().empty() );
+	CHECK( keyCount == reader.size() );
+
+	for ( uint64_t number = 0; number < keyCount; ++number )
+	{
+		CHECK( reader.mayContain( __key( 2 * number ) ) );
+		CHECK( reader.get( __key( 2 * number ), value ) and ( __value( 2 * number ) == value ) );
+		CHECK( not reader.get( __key( 2 * number + 1 ), value ) and reader.errorMessage().empty() );
+	}
+
+	CHECK( not reader.get( "", value ) and reader.errorMessage().empty() );
+	CHECK( not reader.get( "zzz", value ) and reader.errorMessage().empty() );
+}
+
+/*
+ * Damage the table written by __write_table(), then check that reading it fails with EBADMSG.
+ */
+static void __check_corrupt(
+	const char* name,
+	const std::function< void( std::vector< uint8_t >&, FileTableFooter& ) >& damage )
+{
+	__write_table( TEST_KEY_COUNT );
+
+	std::vector< uint8_t > contents = __read_file();
+	FileTableFooter footer;
+
+	if ( contents.size() < sizeof( footer ) )
+	{
+		CHECK( false );
+		return;
+	}
+
+	memcpy( &footer, contents.data() + contents.size() - sizeof( footer ), sizeof( footer ) );
+	damage( contents, footer );
+
+	if ( contents.size() >= sizeof( footer ) )
+	{
+		memcpy( contents.data() + contents.size() - sizeof( footer ), &footer, sizeof( footer ) );
+	}
+
+	__write_file( contents );
+
+	File file( _G_Path, File::IOFlag::READ );
+	FileTableReader reader( file );
+	std::string value;
+
+	fprintf( stderr, "%s\n", name );
+	CHECK( strerror( EBADMSG ) == reader.errorMessage() );
+	CHECK( 0 == reader.size() );
+	CHECK( not reader.get( __key( 0 ), value ) );
+}
+
+int main()
+{
+	__write_table( TEST_KEY_COUNT );
+	__check_table( TEST_KEY_COUNT );
+
+	__write_table( 0 );
+	__check_table( 0 );
+
+	__check_corrupt( "shorter than a footer", []( std::vector< uint8_t >& contents, FileTableFooter& )
+	{
+		contents.resize( sizeof( FileTableFooter ) - 1 );
+	} );
+
+	__check_corrupt( "bad magic", []( std::vector< uint8_t >&, FileTableFooter& footer )
+	{
+		footer.mMagic[ 0 ] ^= 0x01;
+	} );
+
+	__check_corrupt( "index checksum mismatch", []( std::vector< uint8_t >& contents, FileTableFooter& footer )
+	{
+		contents[ footer.mIndexOffset + footer.mIndexLength / 2 ] ^= 0x01;
+	} );
+
+	__check_corrupt( "index past the footer", []( std::vector< uint8_t >& contents, FileTableFooter& footer )
+	{
+		footer.mIndexOffset = contents.size() - sizeof( FileTableFooter ) - footer.mIndexLength + 1;
+	} );
+
+	__check_corrupt( "index before the file", []( std::vector< uint8_t >&, FileTableFooter& footer )
+	{
+		footer.mIndexOffset = -1;
+	} );
+
+	__check_corrupt( "partial filter block", []( std::vector< uint8_t >&, FileTableFooter& footer )
+	{
+		footer.mFilterLength -= 1;
+	} );
+
+	// The checksum holds, so that parsing the index itself must catch these.
+	__check_corrupt( "index entry cut short", []( std::vector< uint8_t >& contents, FileTableFooter& footer )
+	{
+		footer.mIndexLength -= 1;
+		footer.mIndexChecksum = _crc32c( 0, contents.data() + footer.mIndexOffset, footer.mIndexLength );
+	} );
+
+	__check_corrupt( "index key running past the index", []( std::vector< uint8_t >& contents, FileTableFooter& footer )
+	{
+		footer.mIndexLength = 5;
+		footer.mIndexChecksum = _crc32c( 0, contents.data() + footer.mIndexOffset, footer.mIndexLength );
+	} );
+
+	// A damaged data block fails the lookups landing in it, but not the others.
+	{
+		__write_table( TEST_KEY_COUNT );
+		std::vector< uint8_t > contents = __read_file();
+		contents[ TEST_PREAMBLE_SIZE + 1 ] ^= 0x01;
+		__write_file( contents );
+
+		File file( _G_Path, File::IOFlag::READ );
+		FileTableReader reader( file );
+		std::string value;
+
+		CHECK( reader.errorMessage().empty() );
+		CHECK( not reader.get( __key( 0 ), value ) and ( strerror( EBADMSG ) == reader.errorMessage() ) );
+		CHECK( reader.get( __key( 2 * ( TEST_KEY_COUNT - 1 ) ), value ) and ( __value( 2 * ( TEST_KEY_COUNT - 1 ) ) == value ) );
+	}
+
+	unlink( _G_Path.c_str() );
+	return CHECK_RESULT();
+}
@@ -0,0 +1,227 @@
+/**
+ * Copyright ©2021. Brent Weichel. All Rights Reserved.
+ * Permission to use, copy, modify, and/or distribute this software, in whole
+ * or part by any means, without express prior written agreement is prohibited.
+ */
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+#include "Check.hpp"
+#include "Checksum.hpp"
+#include "File.hpp"
+#include "FileView.hpp"
+
+// The journal format, as laid out by JournalLayer.cpp.
+#define JOURNAL_MAGIC         ( "FJOURNL" )
+#define JOURNAL_HEADER_SIZE   ( 16 )
+#define JOURNAL_RECORD_WRITE  ( 1 )
+#define JOURNAL_RECORD_COMMIT ( 2 )
+
+struct JournalRecordHeader
+{
+	uint32_t mType;
+	uint32_t mLength;
+	int64_t mOffset;
+	uint64_t mSequence;
+	uint32_t mChecksum;
+	uint32_t mReserved;
+};
+
+#define TEST_FILE_SIZE ( 4096 )
+
+// Absolute, as relative paths can't take a query.
+static const std::string _G_Path( std::filesystem::absolute( "test_journal.bin" ).string() );
+static const std::string _G_JournalPath( _G_Path + ".journal" );
+
+/*
+ * Append a record to a journal being built.
+ */
+static void __append_record(
+	std::vector< uint8_t >& journal,
+	uint32_t type,
+	int64_t offset,
+	uint64_t sequence,
+	const std::string& data )
+{
+	struct JournalRecordHeader header = { type, static_cast< uint32_t >( data.size() ), offset, sequence, 0, 0 };
+	const uint8_t* dataBytes = reinterpret_cast< const uint8_t* >( data.data() );
+	header.mChecksum = _crc32c( _crc32c( 0, reinterpret_cast< const uint8_t* >( &header ), sizeof( header ) ), dataBytes, data.size() );
+
+	const uint8_t* headerBytes = reinterpret_cast< const uint8_t* >( &header );
+	journal.insert( journal.end(), headerBytes, headerBytes + sizeof( header ) );
+	journal.insert( journal.end(), dataBytes, dataBytes + data.size() );
+}
+
+/*
+ * Write a whole file, replacing any previous one.
+ */
+static bool __write_file(
+	const std::string& path,
+	const std::vector< uint8_t >& contents )
+{
+	int fileHandle = open( path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644 );
+	bool written = ( -1 != fileHandle )
+		and ( static_cast< ssize_t >( contents.size() ) == write( fileHandle, contents.data(), contents.size() ) );
+	return ( -1 != fileHandle ) and ( 0 == close( fileHandle ) ) and written;
+}
+
+/*
+ * Leave the journal of a crash: a file never written in place, and a journal of one
+ * complete batch followed by a second batch, which {@param tear} may tear or corrupt.
+ * Then open the file with its journal, and check that the first batch was replayed,
+ * that the second was only replayed if left whole, and that the journal was emptied.
+ */
+static void __check_recovery(
+	const char* name,
+	const std::function< void( std::vector< uint8_t >&, size_t ) >& tear,
+	bool secondBatchReplayed )
+{
+	std::vector< uint8_t > journal( JOURNAL_HEADER_SIZE, 0 );
+	memcpy( journal.data(), JOURNAL_MAGIC, sizeof( JOURNAL_MAGIC ) );
+
+	__append_record( journal, JOURNAL_RECORD_WRITE, 0, 0, "first" );
+	__append_record( journal, JOURNAL_RECORD_WRITE, 1000, 0, "batch" );
+	__append_record( journal, JOURNAL_RECORD_COMMIT, 0, 0, "" );
+
+	size_t secondBatchStart = journal.size();
+	__append_record( journal, JOURNAL_RECORD_WRITE, 2000, 1, "second" );
+	__append_record( journal, JOURNAL_RECORD_COMMIT, 0, 1, "" );
+	tear( journal, secondBatchStart );
+
+	if ( not __write_file( _G_Path, std::vector< uint8_t >( TEST_FILE_SIZE, '.' ) )
+		or not __write_file( _G_JournalPath, journal ) )
+	{
+		fprintf( stderr, "%s: writing the files failed\n", name );
+		++_G_CheckFailures;
+		return;
+	}
+
+	File file( _G_Path + "?journal=1", static_cast< File::IOFlag >( File::IOFlag::READ | File::IOFlag::WRITE ) );
+	std::vector< uint8_t > contents( TEST_FILE_SIZE );
+	bool read = ( 0 == file.seek( 0 ) ) and ( TEST_FILE_SIZE == file.read( contents.data(), contents.size() ) );
+	std::string recovered( contents.begin(), contents.end() );
+	struct stat journalStat;
+
+	fprintf( stderr, "%s\n", name );
+	CHECK( read );
+	CHECK( "first" == recovered.substr( 0, 5 ) );
+	CHECK( "batch" == recovered.substr( 1000, 5 ) );
+	CHECK( ( secondBatchReplayed ? "second" : "......" ) == recovered.substr( 2000, 6 ) );
+	CHECK( TEST_FILE_SIZE == file.size() );
+	file.close();
+
+	// The journal was checkpointed once its batches were replayed.
+	CHECK( ( 0 == stat( _G_JournalPath.c_str(), &journalStat ) ) and ( JOURNAL_HEADER_SIZE == journalStat.st_size ) );
+}
+
+/*
+ * Write through the journal and close the file, which checkpoints the journal. Then
+ * change the file behind the journal's back, and check that reopening it replays nothing.
+ */
+static void __check_close()
+{
+	const File::IOFlag mode = static_cast< File::IOFlag >( File::IOFlag::READ | File::IOFlag::WRITE );
+	struct stat journalStat;
+
+	unlink( _G_JournalPath.c_str() );
+
+	if ( not __write_file( _G_Path, std::vector< uint8_t >( TEST_FILE_SIZE, '.' ) ) )
+	{
+		fprintf( stderr, "close: writing the file failed\n" );
+		++_G_CheckFailures;
+		return;
+	}
+
+	{
+		File file( _G_Path + "?journal=1", mode );
+		CHECK( file.beginBatch() );
+		CHECK( ( 0 == file.seek( 100 ) ) and ( 5 == file.write( reinterpret_cast< const uint8_t* >( "batch" ), 5 ) ) );
+		CHECK( file.commit() );
+		CHECK( ( 0 == file.seek( 200 ) ) and ( 6 == file.write( reinterpret_cast< const uint8_t* >( "single" ), 6 ) ) );
+		file.close();
+	}
+
+	fprintf( stderr, "close\n" );
+	CHECK( ( 0 == stat( _G_JournalPath.c_str(), &journalStat ) ) and ( JOURNAL_HEADER_SIZE == journalStat.st_size ) );
+
+	int fileHandle = open( _G_Path.c_str(), O_RDWR );
+	char written[ 6 ] = { 0 };
+	CHECK( ( 5 == pread( fileHandle, written, 5, 100 ) ) and ( 0 == memcmp( written, "batch", 5 ) ) );
+	CHECK( ( 6 == pread( fileHandle, written, 6, 200 ) ) and ( 0 == memcmp( written, "single", 6 ) ) );
+	CHECK( 6 == pwrite( fileHandle, "moved!", 6, 100 ) );
+	close( fileHandle );
+
+	File file( _G_Path + "?journal=1", mode );
+	std::vector< uint8_t > contents( TEST_FILE_SIZE );
+	CHECK( ( 0 == file.seek( 0 ) ) and ( TEST_FILE_SIZE == file.read( contents.data(), contents.size() ) ) );
+	CHECK( "moved!" == std::string( contents.begin() + 100, contents.begin() + 106 ) );
+	CHECK( "single" == std::string( contents.begin() + 200, contents.begin() + 206 ) );
+}
+
+/*
+ * Check that a journaled file, which can only be read at its file position, can be
+ * viewed, and that viewing it leaves the file position where it was.
+ */
+static void __check_view()
+{
+	File file( _G_Path + "?journal=1", static_cast< File::IOFlag >( File::IOFlag::READ | File::IOFlag::WRITE ) );
+	fprintf( stderr, "view\n" );
+	CHECK( 0 == file.seek( 50 ) );
+
+	FileView view = file.view( 200, 6 );
+	CHECK( "single" == std::string( reinterpret_cast< const char* >( view.data() ), view.size() ) );
+	CHECK( 50 == file.position() );
+
+	view = file.view( TEST_FILE_SIZE - 2, 100 );
+	CHECK( 2 == view.size() );
+}
+
+int main()
+{
+	__check_recovery( "whole", []( std::vector< uint8_t >&, size_t ) {}, true );
+
+	__check_recovery( "torn within a record header", []( std::vector< uint8_t >& journal, size_t secondBatchStart )
+	{
+		journal.resize( secondBatchStart + sizeof( JournalRecordHeader ) / 2 );
+	}, false );
+
+	__check_recovery( "torn within a record's data", []( std::vector< uint8_t >& journal, size_t secondBatchStart )
+	{
+		journal.resize( secondBatchStart + sizeof( JournalRecordHeader ) + 3 );
+	}, false );
+
+	__check_recovery( "torn before the commit record", []( std::vector< uint8_t >& journal, size_t )
+	{
+		journal.resize( journal.size() - sizeof( JournalRecordHeader ) );
+	}, false );
+
+	__check_recovery( "torn within the commit record", []( std::vector< uint8_t >& journal, size_t )
+	{
+		journal.resize( journal.size() - 1 );
+	}, false );
+
+	__check_recovery( "corrupt record data", []( std::vector< uint8_t >& journal, size_t secondBatchStart )
+	{
+		journal[ secondBatchStart + sizeof( JournalRecordHeader ) ] ^= 0x01;
+	}, false );
+
+	__check_recovery( "trailing garbage", []( std::vector< uint8_t >& journal, size_t secondBatchStart )
+	{
+		journal.resize( secondBatchStart );
+		journal.insert( journal.end(), 100, 0xA5 );
+	}, false );
+
+	__check_close();
+	__check_view();
+
+	unlink( _G_Path.c_str() );
+	unlink( _G_JournalPath.c_str() );
+	return CHECK_RESULT();
+}